@@ -0,0 +1,340 @@
+#include "data_thread.h"
+#include "tick_store.h"
+#include "../utils/mem_track.h"
+#include "raylib.h"
+#include "../utils/trace.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Triple buffer: the writer fills one slot, the reader holds another and
+// `ready` names the latest published one. SNAPSHOT_FRESH marks a published
+// slot the reader has not picked up yet.
+#define SNAPSHOT_SLOTS 3
+#define SNAPSHOT_INDEX_MASK 3u
+#define SNAPSHOT_FRESH 4u
+
+// Longest sleep while idle; commands wake the thread immediately
+#define DATA_THREAD_IDLE_WAIT_SECONDS 0.1
+
+struct DataThread {
+  SimReplay *replay;
+  bool owns_replay; // Closed on stop; false for data_thread_start_shared
+  pthread_t thread;
+  pthread_mutex_t wake_mutex;
+  pthread_cond_t wake_cond;
+  bool wake_pending; // Guarded by wake_mutex
+
+  SimSnapshot slots[SNAPSHOT_SLOTS];
+  atomic_uint ready;
+  int write_index; // Data thread only
+  int read_index;  // Render thread only
+  bool has_snapshot;
+
+  atomic_bool quit;
+  atomic_bool playing;
+  atomic_int requested_tick; // -1 when no seek is pending
+  atomic_int fog_owner;      // 0 when no perspective is active
+  FogGrid fog;               // Data thread only
+  atomic_size_t tick_store_budget; // 0 keeps no decoded ticks
+  TickStore *tick_store;           // Data thread only
+  bool tick_store_full;            // Data thread only
+  double tick_interval;
+  unsigned long sequence;
+};
+
+static double data_thread_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void data_thread_wake(DataThread *data) {
+  pthread_mutex_lock(&data->wake_mutex);
+  data->wake_pending = true;
+  pthread_cond_signal(&data->wake_cond);
+  pthread_mutex_unlock(&data->wake_mutex);
+}
+
+static void data_thread_sleep(DataThread *data, double seconds) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  long nanos = deadline.tv_nsec + (long)(seconds * 1e9);
+  deadline.tv_sec += nanos / 1000000000L;
+  deadline.tv_nsec = nanos % 1000000000L;
+
+  pthread_mutex_lock(&data->wake_mutex);
+  if (!data->wake_pending)
+    pthread_cond_timedwait(&data->wake_cond, &data->wake_mutex, &deadline);
+  data->wake_pending = false;
+  pthread_mutex_unlock(&data->wake_mutex);
+}
+
+// Restricts a freshly decoded snapshot to what the fog owner can see,
+// before the culling grids are built from it
+static void data_thread_apply_fog(DataThread *data, SimSnapshot *snapshot,
+                                  int tick) {
+  int owner = atomic_load(&data->fog_owner);
+  if (owner <= 0) {
+    snapshot->fog.owner = 0;
+    return;
+  }
+
+  if (data->fog.layers.owner != owner) {
+    // Keep versions increasing across owners so cached overlays refresh
+    unsigned long version = data->fog.layers.version + 1;
+    const TileMap *map = GetReplayMap(data->replay);
+    fog_free(&data->fog);
+    if (!fog_init(&data->fog, map->width, map->height, owner,
+                  FOG_DEFAULT_SIGHT_RADIUS)) {
+      snapshot->fog.owner = 0;
+      return;
+    }
+    data->fog.layers.version = version;
+  }
+
+  TRACE_ZONE_BEGIN(zone, "fog_update");
+  SimulationState *sim = &snapshot->sim;
+  if (!fog_update(&data->fog, sim->units, sim->unitCount, tick) ||
+      !fog_copy_layers(&snapshot->fog, &data->fog.layers)) {
+    snapshot->fog.owner = 0;
+    TRACE_ZONE_END(zone);
+    return;
+  }
+  sim->unitCount = fog_filter_units(&data->fog, sim->units, sim->unitCount);
+  sim->objectCount =
+      fog_filter_objects(&data->fog, sim->objects, sim->objectCount);
+  TRACE_ZONE_END(zone);
+}
+
+// Serves a tick from the tick store when it holds it and parses the replay
+// otherwise, adding the result to the store
+static bool data_thread_decode(DataThread *data, int tick,
+                               SimulationState *sim) {
+  size_t budget = atomic_load(&data->tick_store_budget);
+  if (data->tick_store && tick_store_budget(data->tick_store) != budget) {
+    tick_store_destroy(data->tick_store);
+    data->tick_store = NULL;
+    data->tick_store_full = false;
+  }
+  if (budget > 0 && !data->tick_store) {
+    const TileMap *map = GetReplayMap(data->replay);
+    data->tick_store = tick_store_create(map->width, map->height, budget);
+  }
+
+  if (data->tick_store && tick_store_get(data->tick_store, tick, sim)) {
+    sim->map = *GetReplayMap(data->replay);
+    sim->totalTicks = GetReplayTickCount(data->replay);
+    return true;
+  }
+  if (!LoadReplayTick(data->replay, tick, sim))
+    return false;
+  if (data->tick_store && !tick_store_put(data->tick_store, tick, sim) &&
+      !data->tick_store_full) {
+    data->tick_store_full = true;
+    TickStoreStats stats;
+    tick_store_stats(data->tick_store, &stats);
+    TraceLog(LOG_INFO, "DataThread: Tick store full at %d ticks", stats.ticks);
+  }
+  return true;
+}
+
+// Decodes a tick into the write slot and swaps it into `ready`
+static bool data_thread_publish(DataThread *data, int tick) {
+  SimSnapshot *snapshot = &data->slots[data->write_index];
+  const TileMap *map = GetReplayMap(data->replay);
+  double start = data_thread_now();
+  TRACE_ZONE_BEGIN(zone, "data_thread_publish");
+
+  if (!data_thread_decode(data, tick, &snapshot->sim)) {
+    TraceLog(LOG_WARNING, "DataThread: Failed to decode tick %d", tick);
+    TRACE_ZONE_END(zone);
+    return false;
+  }
+  data_thread_apply_fog(data, snapshot, tick);
+  TRACE_ZONE_BEGIN(grid_zone, "spatial_grid_build");
+  spatial_grid_build(&snapshot->unit_grid, snapshot->sim.units,
+                     snapshot->sim.unitCount, sizeof(Unit), map->width,
+                     map->height, DATA_THREAD_GRID_CELL_TILES);
+  spatial_grid_build(&snapshot->object_grid, snapshot->sim.objects,
+                     snapshot->sim.objectCount, sizeof(Object), map->width,
+                     map->height, DATA_THREAD_GRID_CELL_TILES);
+  TRACE_ZONE_END(grid_zone);
+
+  snapshot->tick = tick;
+  snapshot->max_tick = GetReplayTickCount(data->replay) - 1;
+  snapshot->decode_ms = (data_thread_now() - start) * 1000.0;
+  snapshot->sequence = ++data->sequence;
+
+  unsigned int previous =
+      atomic_exchange_explicit(&data->ready, data->write_index | SNAPSHOT_FRESH,
+                               memory_order_acq_rel);
+  data->write_index = (int)(previous & SNAPSHOT_INDEX_MASK);
+  TRACE_ZONE_END(zone);
+  return true;
+}
+
+static void *data_thread_main(void *arg) {
+  DataThread *data = (DataThread *)arg;
+  int current_tick = -1;
+  int published_fog_owner = 0;
+  // Tick count when tick 0 last failed to decode; retried once it changes
+  int failed_tick_count = -1;
+  double next_advance = 0.0;
+  trace_set_thread_name("data");
+
+  while (!atomic_load(&data->quit)) {
+    int target = atomic_exchange(&data->requested_tick, -1);
+    double now = data_thread_now();
+    int fog_owner = atomic_load(&data->fog_owner);
+    // Grows while the replay is still being indexed
+    int max_tick = GetReplayTickCount(data->replay) - 1;
+
+    if (target < 0 && current_tick < 0 && max_tick + 1 != failed_tick_count)
+      target = 0;
+    // Perspective changed: republish the current tick through the new fog
+    if (target < 0 && fog_owner != published_fog_owner)
+      target = current_tick;
+    if (target < 0 && atomic_load(&data->playing) && current_tick < max_tick &&
+        now >= next_advance)
+      target = current_tick + 1;
+
+    if (target >= 0) {
+      if (target > max_tick)
+        target = max_tick;
+      bool published = data_thread_publish(data, target);
+      if (published)
+        current_tick = target;
+      else if (current_tick < 0)
+        failed_tick_count = max_tick + 1;
+      published_fog_owner = fog_owner;
+      next_advance = now + data->tick_interval;
+      // A failed decode waits like an idle pass instead of retrying at once
+      if (published)
+        continue;
+    }
+
+    double wait = DATA_THREAD_IDLE_WAIT_SECONDS;
+    if (atomic_load(&data->playing) && current_tick < max_tick &&
+        next_advance - now < wait)
+      wait = next_advance - now;
+    data_thread_sleep(data, wait);
+  }
+
+  return NULL;
+}
+
+static DataThread *data_thread_launch(SimReplay *replay, double tick_rate,
+                                      bool owns_replay) {
+  if (!replay || GetReplayTickCount(replay) == 0) {
+    if (owns_replay)
+      CloseReplay(replay);
+    return NULL;
+  }
+
+  DataThread *data = (DataThread *)mem_track_calloc(MEM_SUBSYSTEM_LOADER, 1,
+                                                    sizeof(DataThread));
+  if (!data) {
+    if (owns_replay)
+      CloseReplay(replay);
+    return NULL;
+  }
+
+  data->replay = replay;
+  data->owns_replay = owns_replay;
+  data->tick_interval = tick_rate > 0 ? 1.0 / tick_rate : 0.0;
+  data->write_index = 0;
+  data->read_index = 2;
+  atomic_init(&data->ready, 1u);
+  atomic_init(&data->quit, false);
+  atomic_init(&data->playing, false);
+  atomic_init(&data->requested_tick, -1);
+  atomic_init(&data->fog_owner, 0);
+  atomic_init(&data->tick_store_budget, 0);
+  pthread_mutex_init(&data->wake_mutex, NULL);
+  pthread_cond_init(&data->wake_cond, NULL);
+
+  if (pthread_create(&data->thread, NULL, data_thread_main, data) != 0) {
+    TraceLog(LOG_ERROR, "DataThread: Failed to start thread");
+    pthread_cond_destroy(&data->wake_cond);
+    pthread_mutex_destroy(&data->wake_mutex);
+    if (owns_replay)
+      CloseReplay(replay);
+    mem_track_free(data);
+    return NULL;
+  }
+
+  return data;
+}
+
+DataThread *data_thread_start(SimReplay *replay, double tick_rate) {
+  return data_thread_launch(replay, tick_rate, true);
+}
+
+DataThread *data_thread_start_shared(SimReplay *replay, double tick_rate) {
+  return data_thread_launch(replay, tick_rate, false);
+}
+
+void data_thread_stop(DataThread *data) {
+  if (!data)
+    return;
+
+  atomic_store(&data->quit, true);
+  data_thread_wake(data);
+  pthread_join(data->thread, NULL);
+
+  for (int i = 0; i < SNAPSHOT_SLOTS; i++) {
+    FreeStateEntities(&data->slots[i].sim);
+    spatial_grid_free(&data->slots[i].unit_grid);
+    spatial_grid_free(&data->slots[i].object_grid);
+    fog_free_layers(&data->slots[i].fog);
+  }
+  fog_free(&data->fog);
+  if (data->tick_store) {
+    TickStoreStats stats;
+    tick_store_stats(data->tick_store, &stats);
+    TraceLog(LOG_INFO,
+             "DataThread: Tick store held %d ticks in %.1f MB, %.1fx smaller "
+             "than decoded; %lu hits, %lu misses",
+             stats.ticks, stats.bytes / (1024.0 * 1024.0),
+             stats.bytes ? (double)stats.raw_bytes / stats.bytes : 0.0,
+             stats.hits, stats.misses);
+    tick_store_destroy(data->tick_store);
+  }
+  pthread_cond_destroy(&data->wake_cond);
+  pthread_mutex_destroy(&data->wake_mutex);
+  if (data->owns_replay)
+    CloseReplay(data->replay);
+  mem_track_free(data);
+}
+
+const SimSnapshot *data_thread_acquire_snapshot(DataThread *data) {
+  if (atomic_load_explicit(&data->ready, memory_order_acquire) &
+      SNAPSHOT_FRESH) {
+    unsigned int previous = atomic_exchange_explicit(
+        &data->ready, (unsigned int)data->read_index, memory_order_acq_rel);
+    data->read_index = (int)(previous & SNAPSHOT_INDEX_MASK);
+    data->has_snapshot = true;
+  }
+  return data->has_snapshot ? &data->slots[data->read_index] : NULL;
+}
+
+void data_thread_set_playing(DataThread *data, bool playing) {
+  atomic_store(&data->playing, playing);
+  data_thread_wake(data);
+}
+
+void data_thread_request_tick(DataThread *data, int tick) {
+  atomic_store(&data->requested_tick, tick < 0 ? 0 : tick);
+  data_thread_wake(data);
+}
+
+void data_thread_set_tick_store_budget(DataThread *data, size_t bytes) {
+  atomic_store(&data->tick_store_budget, bytes);
+}
+
+void data_thread_set_fog_owner(DataThread *data, int owner) {
+  atomic_store(&data->fog_owner, owner < 0 ? 0 : owner);
+  data_thread_wake(data);
+}
@@ -0,0 +1,109 @@
+#ifndef DATA_THREAD_H
+#define DATA_THREAD_H
+
+#include "../utils/spatial_grid.h"
+#include "fog.h"
+#include "sim_loader.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Background thread that owns the replay timeline and tick decoding
+ *
+ * The data thread decodes ticks from a SimReplay, builds per-tick culling
+ * structures and publishes the result as immutable snapshots through a
+ * lock-free triple buffer. The render thread only ever picks up the latest
+ * published snapshot, so frame time no longer depends on I/O or decode time.
+ * Commands from the render thread (play/pause, seek) are plain atomics.
+ */
+
+// Playback speed when playing, in ticks per second
+#define DATA_THREAD_DEFAULT_TICK_RATE 60.0
+// Cell edge, in tiles, of the per-snapshot culling grids
+#define DATA_THREAD_GRID_CELL_TILES 8
+
+/**
+ * @brief One published tick; immutable once handed to the render thread
+ */
+typedef struct {
+  SimulationState sim;  // Map is shared with the replay, entities are owned
+  SpatialGrid unit_grid;   // Units bucketed by map cell for culling
+  SpatialGrid object_grid; // Objects bucketed by map cell for culling
+  FogLayers fog; // Viewer's visibility; fog.owner is 0 without a perspective
+  int tick;
+  int max_tick;
+  double decode_ms;       // Time spent decoding and preprocessing this tick
+  unsigned long sequence; // Increments with every publish
+} SimSnapshot;
+
+typedef struct DataThread DataThread;
+
+/**
+ * @brief Starts the data thread for an opened replay
+ *
+ * The thread takes ownership of the replay and publishes tick 0 right away.
+ * The replay may still be indexing; playback then waits at the last indexed
+ * tick until more arrive.
+ *
+ * @param replay Opened replay
+ * @param tick_rate Playback speed in ticks per second
+ * @return DataThread* Running thread, or NULL on failure (replay is closed)
+ */
+DataThread *data_thread_start(SimReplay *replay, double tick_rate);
+
+/**
+ * @brief Starts another data thread over a replay that is already open
+ *
+ * The replay is only read, so both threads decode from the same parsed file
+ * and tick index. The caller keeps ownership and must stop this thread
+ * before the replay is closed.
+ *
+ * @param replay Opened replay, typically owned by another data thread
+ * @param tick_rate Playback speed in ticks per second
+ * @return DataThread* Running thread, or NULL on failure
+ */
+DataThread *data_thread_start_shared(SimReplay *replay, double tick_rate);
+
+/**
+ * @brief Stops the thread, then frees its snapshots and the replay if the
+ * thread owns it
+ */
+void data_thread_stop(DataThread *data);
+
+/**
+ * @brief Returns the most recently published snapshot
+ *
+ * Must only be called from the render thread. The returned snapshot stays
+ * valid and unchanged until the next call.
+ *
+ * @return const SimSnapshot* Latest snapshot, or NULL before the first one
+ */
+const SimSnapshot *data_thread_acquire_snapshot(DataThread *data);
+
+void data_thread_set_playing(DataThread *data, bool playing);
+void data_thread_request_tick(DataThread *data, int tick);
+
+/**
+ * @brief Keeps decoded ticks in a compact tick store
+ *
+ * Ticks decoded from then on are kept quantized and compressed, so going
+ * back to them skips parsing; see tick_store.h for the error bounds. The
+ * store is filled until it reaches the budget. Changing the budget drops
+ * the ticks held so far.
+ *
+ * @param bytes Encoded bytes to keep, or 0 to keep none (the default)
+ */
+void data_thread_set_tick_store_budget(DataThread *data, size_t bytes);
+
+/**
+ * @brief Shows the replay from one owner's perspective
+ *
+ * Snapshots then only contain the owner's units, enemy units inside its
+ * sight and objects on explored tiles, so hidden entities never reach the
+ * renderer. The current tick is republished right away.
+ *
+ * @param owner Owner to follow, or 0 to show everything
+ */
+void data_thread_set_fog_owner(DataThread *data, int owner);
+
+#endif
@@ -0,0 +1,249 @@
+#include "fog.h"
+#include "../utils/mem_track.h"
+#include <stdlib.h>
+#include <string.h>
+
+static int fog_word_count(int width, int height) {
+  return (int)(((size_t)width * height + 63) / 64);
+}
+
+static int fog_tile_of(const FogGrid *fog, float x, float y) {
+  int tx = (int)x;
+  int ty = (int)y;
+  if (x < 0 || y < 0 || tx >= fog->layers.width || ty >= fog->layers.height)
+    return -1;
+  return ty * fog->layers.width + tx;
+}
+
+bool fog_init(FogGrid *fog, int map_width, int map_height, int owner,
+              int sight_radius) {
+  *fog = (FogGrid){0};
+  if (map_width <= 0 || map_height <= 0)
+    return false;
+  if (sight_radius < 0)
+    sight_radius = FOG_DEFAULT_SIGHT_RADIUS;
+
+  int words = fog_word_count(map_width, map_height);
+  fog->layers = (FogLayers){.owner = owner,
+                            .width = map_width,
+                            .height = map_height,
+                            .word_capacity = words};
+  fog->sight_radius = sight_radius;
+  fog->last_tick = -1;
+  fog->layers.visible = (uint64_t *)mem_track_calloc(MEM_SUBSYSTEM_ANALYSIS,
+                                                     words, sizeof(uint64_t));
+  fog->layers.explored = (uint64_t *)mem_track_calloc(MEM_SUBSYSTEM_ANALYSIS,
+                                                      words, sizeof(uint64_t));
+  fog->counts = (unsigned int *)mem_track_calloc(
+      MEM_SUBSYSTEM_ANALYSIS, (size_t)map_width * map_height,
+      sizeof(unsigned int));
+  fog->spans = (int *)mem_track_malloc(MEM_SUBSYSTEM_ANALYSIS,
+                                       (2 * sight_radius + 1) * sizeof(int));
+  if (!fog->layers.visible || !fog->layers.explored || !fog->counts ||
+      !fog->spans) {
+    fog_free(fog);
+    return false;
+  }
+
+  // Row offset dy covers columns -span..span of a disc of the sight radius
+  for (int dy = -sight_radius; dy <= sight_radius; dy++) {
+    int span = 0;
+    while ((span + 1) * (span + 1) + dy * dy <= sight_radius * sight_radius)
+      span++;
+    fog->spans[dy + sight_radius] = span;
+  }
+  return true;
+}
+
+void fog_free(FogGrid *fog) {
+  fog_free_layers(&fog->layers);
+  mem_track_free(fog->counts);
+  mem_track_free(fog->spans);
+  mem_track_free(fog->unit_cells);
+  *fog = (FogGrid){0};
+}
+
+// Adds (delta = 1) or removes (delta = -1) one unit's sight disc, flipping
+// bits only on 0 <-> 1 transitions of the per-tile count
+static void fog_stamp(FogGrid *fog, int tile, int delta) {
+  int width = fog->layers.width;
+  int height = fog->layers.height;
+  int cx = tile % width;
+  int cy = tile / width;
+  int radius = fog->sight_radius;
+  uint64_t *visible = fog->layers.visible;
+  uint64_t *explored = fog->layers.explored;
+  bool changed = false;
+
+  for (int dy = -radius; dy <= radius; dy++) {
+    int y = cy + dy;
+    if (y < 0 || y >= height)
+      continue;
+    int span = fog->spans[dy + radius];
+    int x0 = cx - span < 0 ? 0 : cx - span;
+    int x1 = cx + span >= width ? width - 1 : cx + span;
+    size_t row = (size_t)y * width;
+
+    for (int x = x0; x <= x1; x++) {
+      size_t index = row + x;
+      uint64_t bit = (uint64_t)1 << (index & 63);
+      if (delta > 0) {
+        if (fog->counts[index]++ == 0) {
+          visible[index >> 6] |= bit;
+          explored[index >> 6] |= bit;
+          changed = true;
+        }
+      } else if (--fog->counts[index] == 0) {
+        visible[index >> 6] &= ~bit;
+        changed = true;
+      }
+    }
+  }
+
+  if (changed)
+    fog->layers.version++;
+}
+
+bool fog_update(FogGrid *fog, const Unit *units, int count, int tick) {
+  if (!fog->counts)
+    return false;
+
+  int owner = fog->layers.owner;
+  int own_count = 0;
+  for (int i = 0; i < count; i++)
+    own_count += units[i].owner == owner;
+
+  if (own_count > fog->unit_capacity) {
+    int capacity = fog->unit_capacity ? fog->unit_capacity : 256;
+    while (capacity < own_count)
+      capacity *= 2;
+    int *grown = (int *)mem_track_realloc(
+        MEM_SUBSYSTEM_ANALYSIS, fog->unit_cells, capacity * sizeof(int));
+    if (!grown)
+      return false;
+    fog->unit_cells = grown;
+    fog->unit_capacity = capacity;
+  }
+
+  // Seeking back forgets what was explored; the discs of units that did not
+  // move would not be re-stamped incrementally, so rebuild everything
+  bool rewound = tick < fog->last_tick;
+  if (rewound) {
+    memset(fog->layers.explored, 0,
+           fog->layers.word_capacity * sizeof(uint64_t));
+    fog->layers.version++;
+  }
+  fog->last_tick = tick;
+
+  // Count how many units changed tile; past half of them, clearing and
+  // stamping everything is cheaper than removing and re-adding discs
+  int changed = abs(own_count - fog->unit_count);
+  int k = 0;
+  for (int i = 0; i < count && k < fog->unit_count; i++) {
+    if (units[i].owner != owner)
+      continue;
+    changed += fog_tile_of(fog, units[i].x, units[i].y) != fog->unit_cells[k];
+    k++;
+  }
+
+  if (rewound || changed * 2 > own_count) {
+    memset(fog->counts, 0,
+           (size_t)fog->layers.width * fog->layers.height * sizeof(unsigned int));
+    memset(fog->layers.visible, 0,
+           fog->layers.word_capacity * sizeof(uint64_t));
+    fog->layers.version++;
+    k = 0;
+    for (int i = 0; i < count; i++) {
+      if (units[i].owner != owner)
+        continue;
+      int tile = fog_tile_of(fog, units[i].x, units[i].y);
+      fog->unit_cells[k++] = tile;
+      if (tile >= 0)
+        fog_stamp(fog, tile, 1);
+    }
+    fog->unit_count = own_count;
+    return true;
+  }
+
+  k = 0;
+  for (int i = 0; i < count; i++) {
+    if (units[i].owner != owner)
+      continue;
+    int tile = fog_tile_of(fog, units[i].x, units[i].y);
+    if (k < fog->unit_count) {
+      if (tile == fog->unit_cells[k]) {
+        k++;
+        continue;
+      }
+      if (fog->unit_cells[k] >= 0)
+        fog_stamp(fog, fog->unit_cells[k], -1);
+    }
+    if (tile >= 0)
+      fog_stamp(fog, tile, 1);
+    fog->unit_cells[k++] = tile;
+  }
+  // Units that disappeared since the previous tick
+  for (; k < fog->unit_count; k++) {
+    if (fog->unit_cells[k] >= 0)
+      fog_stamp(fog, fog->unit_cells[k], -1);
+  }
+  fog->unit_count = own_count;
+  return true;
+}
+
+int fog_filter_units(const FogGrid *fog, Unit *units, int count) {
+  int kept = 0;
+  for (int i = 0; i < count; i++) {
+    int tile = fog_tile_of(fog, units[i].x, units[i].y);
+    bool seen = tile >= 0 && fog_layer_bit(fog->layers.visible,
+                                           fog->layers.width,
+                                           tile % fog->layers.width,
+                                           tile / fog->layers.width);
+    if (units[i].owner == fog->layers.owner || seen)
+      units[kept++] = units[i];
+  }
+  return kept;
+}
+
+int fog_filter_objects(const FogGrid *fog, Object *objects, int count) {
+  int kept = 0;
+  for (int i = 0; i < count; i++) {
+    int tile = fog_tile_of(fog, objects[i].x, objects[i].y);
+    if (tile >= 0 && fog_layer_bit(fog->layers.explored, fog->layers.width,
+                                   tile % fog->layers.width,
+                                   tile / fog->layers.width))
+      objects[kept++] = objects[i];
+  }
+  return kept;
+}
+
+bool fog_copy_layers(FogLayers *dst, const FogLayers *src) {
+  int words = fog_word_count(src->width, src->height);
+  if (words > dst->word_capacity) {
+    uint64_t *visible = (uint64_t *)mem_track_realloc(
+        MEM_SUBSYSTEM_ANALYSIS, dst->visible, words * sizeof(uint64_t));
+    if (!visible)
+      return false;
+    dst->visible = visible;
+    uint64_t *explored = (uint64_t *)mem_track_realloc(
+        MEM_SUBSYSTEM_ANALYSIS, dst->explored, words * sizeof(uint64_t));
+    if (!explored)
+      return false;
+    dst->explored = explored;
+    dst->word_capacity = words;
+  }
+
+  memcpy(dst->visible, src->visible, words * sizeof(uint64_t));
+  memcpy(dst->explored, src->explored, words * sizeof(uint64_t));
+  dst->owner = src->owner;
+  dst->width = src->width;
+  dst->height = src->height;
+  dst->version = src->version;
+  return true;
+}
+
+void fog_free_layers(FogLayers *layers) {
+  mem_track_free(layers->visible);
+  mem_track_free(layers->explored);
+  *layers = (FogLayers){0};
+}
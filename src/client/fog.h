@@ -0,0 +1,90 @@
+#ifndef FOG_H
+#define FOG_H
+
+#include "sim_loader.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Fog of war for one owner over the tile map
+ *
+ * Every cell keeps a count of the owner's units that can see it; a cell is
+ * visible while its count is non-zero and explored once it has ever been
+ * visible. Updates diff each unit's tile against the previous tick and only
+ * re-stamp sight discs for units that changed tile, so ticks where few units
+ * move cost little. Units are matched by their order among the owner's
+ * units; a mismatch only costs extra work, never wrong counts.
+ */
+
+// Sight radius in tiles used when none is given
+#define FOG_DEFAULT_SIGHT_RADIUS 8
+
+/**
+ * @brief Visibility bitsets, one bit per tile, row-major
+ */
+typedef struct {
+  int owner; // 0 when no perspective is active
+  int width;
+  int height;
+  uint64_t *visible;
+  uint64_t *explored;
+  int word_capacity;
+  unsigned long version; // Changes whenever any bit changes
+} FogLayers;
+
+typedef struct {
+  FogLayers layers;
+  int sight_radius;
+  unsigned int *counts; // Units of the owner seeing each tile
+  int *spans;           // Disc half-width for each row offset
+  int *unit_cells;      // Tile stamped for each of the owner's units
+  int unit_count;
+  int unit_capacity;
+  int last_tick;
+} FogGrid;
+
+/**
+ * @brief Sets up an empty grid for one owner
+ * @return bool False on allocation failure
+ */
+bool fog_init(FogGrid *fog, int map_width, int map_height, int owner,
+              int sight_radius);
+void fog_free(FogGrid *fog);
+
+/**
+ * @brief Moves the owner's sight to a tick's unit positions
+ *
+ * Explored cells accumulate over the ticks passed in; going back in time
+ * restarts exploration from the new tick.
+ *
+ * @return bool False if per-unit storage could not be grown
+ */
+bool fog_update(FogGrid *fog, const Unit *units, int count, int tick);
+
+/**
+ * @brief Drops units the owner cannot see, keeping the owner's own
+ * @return int Number of units kept at the front of the array
+ */
+int fog_filter_units(const FogGrid *fog, Unit *units, int count);
+
+/**
+ * @brief Drops objects on tiles the owner has never explored
+ * @return int Number of objects kept at the front of the array
+ */
+int fog_filter_objects(const FogGrid *fog, Object *objects, int count);
+
+/**
+ * @brief Copies the bitsets into caller-owned layers, growing them as needed
+ * @return bool False on allocation failure
+ */
+bool fog_copy_layers(FogLayers *dst, const FogLayers *src);
+void fog_free_layers(FogLayers *layers);
+
+static inline bool fog_layer_bit(const uint64_t *bits, int width, int x,
+                                 int y) {
+  size_t index = (size_t)y * width + x;
+  return (bits[index >> 6] >> (index & 63)) & 1u;
+}
+
+#endif
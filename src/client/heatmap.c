@@ -0,0 +1,316 @@
+#include "heatmap.h"
+#include "../utils/job_system.h"
+#include "../utils/mem_track.h"
+#include "../utils/trace.h"
+#include "raylib.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Increments are encoded as cell * 8 + owner layer, 0 for no owner layer
+#define HEATMAP_LAYER_BITS 3
+// Ticks in a slice before it is worth a job of its own
+#define HEATMAP_SLICE_MIN_TICKS 32
+
+typedef struct {
+  Heatmap *heatmap;
+  int first_tick;
+  int end_tick;
+  int stop_tick; // Ticks before this one were recorded
+  int max_units; // Most units in one of those ticks
+  // Cells visited by the slice's unit-ticks, kept across batches
+  uint64_t *increments;
+  size_t increment_count;
+  size_t increment_capacity;
+  bool failed; // Out of memory; the batch is accumulated again later
+} HeatmapSlice;
+
+struct Heatmap {
+  const SimReplay *replay;
+  int width;
+  int height;
+  unsigned int *counts; // HEATMAP_LAYERS grids of width * height
+  unsigned int layer_max[HEATMAP_LAYERS];
+  int ticks_covered;
+  int units_per_tick; // Most units in a tick of the last batch
+  unsigned long version;
+
+  HeatmapSlice slices[HEATMAP_MAX_SLICES];
+  int slice_count; // Slices queued for the current batch, 0 when idle
+  int batch_end_tick;
+  bool batch_merged; // Set by the merge job when the counts took the batch
+  JobCounter batch;  // Accumulating slices
+  JobCounter merge;  // The merge, started once the batch is done
+  JobCounter *reader; // Jobs reading the counts, or NULL
+};
+
+static size_t heatmap_cells(const Heatmap *heatmap) {
+  return (size_t)heatmap->width * heatmap->height;
+}
+
+static bool heatmap_push(HeatmapSlice *slice, uint64_t increment) {
+  if (slice->increment_count == slice->increment_capacity) {
+    size_t capacity =
+        slice->increment_capacity ? slice->increment_capacity * 2 : 4096;
+    uint64_t *grown = (uint64_t *)mem_track_realloc(
+        MEM_SUBSYSTEM_ANALYSIS, slice->increments,
+        capacity * sizeof(uint64_t));
+    if (!grown)
+      return false;
+    slice->increments = grown;
+    slice->increment_capacity = capacity;
+  }
+  slice->increments[slice->increment_count++] = increment;
+  return true;
+}
+
+static void heatmap_accumulate(void *arg) {
+  HeatmapSlice *slice = (HeatmapSlice *)arg;
+  Heatmap *heatmap = slice->heatmap;
+  SimulationState state = {0};
+
+  TRACE_ZONE_BEGIN(zone, "heatmap_accumulate");
+
+  int tick = slice->first_tick;
+  for (; !slice->failed && tick < slice->end_tick; tick++) {
+    if (!LoadReplayTick(heatmap->replay, tick, &state))
+      continue;
+    if (state.unitCount > slice->max_units)
+      slice->max_units = state.unitCount;
+    // Out of budget: the rest of the range waits for a later batch
+    if (tick > slice->first_tick &&
+        slice->increment_count + (size_t)state.unitCount >
+            HEATMAP_SLICE_MAX_INCREMENTS)
+      break;
+
+    for (int i = 0; i < state.unitCount; i++) {
+      const Unit *unit = &state.units[i];
+      int x = (int)unit->x;
+      int y = (int)unit->y;
+      if (x < 0 || y < 0 || x >= heatmap->width || y >= heatmap->height)
+        continue;
+
+      uint64_t cell = (uint64_t)y * heatmap->width + x;
+      int layer = unit->owner > 0 && unit->owner <= HEATMAP_MAX_OWNERS
+                      ? unit->owner
+                      : HEATMAP_LAYER_ALL;
+      if (!heatmap_push(slice, cell << HEATMAP_LAYER_BITS | layer)) {
+        slice->failed = true;
+        break;
+      }
+    }
+  }
+
+  slice->stop_tick = tick;
+  FreeStateEntities(&state);
+  TRACE_ZONE_END(zone);
+}
+
+static void heatmap_count(Heatmap *heatmap, int layer, size_t index) {
+  unsigned int count = ++heatmap->counts[index];
+  if (count > heatmap->layer_max[layer])
+    heatmap->layer_max[layer] = count;
+}
+
+// Continuation of a batch: applies the increments of the ticks every
+// slice before them recorded to the counts. Counts only grow, so the layer
+// maxima follow without rescanning the grids.
+static void heatmap_merge(void *arg) {
+  Heatmap *heatmap = (Heatmap *)arg;
+  size_t cells = heatmap_cells(heatmap);
+
+  // The next batch is sized from this one, so it shrinks after a burst
+  heatmap->units_per_tick = 0;
+  for (int s = 0; s < heatmap->slice_count; s++) {
+    if (heatmap->slices[s].max_units > heatmap->units_per_tick)
+      heatmap->units_per_tick = heatmap->slices[s].max_units;
+    if (heatmap->slices[s].failed)
+      return;
+  }
+
+  // Slices after one that stopped short would leave a gap in the ticks
+  int merged = 0;
+  while (merged < heatmap->slice_count) {
+    const HeatmapSlice *slice = &heatmap->slices[merged++];
+    heatmap->batch_end_tick = slice->stop_tick;
+    if (slice->stop_tick < slice->end_tick)
+      break;
+  }
+
+  TRACE_ZONE_BEGIN(zone, "heatmap_merge");
+  for (int s = 0; s < merged; s++) {
+    const HeatmapSlice *slice = &heatmap->slices[s];
+    for (size_t i = 0; i < slice->increment_count; i++) {
+      uint64_t increment = slice->increments[i];
+      size_t cell = (size_t)(increment >> HEATMAP_LAYER_BITS);
+      int layer = (int)(increment & ((1u << HEATMAP_LAYER_BITS) - 1));
+      heatmap_count(heatmap, HEATMAP_LAYER_ALL, cell);
+      if (layer != HEATMAP_LAYER_ALL)
+        heatmap_count(heatmap, layer, layer * cells + cell);
+    }
+  }
+  heatmap->batch_merged = true;
+  TRACE_ZONE_END(zone);
+}
+
+// One slice per job worker
+static int heatmap_slice_limit(void) {
+  int workers = job_system_worker_count();
+  int limit = workers < 1 ? 1 : workers;
+  return limit < HEATMAP_MAX_SLICES ? limit : HEATMAP_MAX_SLICES;
+}
+
+// Splits up to HEATMAP_MAX_BATCH_TICKS new ticks into contiguous ranges,
+// one job each, and queues their merge behind them
+static void heatmap_launch(Heatmap *heatmap, int tick_count) {
+  int first = heatmap->ticks_covered;
+  int total = tick_count - first;
+  if (total > HEATMAP_MAX_BATCH_TICKS)
+    total = HEATMAP_MAX_BATCH_TICKS;
+
+  // Ticks a slice can record within its budget at the unit count seen so
+  // far; short batches get fewer slices, each still within the budget
+  int limit = heatmap_slice_limit();
+  int slice_ticks = HEATMAP_MAX_BATCH_TICKS;
+  if (heatmap->units_per_tick > 0 &&
+      HEATMAP_SLICE_MAX_INCREMENTS / heatmap->units_per_tick < slice_ticks)
+    slice_ticks = HEATMAP_SLICE_MAX_INCREMENTS / heatmap->units_per_tick;
+  if (slice_ticks < 1)
+    slice_ticks = 1;
+  if (total > limit * slice_ticks)
+    total = limit * slice_ticks;
+  int min_ticks = slice_ticks < HEATMAP_SLICE_MIN_TICKS
+                      ? slice_ticks
+                      : HEATMAP_SLICE_MIN_TICKS;
+  int slices = (total + min_ticks - 1) / min_ticks;
+  if (slices > limit)
+    slices = limit;
+
+  for (int s = 0; s < slices; s++) {
+    HeatmapSlice *slice = &heatmap->slices[s];
+    slice->heatmap = heatmap;
+    slice->first_tick = first + (int)((long)total * s / slices);
+    slice->end_tick = first + (int)((long)total * (s + 1) / slices);
+    slice->stop_tick = slice->first_tick;
+    slice->max_units = 0;
+    slice->increment_count = 0;
+    slice->failed = false;
+  }
+  heatmap->slice_count = slices;
+  heatmap->batch_end_tick = first + total;
+  heatmap->batch_merged = false;
+
+  for (int s = 0; s < slices; s++)
+    job_run(heatmap_accumulate, &heatmap->slices[s], &heatmap->batch);
+  job_run_after(&heatmap->batch, heatmap_merge, heatmap, &heatmap->merge);
+}
+
+Heatmap *heatmap_create(const SimReplay *replay) {
+  const TileMap *map = GetReplayMap(replay);
+  if (!map)
+    return NULL;
+
+  Heatmap *heatmap =
+      (Heatmap *)mem_track_calloc(MEM_SUBSYSTEM_ANALYSIS, 1, sizeof(Heatmap));
+  if (!heatmap)
+    return NULL;
+
+  heatmap->replay = replay;
+  heatmap->width = map->width;
+  heatmap->height = map->height;
+  heatmap->counts = (unsigned int *)mem_track_calloc(
+      MEM_SUBSYSTEM_ANALYSIS, HEATMAP_LAYERS * heatmap_cells(heatmap),
+      sizeof(unsigned int));
+  if (!heatmap->counts) {
+    mem_track_free(heatmap);
+    return NULL;
+  }
+  heatmap_update(heatmap);
+  return heatmap;
+}
+
+// Frees the recorded cells; the next batch allocates them again
+static void heatmap_release_slices(Heatmap *heatmap) {
+  for (int s = 0; s < HEATMAP_MAX_SLICES; s++) {
+    HeatmapSlice *slice = &heatmap->slices[s];
+    mem_track_free(slice->increments);
+    slice->increments = NULL;
+    slice->increment_count = 0;
+    slice->increment_capacity = 0;
+  }
+}
+
+void heatmap_destroy(Heatmap *heatmap) {
+  if (!heatmap)
+    return;
+  job_wait(&heatmap->merge);
+  if (heatmap->reader)
+    job_wait(heatmap->reader);
+  heatmap_release_slices(heatmap);
+  mem_track_free(heatmap->counts);
+  mem_track_free(heatmap);
+}
+
+bool heatmap_update(Heatmap *heatmap) {
+  // A merged batch is published, and the next one waits for the next
+  // update so the counts stay still while this frame reads them
+  if (heatmap->slice_count > 0) {
+    if (!job_counter_done(&heatmap->merge))
+      return false;
+    heatmap->slice_count = 0;
+    if (!heatmap->batch_merged) {
+      TraceLog(LOG_WARNING, "Heatmap: Out of memory; retrying ticks %d-%d",
+               heatmap->ticks_covered, heatmap->batch_end_tick);
+      return false;
+    }
+    heatmap->ticks_covered = heatmap->batch_end_tick;
+    heatmap->version++;
+    if (IsReplayIndexed(heatmap->replay) &&
+        heatmap->ticks_covered == GetReplayTickCount(heatmap->replay))
+      heatmap_release_slices(heatmap);
+    return true;
+  }
+
+  if (heatmap->reader && !job_counter_done(heatmap->reader))
+    return false;
+
+  // While the replay is indexed, wait for enough ticks to be worth a batch
+  int tick_count = GetReplayTickCount(heatmap->replay);
+  int pending = tick_count - heatmap->ticks_covered;
+  if (pending >= HEATMAP_MIN_BATCH_TICKS ||
+      (pending > 0 && IsReplayIndexed(heatmap->replay)))
+    heatmap_launch(heatmap, tick_count);
+  return false;
+}
+
+int heatmap_width(const Heatmap *heatmap) { return heatmap->width; }
+
+int heatmap_height(const Heatmap *heatmap) { return heatmap->height; }
+
+const unsigned int *heatmap_layer(const Heatmap *heatmap, int layer) {
+  if (layer < 0 || layer >= HEATMAP_LAYERS)
+    layer = HEATMAP_LAYER_ALL;
+  return &heatmap->counts[layer * heatmap_cells(heatmap)];
+}
+
+void heatmap_set_reader(Heatmap *heatmap, JobCounter *reader) {
+  heatmap->reader = reader;
+}
+
+unsigned int heatmap_layer_max(const Heatmap *heatmap, int layer) {
+  if (layer < 0 || layer >= HEATMAP_LAYERS)
+    layer = HEATMAP_LAYER_ALL;
+  return heatmap->layer_max[layer];
+}
+
+unsigned long heatmap_version(const Heatmap *heatmap) {
+  return heatmap->version;
+}
+
+int heatmap_ticks_covered(const Heatmap *heatmap) {
+  return heatmap->ticks_covered;
+}
+
+bool heatmap_is_busy(const Heatmap *heatmap) {
+  return heatmap->slice_count > 0;
+}
@@ -0,0 +1,111 @@
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include "../utils/job_system.h"
+#include "sim_loader.h"
+#include <stdbool.h>
+
+/**
+ * @brief Unit occupancy accumulated over every tick of a replay
+ *
+ * Each map cell counts how many unit-ticks were spent on it, in total and
+ * per owner. New ticks are taken in batches, split into ranges decoded in
+ * parallel as jobs on the shared job system. Each range records the cells
+ * its units visited, and a continuation job adds them to the counts once
+ * every range is done, so the cost follows the number of unit-ticks, not
+ * the size of the map. While the replay is still being indexed, a batch
+ * waits for HEATMAP_MIN_BATCH_TICKS new ticks.
+ *
+ * A range records at most HEATMAP_SLICE_MAX_INCREMENTS unit-ticks, so a
+ * batch holds a bounded amount of memory whatever the unit count. Batches
+ * are sized from the most units in a tick of the last batch; a range that
+ * fills up anyway stops at a tick boundary, and only the ticks before it
+ * are merged. The recorded cells are released once the whole replay is in.
+ */
+
+// Owners with their own layer; units of other owners only count in total
+#define HEATMAP_MAX_OWNERS 4
+// Layer 0 is every owner, layer N is owner N
+#define HEATMAP_LAYER_ALL 0
+#define HEATMAP_LAYERS (HEATMAP_MAX_OWNERS + 1)
+// Upper bound on tick ranges accumulated at once
+#define HEATMAP_MAX_SLICES 8
+// New ticks needed to start a batch while the replay is being indexed
+#define HEATMAP_MIN_BATCH_TICKS 256
+// Most ticks in one batch
+#define HEATMAP_MAX_BATCH_TICKS 4096
+// Unit-ticks one range records before a merge, 8 bytes each
+#define HEATMAP_SLICE_MAX_INCREMENTS (1 << 20)
+
+typedef struct Heatmap Heatmap;
+
+/**
+ * @brief Creates an empty heatmap for a replay and starts accumulating
+ *
+ * The replay must outlive the heatmap; it is only read.
+ *
+ * @return Heatmap* New heatmap, or NULL on allocation failure
+ */
+Heatmap *heatmap_create(const SimReplay *replay);
+
+/**
+ * @brief Waits for running jobs and frees the heatmap
+ */
+void heatmap_destroy(Heatmap *heatmap);
+
+/**
+ * @brief Merges finished work and queues jobs for newly appended ticks
+ *
+ * Call once per frame from the thread that owns the heatmap; it never
+ * blocks on jobs.
+ *
+ * @return bool True when the counts changed since the previous call
+ */
+bool heatmap_update(Heatmap *heatmap);
+
+int heatmap_width(const Heatmap *heatmap);
+int heatmap_height(const Heatmap *heatmap);
+
+/**
+ * @brief Counts for one layer, row-major at map resolution
+ *
+ * The merge job writes the counts while the heatmap is busy; read them and
+ * the layer maxima only while heatmap_is_busy() is false. An update that
+ * returns true leaves the heatmap idle until the next update.
+ */
+const unsigned int *heatmap_layer(const Heatmap *heatmap, int layer);
+
+/**
+ * @brief Holds new batches back until jobs reading the counts finish
+ *
+ * Lets the counts be read from jobs started while the heatmap is idle: no
+ * batch starts, and destroying the heatmap waits, until the counter is
+ * done. Replaces any earlier reader.
+ *
+ * @param heatmap Heatmap being read
+ * @param reader Counter of the reading jobs; must outlive the heatmap or
+ *               be replaced before it goes away
+ */
+void heatmap_set_reader(Heatmap *heatmap, JobCounter *reader);
+
+/**
+ * @brief Highest count in a layer, for normalization
+ */
+unsigned int heatmap_layer_max(const Heatmap *heatmap, int layer);
+
+/**
+ * @brief Increments whenever the counts change, for caching derived data
+ */
+unsigned long heatmap_version(const Heatmap *heatmap);
+
+/**
+ * @brief Number of ticks merged into the counts so far
+ */
+int heatmap_ticks_covered(const Heatmap *heatmap);
+
+/**
+ * @brief True while jobs are accumulating or merging ticks
+ */
+bool heatmap_is_busy(const Heatmap *heatmap);
+
+#endif
@@ -0,0 +1,289 @@
+#include "replay_diff.h"
+#include "../utils/mem_track.h"
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+// Entities compared together (one SSE/NEON register per field)
+#define REPLAY_DIFF_LANES 4
+// Entities per bytewise pre-check; identical blocks skip the field compare
+#define REPLAY_DIFF_BLOCK 64
+
+#if defined(__GNUC__) || defined(__clang__)
+typedef float DiffLanes
+    __attribute__((vector_size(REPLAY_DIFF_LANES * sizeof(float))));
+typedef int DiffMask
+    __attribute__((vector_size(REPLAY_DIFF_LANES * sizeof(int))));
+#endif
+
+// Layout shared by Object and Unit: float x, y, then more float fields, and
+// for units the int owner and id after them
+typedef struct {
+  size_t stride;
+  int float_fields;
+  int int_fields;     // Int fields compared exactly
+  int int_offsets[2]; // Their byte offsets
+} EntityLayout;
+
+static inline const float *diff_fields(const unsigned char *base,
+                                       size_t stride, int index) {
+  return (const float *)(base + (size_t)index * stride);
+}
+
+static inline int diff_int_field(const unsigned char *base, size_t stride,
+                                 int index, int offset) {
+  int value;
+  memcpy(&value, base + (size_t)index * stride + offset, sizeof(int));
+  return value;
+}
+
+// Compares count entities field by field; returns how many differ and
+// raises max_sq to the largest squared position error
+static int replay_diff_range(const unsigned char *base_a,
+                             const unsigned char *base_b, int count,
+                             EntityLayout layout, float tolerance,
+                             float *max_sq_inout) {
+  size_t stride = layout.stride;
+  float tolerance_sq = tolerance * tolerance;
+  float max_sq = *max_sq_inout;
+  int changed = 0;
+  int n = 0;
+
+#if defined(__GNUC__) || defined(__clang__)
+  // Fields are gathered into lanes with vector initialisers; the change
+  // count and the running maximum are updated from masks without branches
+  DiffLanes lane_max = {0.0f, 0.0f, 0.0f, 0.0f};
+  for (; n + REPLAY_DIFF_LANES <= count; n += REPLAY_DIFF_LANES) {
+    const float *a0 = diff_fields(base_a, stride, n);
+    const float *a1 = diff_fields(base_a, stride, n + 1);
+    const float *a2 = diff_fields(base_a, stride, n + 2);
+    const float *a3 = diff_fields(base_a, stride, n + 3);
+    const float *b0 = diff_fields(base_b, stride, n);
+    const float *b1 = diff_fields(base_b, stride, n + 1);
+    const float *b2 = diff_fields(base_b, stride, n + 2);
+    const float *b3 = diff_fields(base_b, stride, n + 3);
+
+    DiffLanes dx = (DiffLanes){a0[0], a1[0], a2[0], a3[0]} -
+                   (DiffLanes){b0[0], b1[0], b2[0], b3[0]};
+    DiffLanes dy = (DiffLanes){a0[1], a1[1], a2[1], a3[1]} -
+                   (DiffLanes){b0[1], b1[1], b2[1], b3[1]};
+    DiffLanes distance_sq = dx * dx + dy * dy;
+    DiffMask differs = distance_sq > tolerance_sq;
+
+    DiffMask larger = distance_sq > lane_max;
+    lane_max = (DiffLanes)(((DiffMask)distance_sq & larger) |
+                           ((DiffMask)lane_max & ~larger));
+
+    for (int f = 2; f < layout.float_fields; f++) {
+      DiffLanes d = (DiffLanes){a0[f], a1[f], a2[f], a3[f]} -
+                    (DiffLanes){b0[f], b1[f], b2[f], b3[f]};
+      differs |= (d > tolerance) | (d < -tolerance);
+    }
+    for (int f = 0; f < layout.int_fields; f++) {
+      int offset = layout.int_offsets[f];
+      DiffMask ia = {diff_int_field(base_a, stride, n, offset),
+                     diff_int_field(base_a, stride, n + 1, offset),
+                     diff_int_field(base_a, stride, n + 2, offset),
+                     diff_int_field(base_a, stride, n + 3, offset)};
+      DiffMask ib = {diff_int_field(base_b, stride, n, offset),
+                     diff_int_field(base_b, stride, n + 1, offset),
+                     diff_int_field(base_b, stride, n + 2, offset),
+                     diff_int_field(base_b, stride, n + 3, offset)};
+      differs |= ia != ib;
+    }
+
+    // Mask lanes are 0 or -1
+    changed -= differs[0] + differs[1] + differs[2] + differs[3];
+  }
+  for (int k = 0; k < REPLAY_DIFF_LANES; k++) {
+    if (lane_max[k] > max_sq)
+      max_sq = lane_max[k];
+  }
+#endif
+
+  // Remainder (or everything without vector extensions)
+  for (; n < count; n++) {
+    const float *a = diff_fields(base_a, stride, n);
+    const float *b = diff_fields(base_b, stride, n);
+    float dx = a[0] - b[0];
+    float dy = a[1] - b[1];
+    float distance_sq = dx * dx + dy * dy;
+    bool differs = distance_sq > tolerance_sq;
+    if (distance_sq > max_sq)
+      max_sq = distance_sq;
+
+    for (int f = 2; f < layout.float_fields; f++)
+      differs = differs || fabsf(a[f] - b[f]) > tolerance;
+    for (int f = 0; f < layout.int_fields; f++)
+      differs = differs ||
+                diff_int_field(base_a, stride, n, layout.int_offsets[f]) !=
+                    diff_int_field(base_b, stride, n, layout.int_offsets[f]);
+    changed += differs;
+  }
+
+  *max_sq_inout = max_sq;
+  return changed;
+}
+
+// Compares the first count entities of both arrays; returns how many differ
+// and the largest position error among them all
+static int replay_diff_entities(const void *entities_a,
+                                const void *entities_b, int count,
+                                EntityLayout layout, float tolerance,
+                                float *max_error) {
+  const unsigned char *base_a = (const unsigned char *)entities_a;
+  const unsigned char *base_b = (const unsigned char *)entities_b;
+  float max_sq = 0.0f;
+  int changed = 0;
+
+  // Diverging replays usually still share most entities bit for bit, and
+  // memcmp runs far faster than the field compare
+  for (int start = 0; start < count; start += REPLAY_DIFF_BLOCK) {
+    int block = count - start < REPLAY_DIFF_BLOCK ? count - start
+                                                   : REPLAY_DIFF_BLOCK;
+    size_t offset = (size_t)start * layout.stride;
+    size_t bytes = (size_t)block * layout.stride;
+    if (memcmp(base_a + offset, base_b + offset, bytes) == 0)
+      continue;
+    changed += replay_diff_range(base_a + offset, base_b + offset, block,
+                                 layout, tolerance, &max_sq);
+  }
+
+  *max_error = sqrtf(max_sq);
+  return changed;
+}
+
+static bool replay_diff_all_ids(const Unit *units, int count) {
+  for (int i = 0; i < count; i++) {
+    if (units[i].id < 0)
+      return false;
+  }
+  return true;
+}
+
+static bool replay_diff_reserve(ReplayDiffScratch *scratch, int count) {
+  if (count <= scratch->matched_capacity)
+    return true;
+  int capacity = scratch->matched_capacity ? scratch->matched_capacity : 1024;
+  while (capacity < count)
+    capacity *= 2;
+  Unit *matched_a = (Unit *)mem_track_realloc(
+      MEM_SUBSYSTEM_ANALYSIS, scratch->matched_a,
+      (size_t)capacity * sizeof(Unit));
+  if (!matched_a)
+    return false;
+  scratch->matched_a = matched_a;
+  Unit *matched_b = (Unit *)mem_track_realloc(
+      MEM_SUBSYSTEM_ANALYSIS, scratch->matched_b,
+      (size_t)capacity * sizeof(Unit));
+  if (!matched_b)
+    return false;
+  scratch->matched_b = matched_b;
+  scratch->matched_capacity = capacity;
+  return true;
+}
+
+// Matches units by id and compares the pairs; false if out of memory
+static bool replay_diff_units_by_id(const SimulationState *a,
+                                    const SimulationState *b,
+                                    float tolerance, EntityLayout layout,
+                                    ReplayDiffScratch *scratch,
+                                    ReplayTickDiff *out) {
+  UnitMatcher *matcher = &scratch->matcher;
+  if (!unit_matcher_match(matcher, a->units, a->unitCount, b->units,
+                          b->unitCount, a->map.width, a->map.height))
+    return false;
+
+  int matched = 0;
+  bool in_place = a->unitCount == b->unitCount;
+  for (int j = 0; j < b->unitCount; j++) {
+    matched += matcher->sources[j] >= 0;
+    in_place = in_place && matcher->sources[j] == j;
+  }
+  out->units_added = b->unitCount - matched;
+  out->units_removed = a->unitCount - matched;
+
+  // Replays that keep their unit order compare in place
+  if (in_place) {
+    out->units_changed =
+        replay_diff_entities(a->units, b->units, matched, layout, tolerance,
+                             &out->max_unit_error);
+    return true;
+  }
+
+  if (!replay_diff_reserve(scratch, matched))
+    return false;
+  int pair = 0;
+  for (int j = 0; j < b->unitCount; j++) {
+    int source = matcher->sources[j];
+    if (source < 0)
+      continue;
+    scratch->matched_a[pair] = a->units[source];
+    scratch->matched_b[pair] = b->units[j];
+    pair++;
+  }
+  out->units_changed =
+      replay_diff_entities(scratch->matched_a, scratch->matched_b, matched,
+                           layout, tolerance, &out->max_unit_error);
+  return true;
+}
+
+bool replay_diff_tick(const SimulationState *a, const SimulationState *b,
+                      float tolerance, ReplayDiffScratch *scratch,
+                      ReplayTickDiff *out) {
+  static const EntityLayout UNIT_LAYOUT = {
+      sizeof(Unit), 5, 2,
+      {(int)offsetof(Unit, owner), (int)offsetof(Unit, id)}};
+  static const EntityLayout OBJECT_LAYOUT = {sizeof(Object), 3, 0, {0, 0}};
+
+  *out = (ReplayTickDiff){
+      .units_a = a->unitCount,
+      .units_b = b->unitCount,
+      .objects_a = a->objectCount,
+      .objects_b = b->objectCount,
+  };
+
+  if (replay_diff_all_ids(a->units, a->unitCount) &&
+      replay_diff_all_ids(b->units, b->unitCount)) {
+    if (!replay_diff_units_by_id(a, b, tolerance, UNIT_LAYOUT, scratch, out))
+      return false;
+  } else {
+    int units = a->unitCount < b->unitCount ? a->unitCount : b->unitCount;
+    out->units_added = b->unitCount - units;
+    out->units_removed = a->unitCount - units;
+    out->units_changed =
+        replay_diff_entities(a->units, b->units, units, UNIT_LAYOUT,
+                             tolerance, &out->max_unit_error);
+  }
+
+  int objects =
+      a->objectCount < b->objectCount ? a->objectCount : b->objectCount;
+  out->objects_added = b->objectCount - objects;
+  out->objects_removed = a->objectCount - objects;
+  out->objects_changed =
+      replay_diff_entities(a->objects, b->objects, objects, OBJECT_LAYOUT,
+                           tolerance, &out->max_object_error);
+  return true;
+}
+
+void replay_diff_scratch_free(ReplayDiffScratch *scratch) {
+  unit_matcher_free(&scratch->matcher);
+  mem_track_free(scratch->matched_a);
+  mem_track_free(scratch->matched_b);
+  *scratch = (ReplayDiffScratch){0};
+}
+
+bool replay_diff_differs(const ReplayTickDiff *diff) {
+  return diff->units_changed > 0 || diff->units_added > 0 ||
+         diff->units_removed > 0 || diff->objects_changed > 0 ||
+         diff->objects_added > 0 || diff->objects_removed > 0;
+}
+
+bool replay_diff_maps_equal(const TileMap *a, const TileMap *b) {
+  // Paged maps are only known to match when they are the same file
+  if (a->paged || b->paged)
+    return a->paged == b->paged;
+  return a->width == b->width && a->height == b->height &&
+         memcmp(a->tiles, b->tiles,
+                (size_t)a->width * a->height * sizeof(Tile)) == 0;
+}
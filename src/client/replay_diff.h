@@ -0,0 +1,81 @@
+#ifndef REPLAY_DIFF_H
+#define REPLAY_DIFF_H
+
+#include "sim_loader.h"
+#include "unit_events.h"
+#include <stdbool.h>
+
+/**
+ * @brief Differences between the same tick of two replays
+ *
+ * When every unit of both ticks carries an id, units are matched by id, so
+ * a unit that died and one that spawned count as one removed and one
+ * added. Otherwise, and always for objects, which have no ids, entities
+ * are matched by their index in the tick: entities past the shorter array
+ * count as added or removed, and an insertion early in the array shifts
+ * every later entity onto a different one.
+ */
+typedef struct {
+  int units_a;
+  int units_b;
+  int units_added;      // Units of b without a match in a
+  int units_removed;    // Units of a without a match in b
+  int units_changed;    // Matched units differing by more than the tolerance
+  float max_unit_error; // Largest position error of a matched unit, in tiles
+  int objects_a;
+  int objects_b;
+  int objects_added;
+  int objects_removed;
+  int objects_changed;
+  float max_object_error;
+} ReplayTickDiff;
+
+/**
+ * @brief Scratch reused across ticks by replay_diff_tick()
+ *
+ * Zero-initialise and release with replay_diff_scratch_free().
+ */
+typedef struct {
+  UnitMatcher matcher;
+  Unit *matched_a; // Units matched by id, gathered pairwise
+  Unit *matched_b;
+  int matched_capacity;
+} ReplayDiffScratch;
+
+/**
+ * @brief Compares two decoded ticks
+ *
+ * Every float field (position, size, facing, velocity) is compared against
+ * the tolerance, and unit owners and ids must match exactly. Entities are
+ * processed four at a time with vector extensions where the compiler
+ * supports them.
+ *
+ * @param a Tick from the first replay
+ * @param b Same tick from the second replay
+ * @param tolerance Largest difference per field still considered equal
+ * @param scratch Matching storage reused across ticks
+ * @param out Receives the differences
+ * @return bool False if scratch storage could not be grown
+ */
+bool replay_diff_tick(const SimulationState *a, const SimulationState *b,
+                      float tolerance, ReplayDiffScratch *scratch,
+                      ReplayTickDiff *out);
+
+/**
+ * @brief Frees the storage of a diff scratch
+ */
+void replay_diff_scratch_free(ReplayDiffScratch *scratch);
+
+/**
+ * @brief Returns true when the tick diff has any change, addition or removal
+ */
+bool replay_diff_differs(const ReplayTickDiff *diff);
+
+/**
+ * @brief Returns true when two maps have the same size and tiles
+ *
+ * Paged maps only compare equal when they are the same paged map.
+ */
+bool replay_diff_maps_equal(const TileMap *a, const TileMap *b);
+
+#endif
@@ -1,9 +1,79 @@
 #include "sim_loader.h"
 #include "map.h"
+#include "../map/baked_map.h"
+#include "../map/paged_map.h"
+#include "../utils/job_system.h"
+#include "../utils/mem_track.h"
+#include "../utils/trace.h"
 #include <cjson/cJSON.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Tick locations are stored in fixed-size chunks that never move once
+// allocated, so decoding threads can read them while more are appended
+#define TICK_CHUNK_SIZE 4096
+// Ticks indexed between checks for CloseReplay while indexing in the
+// background
+#define INDEX_BATCH_TICKS 256
+
+typedef struct {
+  size_t offset; // Byte offset of the tick's object in the file
+  size_t length;
+} TickSpan;
+
+typedef enum { SCAN_ROOT, SCAN_STATE, SCAN_DONE } ScanPhase;
+
+struct SimReplay {
+  const char *data; // Whole file, mapped read-only
+  size_t size;
+  TickSpan **chunks;
+  int chunkCapacity;
+  atomic_int tickCount;  // Ticks indexed so far; all of them decodable
+  atomic_size_t scanned; // Bytes indexed so far, for progress
+  atomic_bool indexed;   // Set once the whole file has been scanned
+  atomic_bool quit;
+  ScanPhase phase; // Scanner state, owned by whichever thread indexes
+  size_t pos;
+  bool sawState;
+  bool hasIndexer;
+  pthread_t indexer;
+  TileMap *map;
+
+  // Map cache: map points into bakedMap on a hit; on a miss the map built
+  // from the JSON is written to mapCachePath by a job
+  BakedMap bakedMap;
+  char mapCachePath[PATH_MAX];
+  uint64_t mapKey;
+  size_t mapSourceBytes;
+  JobCounter mapWrite;
+  // Map supplied by the caller, such as a paged one; when set, map points
+  // here and only the dimensions of the replay's own map are read
+  TileMap externalMap;
+};
+
+static pthread_once_t g_jsonHooksOnce = PTHREAD_ONCE_INIT;
+
+static void *JSONMalloc(size_t size) {
+  return mem_track_malloc(MEM_SUBSYSTEM_LOADER, size);
+}
+
+static void InstallJSONHooksOnce(void) {
+  cJSON_Hooks hooks = {.malloc_fn = JSONMalloc, .free_fn = mem_track_free};
+  cJSON_InitHooks(&hooks);
+}
+
+// Charges cJSON's documents to the loader; must run before the first parse
+static void InstallJSONHooks(void) {
+  pthread_once(&g_jsonHooksOnce, InstallJSONHooksOnce);
+}
 
 // Helper function to parse TileMap from JSON
 RawTileMap *ParseMapFromJSON(cJSON *mapJson) {
@@ -18,23 +88,25 @@ RawTileMap *ParseMapFromJSON(cJSON *mapJson) {
     return NULL;
   }
 
-  RawTileMap *map = (RawTileMap *)malloc(sizeof(RawTileMap));
+  RawTileMap *map =
+      (RawTileMap *)mem_track_malloc(MEM_SUBSYSTEM_MAP, sizeof(RawTileMap));
   if (!map)
     return NULL;
 
   map->width = widthJson->valueint;
   map->height = heightJson->valueint;
 
-  int totalTiles = map->width * map->height;
-  map->tiles = (RawTileKey *)malloc(totalTiles * sizeof(RawTileKey));
+  size_t totalTiles = (size_t)map->width * map->height;
+  map->tiles = (RawTileKey *)mem_track_malloc(MEM_SUBSYSTEM_MAP,
+                                              totalTiles * sizeof(RawTileKey));
   if (!map->tiles) {
-    free(map);
+    mem_track_free(map);
     return NULL;
   }
 
   // Parse tiles array
   cJSON *tileItem;
-  int i = 0;
+  size_t i = 0;
   cJSON_ArrayForEach(tileItem, tilesJson) {
     if (i < totalTiles) {
       map->tiles[i] = (RawTileKey)tileItem->valueint;
@@ -45,285 +117,666 @@ RawTileMap *ParseMapFromJSON(cJSON *mapJson) {
   return map;
 }
 
-// Helper function to parse objects from JSON
-Object *ParseObjectsFromJSON(cJSON *objectsJson, int *objectCount) {
-  if (!objectsJson || !cJSON_IsArray(objectsJson)) {
-    return NULL;
+void FreeMap(RawTileMap *map) {
+  if (map) {
+    if (map->tiles)
+      mem_track_free(map->tiles);
+    mem_track_free(map);
   }
+}
 
-  *objectCount = cJSON_GetArraySize(objectsJson);
-  if (*objectCount == 0) {
+TileMap *TransformMap(RawTileMap *rmap) {
+  if (!rmap || !rmap->tiles) {
     return NULL;
   }
 
-  Object *objects = (Object *)malloc(*objectCount * sizeof(Object));
-  if (!objects) {
+  TileMap *tmap =
+      (TileMap *)mem_track_malloc(MEM_SUBSYSTEM_MAP, sizeof(TileMap));
+  if (!tmap) {
     return NULL;
   }
 
-  cJSON *objectItem;
-  int i = 0;
-  cJSON_ArrayForEach(objectItem, objectsJson) {
-    cJSON *xJson = cJSON_GetObjectItem(objectItem, "x");
-    cJSON *yJson = cJSON_GetObjectItem(objectItem, "y");
-    cJSON *sizeJson = cJSON_GetObjectItem(objectItem, "size");
+  tmap->width = rmap->width;
+  tmap->height = rmap->height;
+  tmap->paged = NULL;
+  size_t totalTiles = (size_t)tmap->width * tmap->height;
 
-    if (xJson && yJson && sizeJson) {
-      objects[i] = (Object){.x = (float)xJson->valuedouble,
-                            .y = (float)yJson->valuedouble,
-                            .size = (float)sizeJson->valuedouble};
-      i++;
-    }
+  tmap->tiles =
+      (Tile *)mem_track_malloc(MEM_SUBSYSTEM_MAP, totalTiles * sizeof(Tile));
+  if (!tmap->tiles) {
+    mem_track_free(tmap);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < totalTiles; i++) {
+    tmap->tiles[i] = raw_to_tile(rmap->tiles[i]);
   }
 
-  return objects;
+  preprocess_map(tmap);
+
+  return tmap;
 }
 
-// Helper function to parse units from JSON
-Unit *ParseUnitsFromJSON(cJSON *unitsJson, int *unitCount) {
-  if (!unitsJson || !cJSON_IsArray(unitsJson)) {
+// Maps a whole file read-only; pages are only read when first touched, so
+// opening costs the same for any file size
+static const char *MapFile(const char *filename, size_t *size) {
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    printf("Error: Could not open file %s\n", filename);
     return NULL;
   }
 
-  *unitCount = cJSON_GetArraySize(unitsJson);
-  if (*unitCount == 0) {
+  struct stat info;
+  void *data = MAP_FAILED;
+  if (fstat(fd, &info) == 0 && info.st_size > 0)
+    data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    printf("Error: Could not map file %s\n", filename);
     return NULL;
   }
 
-  Unit *units = (Unit *)malloc(*unitCount * sizeof(Unit));
-  if (!units) {
-    return NULL;
-  }
+  *size = (size_t)info.st_size;
+  return (const char *)data;
+}
 
-  cJSON *unitItem;
-  int i = 0;
-  cJSON_ArrayForEach(unitItem, unitsJson) {
-    cJSON *xJson = cJSON_GetObjectItem(unitItem, "x");
-    cJSON *yJson = cJSON_GetObjectItem(unitItem, "y");
-    cJSON *sizeJson = cJSON_GetObjectItem(unitItem, "size");
-    cJSON *facingJson = cJSON_GetObjectItem(unitItem, "facing");
-    cJSON *velocityJson = cJSON_GetObjectItem(unitItem, "velocity");
-    cJSON *ownerJson = cJSON_GetObjectItem(unitItem, "owner");
+static size_t SkipWhitespace(const char *data, size_t pos, size_t size) {
+  while (pos < size && (data[pos] == ' ' || data[pos] == '\t' ||
+                        data[pos] == '\n' || data[pos] == '\r'))
+    pos++;
+  return pos;
+}
 
-    if (xJson && yJson && sizeJson && facingJson && velocityJson && ownerJson) {
-      units[i] = (Unit){.x = (float)xJson->valuedouble,
-                        .y = (float)yJson->valuedouble,
-                        .size = (float)sizeJson->valuedouble,
-                        .facing = (float)facingJson->valuedouble,
-                        .velocity = (float)velocityJson->valuedouble,
-                        .owner = ownerJson->valueint};
-      i++;
-    }
+// Returns the position just past the string opening at pos, or 0 when the
+// file ends inside it
+static size_t SkipString(const char *data, size_t pos, size_t size) {
+  for (pos++; pos < size; pos++) {
+    if (data[pos] == '\\')
+      pos++;
+    else if (data[pos] == '"')
+      return pos + 1;
   }
-
-  return units;
+  return 0;
 }
 
-// Get the maximum tick available in the simulation file
-int GetMaxTickFromFile(const char *filename) {
-  FILE *file = fopen(filename, "r");
-  if (!file) {
-    printf("Error: Could not open file %s\n", filename);
+// Returns the position just past the JSON value starting at pos, or 0 when
+// the file ends inside it. Only strings and brackets are tracked; the value
+// itself is validated by cJSON when it is decoded.
+static size_t SkipValue(const char *data, size_t pos, size_t size) {
+  if (pos >= size)
     return 0;
+  if (data[pos] == '"')
+    return SkipString(data, pos, size);
+  if (data[pos] != '{' && data[pos] != '[') {
+    while (pos < size && !strchr(",}] \t\r\n", data[pos]))
+      pos++;
+    return pos;
+  }
+
+  int depth = 0;
+  for (; pos < size; pos++) {
+    char c = data[pos];
+    if (c == '"') {
+      pos = SkipString(data, pos, size);
+      if (pos == 0)
+        return 0;
+      pos--;
+    } else if (c == '{' || c == '[') {
+      depth++;
+    } else if ((c == '}' || c == ']') && --depth == 0) {
+      return pos + 1;
+    }
   }
+  return 0;
+}
 
-  fseek(file, 0, SEEK_END);
-  long file_size = ftell(file);
-  fseek(file, 0, SEEK_SET);
+static bool KeyEquals(const char *key, size_t length, const char *name) {
+  return strlen(name) == length && memcmp(key, name, length) == 0;
+}
 
-  char *file_content = (char *)malloc(file_size + 1);
-  if (!file_content) {
-    fclose(file);
-    return 0;
+// Finds the value of a key in the object starting at start; returns false
+// if the object has no such key or is malformed
+static bool FindObjectValue(const char *data, size_t start, size_t end,
+                            const char *name, size_t *valueStart,
+                            size_t *valueEnd) {
+  size_t pos = SkipWhitespace(data, start, end);
+  if (pos >= end || data[pos] != '{')
+    return false;
+  for (pos++;;) {
+    pos = SkipWhitespace(data, pos, end);
+    if (pos < end && data[pos] == ',')
+      pos = SkipWhitespace(data, pos + 1, end);
+    if (pos >= end || data[pos] != '"')
+      return false;
+    size_t keyEnd = SkipString(data, pos, end);
+    size_t value = keyEnd ? SkipWhitespace(data, keyEnd, end) : end;
+    if (value >= end || data[value] != ':')
+      return false;
+    value = SkipWhitespace(data, value + 1, end);
+    size_t after = SkipValue(data, value, end);
+    if (after == 0)
+      return false;
+    if (KeyEquals(data + pos + 1, keyEnd - pos - 2, name)) {
+      *valueStart = value;
+      *valueEnd = after;
+      return true;
+    }
+    pos = after;
   }
+}
 
-  fread(file_content, 1, file_size, file);
-  file_content[file_size] = '\0';
-  fclose(file);
+// Parses an integer value in place; the mapped file is not terminated, so
+// at most a short copy of it is handed to strtol
+static bool ParseIntValue(const char *data, size_t start, size_t end,
+                          int *value) {
+  char digits[32];
+  size_t length = end - start;
+  if (length == 0 || length >= sizeof(digits))
+    return false;
+  memcpy(digits, data + start, length);
+  digits[length] = '\0';
+  char *parsed;
+  long number = strtol(digits, &parsed, 10);
+  if (parsed == digits || number < 0 || number > INT_MAX)
+    return false;
+  *value = (int)number;
+  return true;
+}
 
-  cJSON *json = cJSON_Parse(file_content);
-  free(file_content);
+// Reads "width" and "height" of a map object without touching its tiles
+static bool ReadMapSize(const char *data, size_t start, size_t end,
+                        int *width, int *height) {
+  size_t valueStart, valueEnd;
+  return FindObjectValue(data, start, end, "width", &valueStart,
+                         &valueEnd) &&
+         ParseIntValue(data, valueStart, valueEnd, width) &&
+         FindObjectValue(data, start, end, "height", &valueStart,
+                         &valueEnd) &&
+         ParseIntValue(data, valueStart, valueEnd, height);
+}
 
-  if (!json) {
-    printf("Error: Failed to parse JSON\n");
-    return 0;
-  }
+static void WriteBakedMap(void *arg) {
+  SimReplay *replay = (SimReplay *)arg;
+  baked_map_write(replay->map, replay->mapKey, replay->mapSourceBytes,
+                  replay->mapCachePath);
+}
 
-  cJSON *stateArrayJson = cJSON_GetObjectItem(json, "state");
-  int maxTick = 0;
-  if (stateArrayJson && cJSON_IsArray(stateArrayJson)) {
-    maxTick = cJSON_GetArraySize(stateArrayJson) - 1; // 0-based indexing
+// Uses the cached build of the map text when there is one; otherwise
+// parses and autotiles it, then caches the result in the background
+static void ParseReplayMap(SimReplay *replay, size_t start, size_t end) {
+  if (replay->externalMap.width > 0) {
+    int width = 0, height = 0;
+    if (!ReadMapSize(replay->data, start, end, &width, &height) ||
+        width != replay->externalMap.width ||
+        height != replay->externalMap.height) {
+      printf("Error: Replay map is %dx%d, the supplied map %dx%d\n", width,
+             height, replay->externalMap.width, replay->externalMap.height);
+      return;
+    }
+    replay->map = &replay->externalMap;
+    return;
   }
 
-  cJSON_Delete(json);
-  return maxTick;
+  TRACE_ZONE_BEGIN(cacheZone, "OpenBakedMap");
+  replay->mapSourceBytes = end - start;
+  replay->mapKey = baked_map_key(replay->data + start, end - start);
+  bool cacheable = baked_map_cache_path(replay->mapKey, replay->mapCachePath,
+                                        sizeof(replay->mapCachePath));
+  if (cacheable && baked_map_open(replay->mapCachePath, replay->mapKey,
+                                  replay->mapSourceBytes,
+                                  &replay->bakedMap))
+    replay->map = &replay->bakedMap.map;
+  TRACE_ZONE_END(cacheZone);
+  if (replay->map)
+    return;
+
+  cJSON *mapJson = cJSON_ParseWithLength(replay->data + start, end - start);
+  RawTileMap *rawMap = ParseMapFromJSON(mapJson);
+  cJSON_Delete(mapJson);
+  if (!rawMap)
+    return;
+  TRACE_ZONE_BEGIN(mapZone, "TransformMap");
+  replay->map = TransformMap(rawMap);
+  TRACE_ZONE_END(mapZone);
+  FreeMap(rawMap);
+  if (cacheable && replay->map)
+    job_run(WriteBakedMap, replay, &replay->mapWrite);
 }
 
-// Load state at specific tick
-SimulationState *LoadStateAtTick(const char *filename, int tick) {
-  FILE *file = fopen(filename, "r");
-  if (!file) {
-    printf("Error: Could not open file %s\n", filename);
-    return NULL;
+// Records where a tick lives and makes it visible to decoding threads
+static bool AppendTick(SimReplay *replay, int tick, size_t offset,
+                       size_t length) {
+  int chunk = tick / TICK_CHUNK_SIZE;
+  if (chunk >= replay->chunkCapacity)
+    return false;
+  if (!replay->chunks[chunk]) {
+    replay->chunks[chunk] =
+        (TickSpan *)mem_track_malloc(MEM_SUBSYSTEM_LOADER,
+                                     TICK_CHUNK_SIZE * sizeof(TickSpan));
+    if (!replay->chunks[chunk])
+      return false;
   }
+  replay->chunks[chunk][tick % TICK_CHUNK_SIZE] =
+      (TickSpan){.offset = offset, .length = length};
+  atomic_store_explicit(&replay->tickCount, tick + 1, memory_order_release);
+  return true;
+}
 
-  fseek(file, 0, SEEK_END);
-  long file_size = ftell(file);
-  fseek(file, 0, SEEK_SET);
+// Walks the root object and the "state" array without building a document,
+// until minTicks ticks are indexed and the map is parsed or the file ends.
+// Returns false once indexing has finished. Only one thread scans at a time.
+static bool ScanReplay(SimReplay *replay, int minTicks) {
+  const char *data = replay->data;
+  size_t size = replay->size;
+  size_t pos = replay->pos;
+  int tickCount =
+      atomic_load_explicit(&replay->tickCount, memory_order_relaxed);
+
+  while (replay->phase != SCAN_DONE &&
+         (tickCount < minTicks || !replay->map)) {
+    pos = SkipWhitespace(data, pos, size);
+    if (pos < size && data[pos] == ',')
+      pos = SkipWhitespace(data, pos + 1, size);
+    if (pos >= size) {
+      printf("Warning: Replay ends early; indexed %d ticks\n", tickCount);
+      replay->phase = SCAN_DONE;
+      break;
+    }
 
-  char *file_content = (char *)malloc(file_size + 1);
-  if (!file_content) {
-    fclose(file);
-    return NULL;
+    if (replay->phase == SCAN_STATE) {
+      if (data[pos] == ']') {
+        replay->phase = SCAN_ROOT;
+        pos++;
+        continue;
+      }
+      size_t end = SkipValue(data, pos, size);
+      if (end == 0) {
+        printf("Warning: Replay ends inside tick %d\n", tickCount);
+        replay->phase = SCAN_DONE;
+        break;
+      }
+      if (!AppendTick(replay, tickCount, pos, end - pos)) {
+        printf("Error: Could not index tick %d\n", tickCount);
+        replay->phase = SCAN_DONE;
+        break;
+      }
+      tickCount++;
+      pos = end;
+      continue;
+    }
+
+    // Root object: "key": value pairs
+    if (data[pos] == '}') {
+      replay->phase = SCAN_DONE;
+      pos++;
+      break;
+    }
+    size_t keyEnd = data[pos] == '"' ? SkipString(data, pos, size) : 0;
+    size_t valueStart = keyEnd ? SkipWhitespace(data, keyEnd, size) : size;
+    if (valueStart >= size || data[valueStart] != ':') {
+      printf("Error: Malformed replay at byte %zu\n", pos);
+      replay->phase = SCAN_DONE;
+      break;
+    }
+    const char *key = data + pos + 1;
+    size_t keyLength = keyEnd - pos - 2;
+    valueStart = SkipWhitespace(data, valueStart + 1, size);
+
+    if (KeyEquals(key, keyLength, "state") && valueStart < size &&
+        data[valueStart] == '[') {
+      replay->sawState = true;
+      replay->phase = SCAN_STATE;
+      pos = valueStart + 1;
+      continue;
+    }
+    size_t valueEnd = SkipValue(data, valueStart, size);
+    if (valueEnd == 0) {
+      printf("Error: Malformed replay at byte %zu\n", valueStart);
+      replay->phase = SCAN_DONE;
+      break;
+    }
+    if (KeyEquals(key, keyLength, "map") && !replay->map)
+      ParseReplayMap(replay, valueStart, valueEnd);
+    pos = valueEnd;
   }
 
-  fread(file_content, 1, file_size, file);
-  file_content[file_size] = '\0';
-  fclose(file);
+  replay->pos = pos;
+  bool done = replay->phase == SCAN_DONE;
+  atomic_store(&replay->scanned, done ? size : pos);
+  if (done)
+    atomic_store(&replay->indexed, true);
+  return !done;
+}
 
-  cJSON *json = cJSON_Parse(file_content);
-  free(file_content);
+static void *IndexReplayMain(void *arg) {
+  SimReplay *replay = (SimReplay *)arg;
+  trace_set_thread_name("index");
+  while (!atomic_load(&replay->quit) &&
+         ScanReplay(replay, GetReplayTickCount(replay) + INDEX_BATCH_TICKS))
+    ;
+  return NULL;
+}
 
-  if (!json) {
-    printf("Error: Failed to parse JSON\n");
+// Maps the file and indexes it up to the map and the first tick; the
+// replay's own map is only built when no map is supplied
+static SimReplay *BeginReplay(const char *filename, const TileMap *map) {
+  size_t size = 0;
+  InstallJSONHooks();
+  const char *data = MapFile(filename, &size);
+  if (!data)
+    return NULL;
+
+  SimReplay *replay = (SimReplay *)mem_track_calloc(MEM_SUBSYSTEM_LOADER, 1,
+                                                    sizeof(SimReplay));
+  if (!replay) {
+    munmap((void *)data, size);
+    return NULL;
+  }
+  replay->data = data;
+  replay->size = size;
+  if (map)
+    replay->externalMap = *map;
+  atomic_init(&replay->tickCount, 0);
+  atomic_init(&replay->scanned, 0);
+  atomic_init(&replay->indexed, false);
+  atomic_init(&replay->quit, false);
+
+  // The smallest tick, "{}" and a comma, bounds how many ticks can exist
+  size_t maxTicks = size / 3 + 1;
+  if (maxTicks > INT_MAX)
+    maxTicks = INT_MAX;
+  replay->chunkCapacity = (int)(maxTicks / TICK_CHUNK_SIZE + 1);
+  replay->chunks = (TickSpan **)mem_track_calloc(
+      MEM_SUBSYSTEM_LOADER, replay->chunkCapacity, sizeof(TickSpan *));
+  if (!replay->chunks) {
+    CloseReplay(replay);
     return NULL;
   }
 
-  SimulationState *state = (SimulationState *)malloc(sizeof(SimulationState));
-  if (!state) {
-    cJSON_Delete(json);
+  size_t pos = SkipWhitespace(data, 0, size);
+  if (pos >= size || data[pos] != '{') {
+    printf("Error: Failed to parse JSON\n");
+    CloseReplay(replay);
     return NULL;
   }
+  replay->pos = pos + 1;
+  replay->phase = SCAN_ROOT;
 
-  // Parse map (static across all ticks)
-  cJSON *mapJson = cJSON_GetObjectItem(json, "map");
-  RawTileMap *map = ParseMapFromJSON(mapJson);
-  if (!map) {
+  TRACE_ZONE_BEGIN(zone, "IndexFirstTick");
+  ScanReplay(replay, 1);
+  TRACE_ZONE_END(zone);
+  if (!replay->map) {
     printf("Error: Failed to parse map from JSON\n");
-    cJSON_Delete(json);
-    free(state);
+    CloseReplay(replay);
     return NULL;
   }
-  state->map = *TransformMap(map);
-  free(map);
-
-  // Parse state array and get specific tick
-  cJSON *stateArrayJson = cJSON_GetObjectItem(json, "state");
-  if (!stateArrayJson || !cJSON_IsArray(stateArrayJson)) {
+  if (!replay->sawState) {
     printf("Error: No state array found in JSON\n");
-    cJSON_Delete(json);
-    FreeState(state);
+    CloseReplay(replay);
     return NULL;
   }
+  return replay;
+}
 
-  int maxTick = cJSON_GetArraySize(stateArrayJson) - 1;
-  state->totalTicks = maxTick + 1; // Store total ticks available
-
-  // Clamp tick to valid range
-  if (tick < 0)
-    tick = 0;
-  if (tick > maxTick)
-    tick = maxTick;
-
-  cJSON *tickStateJson = cJSON_GetArrayItem(stateArrayJson, tick);
-  if (!tickStateJson) {
-    printf("Error: Could not load tick %d\n", tick);
-    cJSON_Delete(json);
-    FreeState(state);
+SimReplay *OpenReplay(const char *filename) {
+  SimReplay *replay = BeginReplay(filename, NULL);
+  if (!replay)
     return NULL;
-  }
 
-  // Parse paused flag
-  cJSON *pausedJson = cJSON_GetObjectItem(tickStateJson, "paused");
-  state->paused = pausedJson ? cJSON_IsTrue(pausedJson) : false;
+  TRACE_ZONE_BEGIN(zone, "IndexReplay");
+  ScanReplay(replay, INT_MAX);
+  TRACE_ZONE_END(zone);
+  return replay;
+}
 
-  // Parse objects
-  cJSON *objectsJson = cJSON_GetObjectItem(tickStateJson, "objects");
-  state->objects = ParseObjectsFromJSON(objectsJson, &state->objectCount);
+SimReplay *OpenReplayProgressive(const char *filename) {
+  return OpenReplayProgressiveWithMap(filename, NULL);
+}
 
-  // Parse units
-  cJSON *unitsJson = cJSON_GetObjectItem(tickStateJson, "units");
-  state->units = ParseUnitsFromJSON(unitsJson, &state->unitCount);
+SimReplay *OpenReplayProgressiveWithMap(const char *filename,
+                                        const TileMap *map) {
+  SimReplay *replay = BeginReplay(filename, map);
+  if (!replay || IsReplayIndexed(replay))
+    return replay;
+
+  if (pthread_create(&replay->indexer, NULL, IndexReplayMain, replay) == 0) {
+    replay->hasIndexer = true;
+  } else {
+    printf("Warning: Indexing %s in the foreground\n", filename);
+    ScanReplay(replay, INT_MAX);
+  }
+  return replay;
+}
 
-  cJSON_Delete(json);
-  return state;
+void CloseReplay(SimReplay *replay) {
+  if (!replay)
+    return;
+  if (replay->hasIndexer) {
+    atomic_store(&replay->quit, true);
+    pthread_join(replay->indexer, NULL);
+  }
+  job_wait(&replay->mapWrite);
+  if (replay->map == &replay->bakedMap.map) {
+    baked_map_close(&replay->bakedMap);
+  } else if (replay->map && replay->map != &replay->externalMap) {
+    mem_track_free(replay->map->tiles);
+    mem_track_free(replay->map);
+  }
+  for (int i = 0; replay->chunks && i < replay->chunkCapacity; i++)
+    mem_track_free(replay->chunks[i]);
+  mem_track_free(replay->chunks);
+  munmap((void *)replay->data, replay->size);
+  mem_track_free(replay);
 }
 
-// Main function to load state from JSON file (loads tick 0 by default)
-SimulationState *LoadStateFromFile(const char *filename) {
-  return LoadStateAtTick(filename, 0);
+int GetReplayTickCount(const SimReplay *replay) {
+  return replay ? atomic_load_explicit(&replay->tickCount,
+                                       memory_order_acquire)
+                : 0;
 }
 
-// Modified LoadState to use file loading
-SimulationState *LoadState(void) {
-  return LoadStateFromFile("../assets/test.sim.json");
+bool IsReplayIndexed(const SimReplay *replay) {
+  return replay && atomic_load(&replay->indexed);
 }
 
-void FreeState(SimulationState *state) {
-  if (state) {
-    if (state->map.tiles)
-      free(state->map.tiles);
-    if (state->objects)
-      free(state->objects);
-    if (state->units)
-      free(state->units);
-    free(state);
-  }
+float GetReplayIndexProgress(const SimReplay *replay) {
+  if (!replay || replay->size == 0)
+    return 1.0f;
+  return (float)((double)atomic_load(&replay->scanned) / replay->size);
 }
 
-void FreeMap(RawTileMap *map) {
-  if (map) {
-    if (map->tiles)
-      free(map->tiles);
-    free(map);
-  }
-}
-
-RawTileMap *LoadMap() {
-  SimulationState *state = LoadState();
-  if (state) {
-    RawTileMap *map = (RawTileMap *)malloc(sizeof(RawTileMap));
-    if (map) {
-      map->width = state->map.width;
-      map->height = state->map.height;
-      map->tiles =
-          (RawTileKey *)malloc(map->width * map->height * sizeof(RawTileKey));
-      if (map->tiles) {
-        memcpy(map->tiles, state->map.tiles,
-               map->width * map->height * sizeof(RawTileKey));
+const TileMap *GetReplayMap(const SimReplay *replay) {
+  return replay ? replay->map : NULL;
+}
+
+// Streams the tiles array into the writer row by row; missing or
+// non-numeric entries are read as water
+static bool StreamMapTiles(const char *data, size_t start, size_t end,
+                           int width, int height, PagedMapWriter *writer) {
+  RawTileKey *row = (RawTileKey *)mem_track_malloc(
+      MEM_SUBSYSTEM_MAP, (size_t)width * sizeof(RawTileKey));
+  if (!row)
+    return false;
+
+  size_t pos = start + 1; // Past '['
+  bool ok = true;
+  for (int y = 0; ok && y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      pos = SkipWhitespace(data, pos, end);
+      if (pos < end && data[pos] == ',')
+        pos = SkipWhitespace(data, pos + 1, end);
+      if (pos >= end || data[pos] == ']') {
+        row[x] = R_TILE_WATER;
+        continue;
       }
+      size_t valueEnd = SkipValue(data, pos, end);
+      int value = 0;
+      if (valueEnd == 0 || !ParseIntValue(data, pos, valueEnd, &value))
+        value = R_TILE_WATER;
+      row[x] = (RawTileKey)value;
+      pos = valueEnd ? valueEnd : end;
     }
-    FreeState(state);
-    return map;
+    ok = paged_map_writer_add_row(writer, row);
   }
-  return NULL;
+  mem_track_free(row);
+  return ok;
 }
 
-TileMap *TransformMap(RawTileMap *rmap) {
-  if (!rmap || !rmap->tiles) {
-    return NULL;
+bool WriteReplayPagedMap(const char *filename, const char *path, int *width,
+                         int *height) {
+  size_t size = 0;
+  const char *data = MapFile(filename, &size);
+  if (!data)
+    return false;
+
+  TRACE_ZONE_BEGIN(zone, "WriteReplayPagedMap");
+  size_t mapStart, mapEnd, tilesStart, tilesEnd;
+  bool ok = FindObjectValue(data, 0, size, "map", &mapStart, &mapEnd) &&
+            ReadMapSize(data, mapStart, mapEnd, width, height) &&
+            *width > 0 && *height > 0 &&
+            FindObjectValue(data, mapStart, mapEnd, "tiles", &tilesStart,
+                            &tilesEnd) &&
+            data[tilesStart] == '[';
+  if (!ok) {
+    printf("Error: No map found in %s\n", filename);
+  } else {
+    PagedMapWriter *writer = paged_map_writer_begin(path, *width, *height);
+    ok = writer && StreamMapTiles(data, tilesStart, tilesEnd, *width,
+                                  *height, writer);
+    ok = paged_map_writer_finish(writer) && ok;
   }
+  TRACE_ZONE_END(zone);
+  munmap((void *)data, size);
+  return ok;
+}
 
-  TileMap *tmap = (TileMap *)malloc(sizeof(TileMap));
-  if (!tmap) {
-    return NULL;
+// Grows an entity buffer to hold at least count entries
+static bool ReserveEntities(void **buffer, int *capacity, int count,
+                            size_t entrySize) {
+  if (count <= *capacity)
+    return true;
+  int newCapacity = *capacity ? *capacity : 64;
+  while (newCapacity < count)
+    newCapacity *= 2;
+  void *grown = mem_track_realloc(MEM_SUBSYSTEM_LOADER, *buffer,
+                                  newCapacity * entrySize);
+  if (!grown)
+    return false;
+  *buffer = grown;
+  *capacity = newCapacity;
+  return true;
+}
+
+bool ReserveStateEntities(SimulationState *state, int objectCount,
+                          int unitCount) {
+  return ReserveEntities((void **)&state->objects, &state->objectCapacity,
+                         objectCount, sizeof(Object)) &&
+         ReserveEntities((void **)&state->units, &state->unitCapacity,
+                         unitCount, sizeof(Unit));
+}
+
+// Fills a state's entities from one parsed tick, reusing its buffers
+static bool DecodeTick(cJSON *tickStateJson, SimulationState *state) {
+  cJSON *pausedJson = cJSON_GetObjectItem(tickStateJson, "paused");
+  state->paused = pausedJson ? cJSON_IsTrue(pausedJson) : false;
+
+  // Decode objects into the state's own buffer, reusing its storage
+  cJSON *objectsJson = cJSON_GetObjectItem(tickStateJson, "objects");
+  int objectCount = cJSON_IsArray(objectsJson) ? cJSON_GetArraySize(objectsJson)
+                                               : 0;
+  if (!ReserveEntities((void **)&state->objects, &state->objectCapacity,
+                       objectCount, sizeof(Object))) {
+    return false;
   }
+  state->objectCount = 0;
+  cJSON *objectItem;
+  cJSON *objectArray = objectCount ? objectsJson : NULL;
+  cJSON_ArrayForEach(objectItem, objectArray) {
+    cJSON *xJson = cJSON_GetObjectItem(objectItem, "x");
+    cJSON *yJson = cJSON_GetObjectItem(objectItem, "y");
+    cJSON *sizeJson = cJSON_GetObjectItem(objectItem, "size");
 
-  tmap->width = rmap->width;
-  tmap->height = rmap->height;
-  int totalTiles = tmap->width * tmap->height;
+    if (xJson && yJson && sizeJson) {
+      state->objects[state->objectCount++] =
+          (Object){.x = (float)xJson->valuedouble,
+                   .y = (float)yJson->valuedouble,
+                   .size = (float)sizeJson->valuedouble};
+    }
+  }
 
-  tmap->tiles = (Tile *)malloc(totalTiles * sizeof(Tile));
-  if (!tmap->tiles) {
-    free(tmap);
-    return NULL;
+  // Decode units the same way
+  cJSON *unitsJson = cJSON_GetObjectItem(tickStateJson, "units");
+  int unitCount = cJSON_IsArray(unitsJson) ? cJSON_GetArraySize(unitsJson) : 0;
+  if (!ReserveEntities((void **)&state->units, &state->unitCapacity, unitCount,
+                       sizeof(Unit))) {
+    return false;
   }
+  state->unitCount = 0;
+  cJSON *unitItem;
+  cJSON *unitArray = unitCount ? unitsJson : NULL;
+  cJSON_ArrayForEach(unitItem, unitArray) {
+    cJSON *xJson = cJSON_GetObjectItem(unitItem, "x");
+    cJSON *yJson = cJSON_GetObjectItem(unitItem, "y");
+    cJSON *sizeJson = cJSON_GetObjectItem(unitItem, "size");
+    cJSON *facingJson = cJSON_GetObjectItem(unitItem, "facing");
+    cJSON *velocityJson = cJSON_GetObjectItem(unitItem, "velocity");
+    cJSON *ownerJson = cJSON_GetObjectItem(unitItem, "owner");
+    cJSON *idJson = cJSON_GetObjectItem(unitItem, "id");
 
-  for (int i = 0; i < totalTiles; i++) {
-    tmap->tiles[i] = raw_to_tile(rmap->tiles[i]);
+    if (xJson && yJson && sizeJson && facingJson && velocityJson && ownerJson) {
+      state->units[state->unitCount++] =
+          (Unit){.x = (float)xJson->valuedouble,
+                 .y = (float)yJson->valuedouble,
+                 .size = (float)sizeJson->valuedouble,
+                 .facing = (float)facingJson->valuedouble,
+                 .velocity = (float)velocityJson->valuedouble,
+                 .owner = ownerJson->valueint,
+                 .id = cJSON_IsNumber(idJson) ? idJson->valueint : -1};
+    }
   }
 
-  preprocess_map(tmap);
+  return true;
+}
 
-  return tmap;
+bool LoadReplayTick(const SimReplay *replay, int tick, SimulationState *state) {
+  int tickCount = GetReplayTickCount(replay);
+  if (tickCount == 0)
+    return false;
+
+  // Clamp tick to the ticks indexed so far
+  if (tick < 0)
+    tick = 0;
+  if (tick >= tickCount)
+    tick = tickCount - 1;
+
+  TRACE_ZONE_BEGIN(zone, "LoadReplayTick");
+  // Each tick is parsed on its own; no document of the whole file is kept
+  TickSpan span =
+      replay->chunks[tick / TICK_CHUNK_SIZE][tick % TICK_CHUNK_SIZE];
+  cJSON *tickStateJson =
+      cJSON_ParseWithLength(replay->data + span.offset, span.length);
+  if (!tickStateJson) {
+    printf("Error: Failed to parse tick %d\n", tick);
+    TRACE_ZONE_END(zone);
+    return false;
+  }
+
+  state->map = *replay->map;
+  state->totalTicks = tickCount;
+  bool decoded = DecodeTick(tickStateJson, state);
+  cJSON_Delete(tickStateJson);
+  TRACE_ZONE_END(zone);
+  return decoded;
+}
+
+// Frees the entity buffers of a state whose map is owned elsewhere
+void FreeStateEntities(SimulationState *state) {
+  if (!state)
+    return;
+  mem_track_free(state->objects);
+  mem_track_free(state->units);
+  state->objects = NULL;
+  state->units = NULL;
+  state->objectCount = state->unitCount = 0;
+  state->objectCapacity = state->unitCapacity = 0;
 }
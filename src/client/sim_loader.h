@@ -17,6 +17,7 @@ typedef struct {
   float facing;
   float velocity;
   int owner;
+  int id; // Optional "id" from the replay, stable across ticks; -1 if absent
 } Unit;
 
 typedef struct {
@@ -27,19 +28,46 @@ typedef struct {
   int unitCount;
   bool paused;
   int totalTicks; // Added: total ticks available in simulation
+  int objectCapacity; // Allocated entries, for states refilled in place
+  int unitCapacity;
 } SimulationState;
 
+// Replay opened once and decoded tick by tick (opaque)
+typedef struct SimReplay SimReplay;
+
 // Function declarations
-SimulationState *LoadState(void);
-SimulationState *LoadStateFromFile(const char *filename);
-SimulationState *LoadStateAtTick(const char *filename,
-                                 int tick); // New: Load specific tick
-void FreeState(SimulationState *state);
 void FreeMap(RawTileMap *map);
-RawTileMap *LoadMap(void);
-
-// Tick management
-int GetMaxTickFromFile(const char *filename); // New: Get total ticks available
 TileMap *TransformMap(RawTileMap *rmap);
 
+// Replay access: the file is mapped and the byte range of every tick
+// indexed once, then single ticks are parsed and decoded into caller-owned
+// states. Decoding only reads the replay, so several threads may decode
+// from the same replay concurrently, even while it is still being indexed.
+// The autotiled map is cached on disk after the first open (baked_map.h).
+SimReplay *OpenReplay(const char *filename);
+// Returns once the map and the first tick are available and indexes the
+// rest on a background thread; the tick count grows until
+// IsReplayIndexed() turns true
+SimReplay *OpenReplayProgressive(const char *filename);
+// Like OpenReplayProgressive, but draws on a map the caller built, such as
+// a paged one: the replay's own map is not built, only its dimensions are
+// read and must match. The map must outlive the replay.
+SimReplay *OpenReplayProgressiveWithMap(const char *filename,
+                                        const TileMap *map);
+void CloseReplay(SimReplay *replay);
+int GetReplayTickCount(const SimReplay *replay); // Ticks indexed so far
+bool IsReplayIndexed(const SimReplay *replay);
+float GetReplayIndexProgress(const SimReplay *replay); // 0..1 of the file
+const TileMap *GetReplayMap(const SimReplay *replay);
+// Converts the replay's map into a paged map file, streaming it a band of
+// rows at a time so maps larger than memory can be converted; receives the
+// map's dimensions
+bool WriteReplayPagedMap(const char *filename, const char *path, int *width,
+                         int *height);
+bool LoadReplayTick(const SimReplay *replay, int tick, SimulationState *state);
+void FreeStateEntities(SimulationState *state);
+// Grows a state's entity buffers to hold at least the given counts
+bool ReserveStateEntities(SimulationState *state, int objectCount,
+                          int unitCount);
+
 #endif
@@ -0,0 +1,466 @@
+#include "tick_store.h"
+#include "../utils/mem_track.h"
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef enum {
+  OBJECT_FIELD_X,
+  OBJECT_FIELD_Y,
+  OBJECT_FIELD_SIZE,
+  OBJECT_FIELDS
+} ObjectField;
+
+typedef enum {
+  UNIT_FIELD_X,
+  UNIT_FIELD_Y,
+  UNIT_FIELD_SIZE,
+  UNIT_FIELD_FACING,
+  UNIT_FIELD_VELOCITY,
+  UNIT_FIELD_OWNER,
+  UNIT_FIELD_ID,
+  UNIT_FIELDS
+} UnitField;
+
+#define TICK_FLAG_PAUSED 1u
+#define TICK_FLAG_KEYFRAME 2u
+
+// Quantized tick, one array per field
+typedef struct {
+  int tick; // -1 when empty
+  bool paused;
+  int object_count;
+  int unit_count;
+  int object_capacity;
+  int unit_capacity;
+  int32_t *objects[OBJECT_FIELDS];
+  int32_t *units[UNIT_FIELDS];
+} QuantizedTick;
+
+typedef struct {
+  uint8_t *data; // NULL when the tick is not stored
+  uint32_t size;
+  bool keyframe;
+} StoredTick;
+
+typedef struct {
+  uint8_t *data;
+  size_t size;
+  size_t capacity;
+  bool failed;
+} ByteBuffer;
+
+struct TickStore {
+  float map_width;
+  float map_height;
+  size_t budget_bytes;
+
+  StoredTick *ticks; // Indexed by tick
+  int tick_capacity;
+
+  QuantizedTick encoded; // Last tick added, the reference for the next one
+  QuantizedTick scratch; // Tick being added
+  QuantizedTick decoded; // Last tick read, decoded in place
+  ByteBuffer buffer;
+
+  TickStoreStats stats;
+};
+
+static bool quantized_reserve(QuantizedTick *q, int objects, int units) {
+  if (objects > q->object_capacity) {
+    int capacity = q->object_capacity ? q->object_capacity : 64;
+    while (capacity < objects)
+      capacity *= 2;
+    for (int f = 0; f < OBJECT_FIELDS; f++) {
+      int32_t *grown = (int32_t *)mem_track_realloc(
+          MEM_SUBSYSTEM_LOADER, q->objects[f], capacity * sizeof(int32_t));
+      if (!grown)
+        return false;
+      q->objects[f] = grown;
+    }
+    q->object_capacity = capacity;
+  }
+  if (units > q->unit_capacity) {
+    int capacity = q->unit_capacity ? q->unit_capacity : 64;
+    while (capacity < units)
+      capacity *= 2;
+    for (int f = 0; f < UNIT_FIELDS; f++) {
+      int32_t *grown = (int32_t *)mem_track_realloc(
+          MEM_SUBSYSTEM_LOADER, q->units[f], capacity * sizeof(int32_t));
+      if (!grown)
+        return false;
+      q->units[f] = grown;
+    }
+    q->unit_capacity = capacity;
+  }
+  return true;
+}
+
+static void quantized_free(QuantizedTick *q) {
+  for (int f = 0; f < OBJECT_FIELDS; f++)
+    mem_track_free(q->objects[f]);
+  for (int f = 0; f < UNIT_FIELDS; f++)
+    mem_track_free(q->units[f]);
+  *q = (QuantizedTick){.tick = -1};
+}
+
+static int32_t quantize_coordinate(float value, float extent) {
+  float t = extent > 0.0f ? value / extent : 0.0f;
+  t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+  return (int32_t)lrintf(t * 65535.0f);
+}
+
+static float dequantize_coordinate(int32_t q, float extent) {
+  return (float)q * extent / 65535.0f;
+}
+
+static int32_t quantize_size(float size) {
+  long q = lrintf(size * 256.0f);
+  return (int32_t)(q < 0 ? 0 : (q > 65535 ? 65535 : q));
+}
+
+static int32_t quantize_facing(float degrees) {
+  float wrapped = fmodf(degrees, 360.0f);
+  if (wrapped < 0.0f)
+    wrapped += 360.0f;
+  return (int32_t)(lrintf(wrapped * (4096.0f / 360.0f)) & 4095);
+}
+
+// IEEE half precision without subnormals, infinities or NaN
+static int32_t quantize_half(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint32_t sign = (bits >> 16) & 0x8000u;
+  int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+  uint32_t mantissa = bits & 0x7fffffu;
+  if (exponent <= 0)
+    return (int32_t)sign;
+  if (exponent >= 31)
+    return (int32_t)(sign | 0x7bffu);
+
+  // Rounding may carry into the exponent, which is still the nearest value
+  uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+  half += (mantissa >> 12) & 1u;
+  if (half > 0x7bffu)
+    half = 0x7bffu;
+  return (int32_t)(sign | half);
+}
+
+static float dequantize_half(int32_t q) {
+  uint32_t half = (uint32_t)q;
+  uint32_t exponent = (half >> 10) & 0x1fu;
+  uint32_t bits = (half & 0x8000u) << 16;
+  if (exponent != 0)
+    bits |= ((exponent - 15 + 127) << 23) | ((half & 0x3ffu) << 13);
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static void buffer_put_varint(ByteBuffer *buffer, uint64_t value) {
+  if (buffer->size + 10 > buffer->capacity) {
+    size_t capacity = buffer->capacity ? buffer->capacity * 2 : 4096;
+    uint8_t *grown = (uint8_t *)mem_track_realloc(MEM_SUBSYSTEM_LOADER,
+                                                  buffer->data, capacity);
+    if (!grown) {
+      buffer->failed = true;
+      return;
+    }
+    buffer->data = grown;
+    buffer->capacity = capacity;
+  }
+  while (value >= 0x80) {
+    buffer->data[buffer->size++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  buffer->data[buffer->size++] = (uint8_t)value;
+}
+
+static uint64_t read_varint(const uint8_t **cursor) {
+  uint64_t value = 0;
+  int shift = 0;
+  uint8_t byte;
+  do {
+    byte = *(*cursor)++;
+    value |= (uint64_t)(byte & 0x7f) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  return value;
+}
+
+// Entity i is predicted by the same entity of the previous tick when there
+// is one, otherwise by entity i - 1 of this tick
+static inline int64_t stream_reference(const int32_t *values,
+                                       const int32_t *previous,
+                                       int previous_count, int i) {
+  if (i < previous_count)
+    return previous[i];
+  return i > 0 ? values[i - 1] : 0;
+}
+
+// Token low bit 1: a run of that many unchanged values; low bit 0: one
+// zigzag-coded difference
+static void encode_stream(ByteBuffer *buffer, const int32_t *values,
+                          int count, const int32_t *previous,
+                          int previous_count) {
+  uint64_t run = 0;
+  for (int i = 0; i < count; i++) {
+    int64_t delta =
+        values[i] - stream_reference(values, previous, previous_count, i);
+    if (delta == 0) {
+      run++;
+      continue;
+    }
+    if (run > 0) {
+      buffer_put_varint(buffer, (run << 1) | 1);
+      run = 0;
+    }
+    uint64_t zigzag = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+    buffer_put_varint(buffer, zigzag << 1);
+  }
+  if (run > 0)
+    buffer_put_varint(buffer, (run << 1) | 1);
+}
+
+// Decodes in place: values holds the previous tick on entry
+static void decode_stream(const uint8_t **cursor, int32_t *values, int count,
+                          int previous_count) {
+  int i = 0;
+  while (i < count) {
+    uint64_t token = read_varint(cursor);
+    if (token & 1) {
+      for (uint64_t run = token >> 1; run > 0 && i < count; run--, i++)
+        values[i] =
+            (int32_t)stream_reference(values, values, previous_count, i);
+    } else {
+      uint64_t zigzag = token >> 1;
+      int64_t delta = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+      values[i] = (int32_t)(
+          stream_reference(values, values, previous_count, i) + delta);
+      i++;
+    }
+  }
+}
+
+TickStore *tick_store_create(int map_width, int map_height,
+                             size_t budget_bytes) {
+  TickStore *store = (TickStore *)mem_track_calloc(MEM_SUBSYSTEM_LOADER, 1,
+                                                   sizeof(TickStore));
+  if (!store)
+    return NULL;
+  store->map_width = (float)map_width;
+  store->map_height = (float)map_height;
+  store->budget_bytes = budget_bytes;
+  store->stats.budget_bytes = budget_bytes;
+  store->encoded.tick = -1;
+  store->scratch.tick = -1;
+  store->decoded.tick = -1;
+  return store;
+}
+
+void tick_store_destroy(TickStore *store) {
+  if (!store)
+    return;
+  for (int i = 0; i < store->tick_capacity; i++)
+    mem_track_free(store->ticks[i].data);
+  mem_track_free(store->ticks);
+  quantized_free(&store->encoded);
+  quantized_free(&store->scratch);
+  quantized_free(&store->decoded);
+  mem_track_free(store->buffer.data);
+  mem_track_free(store);
+}
+
+bool tick_store_has(const TickStore *store, int tick) {
+  return tick >= 0 && tick < store->tick_capacity &&
+         store->ticks[tick].data != NULL;
+}
+
+size_t tick_store_budget(const TickStore *store) {
+  return store->budget_bytes;
+}
+
+static void tick_store_quantize(const TickStore *store,
+                                const SimulationState *state,
+                                QuantizedTick *q) {
+  q->paused = state->paused;
+  q->object_count = state->objectCount;
+  for (int i = 0; i < state->objectCount; i++) {
+    const Object *object = &state->objects[i];
+    q->objects[OBJECT_FIELD_X][i] =
+        quantize_coordinate(object->x, store->map_width);
+    q->objects[OBJECT_FIELD_Y][i] =
+        quantize_coordinate(object->y, store->map_height);
+    q->objects[OBJECT_FIELD_SIZE][i] = quantize_size(object->size);
+  }
+
+  q->unit_count = state->unitCount;
+  for (int i = 0; i < state->unitCount; i++) {
+    const Unit *unit = &state->units[i];
+    q->units[UNIT_FIELD_X][i] = quantize_coordinate(unit->x, store->map_width);
+    q->units[UNIT_FIELD_Y][i] =
+        quantize_coordinate(unit->y, store->map_height);
+    q->units[UNIT_FIELD_SIZE][i] = quantize_size(unit->size);
+    q->units[UNIT_FIELD_FACING][i] = quantize_facing(unit->facing);
+    q->units[UNIT_FIELD_VELOCITY][i] = quantize_half(unit->velocity);
+    q->units[UNIT_FIELD_OWNER][i] = unit->owner;
+    q->units[UNIT_FIELD_ID][i] = unit->id;
+  }
+}
+
+static bool tick_store_reserve_ticks(TickStore *store, int tick) {
+  if (tick < store->tick_capacity)
+    return true;
+  int capacity = store->tick_capacity ? store->tick_capacity : 1024;
+  while (capacity <= tick)
+    capacity *= 2;
+  StoredTick *grown = (StoredTick *)mem_track_realloc(
+      MEM_SUBSYSTEM_LOADER, store->ticks, capacity * sizeof(StoredTick));
+  if (!grown)
+    return false;
+  memset(grown + store->tick_capacity, 0,
+         (capacity - store->tick_capacity) * sizeof(StoredTick));
+  store->ticks = grown;
+  store->tick_capacity = capacity;
+  return true;
+}
+
+bool tick_store_put(TickStore *store, int tick, const SimulationState *state) {
+  if (tick < 0)
+    return false;
+  if (tick_store_has(store, tick))
+    return true;
+  if (store->stats.bytes >= store->budget_bytes ||
+      !tick_store_reserve_ticks(store, tick))
+    return false;
+
+  QuantizedTick *q = &store->scratch;
+  if (!quantized_reserve(q, state->objectCount, state->unitCount))
+    return false;
+  tick_store_quantize(store, state, q);
+
+  // Deltas need the previous tick both here and when reading back
+  const QuantizedTick *previous = &store->encoded;
+  bool keyframe = tick % TICK_STORE_KEYFRAME_INTERVAL == 0 ||
+                  previous->tick != tick - 1 ||
+                  !tick_store_has(store, tick - 1);
+  int previous_objects = keyframe ? 0 : previous->object_count;
+  int previous_units = keyframe ? 0 : previous->unit_count;
+
+  ByteBuffer *buffer = &store->buffer;
+  buffer->size = 0;
+  buffer->failed = false;
+  buffer_put_varint(buffer, (q->paused ? TICK_FLAG_PAUSED : 0) |
+                                (keyframe ? TICK_FLAG_KEYFRAME : 0));
+  buffer_put_varint(buffer, (uint64_t)q->object_count);
+  buffer_put_varint(buffer, (uint64_t)q->unit_count);
+  for (int f = 0; f < OBJECT_FIELDS; f++)
+    encode_stream(buffer, q->objects[f], q->object_count,
+                  previous->objects[f], previous_objects);
+  for (int f = 0; f < UNIT_FIELDS; f++)
+    encode_stream(buffer, q->units[f], q->unit_count, previous->units[f],
+                  previous_units);
+  if (buffer->failed || store->stats.bytes + buffer->size > store->budget_bytes)
+    return false;
+
+  uint8_t *data = (uint8_t *)mem_track_malloc(MEM_SUBSYSTEM_LOADER,
+                                              buffer->size);
+  if (!data)
+    return false;
+  memcpy(data, buffer->data, buffer->size);
+  store->ticks[tick] = (StoredTick){
+      .data = data, .size = (uint32_t)buffer->size, .keyframe = keyframe};
+
+  // The tick just added becomes the reference for the next one
+  q->tick = tick;
+  QuantizedTick swap = store->encoded;
+  store->encoded = *q;
+  store->scratch = swap;
+
+  store->stats.ticks++;
+  store->stats.bytes += buffer->size;
+  store->stats.raw_bytes += (size_t)state->objectCount * sizeof(Object) +
+                            (size_t)state->unitCount * sizeof(Unit);
+  return true;
+}
+
+// Applies one stored tick on top of the decoded cursor
+static bool tick_store_decode(TickStore *store, int tick) {
+  const StoredTick *stored = &store->ticks[tick];
+  const uint8_t *cursor = stored->data;
+  QuantizedTick *q = &store->decoded;
+
+  uint64_t flags = read_varint(&cursor);
+  int object_count = (int)read_varint(&cursor);
+  int unit_count = (int)read_varint(&cursor);
+  if (!quantized_reserve(q, object_count, unit_count))
+    return false;
+
+  bool keyframe = (flags & TICK_FLAG_KEYFRAME) != 0;
+  int previous_objects = keyframe ? 0 : q->object_count;
+  int previous_units = keyframe ? 0 : q->unit_count;
+  for (int f = 0; f < OBJECT_FIELDS; f++)
+    decode_stream(&cursor, q->objects[f], object_count, previous_objects);
+  for (int f = 0; f < UNIT_FIELDS; f++)
+    decode_stream(&cursor, q->units[f], unit_count, previous_units);
+
+  q->tick = tick;
+  q->paused = (flags & TICK_FLAG_PAUSED) != 0;
+  q->object_count = object_count;
+  q->unit_count = unit_count;
+  return true;
+}
+
+bool tick_store_get(TickStore *store, int tick, SimulationState *state) {
+  if (!tick_store_has(store, tick)) {
+    store->stats.misses++;
+    return false;
+  }
+
+  // Replay from the keyframe, or from the cursor when it is on the way
+  QuantizedTick *q = &store->decoded;
+  if (q->tick != tick) {
+    int start = tick;
+    while (!store->ticks[start].keyframe && q->tick != start - 1)
+      start--;
+    for (int t = start; t <= tick; t++) {
+      if (!tick_store_decode(store, t)) {
+        q->tick = -1;
+        return false;
+      }
+    }
+  }
+
+  if (!ReserveStateEntities(state, q->object_count, q->unit_count))
+    return false;
+  state->paused = q->paused;
+  state->objectCount = q->object_count;
+  for (int i = 0; i < q->object_count; i++)
+    state->objects[i] = (Object){
+        .x = dequantize_coordinate(q->objects[OBJECT_FIELD_X][i],
+                                   store->map_width),
+        .y = dequantize_coordinate(q->objects[OBJECT_FIELD_Y][i],
+                                   store->map_height),
+        .size = q->objects[OBJECT_FIELD_SIZE][i] / 256.0f,
+    };
+  state->unitCount = q->unit_count;
+  for (int i = 0; i < q->unit_count; i++)
+    state->units[i] = (Unit){
+        .x = dequantize_coordinate(q->units[UNIT_FIELD_X][i],
+                                   store->map_width),
+        .y = dequantize_coordinate(q->units[UNIT_FIELD_Y][i],
+                                   store->map_height),
+        .size = q->units[UNIT_FIELD_SIZE][i] / 256.0f,
+        .facing = q->units[UNIT_FIELD_FACING][i] * (360.0f / 4096.0f),
+        .velocity = dequantize_half(q->units[UNIT_FIELD_VELOCITY][i]),
+        .owner = q->units[UNIT_FIELD_OWNER][i],
+        .id = q->units[UNIT_FIELD_ID][i],
+    };
+
+  store->stats.hits++;
+  return true;
+}
+
+void tick_store_stats(const TickStore *store, TickStoreStats *stats) {
+  *stats = store->stats;
+}
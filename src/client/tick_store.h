@@ -0,0 +1,79 @@
+#ifndef TICK_STORE_H
+#define TICK_STORE_H
+
+#include "sim_loader.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Compact in-memory store of decoded ticks
+ *
+ * Holds ticks that were already decoded once so revisiting them skips JSON
+ * parsing, at a fraction of the size of Unit and Object arrays. Fields are
+ * quantized, split into one stream per field and delta coded: against the
+ * previous entity in keyframes, against the same entity of the previous
+ * tick otherwise, as zigzag varints with runs of unchanged values folded
+ * into one token. A keyframe starts every TICK_STORE_KEYFRAME_INTERVAL
+ * ticks and wherever the previous tick is not stored.
+ *
+ * Quantization error, per field:
+ *   x, y      16-bit fixed point over the map: at most map size / 131070
+ *             tiles (0.004 on a 512-tile map); clamped to the map edges
+ *   size      1/256 tile steps up to 256 tiles: at most 1/512 tile
+ *   facing    12 bits over 360 degrees: at most 0.044 degrees; returned
+ *             normalized to [0, 360)
+ *   velocity  half precision: relative error at most 2^-11, magnitudes
+ *             below 6.1e-5 read back as 0 and above 65504 are clamped
+ *   owner, id, paused, entity counts and order are exact
+ *
+ * A store is used from one thread. Ticks are added until the byte budget
+ * is reached; nothing is evicted.
+ */
+
+#define TICK_STORE_KEYFRAME_INTERVAL 32
+
+typedef struct TickStore TickStore;
+
+typedef struct {
+  int ticks;           // Ticks held
+  size_t bytes;        // Encoded size of those ticks
+  size_t raw_bytes;    // Size of the same ticks as Unit and Object arrays
+  size_t budget_bytes; // Limit on bytes
+  unsigned long hits;
+  unsigned long misses;
+} TickStoreStats;
+
+/**
+ * @brief Creates an empty store for the replay of one map
+ *
+ * @param map_width Map width in tiles, the range of quantized x
+ * @param map_height Map height in tiles, the range of quantized y
+ * @param budget_bytes Most encoded bytes held at once
+ * @return TickStore* NULL on allocation failure
+ */
+TickStore *tick_store_create(int map_width, int map_height,
+                             size_t budget_bytes);
+void tick_store_destroy(TickStore *store);
+
+/**
+ * @brief Adds a decoded tick; ticks already held are left as they are
+ *
+ * @return bool False when the budget is used up or memory runs out
+ */
+bool tick_store_put(TickStore *store, int tick, const SimulationState *state);
+
+/**
+ * @brief Decodes a stored tick into a state, reusing its entity buffers
+ *
+ * Sequential ticks decode in one step; other ticks replay the deltas from
+ * their keyframe. Only the entities and the paused flag are written.
+ *
+ * @return bool False when the tick is not stored
+ */
+bool tick_store_get(TickStore *store, int tick, SimulationState *state);
+
+bool tick_store_has(const TickStore *store, int tick);
+size_t tick_store_budget(const TickStore *store);
+void tick_store_stats(const TickStore *store, TickStoreStats *stats);
+
+#endif
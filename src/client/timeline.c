@@ -0,0 +1,324 @@
+#include "timeline.h"
+#include "../utils/job_system.h"
+#include "../utils/mem_track.h"
+#include "../utils/trace.h"
+#include "raylib.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TIMELINE_SERIES TIMELINE_SERIES_COUNT
+// Ticks decoded by one job; a piece reuses its entity buffers across them
+#define TIMELINE_GRAIN_TICKS 64
+
+typedef struct {
+  float min;
+  float max;
+  float sum;
+} TimelineBucket;
+
+struct Timeline {
+  const SimReplay *replay;
+  float *values; // TIMELINE_SERIES values per covered tick
+  int value_capacity; // In ticks
+  // Level n + 1 of the pyramid, TIMELINE_SERIES buckets per position
+  TimelineBucket *levels[TIMELINE_MAX_LEVELS];
+  int level_capacity[TIMELINE_MAX_LEVELS];
+  int ticks_covered;
+
+  // Ticks [ticks_covered, batch_end_tick) are being summarized in place
+  bool batch_running;
+  int batch_end_tick;
+  JobCounter batch;
+};
+
+// Ticks summarized by one bucket of a level; level 0 is single ticks
+static long long timeline_span(int level) {
+  long long span = 1;
+  for (int i = 0; i < level; i++)
+    span *= TIMELINE_FANOUT;
+  return span;
+}
+
+// Buckets a level holds for a number of ticks
+static int timeline_level_size(int ticks, int level) {
+  long long span = timeline_span(level);
+  return (int)((ticks + span - 1) / span);
+}
+
+// Lowest level held in a single bucket; levels above it are not built
+static int timeline_top_level(int ticks) {
+  int level = 0;
+  while (level < TIMELINE_MAX_LEVELS && timeline_level_size(ticks, level) > 1)
+    level++;
+  return level;
+}
+
+static bool timeline_grow(void **array, int *capacity, int needed,
+                          size_t item_size) {
+  if (needed <= *capacity)
+    return true;
+  int grown = *capacity ? *capacity : 1024;
+  while (grown < needed)
+    grown *= 2;
+  void *resized = mem_track_realloc(MEM_SUBSYSTEM_ANALYSIS, *array,
+                                    (size_t)grown * item_size);
+  if (!resized)
+    return false;
+  *array = resized;
+  *capacity = grown;
+  return true;
+}
+
+// Makes room for `ticks` values and every pyramid level above them
+static bool timeline_reserve(Timeline *timeline, int ticks) {
+  if (!timeline_grow((void **)&timeline->values, &timeline->value_capacity,
+                     ticks, TIMELINE_SERIES * sizeof(float)))
+    return false;
+  for (int level = 1; level <= TIMELINE_MAX_LEVELS; level++) {
+    int size = timeline_level_size(ticks, level);
+    if (!timeline_grow((void **)&timeline->levels[level - 1],
+                       &timeline->level_capacity[level - 1], size,
+                       TIMELINE_SERIES * sizeof(TimelineBucket)))
+      return false;
+    if (size <= 1)
+      break;
+  }
+  return true;
+}
+
+static TimelineBucket timeline_bucket(const Timeline *timeline, int level,
+                                      int index, int series) {
+  if (level == 0) {
+    float value =
+        timeline->values[(size_t)index * TIMELINE_SERIES + series];
+    return (TimelineBucket){value, value, value};
+  }
+  return timeline->levels[level - 1][(size_t)index * TIMELINE_SERIES + series];
+}
+
+// Recomputes the buckets of every level that cover ticks from `first` on
+static void timeline_rebuild_levels(Timeline *timeline, int first) {
+  int ticks = timeline->ticks_covered;
+  int dirty = first;
+  for (int level = 1; level <= TIMELINE_MAX_LEVELS; level++) {
+    int below = timeline_level_size(ticks, level - 1);
+    int size = timeline_level_size(ticks, level);
+    dirty /= TIMELINE_FANOUT;
+
+    for (int b = dirty; b < size; b++) {
+      int child_end = (b + 1) * TIMELINE_FANOUT;
+      if (child_end > below)
+        child_end = below;
+      for (int s = 0; s < TIMELINE_SERIES; s++) {
+        TimelineBucket bucket =
+            timeline_bucket(timeline, level - 1, b * TIMELINE_FANOUT, s);
+        for (int c = b * TIMELINE_FANOUT + 1; c < child_end; c++) {
+          TimelineBucket child = timeline_bucket(timeline, level - 1, c, s);
+          bucket.min = fminf(bucket.min, child.min);
+          bucket.max = fmaxf(bucket.max, child.max);
+          bucket.sum += child.sum;
+        }
+        timeline->levels[level - 1][(size_t)b * TIMELINE_SERIES + s] = bucket;
+      }
+    }
+    if (size <= 1)
+      break;
+  }
+}
+
+// Summarizes batch ticks [begin, end), counted from ticks_covered, into
+// their reserved values
+static void timeline_summarize(void *arg, int begin, int end) {
+  Timeline *timeline = (Timeline *)arg;
+  int first = timeline->ticks_covered;
+  SimulationState state = {0};
+
+  TRACE_ZONE_BEGIN(zone, "timeline_summarize");
+
+  for (int tick = first + begin; tick < first + end; tick++) {
+    float *values = &timeline->values[(size_t)tick * TIMELINE_SERIES];
+    if (!LoadReplayTick(timeline->replay, tick, &state))
+      continue;
+
+    float speed = 0.0f;
+    for (int i = 0; i < state.unitCount; i++) {
+      const Unit *unit = &state.units[i];
+      speed += fabsf(unit->velocity);
+      if (unit->owner > 0 && unit->owner <= TIMELINE_MAX_OWNERS)
+        values[TIMELINE_OWNER_UNITS + unit->owner - 1] += 1.0f;
+    }
+    values[TIMELINE_UNITS] = (float)state.unitCount;
+    values[TIMELINE_OBJECTS] = (float)state.objectCount;
+    values[TIMELINE_MEAN_SPEED] =
+        state.unitCount > 0 ? speed / state.unitCount : 0.0f;
+  }
+
+  FreeStateEntities(&state);
+  TRACE_ZONE_END(zone);
+}
+
+// Reserves room for [ticks_covered, tick_count) and summarizes it as a
+// parallel for; the buffers are not resized again until the batch is merged
+static void timeline_launch(Timeline *timeline, int tick_count) {
+  int first = timeline->ticks_covered;
+  if (!timeline_reserve(timeline, tick_count)) {
+    TraceLog(LOG_WARNING, "Timeline: Out of memory at %d ticks", tick_count);
+    return;
+  }
+  memset(&timeline->values[(size_t)first * TIMELINE_SERIES], 0,
+         (size_t)(tick_count - first) * TIMELINE_SERIES * sizeof(float));
+
+  timeline->batch_running = true;
+  timeline->batch_end_tick = tick_count;
+  job_parallel_for(tick_count - first, TIMELINE_GRAIN_TICKS,
+                   timeline_summarize, timeline, &timeline->batch);
+}
+
+// Appends a finished batch to the pyramid
+static void timeline_merge(Timeline *timeline) {
+  int first = timeline->ticks_covered;
+  timeline->ticks_covered = timeline->batch_end_tick;
+  timeline->batch_running = false;
+  timeline_rebuild_levels(timeline, first);
+}
+
+Timeline *timeline_create(const SimReplay *replay) {
+  Timeline *timeline = (Timeline *)mem_track_calloc(MEM_SUBSYSTEM_ANALYSIS, 1,
+                                                    sizeof(Timeline));
+  if (!timeline)
+    return NULL;
+
+  timeline->replay = replay;
+
+  timeline_update(timeline);
+  return timeline;
+}
+
+void timeline_destroy(Timeline *timeline) {
+  if (!timeline)
+    return;
+  job_wait(&timeline->batch);
+  mem_track_free(timeline->values);
+  for (int level = 0; level < TIMELINE_MAX_LEVELS; level++)
+    mem_track_free(timeline->levels[level]);
+  mem_track_free(timeline);
+}
+
+bool timeline_update(Timeline *timeline) {
+  bool changed = false;
+
+  if (timeline->batch_running) {
+    if (!job_counter_done(&timeline->batch))
+      return false;
+    timeline_merge(timeline);
+    changed = true;
+  }
+
+  int tick_count = GetReplayTickCount(timeline->replay);
+  if (tick_count > timeline->ticks_covered)
+    timeline_launch(timeline, tick_count);
+  return changed;
+}
+
+int timeline_ticks_covered(const Timeline *timeline) {
+  return timeline->ticks_covered;
+}
+
+bool timeline_is_busy(const Timeline *timeline) {
+  return timeline->batch_running;
+}
+
+float timeline_value(const Timeline *timeline, TimelineSeries series,
+                     int tick) {
+  if (tick < 0 || tick >= timeline->ticks_covered)
+    return 0.0f;
+  return timeline->values[(size_t)tick * TIMELINE_SERIES + series];
+}
+
+// Folds one bucket into a summary whose mean still holds the running sum
+static void timeline_accumulate(const Timeline *timeline, int level,
+                                int index, int series,
+                                TimelineSummary *summary) {
+  TimelineBucket bucket = timeline_bucket(timeline, level, index, series);
+  long long span = timeline_span(level);
+  long long ticks = timeline->ticks_covered - index * span;
+  if (ticks > span)
+    ticks = span;
+
+  if (summary->ticks == 0) {
+    summary->min = bucket.min;
+    summary->max = bucket.max;
+  } else {
+    summary->min = fminf(summary->min, bucket.min);
+    summary->max = fmaxf(summary->max, bucket.max);
+  }
+  summary->mean += bucket.sum;
+  summary->ticks += (int)ticks;
+}
+
+static void timeline_finish(TimelineSummary *summary) {
+  if (summary->ticks > 0)
+    summary->mean /= summary->ticks;
+}
+
+TimelineSummary timeline_summary(const Timeline *timeline,
+                                 TimelineSeries series, int first_tick,
+                                 int end_tick) {
+  TimelineSummary summary = {0};
+  int first = first_tick < 0 ? 0 : first_tick;
+  int end = end_tick < timeline->ticks_covered ? end_tick
+                                               : timeline->ticks_covered;
+
+  // Peel unaligned buckets off both ends, then climb a level
+  for (int level = 0; first < end && level <= TIMELINE_MAX_LEVELS; level++) {
+    while (first < end && first % TIMELINE_FANOUT != 0)
+      timeline_accumulate(timeline, level, first++, series, &summary);
+    while (first < end && end % TIMELINE_FANOUT != 0)
+      timeline_accumulate(timeline, level, --end, series, &summary);
+    if (level == TIMELINE_MAX_LEVELS) {
+      while (first < end)
+        timeline_accumulate(timeline, level, first++, series, &summary);
+    }
+    first /= TIMELINE_FANOUT;
+    end /= TIMELINE_FANOUT;
+  }
+  timeline_finish(&summary);
+  return summary;
+}
+
+void timeline_columns(const Timeline *timeline, TimelineSeries series,
+                      int first_tick, int end_tick, int columns,
+                      TimelineSummary *out) {
+  if (columns <= 0)
+    return;
+
+  // Coarsest built level whose buckets are no wider than a column
+  double ticks_per_column = (double)(end_tick - first_tick) / columns;
+  int top = timeline_top_level(timeline->ticks_covered);
+  int level = 0;
+  while (level < top &&
+         timeline_span(level + 1) <= ticks_per_column)
+    level++;
+  long long span = timeline_span(level);
+  int size = timeline_level_size(timeline->ticks_covered, level);
+
+  for (int c = 0; c < columns; c++) {
+    TimelineSummary summary = {0};
+    long long first =
+        first_tick + (long long)(end_tick - first_tick) * c / columns;
+    long long end =
+        first_tick + (long long)(end_tick - first_tick) * (c + 1) / columns;
+    int bucket = (int)(first / span);
+    int bucket_end = (int)(end / span);
+    if (bucket_end <= bucket)
+      bucket_end = bucket + 1;
+    if (bucket_end > size)
+      bucket_end = size;
+
+    for (int b = bucket; b < bucket_end; b++)
+      timeline_accumulate(timeline, level, b, series, &summary);
+    timeline_finish(&summary);
+    out[c] = summary;
+  }
+}
@@ -0,0 +1,115 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include "sim_loader.h"
+#include <stdbool.h>
+
+/**
+ * @brief Per-tick aggregates of a replay, summarized for timeline charts
+ *
+ * Every tick is decoded once, in parallel on the shared job system, and
+ * reduced to a few numbers per series. Ticks appended to the replay while
+ * it is indexed are added on later updates.
+ *
+ * Values are kept in a pyramid: level 0 holds one value per tick and every
+ * bucket of level n + 1 holds the min, max and sum of TIMELINE_FANOUT
+ * buckets of level n. A chart column reads a handful of buckets from the
+ * level whose buckets are just narrower than the column, so a chart costs
+ * O(columns) whatever the replay length, and the summary of any tick range
+ * reads O(log ticks) buckets.
+ */
+
+// Owners with their own unit count series
+#define TIMELINE_MAX_OWNERS 4
+// Buckets of one level summarized by a bucket of the next
+#define TIMELINE_FANOUT 8
+// Levels above the per-tick values: enough for INT_MAX ticks
+#define TIMELINE_MAX_LEVELS 11
+
+typedef enum {
+  TIMELINE_UNITS, // Units of every owner
+  // Units of owner N are series TIMELINE_OWNER_UNITS + N - 1
+  TIMELINE_OWNER_UNITS,
+  TIMELINE_OBJECTS = TIMELINE_OWNER_UNITS + TIMELINE_MAX_OWNERS,
+  TIMELINE_MEAN_SPEED, // Mean absolute unit velocity
+  TIMELINE_SERIES_COUNT
+} TimelineSeries;
+
+typedef struct {
+  float min;
+  float max;
+  float mean;
+  int ticks; // Ticks summarized; 0 when the range holds none
+} TimelineSummary;
+
+typedef struct Timeline Timeline;
+
+/**
+ * @brief Creates an empty timeline for a replay and starts summarizing
+ *
+ * The replay must outlive the timeline; it is only read.
+ *
+ * @return Timeline* New timeline, or NULL on allocation failure
+ */
+Timeline *timeline_create(const SimReplay *replay);
+
+/**
+ * @brief Waits for running jobs and frees the timeline
+ */
+void timeline_destroy(Timeline *timeline);
+
+/**
+ * @brief Merges finished work and queues jobs for newly appended ticks
+ *
+ * Call once per frame from the thread that owns the timeline; it never
+ * blocks on jobs.
+ *
+ * @return bool True when ticks were added since the previous call
+ */
+bool timeline_update(Timeline *timeline);
+
+/**
+ * @brief Number of ticks summarized so far, always a prefix of the replay
+ */
+int timeline_ticks_covered(const Timeline *timeline);
+
+/**
+ * @brief True while jobs are summarizing ticks
+ */
+bool timeline_is_busy(const Timeline *timeline);
+
+/**
+ * @brief Value of a series at one covered tick, 0 outside them
+ */
+float timeline_value(const Timeline *timeline, TimelineSeries series,
+                     int tick);
+
+/**
+ * @brief Summarizes a series over the covered ticks in [first_tick, end_tick)
+ *
+ * Exact; reads O(log ticks) buckets.
+ */
+TimelineSummary timeline_summary(const Timeline *timeline,
+                                 TimelineSeries series, int first_tick,
+                                 int end_tick);
+
+/**
+ * @brief Summarizes a series for each column of a chart
+ *
+ * Column c covers [first_tick, end_tick) split into `columns` equal parts.
+ * Column edges are rounded down to bucket edges of the level used, so they
+ * may shift by less than one column's width. Columns past the covered
+ * ticks get a summary of 0 ticks.
+ *
+ * @param timeline Timeline to read
+ * @param series Series to summarize
+ * @param first_tick First tick of the chart
+ * @param end_tick One past the last tick of the chart
+ * @param columns Number of columns
+ * @param out One summary per column
+ */
+void timeline_columns(const Timeline *timeline, TimelineSeries series,
+                      int first_tick, int end_tick, int columns,
+                      TimelineSummary *out);
+
+#endif
@@ -0,0 +1,472 @@
+#include "unit_events.h"
+#include "../utils/job_system.h"
+#include "../utils/mem_track.h"
+#include "../utils/spatial_grid.h"
+#include "../utils/trace.h"
+#include "raylib.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Events found in one tick range, appended to the index on merge
+typedef struct {
+  UnitEvents *events;
+  int first_tick;
+  int end_tick;
+  UnitEvent *found;
+  int found_count;
+  int found_capacity;
+  int *tick_counts; // UNIT_EVENT_TYPES counts per tick of the range
+  bool failed;      // Out of memory; the range is matched again later
+} UnitEventsSlice;
+
+struct UnitEvents {
+  const SimReplay *replay;
+  int map_width;
+  int map_height;
+  UnitEvent *list; // Events of every covered tick, grouped by tick
+  int count;
+  int capacity;
+  // UNIT_EVENT_TYPES running totals per covered tick, through that tick
+  int *totals;
+  int tick_capacity;
+  int ticks_covered;
+
+  UnitEventsSlice slices[UNIT_EVENTS_MAX_SLICES];
+  int slice_count; // Slices queued for the current batch, 0 when idle
+  int batch_end_tick;
+  JobCounter batch;
+};
+
+static bool unit_events_grow(void **array, int *capacity, int needed,
+                             size_t item_size) {
+  if (needed <= *capacity)
+    return true;
+  int grown = *capacity ? *capacity : 1024;
+  while (grown < needed)
+    grown *= 2;
+  void *resized = mem_track_realloc(MEM_SUBSYSTEM_ANALYSIS, *array,
+                                    (size_t)grown * item_size);
+  if (!resized)
+    return false;
+  *array = resized;
+  *capacity = grown;
+  return true;
+}
+
+static bool unit_events_push(UnitEventsSlice *slice, int tick,
+                             UnitEventType type, const Unit *unit,
+                             int index) {
+  if (!unit_events_grow((void **)&slice->found, &slice->found_capacity,
+                        slice->found_count + 1, sizeof(UnitEvent)))
+    return false;
+  int owner = unit->owner >= 0 && unit->owner <= 255 ? unit->owner : 0;
+  slice->found[slice->found_count++] =
+      (UnitEvent){.x = unit->x,
+                  .y = unit->y,
+                  .unit = index,
+                  .type = (unsigned char)type,
+                  .owner = (unsigned char)owner};
+  slice->tick_counts[(tick - slice->first_tick) * UNIT_EVENT_TYPES + type]++;
+  return true;
+}
+
+static unsigned int unit_events_hash(int id, int capacity) {
+  return ((unsigned int)id * 2654435761u) & (unsigned int)(capacity - 1);
+}
+
+// Fills the id table with the previous tick's units that have an id; the
+// first of duplicate ids wins
+static bool unit_matcher_index_ids(UnitMatcher *matcher, const Unit *units,
+                                   int count) {
+  int capacity = matcher->id_capacity ? matcher->id_capacity : 1024;
+  while (capacity < 2 * count)
+    capacity *= 2;
+  if (capacity > matcher->id_capacity) {
+    int *ids = (int *)mem_track_realloc(MEM_SUBSYSTEM_ANALYSIS, matcher->ids,
+                                        (size_t)capacity * sizeof(int));
+    if (!ids)
+      return false;
+    matcher->ids = ids;
+    matcher->id_capacity = capacity;
+  }
+  memset(matcher->ids, 0xff, (size_t)matcher->id_capacity * sizeof(int));
+
+  for (int i = 0; i < count; i++) {
+    if (units[i].id < 0)
+      continue;
+    unsigned int slot = unit_events_hash(units[i].id, matcher->id_capacity);
+    while (matcher->ids[slot] >= 0 &&
+           units[matcher->ids[slot]].id != units[i].id)
+      slot = (slot + 1) & (unsigned int)(matcher->id_capacity - 1);
+    if (matcher->ids[slot] < 0)
+      matcher->ids[slot] = i;
+  }
+  return true;
+}
+
+static int unit_matcher_find_id(const UnitMatcher *matcher, const Unit *units,
+                                int id) {
+  unsigned int slot = unit_events_hash(id, matcher->id_capacity);
+  while (matcher->ids[slot] >= 0) {
+    if (units[matcher->ids[slot]].id == id)
+      return matcher->ids[slot];
+    slot = (slot + 1) & (unsigned int)(matcher->id_capacity - 1);
+  }
+  return -1;
+}
+
+// Nearest unmatched unit of the previous tick without an id, of the same
+// owner and within UNIT_EVENTS_MATCH_TILES; -1 if there is none
+static int unit_matcher_find_nearest(const UnitMatcher *matcher,
+                                     const Unit *previous, const Unit *unit,
+                                     int map_width, int map_height) {
+  const SpatialGrid *grid = &matcher->grid;
+  float radius = UNIT_EVENTS_MATCH_TILES;
+  // Units off the map are bucketed in the border cells; search from there
+  float x = unit->x < 0.0f ? 0.0f : unit->x;
+  float y = unit->y < 0.0f ? 0.0f : unit->y;
+  if (x > map_width)
+    x = (float)map_width;
+  if (y > map_height)
+    y = (float)map_height;
+
+  int first_cx, first_cy, last_cx, last_cy;
+  if (!spatial_grid_cell_range(grid, x - radius, y - radius, 2 * radius,
+                               2 * radius, &first_cx, &first_cy, &last_cx,
+                               &last_cy))
+    return -1;
+
+  int best = -1;
+  float best_sq = radius * radius;
+  for (int cy = first_cy; cy <= last_cy; cy++) {
+    // Cells of one row are contiguous in the index array
+    int row = cy * grid->cells_x;
+    int begin = grid->cell_start[row + first_cx];
+    int end = grid->cell_start[row + last_cx + 1];
+    for (int k = begin; k < end; k++) {
+      int i = grid->indices[k];
+      const Unit *candidate = &previous[i];
+      if (candidate->id >= 0 || matcher->matches[i] >= 0 ||
+          candidate->owner != unit->owner)
+        continue;
+      float dx = candidate->x - unit->x;
+      float dy = candidate->y - unit->y;
+      float d_sq = dx * dx + dy * dy;
+      if (d_sq <= best_sq) {
+        best = i;
+        best_sq = d_sq;
+      }
+    }
+  }
+  return best;
+}
+
+bool unit_matcher_match(UnitMatcher *matcher, const Unit *previous,
+                        int previous_count, const Unit *current,
+                        int current_count, int map_width, int map_height) {
+  if (!unit_events_grow((void **)&matcher->matches, &matcher->match_capacity,
+                        previous_count, sizeof(int)) ||
+      !unit_events_grow((void **)&matcher->sources,
+                        &matcher->source_capacity, current_count,
+                        sizeof(int)))
+    return false;
+  if (previous_count > 0)
+    memset(matcher->matches, 0xff, (size_t)previous_count * sizeof(int));
+
+  // Only build the lookups the two ticks need
+  bool any_id = false;
+  bool any_unnamed = false;
+  for (int j = 0; j < current_count; j++) {
+    any_id = any_id || current[j].id >= 0;
+    any_unnamed = any_unnamed || current[j].id < 0;
+  }
+  if (any_id && !unit_matcher_index_ids(matcher, previous, previous_count))
+    return false;
+  if (any_unnamed &&
+      !spatial_grid_build(&matcher->grid, previous, previous_count,
+                          sizeof(Unit), map_width, map_height,
+                          UNIT_EVENTS_MATCH_TILES))
+    return false;
+
+  for (int j = 0; j < current_count; j++) {
+    const Unit *unit = &current[j];
+    int match;
+    if (unit->id >= 0) {
+      match = unit_matcher_find_id(matcher, previous, unit->id);
+      if (match >= 0 && matcher->matches[match] >= 0)
+        match = -1;
+    } else {
+      match = unit_matcher_find_nearest(matcher, previous, unit, map_width,
+                                        map_height);
+    }
+    matcher->sources[j] = match;
+    if (match >= 0)
+      matcher->matches[match] = j;
+  }
+  return true;
+}
+
+void unit_matcher_free(UnitMatcher *matcher) {
+  spatial_grid_free(&matcher->grid);
+  mem_track_free(matcher->matches);
+  mem_track_free(matcher->sources);
+  mem_track_free(matcher->ids);
+  *matcher = (UnitMatcher){0};
+}
+
+// Matches one tick against the one before it and records its events
+static bool unit_events_match_tick(UnitMatcher *matcher,
+                                   UnitEventsSlice *slice, int tick,
+                                   const SimulationState *before,
+                                   const SimulationState *after) {
+  const UnitEvents *events = slice->events;
+  const Unit *previous = before->units;
+  const Unit *current = after->units;
+  int previous_count = before->unitCount;
+
+  if (!unit_matcher_match(matcher, previous, previous_count, current,
+                          after->unitCount, events->map_width,
+                          events->map_height))
+    return false;
+
+  float far_sq = UNIT_EVENTS_FAR_TILES * UNIT_EVENTS_FAR_TILES;
+  for (int j = 0; j < after->unitCount; j++) {
+    const Unit *unit = &current[j];
+    int match = matcher->sources[j];
+    bool recorded = true;
+    if (match < 0) {
+      recorded = unit_events_push(slice, tick, UNIT_EVENT_SPAWNED, unit, j);
+    } else {
+      float dx = unit->x - previous[match].x;
+      float dy = unit->y - previous[match].y;
+      if (dx * dx + dy * dy > far_sq)
+        recorded =
+            unit_events_push(slice, tick, UNIT_EVENT_MOVED_FAR, unit, j);
+    }
+    if (!recorded)
+      return false;
+  }
+
+  for (int i = 0; i < previous_count; i++) {
+    if (matcher->matches[i] < 0 &&
+        !unit_events_push(slice, tick, UNIT_EVENT_DIED, &previous[i], i))
+      return false;
+  }
+  return true;
+}
+
+static void unit_events_match_slice(void *arg) {
+  UnitEventsSlice *slice = (UnitEventsSlice *)arg;
+  const SimReplay *replay = slice->events->replay;
+  SimulationState states[2];
+  UnitMatcher matcher = {0};
+
+  memset(states, 0, sizeof(states));
+
+  TRACE_ZONE_BEGIN(zone, "unit_events_match");
+
+  // Tick 0 has nothing to be matched against
+  int before = 0;
+  bool have_before = slice->first_tick > 0 &&
+                     LoadReplayTick(replay, slice->first_tick - 1, &states[0]);
+  for (int tick = slice->first_tick; tick < slice->end_tick; tick++) {
+    SimulationState *after = &states[before ^ 1];
+    // A tick that fails to decode has no events and breaks the chain
+    if (!LoadReplayTick(replay, tick, after)) {
+      have_before = false;
+      continue;
+    }
+    if (have_before && !unit_events_match_tick(&matcher, slice, tick,
+                                               &states[before], after)) {
+      slice->failed = true;
+      break;
+    }
+    before ^= 1;
+    have_before = true;
+  }
+
+  FreeStateEntities(&states[0]);
+  FreeStateEntities(&states[1]);
+  unit_matcher_free(&matcher);
+  TRACE_ZONE_END(zone);
+}
+
+// One slice per job worker, like the heatmap
+static int unit_events_slice_limit(void) {
+  int workers = job_system_worker_count();
+  if (workers < 1)
+    return 1;
+  return workers < UNIT_EVENTS_MAX_SLICES ? workers : UNIT_EVENTS_MAX_SLICES;
+}
+
+// Splits [ticks_covered, tick_count) into contiguous ranges, one job each
+static void unit_events_launch(UnitEvents *events, int tick_count) {
+  int first = events->ticks_covered;
+  int total = tick_count - first;
+  int slices = unit_events_slice_limit();
+  if (slices > total)
+    slices = total;
+
+  events->slice_count = 0;
+  for (int s = 0; s < slices; s++) {
+    UnitEventsSlice *slice = &events->slices[events->slice_count];
+    *slice = (UnitEventsSlice){
+        .events = events,
+        .first_tick = first + (int)((long)total * s / slices),
+        .end_tick = first + (int)((long)total * (s + 1) / slices),
+    };
+    slice->tick_counts = (int *)mem_track_calloc(
+        MEM_SUBSYSTEM_ANALYSIS,
+        (size_t)(slice->end_tick - slice->first_tick) * UNIT_EVENT_TYPES,
+        sizeof(int));
+    if (!slice->tick_counts)
+      break;
+    events->slice_count++;
+  }
+
+  if (events->slice_count == 0) {
+    TraceLog(LOG_WARNING, "UnitEvents: Failed to allocate tick ranges");
+    return;
+  }
+  // Ranges that did not get a slice are matched on a later update
+  events->batch_end_tick = events->slices[events->slice_count - 1].end_tick;
+  for (int s = 0; s < events->slice_count; s++)
+    job_run(unit_events_match_slice, &events->slices[s], &events->batch);
+}
+
+// Appends the events and running totals of a finished batch in tick order
+static void unit_events_merge(UnitEvents *events) {
+  int found = 0;
+  bool complete = true;
+  for (int s = 0; s < events->slice_count; s++) {
+    found += events->slices[s].found_count;
+    complete = complete && !events->slices[s].failed;
+  }
+  // Without room the batch is dropped and matched again later
+  complete = complete &&
+             unit_events_grow((void **)&events->list, &events->capacity,
+                              events->count + found, sizeof(UnitEvent)) &&
+             unit_events_grow((void **)&events->totals, &events->tick_capacity,
+                              events->batch_end_tick,
+                              UNIT_EVENT_TYPES * sizeof(int));
+
+  for (int s = 0; s < events->slice_count; s++) {
+    UnitEventsSlice *slice = &events->slices[s];
+    if (complete) {
+      if (slice->found_count > 0)
+        memcpy(&events->list[events->count], slice->found,
+               (size_t)slice->found_count * sizeof(UnitEvent));
+      events->count += slice->found_count;
+      for (int tick = slice->first_tick; tick < slice->end_tick; tick++) {
+        int *totals = &events->totals[tick * UNIT_EVENT_TYPES];
+        const int *counts =
+            &slice->tick_counts[(tick - slice->first_tick) * UNIT_EVENT_TYPES];
+        for (int type = 0; type < UNIT_EVENT_TYPES; type++)
+          totals[type] =
+              (tick > 0 ? totals[type - UNIT_EVENT_TYPES] : 0) + counts[type];
+      }
+    }
+    mem_track_free(slice->found);
+    mem_track_free(slice->tick_counts);
+    *slice = (UnitEventsSlice){0};
+  }
+  events->slice_count = 0;
+
+  if (!complete) {
+    TraceLog(LOG_WARNING, "UnitEvents: Out of memory at %d ticks",
+             events->batch_end_tick);
+    return;
+  }
+  events->ticks_covered = events->batch_end_tick;
+}
+
+UnitEvents *unit_events_create(const SimReplay *replay) {
+  const TileMap *map = GetReplayMap(replay);
+  if (!map)
+    return NULL;
+
+  UnitEvents *events = (UnitEvents *)mem_track_calloc(MEM_SUBSYSTEM_ANALYSIS,
+                                                      1, sizeof(UnitEvents));
+  if (!events)
+    return NULL;
+
+  events->replay = replay;
+  events->map_width = map->width;
+  events->map_height = map->height;
+
+  unit_events_update(events);
+  return events;
+}
+
+void unit_events_destroy(UnitEvents *events) {
+  if (!events)
+    return;
+  job_wait(&events->batch);
+  for (int s = 0; s < events->slice_count; s++) {
+    mem_track_free(events->slices[s].found);
+    mem_track_free(events->slices[s].tick_counts);
+  }
+  mem_track_free(events->list);
+  mem_track_free(events->totals);
+  mem_track_free(events);
+}
+
+bool unit_events_update(UnitEvents *events) {
+  bool changed = false;
+
+  if (events->slice_count > 0) {
+    if (!job_counter_done(&events->batch))
+      return false;
+    int covered = events->ticks_covered;
+    unit_events_merge(events);
+    changed = events->ticks_covered != covered;
+  }
+
+  int tick_count = GetReplayTickCount(events->replay);
+  if (tick_count > events->ticks_covered)
+    unit_events_launch(events, tick_count);
+  return changed;
+}
+
+int unit_events_ticks_covered(const UnitEvents *events) {
+  return events->ticks_covered;
+}
+
+bool unit_events_is_busy(const UnitEvents *events) {
+  return events->slice_count > 0;
+}
+
+// Events of every type in ticks [0, tick]
+static int unit_events_through(const UnitEvents *events, int tick) {
+  if (tick < 0)
+    return 0;
+  const int *totals = &events->totals[tick * UNIT_EVENT_TYPES];
+  int sum = 0;
+  for (int type = 0; type < UNIT_EVENT_TYPES; type++)
+    sum += totals[type];
+  return sum;
+}
+
+const UnitEvent *unit_events_at(const UnitEvents *events, int tick,
+                                int *count) {
+  *count = 0;
+  if (tick <= 0 || tick >= events->ticks_covered)
+    return events->list;
+  int first = unit_events_through(events, tick - 1);
+  *count = unit_events_through(events, tick) - first;
+  return &events->list[first];
+}
+
+int unit_events_count(const UnitEvents *events, UnitEventType type,
+                      int first_tick, int end_tick) {
+  if (first_tick < 0)
+    first_tick = 0;
+  if (end_tick > events->ticks_covered)
+    end_tick = events->ticks_covered;
+  if ((int)type < 0 || type >= UNIT_EVENT_TYPES || first_tick >= end_tick)
+    return 0;
+  const int *totals = &events->totals[type];
+  int before = first_tick > 0 ? totals[(first_tick - 1) * UNIT_EVENT_TYPES] : 0;
+  return totals[(end_tick - 1) * UNIT_EVENT_TYPES] - before;
+}
@@ -0,0 +1,143 @@
+#ifndef UNIT_EVENTS_H
+#define UNIT_EVENTS_H
+
+#include "../utils/spatial_grid.h"
+#include "sim_loader.h"
+#include <stdbool.h>
+
+/**
+ * @brief Spawn, death and jump events found by matching units across ticks
+ *
+ * Ticks are independent arrays, so every tick is matched against the one
+ * before it. Units that both ticks give an explicit id are matched by id
+ * through a hash table; the rest are matched to the nearest unclaimed
+ * unit of the same owner within UNIT_EVENTS_MATCH_TILES, looked up in a
+ * spatial grid of the previous tick. Units left unmatched spawned or died.
+ *
+ * Like the heatmap, ticks are split into contiguous ranges matched in
+ * parallel as jobs, and ticks appended while the replay is indexed are
+ * matched on later updates. Events are stored grouped by tick with running
+ * per-type totals, so the events of a tick and the number of events in any
+ * tick range are found in O(1).
+ */
+
+// Farthest a unit can move in one tick and still be matched by position
+#define UNIT_EVENTS_MATCH_TILES 4
+// A matched unit moving farther than this in one tick raises an event
+#define UNIT_EVENTS_FAR_TILES 2.0f
+// Upper bound on tick ranges matched at once
+#define UNIT_EVENTS_MAX_SLICES 8
+
+typedef enum {
+  UNIT_EVENT_SPAWNED,   // No match in the previous tick
+  UNIT_EVENT_DIED,      // No match in this tick; position and index are
+                        // from the previous tick
+  UNIT_EVENT_MOVED_FAR, // Matched, but moved more than UNIT_EVENTS_FAR_TILES
+  UNIT_EVENT_TYPES
+} UnitEventType;
+
+typedef struct {
+  float x;
+  float y;
+  int unit; // Index of the unit within its tick
+  unsigned char type;
+  unsigned char owner;
+} UnitEvent;
+
+typedef struct UnitEvents UnitEvents;
+
+/**
+ * @brief Scratch for matching the units of a tick to those of the tick
+ *        before it
+ *
+ * Zero-initialise, reuse across ticks so matching does not allocate once
+ * storage has grown, and release with unit_matcher_free().
+ */
+typedef struct {
+  SpatialGrid grid; // Units of the previous tick
+  int *matches;     // Per previous unit: its match in this tick, or -1
+  int match_capacity;
+  int *sources; // Per unit of this tick: its match in the previous, or -1
+  int source_capacity;
+  int *ids; // Open-addressed id table of previous unit indices, -1 empty
+  int id_capacity; // Power of two
+} UnitMatcher;
+
+/**
+ * @brief Matches every unit of a tick to at most one of the tick before
+ *
+ * Uses the id table and nearest-unit search described above. On success
+ * matcher->matches and matcher->sources hold the correspondence in both
+ * directions.
+ *
+ * @param matcher Scratch reused across ticks
+ * @param previous Units of the tick before
+ * @param previous_count Number of those units
+ * @param current Units of the tick matched
+ * @param current_count Number of those units
+ * @param map_width Map width in tiles, bounding the search grid
+ * @param map_height Map height in tiles
+ * @return bool False if scratch storage could not be grown
+ */
+bool unit_matcher_match(UnitMatcher *matcher, const Unit *previous,
+                        int previous_count, const Unit *current,
+                        int current_count, int map_width, int map_height);
+
+/**
+ * @brief Frees a matcher's scratch storage
+ */
+void unit_matcher_free(UnitMatcher *matcher);
+
+/**
+ * @brief Creates an empty event index for a replay and starts matching
+ *
+ * The replay must outlive the index; it is only read.
+ *
+ * @return UnitEvents* New index, or NULL on allocation failure
+ */
+UnitEvents *unit_events_create(const SimReplay *replay);
+
+/**
+ * @brief Waits for running jobs and frees the index
+ */
+void unit_events_destroy(UnitEvents *events);
+
+/**
+ * @brief Merges finished work and queues jobs for newly appended ticks
+ *
+ * Call once per frame from the thread that owns the index; it never blocks
+ * on jobs.
+ *
+ * @return bool True when ticks were added since the previous call
+ */
+bool unit_events_update(UnitEvents *events);
+
+/**
+ * @brief Number of ticks matched so far, always a prefix of the replay
+ */
+int unit_events_ticks_covered(const UnitEvents *events);
+
+/**
+ * @brief True while jobs are matching ticks
+ */
+bool unit_events_is_busy(const UnitEvents *events);
+
+/**
+ * @brief Events of one covered tick, relative to the tick before it
+ *
+ * @param events Index to read
+ * @param tick Tick to look up; tick 0 and uncovered ticks have none
+ * @param count Receives the number of events
+ * @return const UnitEvent* First event, valid until the next update
+ */
+const UnitEvent *unit_events_at(const UnitEvents *events, int tick,
+                                int *count);
+
+/**
+ * @brief Counts events of one type over the covered ticks in
+ *        [first_tick, end_tick)
+ */
+int unit_events_count(const UnitEvents *events, UnitEventType type,
+                      int first_tick, int end_tick);
+
+#endif
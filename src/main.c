@@ -1,16 +1,67 @@
 #include "client/sim_loader.h"
 #include "render/game_window.h"
+#include "utils/job_system.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-int main(void) {
-  SimulationState *sim = LoadState();
-  if (sim == NULL) {
-    return 1;
-  }
+static void print_usage(const char *program) {
+  printf("Usage: %s [replay.sim.json] [--compare other.sim.json] "
+         "[--offset ticks] [--map world.axmap]\n",
+         program);
+  printf("  --compare FILE  Show FILE side by side with the replay\n");
+  printf("  --offset N      Show the replay next to itself N ticks ahead, or "
+         "shift the compared replay by N ticks\n");
+  printf("  --map FILE      Page the terrain from FILE instead of holding the "
+         "replay's map in memory\n");
+  printf("  --write-map FILE  Write the replay's map as a paged map to FILE "
+         "and exit\n");
+}
+
+// Converts the replay's map into the chunked file --map reads, without
+// ever holding the whole map
+static int write_paged_map(const char *filename, const char *path) {
+  job_system_init_headless();
+  int width = 0, height = 0;
+  bool ok = WriteReplayPagedMap(filename, path, &width, &height);
+  if (ok)
+    printf("Wrote %dx%d paged map to %s\n", width, height, path);
+  job_system_shutdown();
+  return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+  const char *filename = "../assets/test.sim.json";
+  GameWindowCompare compare = {0};
+  bool comparing = false;
+  const char *write_map = NULL;
 
-  int result = game_window_run(sim);
-  FreeState(sim);
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc) {
+      compare.filename = argv[++i];
+      comparing = true;
+    } else if (strcmp(argv[i], "--offset") == 0 && i + 1 < argc) {
+      compare.tick_offset = atoi(argv[++i]);
+      comparing = true;
+    } else if (strcmp(argv[i], "--map") == 0 && i + 1 < argc) {
+      game_window_use_paged_map(argv[++i]);
+    } else if (strcmp(argv[i], "--write-map") == 0 && i + 1 < argc) {
+      write_map = argv[++i];
+    } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+      print_usage(argv[0]);
+      return 0;
+    } else if (argv[i][0] == '-') {
+      printf("Error: Unknown option %s\n", argv[i]);
+      print_usage(argv[0]);
+      return 1;
+    } else {
+      filename = argv[i];
+    }
+  }
 
-  return result;
+  if (write_map)
+    return write_paged_map(filename, write_map);
+  if (comparing)
+    return game_window_run_compare(filename, &compare);
+  return game_window_run(filename);
 }
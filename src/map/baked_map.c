@@ -0,0 +1,348 @@
+#include "baked_map.h"
+#include "../utils/job_system.h"
+#include "../utils/mem_track.h"
+#include "../utils/trace.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BAKED_MAP_HASH_PRIME 0x100000001b3ull
+// Checksum blocks hashed by one job
+#define BAKED_MAP_CHECKSUM_GRAIN 4
+
+// Distinguishes temporary files of writes running at the same time
+static atomic_uint g_baked_map_writes;
+
+// Checks the blocks that opening did not sample, after the map is in use
+struct BakedMapVerify {
+  const unsigned char *tiles; // In a read-only shared mapping of the file
+  size_t bytes;
+  const uint64_t *checksums;
+  void *mapping;
+  size_t mapping_bytes;
+  dev_t device; // Identify the checked file, so a newer one is never removed
+  ino_t inode;
+  atomic_bool cancel;
+  atomic_int damaged;
+  JobCounter blocks;
+  JobCounter done;
+  char path[];
+};
+
+static uint64_t baked_map_hash(const void *source, size_t bytes) {
+  const unsigned char *data = (const unsigned char *)source;
+  uint64_t hash = 0xcbf29ce484222325ull ^ (uint64_t)bytes;
+  size_t i = 0;
+
+  // FNV-style, a word at a time so a large map's text hashes in
+  // milliseconds
+  for (; i + sizeof(uint64_t) <= bytes; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, data + i, sizeof(word));
+    hash = (hash ^ word) * BAKED_MAP_HASH_PRIME;
+    hash ^= hash >> 29;
+  }
+  for (; i < bytes; i++)
+    hash = (hash ^ data[i]) * BAKED_MAP_HASH_PRIME;
+  return hash ^ (hash >> 32);
+}
+
+uint64_t baked_map_key(const void *source, size_t bytes) {
+  // Tiles are built through the mapping table, so caches built with a
+  // different table get a different key
+  size_t mapping_count;
+  const TileType *mappings = map_tile_mappings(&mapping_count);
+  uint64_t table = baked_map_hash(mappings, mapping_count * sizeof(TileType));
+  return baked_map_hash(source, bytes) ^ (table * BAKED_MAP_HASH_PRIME);
+}
+
+static int baked_map_block_count(size_t bytes) {
+  return (int)((bytes + BAKED_MAP_CHECKSUM_BLOCK - 1) /
+               BAKED_MAP_CHECKSUM_BLOCK);
+}
+
+static uint64_t baked_map_block_checksum(const unsigned char *tiles,
+                                         size_t bytes, int block) {
+  size_t offset = (size_t)block * BAKED_MAP_CHECKSUM_BLOCK;
+  size_t length = bytes - offset;
+  if (length > BAKED_MAP_CHECKSUM_BLOCK)
+    length = BAKED_MAP_CHECKSUM_BLOCK;
+  // Mixing in the block index makes each checksum depend on where it is
+  return baked_map_hash(tiles + offset, length) ^
+         ((uint64_t)block * 0x9e3779b97f4a7c15ull);
+}
+
+// Covers the header fields and the block table, so a damaged table is
+// caught before any block is compared against it
+static uint64_t baked_map_header_checksum(const BakedMapHeader *header,
+                                          const uint64_t *checksums,
+                                          int blocks) {
+  BakedMapHeader fields = *header;
+  fields.header_checksum = 0;
+  return baked_map_hash(&fields, sizeof(fields)) ^
+         (baked_map_hash(checksums, (size_t)blocks * sizeof(uint64_t)) *
+          BAKED_MAP_HASH_PRIME);
+}
+
+typedef struct {
+  const unsigned char *tiles;
+  size_t bytes;
+  uint64_t *checksums;
+} BakedMapChecksums;
+
+static void baked_map_checksum_blocks(void *arg, int begin, int end) {
+  BakedMapChecksums *checksums = (BakedMapChecksums *)arg;
+  for (int block = begin; block < end; block++)
+    checksums->checksums[block] =
+        baked_map_block_checksum(checksums->tiles, checksums->bytes, block);
+}
+
+static void baked_map_verify_blocks(void *arg, int begin, int end) {
+  BakedMapVerify *verify = (BakedMapVerify *)arg;
+  for (int block = begin; block < end; block++) {
+    if (atomic_load_explicit(&verify->cancel, memory_order_relaxed))
+      return;
+    if (baked_map_block_checksum(verify->tiles, verify->bytes, block) !=
+        verify->checksums[block])
+      atomic_fetch_add(&verify->damaged, 1);
+  }
+}
+
+// Removes a damaged file so the next open rebuilds it; the map already in
+// use keeps its tiles
+static void baked_map_verify_finish(void *arg) {
+  BakedMapVerify *verify = (BakedMapVerify *)arg;
+  if (atomic_load(&verify->damaged) > 0) {
+    struct stat info;
+    if (stat(verify->path, &info) == 0 && info.st_dev == verify->device &&
+        info.st_ino == verify->inode)
+      remove(verify->path);
+    printf("Warning: Map cache %s is damaged; it will be rebuilt\n",
+           verify->path);
+  }
+  munmap(verify->mapping, verify->mapping_bytes);
+}
+
+// Maps the file again read-only, so checking never races with writes to
+// the copy-on-write tiles, and queues a check of every block
+static BakedMapVerify *baked_map_start_verify(int fd, const char *path,
+                                              const struct stat *info,
+                                              size_t tiles_offset,
+                                              int blocks) {
+  size_t path_bytes = strlen(path) + 1;
+  BakedMapVerify *verify = (BakedMapVerify *)mem_track_calloc(
+      MEM_SUBSYSTEM_MAP, 1, sizeof(BakedMapVerify) + path_bytes);
+  if (!verify)
+    return NULL;
+  verify->mapping_bytes = (size_t)info->st_size;
+  verify->mapping =
+      mmap(NULL, verify->mapping_bytes, PROT_READ, MAP_SHARED, fd, 0);
+  if (verify->mapping == MAP_FAILED) {
+    mem_track_free(verify);
+    return NULL;
+  }
+  verify->tiles = (const unsigned char *)verify->mapping + tiles_offset;
+  verify->bytes = verify->mapping_bytes - tiles_offset;
+  verify->checksums = (const uint64_t *)((const char *)verify->mapping +
+                                         sizeof(BakedMapHeader));
+  verify->device = info->st_dev;
+  verify->inode = info->st_ino;
+  atomic_init(&verify->cancel, false);
+  atomic_init(&verify->damaged, 0);
+  memcpy(verify->path, path, path_bytes);
+
+  job_parallel_for(blocks, BAKED_MAP_CHECKSUM_GRAIN, baked_map_verify_blocks,
+                   verify, &verify->blocks);
+  job_run_after(&verify->blocks, baked_map_verify_finish, verify,
+                &verify->done);
+  return verify;
+}
+
+static bool baked_map_make_dir(const char *dir) {
+  return mkdir(dir, 0755) == 0 || errno == EEXIST;
+}
+
+// Resolves the cache directory, creating missing levels below the base
+static bool baked_map_cache_dir(char *dir, size_t size) {
+  const char *custom = getenv("AXIOM_MAP_CACHE_DIR");
+  if (custom) {
+    if (!custom[0])
+      return false;
+    return snprintf(dir, size, "%s", custom) < (int)size &&
+           baked_map_make_dir(dir);
+  }
+
+  const char *xdg = getenv("XDG_CACHE_HOME");
+  if (xdg && xdg[0])
+    return snprintf(dir, size, "%s/axiorem", xdg) < (int)size &&
+           baked_map_make_dir(dir);
+
+  const char *home = getenv("HOME");
+  if (!home || !home[0])
+    return false;
+  return snprintf(dir, size, "%s/.cache", home) < (int)size &&
+         baked_map_make_dir(dir) &&
+         snprintf(dir, size, "%s/.cache/axiorem", home) < (int)size &&
+         baked_map_make_dir(dir);
+}
+
+bool baked_map_cache_path(uint64_t key, char *path, size_t path_size) {
+  char dir[4096];
+  if (!baked_map_cache_dir(dir, sizeof(dir)))
+    return false;
+  return snprintf(path, path_size, "%s/map-%016llx.axmc", dir,
+                  (unsigned long long)key) < (int)path_size;
+}
+
+bool baked_map_open(const char *path, uint64_t key, size_t source_bytes,
+                    BakedMap *baked) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  TRACE_ZONE_BEGIN(zone, "baked_map_open");
+  BakedMapHeader header = {0};
+  struct stat info;
+  size_t tile_bytes = 0;
+  int blocks = 0;
+  bool valid =
+      pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+      memcmp(header.magic, BAKED_MAP_MAGIC, sizeof(header.magic)) == 0 &&
+      header.version == BAKED_MAP_VERSION &&
+      header.tile_bytes == sizeof(Tile) && header.source_key == key &&
+      header.source_bytes == (uint64_t)source_bytes && header.width > 0 &&
+      header.height > 0 && fstat(fd, &info) == 0;
+  if (valid) {
+    tile_bytes = (size_t)header.width * (size_t)header.height * sizeof(Tile);
+    blocks = baked_map_block_count(tile_bytes);
+    valid = (uint64_t)info.st_size ==
+            sizeof(header) + (uint64_t)blocks * sizeof(uint64_t) + tile_bytes;
+  }
+  size_t tiles_offset = sizeof(header) + (size_t)blocks * sizeof(uint64_t);
+
+  void *mapping = MAP_FAILED;
+  if (valid)
+    mapping = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE, fd, 0);
+  const uint64_t *checksums = NULL;
+  const unsigned char *tiles = NULL;
+  valid = mapping != MAP_FAILED;
+  if (valid) {
+    checksums = (const uint64_t *)((char *)mapping + sizeof(header));
+    tiles = (const unsigned char *)mapping + tiles_offset;
+    valid = baked_map_header_checksum(&header, checksums, blocks) ==
+            header.header_checksum;
+  }
+
+  // Only a few blocks are checked before the map is used; reading every
+  // page here would cost more than the mapping saves
+  for (int sample = 0; valid && sample < BAKED_MAP_SAMPLE_BLOCKS; sample++) {
+    int block = BAKED_MAP_SAMPLE_BLOCKS > 1
+                    ? (int)((int64_t)sample * (blocks - 1) /
+                            (BAKED_MAP_SAMPLE_BLOCKS - 1))
+                    : 0;
+    valid = baked_map_block_checksum(tiles, tile_bytes, block) ==
+            checksums[block];
+  }
+  BakedMapVerify *verify = NULL;
+  if (valid && blocks > BAKED_MAP_SAMPLE_BLOCKS) {
+    verify = baked_map_start_verify(fd, path, &info, tiles_offset, blocks);
+    valid = verify != NULL;
+  }
+  close(fd);
+  TRACE_ZONE_END(zone);
+
+  if (!valid) {
+    if (mapping != MAP_FAILED)
+      munmap(mapping, (size_t)info.st_size);
+    printf("Warning: Ignoring stale or damaged map cache %s\n", path);
+    return false;
+  }
+
+  *baked = (BakedMap){
+      .map = {.width = header.width,
+              .height = header.height,
+              .tiles = (Tile *)tiles},
+      .mapping = mapping,
+      .mapping_bytes = (size_t)info.st_size,
+      .verify = verify,
+  };
+  return true;
+}
+
+void baked_map_close(BakedMap *baked) {
+  if (baked->verify) {
+    atomic_store(&baked->verify->cancel, true);
+    job_wait(&baked->verify->done);
+    mem_track_free(baked->verify);
+  }
+  if (baked->mapping)
+    munmap(baked->mapping, baked->mapping_bytes);
+  *baked = (BakedMap){0};
+}
+
+bool baked_map_write(const TileMap *map, uint64_t key, size_t source_bytes,
+                     const char *path) {
+  if (!map || !map->tiles || map->width <= 0 || map->height <= 0)
+    return false;
+
+  char temp[4096];
+  if (snprintf(temp, sizeof(temp), "%s.%d.%u.tmp", path, (int)getpid(),
+               atomic_fetch_add(&g_baked_map_writes, 1)) >= (int)sizeof(temp))
+    return false;
+  FILE *file = fopen(temp, "wb");
+  if (!file) {
+    printf("Error: Could not create map cache %s\n", temp);
+    return false;
+  }
+
+  TRACE_ZONE_BEGIN(zone, "baked_map_write");
+  size_t tile_count = (size_t)map->width * (size_t)map->height;
+  BakedMapChecksums checksums = {
+      .tiles = (const unsigned char *)map->tiles,
+      .bytes = tile_count * sizeof(Tile),
+  };
+  int blocks = baked_map_block_count(checksums.bytes);
+  checksums.checksums = (uint64_t *)mem_track_malloc(
+      MEM_SUBSYSTEM_MAP, (size_t)blocks * sizeof(uint64_t));
+  bool ok = checksums.checksums != NULL;
+  if (ok) {
+    JobCounter counter = {0};
+    job_parallel_for(blocks, BAKED_MAP_CHECKSUM_GRAIN,
+                     baked_map_checksum_blocks, &checksums, &counter);
+    job_wait(&counter);
+  }
+
+  BakedMapHeader header = {
+      .version = BAKED_MAP_VERSION,
+      .tile_bytes = sizeof(Tile),
+      .width = map->width,
+      .height = map->height,
+      .source_key = key,
+      .source_bytes = (uint64_t)source_bytes,
+  };
+  memcpy(header.magic, BAKED_MAP_MAGIC, sizeof(header.magic));
+  if (ok)
+    header.header_checksum =
+        baked_map_header_checksum(&header, checksums.checksums, blocks);
+  ok = ok && fwrite(&header, sizeof(header), 1, file) == 1 &&
+       fwrite(checksums.checksums, sizeof(uint64_t), (size_t)blocks, file) ==
+           (size_t)blocks &&
+       fwrite(map->tiles, sizeof(Tile), tile_count, file) == tile_count;
+  mem_track_free(checksums.checksums);
+
+  ok = fclose(file) == 0 && ok;
+  ok = ok && rename(temp, path) == 0;
+  if (!ok) {
+    printf("Error: Could not write map cache %s\n", path);
+    remove(temp);
+  }
+  TRACE_ZONE_END(zone);
+  return ok;
+}
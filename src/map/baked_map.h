@@ -0,0 +1,112 @@
+#ifndef BAKED_MAP_H
+#define BAKED_MAP_H
+
+#include "map.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief On-disk cache of autotiled maps, keyed by the map's source text
+ *
+ * Parsing a replay's map and autotiling it costs seconds on large maps, yet
+ * the result never changes between runs. Once a map has been built it is
+ * written as a flat file named after a hash of the map's JSON text and of
+ * the tile mapping table; later opens map that file and use its tiles in
+ * place instead of parsing and autotiling again.
+ *
+ * A file is used only if its header matches the key, the source length,
+ * the format version and this build's Tile layout, its size matches the
+ * map, a checksum of the header and block table matches, and a few sampled
+ * blocks of tiles match their checksums. Checking every block before use
+ * would read the whole file and lose most of what mapping it saves, so the
+ * remaining blocks are checked by jobs while the map is already in use; a
+ * damaged file found that way is removed, and the next open rebuilds it.
+ * Files are written under a temporary name and renamed into place, so an
+ * interrupted write never leaves a truncated cache behind. Anything that
+ * fails the checks on open is rebuilt and overwritten.
+ *
+ * Cache files live in $AXIOM_MAP_CACHE_DIR, else $XDG_CACHE_HOME/axiorem,
+ * else $HOME/.cache/axiorem. Setting AXIOM_MAP_CACHE_DIR to an empty string
+ * disables the cache.
+ *
+ * File layout, native byte order:
+ *   BakedMapHeader
+ *   One checksum per BAKED_MAP_CHECKSUM_BLOCK bytes of tiles, uint64_t
+ *   width * height Tiles in row-major order
+ */
+
+#define BAKED_MAP_MAGIC "AXMC"
+// Bump whenever autotiling changes, so older caches are rebuilt
+#define BAKED_MAP_VERSION 3
+// Bytes of tiles per checksum block
+#define BAKED_MAP_CHECKSUM_BLOCK (1 << 20)
+// Blocks checked before a file is used: the first, the last and evenly
+// spaced ones between
+#define BAKED_MAP_SAMPLE_BLOCKS 3
+
+typedef struct {
+  char magic[4];
+  unsigned int version;
+  unsigned int tile_bytes; // sizeof(Tile) of the writer
+  int width;
+  int height;
+  unsigned int reserved;
+  uint64_t source_key;     // baked_map_key() of the map's JSON text
+  uint64_t source_bytes;   // Length of that text
+  uint64_t header_checksum; // Of this header and the block checksums
+} BakedMapHeader;
+
+typedef struct BakedMapVerify BakedMapVerify;
+
+typedef struct {
+  TileMap map; // Tiles point into the mapping
+  void *mapping;
+  size_t mapping_bytes;
+  BakedMapVerify *verify; // Background check of the blocks, or NULL
+} BakedMap;
+
+/**
+ * @brief Hashes a map's source text and the tile mapping table into its
+ *        cache key
+ */
+uint64_t baked_map_key(const void *source, size_t bytes);
+
+/**
+ * @brief Builds the cache file path for a key, creating the directory
+ *
+ * @return bool False when caching is disabled or no directory is usable
+ */
+bool baked_map_cache_path(uint64_t key, char *path, size_t path_size);
+
+/**
+ * @brief Maps a cache file if it holds the map built from the given source
+ *
+ * The tiles are mapped copy-on-write, so the map may be modified like one
+ * built in memory. Blocks not sampled here are checked in the background;
+ * baked_map_close() stops that check if it is still running.
+ *
+ * @param path Cache file
+ * @param key baked_map_key() of the source text
+ * @param source_bytes Length of the source text
+ * @param baked Receives the map; release it with baked_map_close()
+ * @return bool False if the file is missing, stale or damaged
+ */
+bool baked_map_open(const char *path, uint64_t key, size_t source_bytes,
+                    BakedMap *baked);
+
+void baked_map_close(BakedMap *baked);
+
+/**
+ * @brief Writes a resident map as a cache file, replacing any old one
+ *
+ * @param map Autotiled map to write; must not be paged
+ * @param key baked_map_key() of the source text
+ * @param source_bytes Length of the source text
+ * @param path Cache file
+ * @return bool False if the file could not be written
+ */
+bool baked_map_write(const TileMap *map, uint64_t key, size_t source_bytes,
+                     const char *path);
+
+#endif
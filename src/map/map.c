@@ -1,10 +1,16 @@
 #include "map.h"
+#include "paged_map.h"
+#include "../utils/job_system.h"
+#include "../utils/trace.h"
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 
+// Rows autotiled by one job
+#define PREPROCESS_GRAIN_ROWS 32
+
 static TileType TILE_MAPPINGS[] = {
     // Basic terrain tiles
     {.key = TILE_WATER,
@@ -75,6 +81,11 @@ static TileType TILE_MAPPINGS[] = {
      .atlas_coords = {0, 1}},
 };
 
+const TileType *map_tile_mappings(size_t *count) {
+  *count = sizeof(TILE_MAPPINGS) / sizeof(TILE_MAPPINGS[0]);
+  return TILE_MAPPINGS;
+}
+
 Tile raw_to_tile(RawTileKey raw_key) {
   Tile tile = {.elevation = 0,
                .texture_index_x = 0,
@@ -112,37 +123,51 @@ TileKey get_neighbor_at_offset(TileMap *map, int x, int y, int dx, int dy) {
     return TILE_UNKNOWN;
   }
 
-  int idx = ny * map->width + nx;
+  size_t idx = (size_t)ny * map->width + nx;
   return map->tiles[idx].key;
 }
 
-void preprocess_map(TileMap *map) {
-  for (int y = 0; y < map->height; y++) {
+const Tile *map_get_tile(const TileMap *map, int x, int y) {
+  if (map->paged)
+    return paged_map_tile(map->paged, x, y);
+  return &map->tiles[(size_t)y * map->width + x];
+}
+
+// Neighbours are tested on their raw key, which rows being autotiled on
+// other threads never write
+static bool is_land_at_offset(const TileMap *map, int x, int y, int dx,
+                              int dy) {
+  int nx = x + dx;
+  int ny = y + dy;
+  if (nx < 0 || nx >= map->width || ny < 0 || ny >= map->height)
+    return false;
+  return map->tiles[(size_t)ny * map->width + nx].raw_key == R_TILE_LAND;
+}
+
+typedef struct {
+  TileMap *map;
+  int first_row;
+} PreprocessRows;
+
+// Autotiles the water of rows [begin, end), counted from first_row
+static void preprocess_rows(void *arg, int begin, int end) {
+  const PreprocessRows *rows = (const PreprocessRows *)arg;
+  TileMap *map = rows->map;
+  for (int y = rows->first_row + begin; y < rows->first_row + end; y++) {
     for (int x = 0; x < map->width; x++) {
-      Tile tile = map->tiles[y * map->width + x];
-      if (tile.raw_key != R_TILE_WATER) {
+      Tile *tile = &map->tiles[(size_t)y * map->width + x];
+      if (tile->raw_key != R_TILE_WATER) {
         continue;
       }
 
-      // Get neighbor tile keys
-      TileKey tl = get_neighbor_at_offset(map, x, y, -1, -1);
-      TileKey t = get_neighbor_at_offset(map, x, y, 0, -1);
-      TileKey tr = get_neighbor_at_offset(map, x, y, 1, -1);
-      TileKey l = get_neighbor_at_offset(map, x, y, -1, 0);
-      TileKey r = get_neighbor_at_offset(map, x, y, 1, 0);
-      TileKey bl = get_neighbor_at_offset(map, x, y, -1, 1);
-      TileKey b = get_neighbor_at_offset(map, x, y, 0, 1);
-      TileKey br = get_neighbor_at_offset(map, x, y, 1, 1);
-
-      // Convert to booleans
-      bool is_tl_land = (tl == TILE_LAND);
-      bool is_t_land = (t == TILE_LAND);
-      bool is_tr_land = (tr == TILE_LAND);
-      bool is_l_land = (l == TILE_LAND);
-      bool is_r_land = (r == TILE_LAND);
-      bool is_bl_land = (bl == TILE_LAND);
-      bool is_b_land = (b == TILE_LAND);
-      bool is_br_land = (br == TILE_LAND);
+      bool is_tl_land = is_land_at_offset(map, x, y, -1, -1);
+      bool is_t_land = is_land_at_offset(map, x, y, 0, -1);
+      bool is_tr_land = is_land_at_offset(map, x, y, 1, -1);
+      bool is_l_land = is_land_at_offset(map, x, y, -1, 0);
+      bool is_r_land = is_land_at_offset(map, x, y, 1, 0);
+      bool is_bl_land = is_land_at_offset(map, x, y, -1, 1);
+      bool is_b_land = is_land_at_offset(map, x, y, 0, 1);
+      bool is_br_land = is_land_at_offset(map, x, y, 1, 1);
 
       TileKey key = TILE_WATER;
 
@@ -193,8 +218,22 @@ void preprocess_map(TileMap *map) {
       if (is_b_land && is_br_land && is_r_land) {
         key = TILE_WATER_LAND_BR_R_B;
       }
-      map->tiles[y * map->width + x].key = key;
-      update_coordinates(&map->tiles[y * map->width + x]);
+      tile->key = key;
+      update_coordinates(tile);
     }
   }
 }
+
+void preprocess_map(TileMap *map) {
+  preprocess_map_rows(map, 0, map->height);
+}
+
+void preprocess_map_rows(TileMap *map, int first_row, int end_row) {
+  TRACE_ZONE_BEGIN(zone, "preprocess_map");
+  PreprocessRows rows = {.map = map, .first_row = first_row};
+  JobCounter done = {0};
+  job_parallel_for(end_row - first_row, PREPROCESS_GRAIN_ROWS,
+                   preprocess_rows, &rows, &done);
+  job_wait(&done);
+  TRACE_ZONE_END(zone);
+}
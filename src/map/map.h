@@ -1,6 +1,8 @@
 #ifndef MAP_H
 #define MAP_H
 
+#include <stddef.h>
+
 typedef enum { R_TILE_WATER, R_TILE_LAND, R_TILE_DIRT, R_TILE_ROCK } RawTileKey;
 
 typedef enum {
@@ -47,14 +49,43 @@ typedef struct {
   int texture_index_y;
 } Tile;
 
+typedef struct PagedMap PagedMap;
+
+// Sizes fit in an int, tile counts may not: index with size_t
 typedef struct {
   int width;
   int height;
-  Tile *tiles;
+  Tile *tiles;     // width * height tiles, NULL when paged
+  PagedMap *paged; // Chunked file the tiles are read from, or NULL
 } TileMap;
 
+/**
+ * @brief Table of tile types that autotiling maps raw tiles onto
+ *
+ * @param count Receives the number of entries
+ * @return const TileType* First entry
+ */
+const TileType *map_tile_mappings(size_t *count);
+
 Tile raw_to_tile(RawTileKey raw_key);
 void update_coordinates(Tile *tile);
 TileKey get_neighbor_at_offset(TileMap *map, int x, int y, int dx, int dy);
 void preprocess_map(TileMap *map);
+
+/**
+ * @brief Autotiles rows [first_row, end_row) of a map
+ *
+ * The rows just outside the range are read as neighbours but not changed,
+ * so a band of a larger map can be autotiled on its own as long as it
+ * holds one extra row on each side that is not a map edge.
+ */
+void preprocess_map_rows(TileMap *map, int first_row, int end_row);
+
+/**
+ * @brief Returns the tile at (x, y), which must lie inside the map
+ *
+ * Paged maps read the tile's chunk in if it is not resident; the pointer
+ * then stays valid until the next tile access.
+ */
+const Tile *map_get_tile(const TileMap *map, int x, int y);
 #endif
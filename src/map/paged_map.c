@@ -0,0 +1,704 @@
+#include "paged_map.h"
+#include "../utils/chunk_table.h"
+#include "../utils/mem_track.h"
+#include "../utils/trace.h"
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Chunks kept resident however small the budget
+#define PAGED_MAP_MIN_SLOTS 16
+// Chunks queued for the pager thread per prefetch call
+#define PAGED_MAP_PREFETCH_PER_UPDATE 8
+// Updates of camera motion the read-ahead looks into the future
+#define PAGED_MAP_LOOKAHEAD_UPDATES 30
+
+typedef enum {
+  PAGED_CHUNK_FREE,
+  PAGED_CHUNK_LOADING, // Owned by the pager thread until it turns READY
+  PAGED_CHUNK_READY,
+} PagedChunkState;
+
+typedef struct {
+  Tile *tiles;
+  int64_t index;           // Chunk held, -1 when free
+  unsigned long last_used; // Update of the last access or prefetch
+  _Atomic int state;
+} PagedChunk;
+
+struct PagedMap {
+  int fd;
+  int width;
+  int height;
+  int chunk_tiles;
+  int chunks_x;
+  int chunks_y;
+  int64_t data_offset; // Byte offset of the first chunk
+  size_t chunk_bytes;
+  TileMap overview;
+
+  // Slots and the table are only touched by the render thread, except for
+  // a LOADING slot's tiles and state, which belong to the pager thread
+  Tile *storage;
+  PagedChunk *slots;
+  int slot_count;
+  ChunkTable table;
+  unsigned long frame;
+  int64_t last_index; // Chunk paged_map_tile() returned last, or -1
+  const Tile *last_tiles;
+
+  // Camera motion in tiles per update, smoothed
+  bool has_center;
+  float center_x;
+  float center_y;
+  float velocity_x;
+  float velocity_y;
+
+  pthread_mutex_t mutex;
+  pthread_cond_t wake;   // Work queued or quitting
+  pthread_cond_t loaded; // A LOADING slot turned READY
+  int *queue;            // Ring of LOADING slots, one entry per slot at most
+  int queue_head;
+  int queue_count;
+  bool quit;
+  bool has_thread;
+  pthread_t thread;
+
+  unsigned long faults;
+  unsigned long evictions;
+  atomic_ulong prefetched;
+  atomic_ulong read_errors;
+};
+
+static size_t paged_map_tile_count(int width, int height) {
+  return (size_t)width * (size_t)height;
+}
+
+static int paged_map_overview_step(int width, int height) {
+  int side = width > height ? width : height;
+  return (side + PAGED_MAP_OVERVIEW_SIZE - 1) / PAGED_MAP_OVERVIEW_SIZE;
+}
+
+static PagedMapHeader paged_map_header(int width, int height) {
+  int step = paged_map_overview_step(width, height);
+  PagedMapHeader header = {
+      .version = PAGED_MAP_VERSION,
+      .tile_bytes = sizeof(Tile),
+      .width = width,
+      .height = height,
+      .chunk_tiles = PAGED_MAP_CHUNK_TILES,
+      .overview_width = (width + step - 1) / step,
+      .overview_height = (height + step - 1) / step,
+  };
+  memcpy(header.magic, PAGED_MAP_MAGIC, sizeof(header.magic));
+  return header;
+}
+
+// Writes one row of chunks from up to PAGED_MAP_CHUNK_TILES rows of tiles,
+// one chunk at a time; the padding past the map edge stays zeroed
+static bool paged_map_write_chunk_row(FILE *file, const Tile *rows,
+                                      int width, int row_count, Tile *chunk) {
+  size_t chunk_tiles = (size_t)PAGED_MAP_CHUNK_TILES * PAGED_MAP_CHUNK_TILES;
+  int chunks_x = (width + PAGED_MAP_CHUNK_TILES - 1) / PAGED_MAP_CHUNK_TILES;
+  for (int cx = 0; cx < chunks_x; cx++) {
+    memset(chunk, 0, chunk_tiles * sizeof(Tile));
+    int x0 = cx * PAGED_MAP_CHUNK_TILES;
+    int columns = width - x0 < PAGED_MAP_CHUNK_TILES ? width - x0
+                                                     : PAGED_MAP_CHUNK_TILES;
+    for (int row = 0; row < row_count; row++)
+      memcpy(&chunk[(size_t)row * PAGED_MAP_CHUNK_TILES],
+             &rows[(size_t)row * width + x0], (size_t)columns * sizeof(Tile));
+    if (fwrite(chunk, sizeof(Tile), chunk_tiles, file) != chunk_tiles)
+      return false;
+  }
+  return true;
+}
+
+bool paged_map_write(const TileMap *map, const char *path) {
+  if (!map || !map->tiles || map->width <= 0 || map->height <= 0)
+    return false;
+
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    printf("Error: Could not create paged map %s\n", path);
+    return false;
+  }
+
+  TRACE_ZONE_BEGIN(zone, "paged_map_write");
+  int step = paged_map_overview_step(map->width, map->height);
+  PagedMapHeader header = paged_map_header(map->width, map->height);
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+  for (int oy = 0; ok && oy < header.overview_height; oy++) {
+    for (int ox = 0; ok && ox < header.overview_width; ox++) {
+      const Tile *tile = &map->tiles[(size_t)oy * step * map->width +
+                                     (size_t)ox * step];
+      ok = fwrite(tile, sizeof(Tile), 1, file) == 1;
+    }
+  }
+
+  size_t chunk_tiles = (size_t)PAGED_MAP_CHUNK_TILES * PAGED_MAP_CHUNK_TILES;
+  Tile *chunk =
+      (Tile *)mem_track_malloc(MEM_SUBSYSTEM_MAP, chunk_tiles * sizeof(Tile));
+  ok = ok && chunk;
+  for (int y0 = 0; ok && y0 < map->height; y0 += PAGED_MAP_CHUNK_TILES) {
+    int rows = map->height - y0 < PAGED_MAP_CHUNK_TILES
+                   ? map->height - y0
+                   : PAGED_MAP_CHUNK_TILES;
+    ok = paged_map_write_chunk_row(
+        file, &map->tiles[(size_t)y0 * map->width], map->width, rows, chunk);
+  }
+  mem_track_free(chunk);
+
+  ok = fclose(file) == 0 && ok;
+  if (!ok) {
+    printf("Error: Could not write paged map %s\n", path);
+    remove(path);
+  }
+  TRACE_ZONE_END(zone);
+  return ok;
+}
+
+// Rows of the writer's band: a chunk row plus one neighbour row each side
+#define PAGED_MAP_BAND_ROWS (PAGED_MAP_CHUNK_TILES + 2)
+
+struct PagedMapWriter {
+  FILE *file;
+  char *path;
+  PagedMapHeader header;
+  int overview_step;
+  Tile *overview;
+  Tile *chunk;
+  // Raw rows converted to tiles; band.tiles row 0 is map row band_first
+  TileMap band;
+  int band_first;
+  int rows_added;
+  int chunk_rows_written;
+  bool ok;
+};
+
+PagedMapWriter *paged_map_writer_begin(const char *path, int width,
+                                       int height) {
+  if (width <= 0 || height <= 0)
+    return NULL;
+  PagedMapWriter *writer = (PagedMapWriter *)mem_track_calloc(
+      MEM_SUBSYSTEM_MAP, 1, sizeof(PagedMapWriter));
+  if (!writer)
+    return NULL;
+
+  writer->header = paged_map_header(width, height);
+  writer->overview_step = paged_map_overview_step(width, height);
+  size_t path_bytes = strlen(path) + 1;
+  writer->path = (char *)mem_track_malloc(MEM_SUBSYSTEM_MAP, path_bytes);
+  writer->overview = (Tile *)mem_track_calloc(
+      MEM_SUBSYSTEM_MAP,
+      paged_map_tile_count(writer->header.overview_width,
+                           writer->header.overview_height),
+      sizeof(Tile));
+  writer->chunk = (Tile *)mem_track_malloc(
+      MEM_SUBSYSTEM_MAP,
+      (size_t)PAGED_MAP_CHUNK_TILES * PAGED_MAP_CHUNK_TILES * sizeof(Tile));
+  writer->band = (TileMap){
+      .width = width,
+      .tiles = (Tile *)mem_track_malloc(
+          MEM_SUBSYSTEM_MAP,
+          paged_map_tile_count(width, PAGED_MAP_BAND_ROWS) * sizeof(Tile)),
+  };
+  if (!writer->path || !writer->overview || !writer->chunk ||
+      !writer->band.tiles) {
+    paged_map_writer_finish(writer);
+    return NULL;
+  }
+  memcpy(writer->path, path, path_bytes);
+
+  // The overview is only complete at the end; its space is left for it
+  writer->file = fopen(path, "wb");
+  if (!writer->file) {
+    printf("Error: Could not create paged map %s\n", path);
+    paged_map_writer_finish(writer);
+    return NULL;
+  }
+  size_t overview_bytes =
+      paged_map_tile_count(writer->header.overview_width,
+                           writer->header.overview_height) *
+      sizeof(Tile);
+  writer->ok = fseek(writer->file, (long)(sizeof(PagedMapHeader) +
+                                          overview_bytes),
+                     SEEK_SET) == 0;
+  return writer;
+}
+
+// Autotiles the next chunk row of the band, writes it and keeps its last
+// row and the row below as the neighbour and first row of the next one
+static void paged_map_writer_flush(PagedMapWriter *writer) {
+  int width = writer->band.width;
+  int first = writer->chunk_rows_written * PAGED_MAP_CHUNK_TILES;
+  int top = first - writer->band_first; // 1 below the first chunk row
+  int rows = writer->rows_added - first;
+  if (rows > PAGED_MAP_CHUNK_TILES)
+    rows = PAGED_MAP_CHUNK_TILES;
+
+  writer->band.height = writer->rows_added - writer->band_first;
+  preprocess_map_rows(&writer->band, top, top + rows);
+
+  int step = writer->overview_step;
+  for (int y = first; y < first + rows; y++) {
+    if (y % step != 0)
+      continue;
+    const Tile *row = &writer->band.tiles[(size_t)(y - writer->band_first) *
+                                          width];
+    Tile *overview = &writer->overview[(size_t)(y / step) *
+                                       writer->header.overview_width];
+    for (int ox = 0; ox < writer->header.overview_width; ox++)
+      overview[ox] = row[(size_t)ox * step];
+  }
+
+  writer->ok = writer->ok &&
+               paged_map_write_chunk_row(
+                   writer->file, &writer->band.tiles[(size_t)top * width],
+                   width, rows, writer->chunk);
+  writer->chunk_rows_written++;
+
+  int keep_first = first + rows - 1;
+  int keep = writer->rows_added - keep_first;
+  memmove(writer->band.tiles,
+          &writer->band.tiles[(size_t)(keep_first - writer->band_first) *
+                              width],
+          (size_t)keep * width * sizeof(Tile));
+  writer->band_first = keep_first;
+}
+
+bool paged_map_writer_add_row(PagedMapWriter *writer, const RawTileKey *row) {
+  if (writer->rows_added >= writer->header.height)
+    return false;
+  int width = writer->band.width;
+  Tile *tiles = &writer->band.tiles[(size_t)(writer->rows_added -
+                                             writer->band_first) *
+                                    width];
+  for (int x = 0; x < width; x++)
+    tiles[x] = raw_to_tile(row[x]);
+  writer->rows_added++;
+
+  // A chunk row is autotiled once the row below it is known
+  int next_end = (writer->chunk_rows_written + 1) * PAGED_MAP_CHUNK_TILES;
+  if (writer->rows_added == next_end + 1 ||
+      writer->rows_added == writer->header.height)
+    paged_map_writer_flush(writer);
+  return writer->ok;
+}
+
+bool paged_map_writer_finish(PagedMapWriter *writer) {
+  if (!writer)
+    return false;
+
+  bool ok = writer->file && writer->ok &&
+            writer->rows_added == writer->header.height;
+  if (writer->file) {
+    // The last chunk row waits for a row below it that may never come
+    while (ok && writer->chunk_rows_written * PAGED_MAP_CHUNK_TILES <
+                     writer->header.height) {
+      paged_map_writer_flush(writer);
+      ok = writer->ok;
+    }
+    size_t overview_tiles = paged_map_tile_count(
+        writer->header.overview_width, writer->header.overview_height);
+    ok = ok && fseek(writer->file, 0, SEEK_SET) == 0 &&
+         fwrite(&writer->header, sizeof(writer->header), 1, writer->file) ==
+             1 &&
+         fwrite(writer->overview, sizeof(Tile), overview_tiles,
+                writer->file) == overview_tiles;
+    ok = fclose(writer->file) == 0 && ok;
+    if (!ok) {
+      printf("Error: Could not write paged map %s\n", writer->path);
+      remove(writer->path);
+    }
+  }
+
+  mem_track_free(writer->band.tiles);
+  mem_track_free(writer->chunk);
+  mem_track_free(writer->overview);
+  mem_track_free(writer->path);
+  mem_track_free(writer);
+  return ok;
+}
+
+// Reads a whole chunk at its 64-bit offset, retrying short reads
+static bool paged_map_read_chunk(const PagedMap *map, int64_t index,
+                                 Tile *tiles) {
+  unsigned char *dest = (unsigned char *)tiles;
+  int64_t offset = map->data_offset + index * (int64_t)map->chunk_bytes;
+  size_t done = 0;
+  while (done < map->chunk_bytes) {
+    ssize_t bytes = pread(map->fd, dest + done, map->chunk_bytes - done,
+                          (off_t)(offset + (int64_t)done));
+    if (bytes <= 0)
+      return false;
+    done += (size_t)bytes;
+  }
+  return true;
+}
+
+// A chunk that cannot be read shows as plain water rather than stale tiles
+static void paged_map_fill_chunk(PagedMap *map, int64_t index, Tile *tiles,
+                                 bool *failed) {
+  *failed = !paged_map_read_chunk(map, index, tiles);
+  if (*failed)
+    memset(tiles, 0, map->chunk_bytes);
+}
+
+static void *paged_map_pager_main(void *arg) {
+  PagedMap *map = (PagedMap *)arg;
+  trace_set_thread_name("pager");
+
+  pthread_mutex_lock(&map->mutex);
+  while (true) {
+    while (!map->quit && map->queue_count == 0)
+      pthread_cond_wait(&map->wake, &map->mutex);
+    if (map->quit)
+      break;
+
+    int slot = map->queue[map->queue_head];
+    map->queue_head = (map->queue_head + 1) % map->slot_count;
+    map->queue_count--;
+    PagedChunk *chunk = &map->slots[slot];
+    pthread_mutex_unlock(&map->mutex);
+
+    TRACE_ZONE_BEGIN(zone, "paged_map_prefetch_chunk");
+    bool failed;
+    paged_map_fill_chunk(map, chunk->index, chunk->tiles, &failed);
+    TRACE_ZONE_END(zone);
+
+    atomic_fetch_add(failed ? &map->read_errors : &map->prefetched, 1);
+    pthread_mutex_lock(&map->mutex);
+    atomic_store(&chunk->state, PAGED_CHUNK_READY);
+    pthread_cond_broadcast(&map->loaded);
+  }
+  pthread_mutex_unlock(&map->mutex);
+  return NULL;
+}
+
+PagedMap *paged_map_open(const char *path, size_t budget_bytes) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    printf("Error: Could not open paged map %s\n", path);
+    return NULL;
+  }
+
+  PagedMapHeader header = {0};
+  struct stat info;
+  bool valid =
+      pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+      memcmp(header.magic, PAGED_MAP_MAGIC, sizeof(header.magic)) == 0 &&
+      header.version == PAGED_MAP_VERSION &&
+      header.tile_bytes == sizeof(Tile) && header.width > 0 &&
+      header.height > 0 && header.chunk_tiles > 0 &&
+      header.chunk_tiles <= 4096 &&
+      header.overview_width > 0 && header.overview_height > 0 &&
+      fstat(fd, &info) == 0;
+
+  int chunks_x = valid ? (header.width + header.chunk_tiles - 1) /
+                             header.chunk_tiles
+                       : 0;
+  int chunks_y = valid ? (header.height + header.chunk_tiles - 1) /
+                             header.chunk_tiles
+                       : 0;
+  size_t chunk_bytes =
+      (size_t)header.chunk_tiles * header.chunk_tiles * sizeof(Tile);
+  size_t overview_bytes =
+      paged_map_tile_count(header.overview_width, header.overview_height) *
+      sizeof(Tile);
+  int64_t data_offset = (int64_t)sizeof(header) + (int64_t)overview_bytes;
+  valid = valid && (int64_t)info.st_size >=
+                       data_offset + (int64_t)chunks_x * chunks_y *
+                                         (int64_t)chunk_bytes;
+  if (!valid) {
+    printf("Error: %s is not a valid paged map\n", path);
+    close(fd);
+    return NULL;
+  }
+
+  PagedMap *map =
+      (PagedMap *)mem_track_calloc(MEM_SUBSYSTEM_MAP, 1, sizeof(PagedMap));
+  if (!map) {
+    close(fd);
+    return NULL;
+  }
+  map->fd = fd;
+  map->width = header.width;
+  map->height = header.height;
+  map->chunk_tiles = header.chunk_tiles;
+  map->chunks_x = chunks_x;
+  map->chunks_y = chunks_y;
+  map->data_offset = data_offset;
+  map->chunk_bytes = chunk_bytes;
+  map->last_index = -1;
+  atomic_init(&map->prefetched, 0);
+  atomic_init(&map->read_errors, 0);
+  pthread_mutex_init(&map->mutex, NULL);
+  pthread_cond_init(&map->wake, NULL);
+  pthread_cond_init(&map->loaded, NULL);
+
+  size_t slots = budget_bytes / chunk_bytes;
+  if (slots < PAGED_MAP_MIN_SLOTS)
+    slots = PAGED_MAP_MIN_SLOTS;
+  if ((int64_t)slots > (int64_t)chunks_x * chunks_y)
+    slots = (size_t)chunks_x * chunks_y;
+  map->slot_count = (int)slots;
+
+  map->overview = (TileMap){
+      .width = header.overview_width,
+      .height = header.overview_height,
+      .tiles = (Tile *)mem_track_malloc(MEM_SUBSYSTEM_MAP, overview_bytes),
+  };
+  map->storage =
+      (Tile *)mem_track_malloc(MEM_SUBSYSTEM_MAP, slots * chunk_bytes);
+  map->slots = (PagedChunk *)mem_track_calloc(MEM_SUBSYSTEM_MAP, slots,
+                                              sizeof(PagedChunk));
+  map->queue = (int *)mem_track_malloc(MEM_SUBSYSTEM_MAP, slots * sizeof(int));
+  bool ready = map->overview.tiles && map->storage && map->slots &&
+               map->queue &&
+               chunk_table_init(&map->table, map->slot_count,
+                                MEM_SUBSYSTEM_MAP) &&
+               pread(fd, map->overview.tiles, overview_bytes,
+                     (off_t)sizeof(header)) == (ssize_t)overview_bytes;
+  if (!ready) {
+    printf("Error: Could not load paged map %s\n", path);
+    paged_map_close(map);
+    return NULL;
+  }
+
+  for (int i = 0; i < map->slot_count; i++) {
+    map->slots[i].tiles = map->storage + (size_t)i * chunk_bytes / sizeof(Tile);
+    map->slots[i].index = -1;
+    atomic_init(&map->slots[i].state, PAGED_CHUNK_FREE);
+  }
+
+  // Without the pager thread every chunk is simply faulted in
+  map->has_thread =
+      pthread_create(&map->thread, NULL, paged_map_pager_main, map) == 0;
+  return map;
+}
+
+void paged_map_close(PagedMap *map) {
+  if (!map)
+    return;
+
+  if (map->has_thread) {
+    pthread_mutex_lock(&map->mutex);
+    map->quit = true;
+    pthread_cond_signal(&map->wake);
+    pthread_mutex_unlock(&map->mutex);
+    pthread_join(map->thread, NULL);
+  }
+  pthread_mutex_destroy(&map->mutex);
+  pthread_cond_destroy(&map->wake);
+  pthread_cond_destroy(&map->loaded);
+
+  chunk_table_free(&map->table);
+  mem_track_free(map->queue);
+  mem_track_free(map->slots);
+  mem_track_free(map->storage);
+  mem_track_free(map->overview.tiles);
+  close(map->fd);
+  mem_track_free(map);
+}
+
+TileMap paged_map_tile_map(PagedMap *map) {
+  return (TileMap){.width = map->width, .height = map->height, .paged = map};
+}
+
+const TileMap *paged_map_overview(const PagedMap *map) {
+  return &map->overview;
+}
+
+// Frees the least recently used slot for a chunk. Slots touched in this
+// update are only taken when allow_recent is set; LOADING slots never are.
+static int paged_map_claim(PagedMap *map, int64_t index, bool allow_recent) {
+  int victim = -1;
+  for (int i = 0; i < map->slot_count; i++) {
+    PagedChunk *chunk = &map->slots[i];
+    int state = atomic_load(&chunk->state);
+    if (state == PAGED_CHUNK_FREE) {
+      victim = i;
+      break;
+    }
+    if (state == PAGED_CHUNK_LOADING ||
+        (!allow_recent && chunk->last_used == map->frame))
+      continue;
+    if (victim < 0 || chunk->last_used < map->slots[victim].last_used)
+      victim = i;
+  }
+  if (victim < 0)
+    return -1;
+
+  PagedChunk *chunk = &map->slots[victim];
+  if (chunk->index >= 0) {
+    chunk_table_remove(&map->table, chunk->index);
+    map->evictions++;
+    if (map->last_index == chunk->index)
+      map->last_index = -1;
+  }
+  chunk->index = index;
+  chunk->last_used = map->frame;
+  chunk_table_insert(&map->table, index, victim);
+  return victim;
+}
+
+static bool paged_map_has_claimable(const PagedMap *map) {
+  for (int i = 0; i < map->slot_count; i++) {
+    if (atomic_load(&map->slots[i].state) != PAGED_CHUNK_LOADING)
+      return true;
+  }
+  return false;
+}
+
+static const Tile *paged_map_acquire(PagedMap *map, int64_t index) {
+  int slot = chunk_table_find(&map->table, index);
+  if (slot < 0) {
+    // Every slot may be waiting on the pager; the first to finish is taken
+    slot = paged_map_claim(map, index, true);
+    if (slot < 0) {
+      pthread_mutex_lock(&map->mutex);
+      while (!paged_map_has_claimable(map))
+        pthread_cond_wait(&map->loaded, &map->mutex);
+      pthread_mutex_unlock(&map->mutex);
+      slot = paged_map_claim(map, index, true);
+    }
+
+    TRACE_ZONE_BEGIN(zone, "paged_map_fault");
+    PagedChunk *chunk = &map->slots[slot];
+    bool failed;
+    paged_map_fill_chunk(map, index, chunk->tiles, &failed);
+    atomic_store(&chunk->state, PAGED_CHUNK_READY);
+    map->faults++;
+    if (failed)
+      atomic_fetch_add(&map->read_errors, 1);
+    TRACE_ZONE_END(zone);
+  } else if (atomic_load(&map->slots[slot].state) == PAGED_CHUNK_LOADING) {
+    pthread_mutex_lock(&map->mutex);
+    while (atomic_load(&map->slots[slot].state) == PAGED_CHUNK_LOADING)
+      pthread_cond_wait(&map->loaded, &map->mutex);
+    pthread_mutex_unlock(&map->mutex);
+  }
+
+  map->slots[slot].last_used = map->frame;
+  return map->slots[slot].tiles;
+}
+
+const Tile *paged_map_tile(PagedMap *map, int x, int y) {
+  int cx = x / map->chunk_tiles;
+  int cy = y / map->chunk_tiles;
+  int64_t index = (int64_t)cy * map->chunks_x + cx;
+  if (index != map->last_index) {
+    map->last_tiles = paged_map_acquire(map, index);
+    map->last_index = index;
+  }
+  size_t offset = (size_t)(y - cy * map->chunk_tiles) * map->chunk_tiles +
+                  (size_t)(x - cx * map->chunk_tiles);
+  return &map->last_tiles[offset];
+}
+
+// Protects a resident chunk or queues a missing one; returns false once
+// the per-update limit of new requests is used up
+static bool paged_map_request(PagedMap *map, int cx, int cy, int *budget) {
+  if (cx < 0 || cy < 0 || cx >= map->chunks_x || cy >= map->chunks_y)
+    return true;
+
+  int64_t index = (int64_t)cy * map->chunks_x + cx;
+  int slot = chunk_table_find(&map->table, index);
+  if (slot >= 0) {
+    map->slots[slot].last_used = map->frame;
+    return true;
+  }
+  if (!map->has_thread || *budget <= 0)
+    return false;
+
+  slot = paged_map_claim(map, index, false);
+  if (slot < 0)
+    return false;
+  (*budget)--;
+
+  atomic_store(&map->slots[slot].state, PAGED_CHUNK_LOADING);
+  pthread_mutex_lock(&map->mutex);
+  int tail = (map->queue_head + map->queue_count) % map->slot_count;
+  map->queue[tail] = slot;
+  map->queue_count++;
+  pthread_cond_signal(&map->wake);
+  pthread_mutex_unlock(&map->mutex);
+  return true;
+}
+
+// Requests every chunk overlapping a tile rectangle, grown by margin chunks
+static void paged_map_request_range(PagedMap *map, float x0, float y0,
+                                    float x1, float y1, int margin,
+                                    int *budget) {
+  int first_cx = (int)floorf(x0 / map->chunk_tiles) - margin;
+  int first_cy = (int)floorf(y0 / map->chunk_tiles) - margin;
+  int last_cx = (int)floorf((x1 - 1) / map->chunk_tiles) + margin;
+  int last_cy = (int)floorf((y1 - 1) / map->chunk_tiles) + margin;
+  if (first_cx < 0)
+    first_cx = 0;
+  if (first_cy < 0)
+    first_cy = 0;
+  if (last_cx >= map->chunks_x)
+    last_cx = map->chunks_x - 1;
+  if (last_cy >= map->chunks_y)
+    last_cy = map->chunks_y - 1;
+
+  for (int cy = first_cy; cy <= last_cy; cy++) {
+    for (int cx = first_cx; cx <= last_cx; cx++)
+      paged_map_request(map, cx, cy, budget);
+  }
+}
+
+void paged_map_prefetch(PagedMap *map, int start_x, int start_y, int end_x,
+                        int end_y) {
+  if (start_x >= end_x || start_y >= end_y)
+    return;
+  map->frame++;
+
+  float center_x = (start_x + end_x) * 0.5f;
+  float center_y = (start_y + end_y) * 0.5f;
+  if (map->has_center) {
+    map->velocity_x =
+        map->velocity_x * 0.7f + (center_x - map->center_x) * 0.3f;
+    map->velocity_y =
+        map->velocity_y * 0.7f + (center_y - map->center_y) * 0.3f;
+  }
+  map->has_center = true;
+  map->center_x = center_x;
+  map->center_y = center_y;
+
+  // Visible chunks first so they are protected before anything is evicted,
+  // then a one-chunk margin, then where the camera is heading
+  int budget = PAGED_MAP_PREFETCH_PER_UPDATE;
+  paged_map_request_range(map, start_x, start_y, end_x, end_y, 0, &budget);
+  paged_map_request_range(map, start_x, start_y, end_x, end_y, 1, &budget);
+
+  float ahead_x = map->velocity_x * PAGED_MAP_LOOKAHEAD_UPDATES;
+  float ahead_y = map->velocity_y * PAGED_MAP_LOOKAHEAD_UPDATES;
+  if (fabsf(ahead_x) >= 1.0f || fabsf(ahead_y) >= 1.0f)
+    paged_map_request_range(map, start_x + ahead_x, start_y + ahead_y,
+                            end_x + ahead_x, end_y + ahead_y, 1, &budget);
+}
+
+void paged_map_stats(const PagedMap *map, PagedMapStats *stats) {
+  *stats = (PagedMapStats){
+      .slots = map->slot_count,
+      .faults = map->faults,
+      .prefetched = atomic_load(&map->prefetched),
+      .evictions = map->evictions,
+      .read_errors = atomic_load(&map->read_errors),
+  };
+  for (int i = 0; i < map->slot_count; i++) {
+    int state = atomic_load(&map->slots[i].state);
+    stats->resident += state == PAGED_CHUNK_READY;
+    stats->loading += state == PAGED_CHUNK_LOADING;
+  }
+}
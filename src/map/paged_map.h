@@ -0,0 +1,150 @@
+#ifndef PAGED_MAP_H
+#define PAGED_MAP_H
+
+#include "map.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Tile map paged in from a chunked file for maps larger than RAM
+ *
+ * The file holds the autotiled map cut into square chunks, plus a small
+ * overview sampled from the whole map for the minimap. Only chunks around
+ * the view are resident: they live in a fixed set of slots sized by a byte
+ * budget and are evicted least-recently-used. A pager thread reads chunks
+ * ahead of the camera in the direction it is moving; a chunk that is needed
+ * before it arrives is read on the spot (a fault).
+ *
+ * Tiles are read and prefetches requested from one thread, the render
+ * thread. All offsets and sizes are 64-bit.
+ *
+ * File layout, native byte order:
+ *   PagedMapHeader
+ *   overview_width * overview_height Tiles
+ *   chunks_x * chunks_y chunks in row-major order, each chunk_tiles^2
+ *   Tiles in row-major order; edge chunks are padded to full size
+ */
+
+#define PAGED_MAP_MAGIC "AXPM"
+#define PAGED_MAP_VERSION 1
+#define PAGED_MAP_CHUNK_TILES 64
+#define PAGED_MAP_OVERVIEW_SIZE 512 // Largest overview side in tiles
+#define PAGED_MAP_DEFAULT_BUDGET (256u << 20)
+
+typedef struct {
+  char magic[4];
+  unsigned int version;
+  unsigned int tile_bytes; // sizeof(Tile) of the writer
+  int width;
+  int height;
+  int chunk_tiles;
+  int overview_width;
+  int overview_height;
+} PagedMapHeader;
+
+typedef struct {
+  int slots;   // Chunks the budget holds
+  int resident;
+  int loading; // Queued for or being read by the pager thread
+  unsigned long faults;     // Chunks read on the render thread
+  unsigned long prefetched; // Chunks read ahead by the pager thread
+  unsigned long evictions;
+  unsigned long read_errors;
+} PagedMapStats;
+
+/**
+ * @brief Writes a resident map as a paged map file
+ *
+ * @param map Autotiled map to write; must not be paged itself
+ * @param path Output file
+ * @return bool False if the file could not be written
+ */
+bool paged_map_write(const TileMap *map, const char *path);
+
+typedef struct PagedMapWriter PagedMapWriter;
+
+/**
+ * @brief Starts writing a paged map from raw rows, for maps too large to
+ *        hold in memory
+ *
+ * Rows are autotiled a chunk row at a time, so only that band and the
+ * overview are held.
+ *
+ * @param path Output file
+ * @param width Map width in tiles
+ * @param height Map height in tiles
+ * @return PagedMapWriter* NULL if the file could not be created
+ */
+PagedMapWriter *paged_map_writer_begin(const char *path, int width,
+                                       int height);
+
+/**
+ * @brief Adds the next row of raw tiles, top to bottom
+ *
+ * @param writer Writer from paged_map_writer_begin
+ * @param row `width` raw tiles
+ * @return bool False once writing has failed
+ */
+bool paged_map_writer_add_row(PagedMapWriter *writer, const RawTileKey *row);
+
+/**
+ * @brief Writes what is left and frees the writer
+ *
+ * @return bool False if writing failed or fewer than `height` rows were
+ *         added; the file is then removed
+ */
+bool paged_map_writer_finish(PagedMapWriter *writer);
+
+/**
+ * @brief Opens a paged map file and starts its pager thread
+ *
+ * @param path File written by paged_map_write
+ * @param budget_bytes Memory for resident chunks; a few chunks are always
+ *                     kept however small the budget
+ * @return PagedMap* NULL if the file is missing or not a valid paged map
+ */
+PagedMap *paged_map_open(const char *path, size_t budget_bytes);
+
+/**
+ * @brief Stops the pager thread and releases every chunk
+ */
+void paged_map_close(PagedMap *map);
+
+/**
+ * @brief Wraps a paged map in a TileMap the renderer can draw
+ *
+ * The result has no tile array; tiles are read through map_get_tile().
+ */
+TileMap paged_map_tile_map(PagedMap *map);
+
+/**
+ * @brief Returns the tile at (x, y), faulting its chunk in if needed
+ *
+ * The pointer stays valid until the next call into the paged map.
+ */
+const Tile *paged_map_tile(PagedMap *map, int x, int y);
+
+/**
+ * @brief Keeps the chunks of a view resident and reads ahead of it
+ *
+ * Call once per frame with the visible tile range. Visible chunks are
+ * protected from eviction; missing ones, a one-chunk margin and the view
+ * shifted along the camera's recent motion are queued for the pager thread.
+ *
+ * @param map Paged map
+ * @param start_x First visible column
+ * @param start_y First visible row
+ * @param end_x One past the last visible column
+ * @param end_y One past the last visible row
+ */
+void paged_map_prefetch(PagedMap *map, int start_x, int start_y, int end_x,
+                        int end_y);
+
+/**
+ * @brief Low-resolution copy of the whole map, resident at all times
+ */
+const TileMap *paged_map_overview(const PagedMap *map);
+
+void paged_map_stats(const PagedMap *map, PagedMapStats *stats);
+
+#endif
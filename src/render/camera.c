@@ -26,6 +26,19 @@ void camera_init(Camera2D_RTS *camera, const CameraConfig *config,
       (Rectangle){camera->position.x / TILE_SIZE_PIXELS - half_width,
                   camera->position.y / TILE_SIZE_PIXELS - half_height,
                   half_width * 2, half_height * 2};
+
+  camera->screen_size =
+      (Vector2){(float)config->screen_width, (float)config->screen_height};
+  camera->screen_area = (Rectangle){0};
+  camera->handles_input = true;
+  camera_update_transform(camera);
+}
+
+// Mouse position relative to the camera's screen area
+static Vector2 camera_mouse_position(const Camera2D_RTS *camera) {
+  Vector2 mouse = GetMousePosition();
+  return (Vector2){mouse.x - camera->screen_area.x,
+                   mouse.y - camera->screen_area.y};
 }
 
 void camera_handle_zoom_input(Camera2D_RTS *camera) {
@@ -34,7 +47,7 @@ void camera_handle_zoom_input(Camera2D_RTS *camera) {
     return;
 
   Vector2 mouse_world_before =
-      camera_screen_to_world(camera, GetMousePosition());
+      camera_screen_to_world(camera, camera_mouse_position(camera));
   float old_zoom = camera->zoom;
 
   camera->zoom += wheel * camera->zoom_speed;
@@ -43,7 +56,7 @@ void camera_handle_zoom_input(Camera2D_RTS *camera) {
   // Adjust position to zoom towards mouse position
   if (camera->zoom != old_zoom) {
     Vector2 mouse_world_after =
-        camera_screen_to_world(camera, GetMousePosition());
+        camera_screen_to_world(camera, camera_mouse_position(camera));
     camera->position.x += (mouse_world_after.x - mouse_world_before.x) *
                           TILE_SIZE_PIXELS * camera->zoom;
     camera->position.y += (mouse_world_after.y - mouse_world_before.y) *
@@ -74,9 +87,9 @@ void camera_handle_keyboard_input(Camera2D_RTS *camera) {
 }
 
 void camera_handle_edge_scrolling(Camera2D_RTS *camera) {
-  Vector2 mouse_pos = GetMousePosition();
-  int screen_width = GetScreenWidth();
-  int screen_height = GetScreenHeight();
+  Vector2 mouse_pos = camera_mouse_position(camera);
+  float screen_width = camera->screen_size.x;
+  float screen_height = camera->screen_size.y;
   float effective_speed = camera->move_speed / camera->zoom;
 
   if (mouse_pos.x < EDGE_SCROLL_THRESHOLD)
@@ -89,10 +102,37 @@ void camera_handle_edge_scrolling(Camera2D_RTS *camera) {
     camera->target.y += effective_speed;
 }
 
+// Window area size, or the whole window when no area is set
+static Vector2 camera_area_size(const Camera2D_RTS *camera) {
+  if (camera->screen_area.width > 0 && camera->screen_area.height > 0)
+    return (Vector2){camera->screen_area.width, camera->screen_area.height};
+  return (Vector2){(float)GetScreenWidth(), (float)GetScreenHeight()};
+}
+
+// Recomputes the visible tile rectangle and the transform
+static void camera_refresh_view(Camera2D_RTS *camera) {
+  float half_width =
+      (camera->screen_size.x / 2.0f) / (camera->zoom * TILE_SIZE_PIXELS);
+  float half_height =
+      (camera->screen_size.y / 2.0f) / (camera->zoom * TILE_SIZE_PIXELS);
+
+  camera->viewport =
+      (Rectangle){camera->position.x / TILE_SIZE_PIXELS - half_width,
+                  camera->position.y / TILE_SIZE_PIXELS - half_height,
+                  half_width * 2, half_height * 2};
+
+  camera_update_transform(camera);
+}
+
 void camera_update(Camera2D_RTS *camera, const TileMap *map) {
-  camera_handle_zoom_input(camera);
-  camera_handle_keyboard_input(camera);
-  camera_handle_edge_scrolling(camera);
+  // Query the window once per frame; everything below uses the cached size
+  camera->screen_size = camera_area_size(camera);
+
+  if (camera->handles_input) {
+    camera_handle_zoom_input(camera);
+    camera_handle_keyboard_input(camera);
+    camera_handle_edge_scrolling(camera);
+  }
 
   // Smooth camera movement
   camera->position.x = math_utils_lerp(camera->position.x, camera->target.x,
@@ -101,33 +141,42 @@ void camera_update(Camera2D_RTS *camera, const TileMap *map) {
                                        CAMERA_SMOOTHING_FACTOR);
 
   camera_constrain_to_map(camera, map);
+  camera_refresh_view(camera);
+}
 
-  // Update viewport
-  float half_width =
-      (GetScreenWidth() / 2.0f) / (camera->zoom * TILE_SIZE_PIXELS);
-  float half_height =
-      (GetScreenHeight() / 2.0f) / (camera->zoom * TILE_SIZE_PIXELS);
+void camera_set_screen_area(Camera2D_RTS *camera, Rectangle area) {
+  camera->screen_area = area;
+}
 
-  camera->viewport =
-      (Rectangle){camera->position.x / TILE_SIZE_PIXELS - half_width,
-                  camera->position.y / TILE_SIZE_PIXELS - half_height,
-                  half_width * 2, half_height * 2};
+void camera_follow(Camera2D_RTS *camera, const Camera2D_RTS *leader,
+                   const TileMap *map) {
+  camera->screen_size = camera_area_size(camera);
+  camera->position = leader->position;
+  camera->target = leader->target;
+  camera->zoom = leader->zoom;
+  camera_constrain_to_map(camera, map);
+  camera_refresh_view(camera);
 }
 
-Vector2 camera_world_to_screen(const Camera2D_RTS *camera, Vector2 world_pos) {
-  int screen_width = GetScreenWidth();
-  int screen_height = GetScreenHeight();
+void camera_update_transform(Camera2D_RTS *camera) {
+  camera->scale = TILE_SIZE_PIXELS * camera->zoom;
+  camera->offset =
+      (Vector2){camera->screen_size.x / 2.0f - camera->position.x * camera->zoom,
+                camera->screen_size.y / 2.0f -
+                    camera->position.y * camera->zoom};
+}
 
-  return (Vector2){
-      (world_pos.x * TILE_SIZE_PIXELS - camera->position.x) * camera->zoom +
-          screen_width / 2.0f,
-      (world_pos.y * TILE_SIZE_PIXELS - camera->position.y) * camera->zoom +
-          screen_height / 2.0f};
+// Uses the transform cached by the last camera_update
+Vector2 camera_world_to_screen(const Camera2D_RTS *camera, Vector2 world_pos) {
+  return (Vector2){world_pos.x * camera->scale + camera->offset.x,
+                   world_pos.y * camera->scale + camera->offset.y};
 }
 
+// Uses the live position and zoom, so it stays valid while camera_update is
+// still moving the camera
 Vector2 camera_screen_to_world(const Camera2D_RTS *camera, Vector2 screen_pos) {
-  int screen_width = GetScreenWidth();
-  int screen_height = GetScreenHeight();
+  float screen_width = camera->screen_size.x;
+  float screen_height = camera->screen_size.y;
 
   return (Vector2){((screen_pos.x - screen_width / 2.0f) / camera->zoom +
                     camera->position.x) /
@@ -138,8 +187,8 @@ Vector2 camera_screen_to_world(const Camera2D_RTS *camera, Vector2 screen_pos) {
 }
 
 void camera_constrain_to_map(Camera2D_RTS *camera, const TileMap *map) {
-  int screen_width = GetScreenWidth();
-  int screen_height = GetScreenHeight();
+  float screen_width = camera->screen_size.x;
+  float screen_height = camera->screen_size.y;
 
   float map_width_pixels = map->width * TILE_SIZE_PIXELS;
   float map_height_pixels = map->height * TILE_SIZE_PIXELS;
@@ -169,3 +218,85 @@ void camera_center_on_world_position(Camera2D_RTS *camera, Vector2 world_pos) {
   camera->target.x = world_pos.x * TILE_SIZE_PIXELS;
   camera->target.y = world_pos.y * TILE_SIZE_PIXELS;
 }
+
+// Lanes processed together by camera_cull_entities (one SSE/NEON register)
+#define CAMERA_CULL_LANES 4
+
+#if defined(__GNUC__) || defined(__clang__)
+typedef float CameraLanes
+    __attribute__((vector_size(CAMERA_CULL_LANES * sizeof(float))));
+typedef int CameraMask
+    __attribute__((vector_size(CAMERA_CULL_LANES * sizeof(int))));
+#endif
+
+// Entities start with float x, y, size
+static inline const float *camera_entity_fields(const unsigned char *base,
+                                                size_t stride, int index) {
+  return (const float *)(base + (size_t)index * stride);
+}
+
+int camera_cull_entities(const Camera2D_RTS *camera, const void *entities,
+                         size_t stride, const int *indices, int count,
+                         CameraVisibleEntity *out) {
+  const unsigned char *base = (const unsigned char *)entities;
+  float scale = camera->scale;
+  float offset_x = camera->offset.x;
+  float offset_y = camera->offset.y;
+  float width = camera->screen_size.x;
+  float height = camera->screen_size.y;
+  int visible = 0;
+  int n = 0;
+
+#if defined(__GNUC__) || defined(__clang__)
+  // Transform and test four entities at once. Lanes are built with vector
+  // initialisers so the gather stays in registers, and survivors are written
+  // unconditionally with the count advanced by the mask, so compaction has no
+  // unpredictable branches.
+  for (; n + CAMERA_CULL_LANES <= count; n += CAMERA_CULL_LANES) {
+    int i0 = indices ? indices[n] : n;
+    int i1 = indices ? indices[n + 1] : n + 1;
+    int i2 = indices ? indices[n + 2] : n + 2;
+    int i3 = indices ? indices[n + 3] : n + 3;
+    const float *e0 = camera_entity_fields(base, stride, i0);
+    const float *e1 = camera_entity_fields(base, stride, i1);
+    const float *e2 = camera_entity_fields(base, stride, i2);
+    const float *e3 = camera_entity_fields(base, stride, i3);
+
+    CameraLanes x = {e0[0], e1[0], e2[0], e3[0]};
+    CameraLanes y = {e0[1], e1[1], e2[1], e3[1]};
+    CameraLanes size = {e0[2], e1[2], e2[2], e3[2]};
+
+    CameraLanes sx = x * scale + offset_x;
+    CameraLanes sy = y * scale + offset_y;
+    CameraLanes ss = size * scale;
+    CameraLanes r = ss * 0.5f;
+    CameraMask keep = (sx + r > 0.0f) & (sx - r < width) & (sy + r > 0.0f) &
+                      (sy - r < height);
+    if (!(keep[0] | keep[1] | keep[2] | keep[3]))
+      continue;
+
+    // Mask lanes are 0 or -1
+    int lane_index[CAMERA_CULL_LANES] = {i0, i1, i2, i3};
+    for (int k = 0; k < CAMERA_CULL_LANES; k++) {
+      out[visible] = (CameraVisibleEntity){
+          lane_index[k], (Vector2){sx[k], sy[k]}, ss[k]};
+      visible -= keep[k];
+    }
+  }
+#endif
+
+  // Remainder (or everything without vector extensions)
+  for (; n < count; n++) {
+    int i = indices ? indices[n] : n;
+    const float *e = camera_entity_fields(base, stride, i);
+
+    float sx = e[0] * scale + offset_x;
+    float sy = e[1] * scale + offset_y;
+    float ss = e[2] * scale;
+    float r = ss * 0.5f;
+    if (sx + r > 0.0f && sx - r < width && sy + r > 0.0f && sy - r < height)
+      out[visible++] = (CameraVisibleEntity){i, (Vector2){sx, sy}, ss};
+  }
+
+  return visible;
+}
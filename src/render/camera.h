@@ -3,6 +3,7 @@
 
 #include "../client/sim_loader.h"
 #include "raylib.h"
+#include <stddef.h>
 
 /**
  * @brief RTS-style camera configuration
@@ -24,19 +25,78 @@ typedef struct {
   float move_speed;
   float zoom_speed;
   Rectangle viewport;
+
+  // World-to-screen affine transform, refreshed by camera_update:
+  // screen = world * scale + offset
+  Vector2 screen_size;
+  float scale; // Screen pixels per world tile
+  Vector2 offset;
+
+  // Window area the camera draws into, empty for the whole window. Screen
+  // coordinates above are relative to its top-left corner.
+  Rectangle screen_area;
+  bool handles_input; // Reacts to keyboard, wheel and edge scrolling
 } Camera2D_RTS;
 
+/**
+ * @brief An entity that survived camera_cull_entities
+ */
+typedef struct {
+  int index;         // Index into the entity array
+  Vector2 screen_pos; // Screen-space centre
+  float screen_size;  // Entity size in screen pixels
+} CameraVisibleEntity;
+
 // Camera lifecycle management
 void camera_init(Camera2D_RTS *camera, const CameraConfig *config,
                  const TileMap *map);
 void camera_update(Camera2D_RTS *camera, const TileMap *map);
 void camera_constrain_to_map(Camera2D_RTS *camera, const TileMap *map);
 
+/**
+ * @brief Restricts the camera to part of the window, e.g. one side of a
+ * split view
+ *
+ * Takes effect on the next camera_update or camera_follow.
+ *
+ * @param area Window area, or an empty rectangle for the whole window
+ */
+void camera_set_screen_area(Camera2D_RTS *camera, Rectangle area);
+
+/**
+ * @brief Shows the same world view as another camera in this camera's area
+ *
+ * Copies the leader's position and zoom instead of handling input, so two
+ * linked views pan and zoom together.
+ */
+void camera_follow(Camera2D_RTS *camera, const Camera2D_RTS *leader,
+                   const TileMap *map);
+
 // Coordinate transformation
+void camera_update_transform(Camera2D_RTS *camera);
 Vector2 camera_world_to_screen(const Camera2D_RTS *camera, Vector2 world_pos);
 Vector2 camera_screen_to_world(const Camera2D_RTS *camera, Vector2 screen_pos);
 void camera_center_on_world_position(Camera2D_RTS *camera, Vector2 world_pos);
 
+/**
+ * @brief Transforms and culls a batch of entities against the screen
+ *
+ * Entities must start with float x, y, size (Object and Unit both do). An
+ * entity is kept when its size-wide square overlaps the screen; survivors are
+ * written to out in input order.
+ *
+ * @param camera Camera with an up-to-date transform
+ * @param entities Entity array
+ * @param stride Size of one entity in bytes
+ * @param indices Entities to test, or NULL to test 0..count-1
+ * @param count Number of entities to test
+ * @param out Receives up to count visible entities
+ * @return int Number of visible entities written
+ */
+int camera_cull_entities(const Camera2D_RTS *camera, const void *entities,
+                         size_t stride, const int *indices, int count,
+                         CameraVisibleEntity *out);
+
 // Input handling
 void camera_handle_zoom_input(Camera2D_RTS *camera);
 void camera_handle_keyboard_input(Camera2D_RTS *camera);
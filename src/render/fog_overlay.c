@@ -0,0 +1,105 @@
+#include "fog_overlay.h"
+#include "../utils/mem_track.h"
+#include "../utils/trace.h"
+#include "renderer.h"
+#include <stdlib.h>
+
+// Maps larger than this are nearest-sampled down, like the minimap terrain
+#define FOG_OVERLAY_MAX_SIZE 2048
+
+static const Color FOG_UNEXPLORED_COLOR = {0, 0, 0, 230};
+static const Color FOG_EXPLORED_COLOR = {0, 0, 0, 130};
+
+typedef struct {
+  Texture2D texture;
+  Color *pixels;
+  int owner;
+  unsigned long version;
+} FogOverlayCache;
+
+// One cache per view, so split views with different fog do not re-upload
+// each other's texture every frame
+static FogOverlayCache g_fog_overlay[FOG_OVERLAY_VIEWS] = {0};
+
+static void fog_overlay_upload(FogOverlayCache *cache, const FogLayers *fog) {
+  int width = fog->width < FOG_OVERLAY_MAX_SIZE ? fog->width
+                                                : FOG_OVERLAY_MAX_SIZE;
+  int height = fog->height < FOG_OVERLAY_MAX_SIZE ? fog->height
+                                                  : FOG_OVERLAY_MAX_SIZE;
+
+  if (cache->texture.width != width ||
+      cache->texture.height != height) {
+    if (cache->texture.id > 0) {
+      mem_track_texture_unloaded(cache->texture.width, cache->texture.height,
+                                 MEM_TRACK_TEXTURE_BPP);
+      UnloadTexture(cache->texture);
+    }
+    mem_track_free(cache->pixels);
+    cache->pixels = (Color *)mem_track_malloc(
+        MEM_SUBSYSTEM_CACHES, (size_t)width * height * sizeof(Color));
+    if (!cache->pixels) {
+      cache->texture = (Texture2D){0};
+      return;
+    }
+    Image image = GenImageColor(width, height, BLANK);
+    cache->texture = LoadTextureFromImage(image);
+    if (cache->texture.id > 0)
+      mem_track_texture_loaded(width, height, MEM_TRACK_TEXTURE_BPP);
+    SetTextureFilter(cache->texture, TEXTURE_FILTER_BILINEAR);
+    UnloadImage(image);
+  }
+
+  TRACE_ZONE_BEGIN(zone, "fog_overlay_upload");
+  for (int py = 0; py < height; py++) {
+    int tile_y = (int)((long)py * fog->height / height);
+    for (int px = 0; px < width; px++) {
+      int tile_x = (int)((long)px * fog->width / width);
+      Color color = BLANK;
+      if (!fog_layer_bit(fog->visible, fog->width, tile_x, tile_y))
+        color = fog_layer_bit(fog->explored, fog->width, tile_x, tile_y)
+                    ? FOG_EXPLORED_COLOR
+                    : FOG_UNEXPLORED_COLOR;
+      cache->pixels[py * width + px] = color;
+    }
+  }
+  UpdateTexture(cache->texture, cache->pixels);
+  TRACE_ZONE_END(zone);
+}
+
+void fog_overlay_draw(const FogLayers *fog, const Camera2D_RTS *camera,
+                      int view) {
+  if (fog->owner <= 0 || !fog->visible || view < 0 ||
+      view >= FOG_OVERLAY_VIEWS)
+    return;
+
+  FogOverlayCache *cache = &g_fog_overlay[view];
+  if (cache->texture.id == 0 || cache->owner != fog->owner ||
+      cache->version != fog->version) {
+    fog_overlay_upload(cache, fog);
+    cache->owner = fog->owner;
+    cache->version = fog->version;
+  }
+  if (cache->texture.id == 0)
+    return;
+
+  Vector2 top_left = camera_world_to_screen(camera, (Vector2){0, 0});
+  Rectangle source = {0, 0, cache->texture.width, cache->texture.height};
+  Rectangle dest = {top_left.x, top_left.y, fog->width * camera->scale,
+                    fog->height * camera->scale};
+
+  renderer_track_texture(cache->texture.id);
+  DrawTexturePro(cache->texture, source, dest, (Vector2){0, 0}, 0.0f, WHITE);
+}
+
+void fog_overlay_cleanup(void) {
+  for (int view = 0; view < FOG_OVERLAY_VIEWS; view++) {
+    FogOverlayCache *cache = &g_fog_overlay[view];
+    if (cache->texture.id > 0) {
+      mem_track_texture_unloaded(cache->texture.width, cache->texture.height,
+                                 MEM_TRACK_TEXTURE_BPP);
+      UnloadTexture(cache->texture);
+    }
+    mem_track_free(cache->pixels);
+    *cache = (FogOverlayCache){0};
+  }
+}
@@ -0,0 +1,29 @@
+#ifndef FOG_OVERLAY_H
+#define FOG_OVERLAY_H
+
+#include "../client/fog.h"
+#include "camera.h"
+
+// Independent overlay caches, one per split-screen view
+#define FOG_OVERLAY_VIEWS 2
+
+/**
+ * @brief Darkens unexplored tiles and dims explored but unseen ones
+ *
+ * The bitsets are expanded into a texture only when they change (the layer
+ * version moves); drawing is a single textured quad over the map.
+ *
+ * @param fog Visibility of the snapshot being drawn; nothing is drawn when
+ *            fog->owner is 0
+ * @param camera Active camera
+ * @param view Split-screen view being drawn, 0 in single view
+ */
+void fog_overlay_draw(const FogLayers *fog, const Camera2D_RTS *camera,
+                      int view);
+
+/**
+ * @brief Releases the overlay textures (requires a live GL context)
+ */
+void fog_overlay_cleanup(void);
+
+#endif
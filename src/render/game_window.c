@@ -1,8 +1,27 @@
 #include "game_window.h"
+#include "../client/replay_diff.h"
+#include "../map/paged_map.h"
+#include "../utils/job_system.h"
+#include "../utils/mem_track.h"
+#include "../utils/profiler.h"
+#include "../utils/quality_governor.h"
+#include "../utils/trace.h"
+#include "fog_overlay.h"
+#include "heatmap_overlay.h"
+#include "map_cache.h"
+#include "memory_overlay.h"
+#include "profiler_overlay.h"
+#include "quality_overlay.h"
 #include "raylib.h"
 #include "renderer.h"
+#include "unit_trails.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+// Perspectives offered by the V key, owners 1..N
+#define GAME_WINDOW_MAX_FOG_OWNER 4
 
 static GameWindowConfig default_config = {
     .screen_width = 800,
@@ -11,34 +30,351 @@ static GameWindowConfig default_config = {
     .target_fps = 60,
 };
 
+// Offscreen targets for the world layers, one per view, used when the
+// governor lowers the render resolution or the window is split; resized
+// lazily to match the view
+static RenderTexture2D g_world_targets[GAME_WINDOW_MAX_VIEWS] = {0};
+
+// Movement trails, one set per view, sampled while shown
+static UnitTrails g_unit_trails[GAME_WINDOW_MAX_VIEWS] = {0};
+
+// Terrain paged from disk in place of the replay's map
+static const char *g_paged_map_path = NULL;
+static TileMap g_paged_map = {0};
+
+// AXIOM_ZERO_ALLOC_TEST=1 plays the replay and fails the run when the frame
+// loop allocates once everything is loaded and the caches are warm
+#define ZERO_ALLOC_WARMUP_FRAMES 120
+#define ZERO_ALLOC_TEST_FRAMES 600
+
+typedef struct {
+  bool enabled;
+  int warm_frames; // Consecutive frames with everything loaded
+  int checked_frames;
+  int failed_frames;
+  unsigned long frame_start[MEM_SUBSYSTEM_COUNT];
+} ZeroAllocTest;
+
+static void game_window_release_world_target(RenderTexture2D *target) {
+  if (target->id > 0) {
+    mem_track_texture_unloaded(target->texture.width, target->texture.height,
+                               MEM_TRACK_RENDER_TEXTURE_BPP);
+    UnloadRenderTexture(*target);
+  }
+  *target = (RenderTexture2D){0};
+}
+
 void game_window_load_tick(GameState *game_state, int tick) {
   if (tick < 0)
     tick = 0;
   if (tick > game_state->max_tick)
     tick = game_state->max_tick;
 
-  SimulationState *new_sim = LoadStateAtTick(game_state->filename, tick);
-  if (new_sim) {
-    FreeState(game_state->sim);
-    game_state->sim = new_sim;
-    game_state->current_tick = tick;
-    TraceLog(LOG_INFO, "GameWindow: Loaded tick %d", tick);
+  // Decoding happens on the data thread; the tick shows up in a later
+  // snapshot
+  data_thread_request_tick(game_state->data, tick);
+}
+
+// Points the game state at the latest published snapshot
+static void game_window_sync_snapshot(GameState *game_state) {
+  const SimSnapshot *snapshot =
+      data_thread_acquire_snapshot(game_state->data);
+  if (!snapshot)
+    return;
+
+  // Decode time is spent on the data thread; attribute it to the frame that
+  // first shows the tick
+  if (!game_state->snapshot ||
+      snapshot->sequence != game_state->snapshot->sequence)
+    profiler_add_stage_ms(PROFILER_STAGE_TICK_LOAD, snapshot->decode_ms);
+
+  game_state->snapshot = snapshot;
+  game_state->sim = &snapshot->sim;
+  game_state->current_tick = snapshot->tick;
+  game_state->max_tick = snapshot->max_tick;
+}
+
+// Follows the timeline as the replay index grows, even while paused
+static void game_window_sync_tick_count(GameState *game_state) {
+  int max_tick = GetReplayTickCount(game_state->replay) - 1;
+  if (max_tick > game_state->max_tick)
+    game_state->max_tick = max_tick;
+}
+
+// Width of the divider between split views, in pixels
+#define GAME_WINDOW_DIVIDER_WIDTH 2
+
+// Opens the --map file, if any. Replays opened afterwards draw on it and
+// size their heatmap and fog from it; their own maps are never built, so
+// the terrain may be larger than memory.
+static void game_window_open_paged_map(void) {
+  if (!g_paged_map_path)
+    return;
+  PagedMap *paged = paged_map_open(g_paged_map_path, PAGED_MAP_DEFAULT_BUDGET);
+  if (paged) {
+    g_paged_map = paged_map_tile_map(paged);
+    TraceLog(LOG_INFO, "GameWindow: Paging %dx%d map from %s",
+             g_paged_map.width, g_paged_map.height, g_paged_map_path);
+  } else {
+    TraceLog(LOG_WARNING, "GameWindow: Could not open paged map %s; "
+                          "drawing the replay's map",
+             g_paged_map_path);
+  }
+}
+
+static SimReplay *game_window_open_replay(const char *filename) {
+  if (g_paged_map.paged)
+    return OpenReplayProgressiveWithMap(filename, &g_paged_map);
+  return OpenReplayProgressive(filename);
+}
+
+// Closes the paged map once every replay drawing on it is closed
+static void game_window_close_paged_map(void) {
+  if (!g_paged_map.paged)
+    return;
+  PagedMapStats paged_stats;
+  paged_map_stats(g_paged_map.paged, &paged_stats);
+  TraceLog(LOG_INFO,
+           "GameWindow: Paged map read %lu chunks ahead, %lu on demand, "
+           "evicted %lu",
+           paged_stats.prefetched, paged_stats.faults, paged_stats.evictions);
+  paged_map_close(g_paged_map.paged);
+  g_paged_map = (TileMap){0};
+}
+
+// Map drawn for a view: the main view's map when the terrain is identical,
+// so both views hit the same chunk and minimap caches
+static const TileMap *game_window_view_map(const GameState *game_state) {
+  return game_state->shared_map ? game_state->shared_map
+                                : &game_state->sim->map;
+}
+
+// Opens the second view of a comparison. Two ticks of one replay share the
+// parsed replay, its tick index and the heatmap; a second replay shares the
+// main one's map when the terrain is identical.
+static bool game_window_open_compare(GameState *views, SimReplay *replay,
+                                     const GameWindowCompare *compare) {
+  GameState *view = &views[1];
+  views[0].linked_cameras = true;
+  *view = (GameState){
+      .paused = true,
+      .heatmap_layer = -1,
+      .view = 1,
+      .tick_offset = compare->tick_offset,
+  };
+
+  if (compare->filename == NULL) {
+    view->data = data_thread_start_shared(replay, DATA_THREAD_DEFAULT_TICK_RATE);
+    view->replay = replay;
+    view->heatmap = views[0].heatmap;
+    view->max_tick = views[0].max_tick;
+    snprintf(view->filename, sizeof(view->filename), "%s", views[0].filename);
+  } else {
+    SimReplay *other = game_window_open_replay(compare->filename);
+    if (other == NULL) {
+      TraceLog(LOG_ERROR, "GameWindow: Failed to open replay %s",
+               compare->filename);
+      return false;
+    }
+    // Identical terrain renders from one set of cached textures
+    if (replay_diff_maps_equal(GetReplayMap(replay), GetReplayMap(other)))
+      view->shared_map = GetReplayMap(replay);
+    else
+      TraceLog(LOG_WARNING, "GameWindow: %s uses a different map; terrain "
+                            "caches are rebuilt for each view",
+               compare->filename);
+    view->max_tick = GetReplayTickCount(other) - 1;
+    view->replay = other;
+    view->data = data_thread_start(other, DATA_THREAD_DEFAULT_TICK_RATE);
+    snprintf(view->filename, sizeof(view->filename), "%s", compare->filename);
+  }
+
+  if (view->data == NULL) {
+    TraceLog(LOG_ERROR, "GameWindow: Failed to start compare data thread");
+    return false;
   }
+  return true;
 }
 
-int game_window_run(SimulationState *sim) {
-  if (sim == NULL) {
-    TraceLog(LOG_ERROR, "GameWindow: NULL simulation state provided");
+// Splits the window between the views and picks the view that gets mouse
+// and keyboard input: the one under the mouse
+static int game_window_layout_views(Camera2D_RTS *cameras, int view_count) {
+  if (view_count == 1) {
+    camera_set_screen_area(&cameras[0], (Rectangle){0});
+    cameras[0].handles_input = true;
+    return 0;
+  }
+
+  float width = (GetScreenWidth() - GAME_WINDOW_DIVIDER_WIDTH) / 2.0f;
+  float height = (float)GetScreenHeight();
+  camera_set_screen_area(&cameras[0], (Rectangle){0, 0, width, height});
+  camera_set_screen_area(
+      &cameras[1],
+      (Rectangle){width + GAME_WINDOW_DIVIDER_WIDTH, 0, width, height});
+
+  int active = GetMousePosition().x > width ? 1 : 0;
+  for (int i = 0; i < view_count; i++)
+    cameras[i].handles_input = i == active;
+  return active;
+}
+
+// Keeps the second view on the main view's tick plus its offset, and on the
+// same fog perspective and heatmap layer
+static void game_window_sync_compare(GameState *views) {
+  GameState *view = &views[1];
+  int tick = views[0].current_tick + view->tick_offset;
+  if (tick < 0)
+    tick = 0;
+  if (tick > view->max_tick)
+    tick = view->max_tick;
+  if (tick != view->requested_tick) {
+    data_thread_request_tick(view->data, tick);
+    view->requested_tick = tick;
+  }
+
+  if (view->fog_owner != views[0].fog_owner) {
+    view->fog_owner = views[0].fog_owner;
+    data_thread_set_fog_owner(view->data, view->fog_owner);
+  }
+  view->heatmap_layer = view->heatmap ? views[0].heatmap_layer : -1;
+  view->show_trails = views[0].show_trails;
+  view->paused = views[0].paused;
+}
+
+static void game_window_zero_alloc_begin(ZeroAllocTest *test) {
+  for (int s = 0; s < MEM_SUBSYSTEM_COUNT; s++)
+    test->frame_start[s] =
+        mem_track_thread_subsystem_allocations((MemSubsystem)s);
+}
+
+// Checks one frame; returns true once the test has run its course
+static bool game_window_zero_alloc_end(ZeroAllocTest *test, bool warm) {
+  test->warm_frames = warm ? test->warm_frames + 1 : 0;
+  if (test->warm_frames <= ZERO_ALLOC_WARMUP_FRAMES)
+    return false;
+
+  char culprits[192] = "";
+  int length = 0;
+  for (int s = 0; s < MEM_SUBSYSTEM_COUNT; s++) {
+    unsigned long count =
+        mem_track_thread_subsystem_allocations((MemSubsystem)s) -
+        test->frame_start[s];
+    if (count > 0 && length < (int)sizeof(culprits))
+      length += snprintf(culprits + length, sizeof(culprits) - length,
+                         "%s%s %lu", length ? ", " : "",
+                         mem_track_subsystem_name((MemSubsystem)s), count);
+  }
+  if (length > 0) {
+    test->failed_frames++;
+    TraceLog(LOG_ERROR, "GameWindow: Warm frame %d allocated (%s)",
+             test->checked_frames, culprits);
+  }
+
+  if (++test->checked_frames < ZERO_ALLOC_TEST_FRAMES)
+    return false;
+  if (test->failed_frames > 0)
+    TraceLog(LOG_ERROR,
+             "GameWindow: Zero-allocation test failed: %d of %d warm frames "
+             "allocated",
+             test->failed_frames, test->checked_frames);
+  else
+    TraceLog(LOG_INFO,
+             "GameWindow: Zero-allocation test passed: %d warm frames "
+             "without allocations",
+             test->checked_frames);
+  return true;
+}
+
+void game_window_use_paged_map(const char *path) { g_paged_map_path = path; }
+
+int game_window_run(const char *filename) {
+  return game_window_run_compare(filename, NULL);
+}
+
+int game_window_run_compare(const char *filename,
+                            const GameWindowCompare *compare) {
+  if (filename == NULL) {
+    TraceLog(LOG_ERROR, "GameWindow: No replay file provided");
     return 1;
   }
 
-  // Initialize game state
-  GameState game_state = {
-      .sim = sim,
+  // AXIOM_TRACE=1 records from startup so loading shows up in the trace
+  const char *trace_env = getenv("AXIOM_TRACE");
+  if (trace_env && trace_env[0] == '1')
+    trace_set_enabled(true);
+  const char *zero_alloc_env = getenv("AXIOM_ZERO_ALLOC_TEST");
+  ZeroAllocTest zero_alloc = {
+      .enabled = zero_alloc_env && zero_alloc_env[0] == '1'};
+  int exit_status = 0;
+  trace_set_thread_name("main");
+
+  // Every parallel pass, map preprocessing included, runs on these workers
+  if (job_system_init(-1))
+    TraceLog(LOG_INFO, "GameWindow: Started %d job workers",
+             job_system_worker_count());
+  else
+    TraceLog(LOG_WARNING, "GameWindow: No job workers; running jobs inline");
+
+  // Only the map and the first tick are read before the window opens; the
+  // rest of the file is indexed in the background
+  game_window_open_paged_map();
+  SimReplay *replay = game_window_open_replay(filename);
+  if (replay == NULL) {
+    TraceLog(LOG_ERROR, "GameWindow: Failed to open replay %s", filename);
+    job_system_shutdown();
+    game_window_close_paged_map();
+    return 1;
+  }
+  const TileMap *map = GetReplayMap(replay);
+  int max_tick = GetReplayTickCount(replay) - 1;
+
+  // Initialize game state; the data thread takes ownership of the replay
+  GameState views[GAME_WINDOW_MAX_VIEWS] = {0};
+  views[0] = (GameState){
+      .sim = NULL,
+      .snapshot = NULL,
+      .data = data_thread_start(replay, DATA_THREAD_DEFAULT_TICK_RATE),
+      .replay = replay,
       .current_tick = 0,
-      .max_tick = GetMaxTickFromFile("../assets/test.sim.json"),
+      .max_tick = max_tick,
       .paused = true, // Start paused to allow tick navigation
-      .filename = "../assets/test.sim.json"};
+      .heatmap_layer = -1,
+  };
+  GameState *game_state = &views[0];
+  if (game_state->data == NULL) {
+    TraceLog(LOG_ERROR, "GameWindow: Failed to start data thread");
+    job_system_shutdown();
+    game_window_close_paged_map();
+    return 1;
+  }
+  // Reads the replay the data thread now owns; destroyed before it stops
+  game_state->heatmap = heatmap_create(replay);
+  game_state->timeline = timeline_create(replay);
+  game_state->unit_events = unit_events_create(replay);
+  snprintf(game_state->filename, sizeof(game_state->filename), "%s", filename);
+
+  int view_count = 1;
+  if (compare) {
+    if (!game_window_open_compare(views, replay, compare)) {
+      data_thread_stop(views[1].data);
+      heatmap_destroy(game_state->heatmap);
+      timeline_destroy(game_state->timeline);
+      unit_events_destroy(game_state->unit_events);
+      data_thread_stop(game_state->data);
+      job_system_shutdown();
+      game_window_close_paged_map();
+      return 1;
+    }
+    view_count = 2;
+  }
+
+  // AXIOM_TICK_STORE_MB=<n> keeps up to n MB of decoded ticks per view
+  const char *tick_store_env = getenv("AXIOM_TICK_STORE_MB");
+  if (tick_store_env && atoi(tick_store_env) > 0) {
+    for (int i = 0; i < view_count; i++)
+      data_thread_set_tick_store_budget(views[i].data,
+                                        (size_t)atoi(tick_store_env) << 20);
+  }
 
   // Set initial window state
   InitWindow(default_config.screen_width, default_config.screen_height,
@@ -50,83 +386,510 @@ int game_window_run(SimulationState *sim) {
                     (screen_height - default_config.screen_height) / 2);
 
   SetTargetFPS(default_config.target_fps);
-  renderer_init_tile_atlas("../assets/tiles.png", 16, 16, 1);
-  renderer_init_unit_texture("../assets/unit.png");
-  renderer_init_tree_texture("../assets/tree.png");
+  renderer_init_world_atlas("../assets/tiles.png", 16, 16, 1,
+                            "../assets/unit.png", "../assets/tree.png");
+  renderer_init_sprite_batches();
+  unit_trails_system_init();
+  map_cache_init(MAP_CACHE_DEFAULT_BUDGET);
 
   if (!IsWindowReady()) {
     TraceLog(LOG_ERROR, "GameWindow: Failed to initialize window");
+    if (view_count > 1)
+      data_thread_stop(views[1].data);
+    heatmap_destroy(game_state->heatmap);
+    timeline_destroy(game_state->timeline);
+    unit_events_destroy(game_state->unit_events);
+    data_thread_stop(game_state->data);
+    job_system_shutdown();
+    game_window_close_paged_map();
     return 1;
   }
 
-  Camera2D_RTS camera;
+  Camera2D_RTS cameras[GAME_WINDOW_MAX_VIEWS];
   CameraConfig cam_config = {.screen_width = GetScreenWidth(),
                              .screen_height = GetScreenHeight(),
                              .camera_move_speed = DEFAULT_CAMERA_SPEED,
                              .camera_zoom_speed = 0.1f};
 
-  camera_init(&camera, &cam_config, &game_state.sim->map);
+  for (int i = 0; i < view_count; i++)
+    camera_init(&cameras[i], &cam_config, map);
+  quality_governor_init(1000.0 / default_config.target_fps);
+  double work_ms = 0.0;
 
   TraceLog(LOG_INFO, "GameWindow: Starting main game loop");
-  TraceLog(LOG_INFO, "GameWindow: Total ticks available: %d",
-           game_state.max_tick);
+  bool indexed = IsReplayIndexed(replay);
+  if (indexed)
+    TraceLog(LOG_INFO, "GameWindow: Total ticks available: %d",
+             game_state->max_tick);
+  else
+    TraceLog(LOG_INFO, "GameWindow: Indexing replay in the background");
   TraceLog(LOG_INFO, "GameWindow: Controls - WASD: Move, Mouse Wheel: Zoom, R: "
                      "Reset, P: Pause, Q: Quit");
   TraceLog(LOG_INFO, "GameWindow: Tick Controls - Left/Right: Navigate ticks, "
-                     "Space: Play/Pause, Home/End: First/Last tick");
+                     "Space: Play/Pause, Home/End: First/Last tick, "
+                     "Click/drag the timeline: Seek");
+  TraceLog(LOG_INFO, "GameWindow: Debug - F3: Profiler overlay, F4: Dump "
+                     "profiler CSV, F5: Write trace, F6: Toggle tracing, F7: "
+                     "Quality readout, F8: Toggle quality governor, F9: Memory "
+                     "readout");
+  TraceLog(LOG_INFO, "GameWindow: Analysis - H: Cycle unit density heatmap, "
+                     "V: Cycle player perspective, T: Movement trails");
+  if (view_count > 1)
+    TraceLog(LOG_INFO, "GameWindow: Compare - L: Link/unlink cameras, [/]: "
+                       "Shift the right view's tick offset");
+  if (zero_alloc.enabled) {
+    TraceLog(LOG_INFO, "GameWindow: Zero-allocation test: playing, then "
+                       "checking %d warm frames",
+             ZERO_ALLOC_TEST_FRAMES);
+    game_state->paused = false;
+    data_thread_set_playing(game_state->data, true);
+  }
 
   while (!WindowShouldClose()) {
-    camera_update(&camera, &game_state.sim->map);
-    game_window_handle_input(&game_state, &camera);
+    TRACE_ZONE_BEGIN(frame_zone, "Frame");
+    profiler_frame_begin();
+    double work_start_ms = profiler_now_ms();
+    unsigned long frame_allocations = mem_track_thread_allocations();
+    if (zero_alloc.enabled)
+      game_window_zero_alloc_begin(&zero_alloc);
+
+    // Judge the previous frame; loading frames say nothing about rendering
+    const ProfilerFrame *last_frame = profiler_history_frame(0);
+    if (last_frame && game_state->sim) {
+      int level = quality_governor_level();
+      quality_governor_update(last_frame->frame_ms, work_ms);
+      if (quality_governor_level() != level)
+        TraceLog(LOG_INFO, "GameWindow: Quality %d -> %d (%s): %s", level,
+                 quality_governor_level(),
+                 quality_governor_level_name(quality_governor_level()),
+                 quality_governor_decision(0)->reason);
+    }
+    const QualitySettings *quality = quality_governor_settings();
+    renderer_set_unit_lod_pixels(quality->unit_lod_pixels);
+    ui_set_minimap_update_interval(quality->minimap_interval);
+
+    for (int i = 0; i < view_count; i++) {
+      game_window_sync_snapshot(&views[i]);
+      game_window_sync_tick_count(&views[i]);
+    }
+    if (!indexed && IsReplayIndexed(replay)) {
+      indexed = true;
+      TraceLog(LOG_INFO, "GameWindow: Replay indexed, %d ticks available",
+               GetReplayTickCount(replay));
+    }
+    if (view_count > 1)
+      game_window_sync_compare(views);
+    for (int i = 0; i < view_count; i++) {
+      if (views[i].show_trails && views[i].snapshot)
+        unit_trails_update(&g_unit_trails[i], views[i].snapshot);
+      else
+        unit_trails_reset(&g_unit_trails[i]);
+    }
+    if (game_state->heatmap)
+      heatmap_update(game_state->heatmap);
+    if (game_state->timeline)
+      timeline_update(game_state->timeline);
+    if (game_state->unit_events)
+      unit_events_update(game_state->unit_events);
+
+    TRACE_ZONE_BEGIN(update_zone, "Update");
+    profiler_stage_begin(PROFILER_STAGE_CAMERA);
+    // With linked cameras the view under the mouse leads and the other
+    // copies it
+    int active = game_window_layout_views(cameras, view_count);
+    const TileMap *view_maps[GAME_WINDOW_MAX_VIEWS];
+    for (int i = 0; i < view_count; i++)
+      view_maps[i] = views[i].sim ? game_window_view_map(&views[i]) : map;
+    camera_update(&cameras[active], view_maps[active]);
+    for (int i = 0; i < view_count; i++) {
+      if (i == active)
+        continue;
+      if (game_state->linked_cameras)
+        camera_follow(&cameras[i], &cameras[active], view_maps[i]);
+      else
+        camera_update(&cameras[i], view_maps[i]);
+    }
+    profiler_stage_end(PROFILER_STAGE_CAMERA);
+    game_window_handle_input(game_state, &cameras[0]);
+    if (view_count > 1)
+      game_window_handle_compare_input(views);
+    TRACE_ZONE_END(update_zone);
 
     BeginDrawing();
-    game_window_render_frame(&game_state, &camera);
+    bool ready = true;
+    for (int i = 0; i < view_count; i++)
+      ready = ready && views[i].sim;
+    if (ready) {
+      game_window_render_frame(views, cameras, view_count);
+    } else {
+      ClearBackground(RAYWHITE);
+      DrawText("Loading...", 20, 20, 20, DARKGRAY);
+    }
+    work_ms = profiler_now_ms() - work_start_ms;
+    // Includes the buffer swap and the frame limiter's wait
+    TRACE_ZONE_BEGIN(present_zone, "EndDrawing");
     EndDrawing();
+    TRACE_ZONE_END(present_zone);
+    frame_allocations = mem_track_thread_allocations() - frame_allocations;
+    profiler_set_counter(PROFILER_COUNTER_ALLOCATIONS, (int)frame_allocations);
+    profiler_frame_end();
+    TRACE_ZONE_END(frame_zone);
+
+    // Warm once the replay is indexed, every view shows a tick and the
+    // heatmap, timeline and unit events have caught up
+    bool analysed = !(game_state->heatmap &&
+                      heatmap_is_busy(game_state->heatmap)) &&
+                    !(game_state->timeline &&
+                      timeline_is_busy(game_state->timeline)) &&
+                    !(game_state->unit_events &&
+                      unit_events_is_busy(game_state->unit_events));
+    if (zero_alloc.enabled &&
+        game_window_zero_alloc_end(&zero_alloc,
+                                   ready && indexed && analysed)) {
+      exit_status = zero_alloc.failed_frames > 0 ? 1 : 0;
+      break;
+    }
   }
 
+  map_cache_cleanup();
+  for (int i = 0; i < GAME_WINDOW_MAX_VIEWS; i++)
+    game_window_release_world_target(&g_world_targets[i]);
+  renderer_cleanup_sprite_batches();
+  for (int i = 0; i < GAME_WINDOW_MAX_VIEWS; i++)
+    unit_trails_free(&g_unit_trails[i]);
+  unit_trails_system_cleanup();
+  renderer_cleanup_world_atlas();
+  ui_cleanup_minimap();
+  ui_cleanup_panels();
+  heatmap_overlay_cleanup();
+  fog_overlay_cleanup();
   CloseWindow();
-  renderer_cleanup_tile_atlas();
-  renderer_cleanup_unit_texture();
-  renderer_cleanup_tree_texture();
+  // The compare view may borrow the main replay and heatmap; stop it first
+  if (view_count > 1)
+    data_thread_stop(views[1].data);
+  heatmap_destroy(game_state->heatmap);
+  timeline_destroy(game_state->timeline);
+  unit_events_destroy(game_state->unit_events);
+  data_thread_stop(game_state->data);
+  job_system_shutdown();
+  game_window_close_paged_map();
+  trace_shutdown();
 
   TraceLog(LOG_INFO, "GameWindow: Shutdown complete");
-  return 0;
+  return exit_status;
 }
 
 void game_window_handle_input(GameState *game_state, Camera2D_RTS *camera) {
   // Space: Toggle play/pause
   if (IsKeyPressed(KEY_SPACE)) {
     game_state->paused = !game_state->paused;
+    data_thread_set_playing(game_state->data, !game_state->paused);
     TraceLog(LOG_INFO, "GameWindow: Simulation %s",
              game_state->paused ? "paused" : "playing");
   }
 
+  // Left mouse on the timeline: Seek to the tick under the cursor
+  int scrub_tick;
+  if (IsMouseButtonDown(MOUSE_BUTTON_LEFT) &&
+      ui_tick_controls_tick_at(GetMousePosition(), game_state->max_tick,
+                               &scrub_tick) &&
+      scrub_tick != game_state->current_tick)
+    game_window_load_tick(game_state, scrub_tick);
+
+  // H: Cycle the heatmap through all units, each owner, and off
+  if (IsKeyPressed(KEY_H) && game_state->heatmap) {
+    game_state->heatmap_layer++;
+    if (game_state->heatmap_layer >= HEATMAP_LAYERS)
+      game_state->heatmap_layer = -1;
+    if (game_state->heatmap_layer < 0)
+      TraceLog(LOG_INFO, "GameWindow: Heatmap hidden");
+    else if (game_state->heatmap_layer == HEATMAP_LAYER_ALL)
+      TraceLog(LOG_INFO, "GameWindow: Heatmap showing all units");
+    else
+      TraceLog(LOG_INFO, "GameWindow: Heatmap showing owner %d",
+               game_state->heatmap_layer);
+  }
+
+  // V: Cycle the fog-of-war perspective through each owner and off
+  if (IsKeyPressed(KEY_V)) {
+    game_state->fog_owner =
+        (game_state->fog_owner + 1) % (GAME_WINDOW_MAX_FOG_OWNER + 1);
+    data_thread_set_fog_owner(game_state->data, game_state->fog_owner);
+    if (game_state->fog_owner == 0)
+      TraceLog(LOG_INFO, "GameWindow: Showing all players");
+    else
+      TraceLog(LOG_INFO, "GameWindow: Showing owner %d's perspective",
+               game_state->fog_owner);
+  }
+
+  // T: Toggle movement trails; not kept under a perspective, which
+  // reorders the units every tick
+  if (IsKeyPressed(KEY_T)) {
+    game_state->show_trails = !game_state->show_trails;
+    TraceLog(LOG_INFO, "GameWindow: Movement trails %s",
+             game_state->show_trails ? "shown" : "hidden");
+  }
+
+  // F3: Toggle the frame profiler overlay
+  if (IsKeyPressed(KEY_F3)) {
+    game_state->show_profiler = !game_state->show_profiler;
+  }
+
+  // F4: Dump captured frame stats for bug reports
+  if (IsKeyPressed(KEY_F4)) {
+    char path[64];
+    snprintf(path, sizeof(path), "axiorem_profile_%ld.csv", (long)time(NULL));
+    if (profiler_dump_csv(path))
+      TraceLog(LOG_INFO, "GameWindow: Profiler stats written to %s", path);
+    else
+      TraceLog(LOG_WARNING, "GameWindow: Could not write %s", path);
+  }
+
+  // F5: Write recorded zones as a Chrome trace (chrome://tracing, Perfetto)
+  if (IsKeyPressed(KEY_F5)) {
+    char path[64];
+    snprintf(path, sizeof(path), "axiorem_trace_%ld.json", (long)time(NULL));
+    if (trace_write_json(path))
+      TraceLog(LOG_INFO, "GameWindow: Trace written to %s", path);
+    else
+      TraceLog(LOG_WARNING, "GameWindow: Could not write %s", path);
+  }
+
+  // F6: Start/stop trace recording
+  if (IsKeyPressed(KEY_F6)) {
+    trace_set_enabled(!trace_is_enabled());
+    TraceLog(LOG_INFO, "GameWindow: Tracing %s",
+             trace_is_enabled() ? "enabled" : "disabled");
+  }
+
+  // F7: Toggle the quality governor readout
+  if (IsKeyPressed(KEY_F7)) {
+    game_state->show_quality = !game_state->show_quality;
+  }
+
+  // F9: Toggle the memory readout
+  if (IsKeyPressed(KEY_F9)) {
+    game_state->show_memory = !game_state->show_memory;
+  }
+
+  // F8: Enable/disable the quality governor (disabled holds full quality)
+  if (IsKeyPressed(KEY_F8)) {
+    quality_governor_set_enabled(!quality_governor_is_enabled());
+    TraceLog(LOG_INFO, "GameWindow: Quality governor %s",
+             quality_governor_is_enabled() ? "enabled" : "disabled");
+  }
+
   // Q: Quit game
   if (IsKeyPressed(KEY_Q)) {
     TraceLog(LOG_INFO, "GameWindow: Quit requested via Q key");
   }
+}
+
+void game_window_handle_compare_input(GameState *views) {
+  // L: Link/unlink the two cameras
+  if (IsKeyPressed(KEY_L)) {
+    views[0].linked_cameras = !views[0].linked_cameras;
+    TraceLog(LOG_INFO, "GameWindow: Cameras %s",
+             views[0].linked_cameras ? "linked" : "independent");
+  }
 
-  // Auto-advance if not paused
-  if (!game_state->paused && game_state->current_tick < game_state->max_tick) {
-    game_window_load_tick(game_state, game_state->current_tick + 1);
+  // [ / ]: Move the right view's tick relative to the left one
+  int shift = IsKeyPressed(KEY_RIGHT_BRACKET) - IsKeyPressed(KEY_LEFT_BRACKET);
+  if (shift != 0) {
+    // Hold shift for steps of 10 ticks
+    if (IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT))
+      shift *= 10;
+    views[1].tick_offset += shift;
+    TraceLog(LOG_INFO, "GameWindow: Right view offset %+d ticks",
+             views[1].tick_offset);
   }
 }
 
-void game_window_render_frame(const GameState *game_state,
-                              const Camera2D_RTS *camera) {
-  ClearBackground(RAYWHITE);
+// Map, overlays and entities: everything that lives in world space
+static void game_window_render_world(const GameState *game_state,
+                                     const Camera2D_RTS *camera,
+                                     bool draw_objects) {
+  profiler_stage_begin(PROFILER_STAGE_MAP);
+  renderer_draw_map_textured(game_window_view_map(game_state), camera);
+  if (game_state->heatmap_layer >= 0)
+    heatmap_overlay_draw(game_state->heatmap, game_state->heatmap_layer,
+                         camera);
+  profiler_stage_end(PROFILER_STAGE_MAP);
 
-  // Render game world layer
+  if (game_state->show_trails) {
+    profiler_stage_begin(PROFILER_STAGE_UNITS);
+    unit_trails_draw(&g_unit_trails[game_state->view], game_state->snapshot,
+                     camera);
+    profiler_stage_end(PROFILER_STAGE_UNITS);
+  }
 
-  renderer_draw_map_textured(&game_state->sim->map, camera);
-  renderer_draw_objects(game_state->sim->objects, game_state->sim->objectCount,
-                        camera);
+  renderer_begin_world_sprites();
+  profiler_stage_begin(PROFILER_STAGE_OBJECTS);
+  if (draw_objects)
+    renderer_draw_objects(game_state->sim->objects,
+                          game_state->sim->objectCount,
+                          &game_state->snapshot->object_grid, camera);
+  profiler_stage_end(PROFILER_STAGE_OBJECTS);
+  profiler_stage_begin(PROFILER_STAGE_UNITS);
   renderer_draw_units(game_state->sim->units, game_state->sim->unitCount,
-                      camera);
+                      &game_state->snapshot->unit_grid, camera);
+  renderer_flush_world_sprites();
+  profiler_stage_end(PROFILER_STAGE_UNITS);
+
+  // Fog sits above entities so objects on explored tiles are dimmed too
+  fog_overlay_draw(&game_state->snapshot->fog, camera, game_state->view);
+}
+
+// Draws the world into the view's offscreen target through a camera scaled
+// to match, then stretches it over the camera's screen area
+static void game_window_render_world_offscreen(const GameState *game_state,
+                                               const Camera2D_RTS *camera,
+                                               float scale,
+                                               bool draw_objects) {
+  RenderTexture2D *target = &g_world_targets[game_state->view];
+  int width = (int)(camera->screen_size.x * scale + 0.5f);
+  int height = (int)(camera->screen_size.y * scale + 0.5f);
+  if (width < 1)
+    width = 1;
+  if (height < 1)
+    height = 1;
+
+  if (target->texture.width != width || target->texture.height != height) {
+    game_window_release_world_target(target);
+    *target = LoadRenderTexture(width, height);
+    if (target->id > 0) {
+      mem_track_texture_loaded(width, height, MEM_TRACK_RENDER_TEXTURE_BPP);
+      SetTextureFilter(target->texture, TEXTURE_FILTER_BILINEAR);
+    }
+  }
+  if (target->id == 0) {
+    game_window_render_world(game_state, camera, draw_objects);
+    return;
+  }
+
+  Camera2D_RTS scaled = *camera;
+  scaled.zoom *= scale;
+  scaled.screen_size = (Vector2){(float)width, (float)height};
+  camera_update_transform(&scaled);
+
+  // Switching render targets submits whatever is batched so far
+  renderer_track_flush(0);
+  BeginTextureMode(*target);
+  map_cache_set_frame_target(target);
+  ClearBackground(RAYWHITE);
+  game_window_render_world(game_state, &scaled, draw_objects);
+  map_cache_set_frame_target(NULL);
+  EndTextureMode();
+  renderer_track_flush(0);
 
-  // Render UI layers
-  ui_draw_main_panel(game_state->sim, camera, game_state->current_tick,
+  // Render textures are stored bottom-up; a negative height flips them back
+  renderer_track_texture(target->texture.id);
+  DrawTexturePro(target->texture,
+                 (Rectangle){0, 0, (float)width, (float)-height},
+                 (Rectangle){camera->screen_area.x, camera->screen_area.y,
+                             camera->screen_size.x, camera->screen_size.y},
+                 (Vector2){0, 0}, 0.0f, WHITE);
+}
+
+// Bar along the bottom of a view while its replay is still being indexed
+static void game_window_draw_index_progress(const GameState *game_state,
+                                            const Camera2D_RTS *camera,
+                                            int bottom) {
+  if (IsReplayIndexed(game_state->replay))
+    return;
+
+  const int width = 220;
+  const int height = 16;
+  int x = (int)camera->screen_area.x + 10;
+  int y = bottom - height - 8;
+  float progress = GetReplayIndexProgress(game_state->replay);
+  DrawRectangle(x, y, width, height, (Color){0, 0, 0, 160});
+  DrawRectangle(x + 2, y + 2, (int)((width - 4) * progress), height - 4,
+                (Color){255, 215, 0, 120});
+  DrawRectangleLines(x, y, width, height, (Color){255, 215, 0, 255});
+  DrawText(TextFormat("Indexing %.0f%%  (%d ticks)", progress * 100.0f,
+                      game_state->max_tick + 1),
+           x + 6, y + 3, 10, RAYWHITE);
+}
+
+// Names the replay and tick shown by each side of a split view
+static void game_window_draw_view_label(const GameState *game_state,
+                                        const Camera2D_RTS *camera,
+                                        int top) {
+  const char *name = strrchr(game_state->filename, '/');
+  name = name ? name + 1 : game_state->filename;
+  const char *label =
+      game_state->tick_offset != 0
+          ? TextFormat("%s  tick %d (%+d)", name, game_state->current_tick,
+                       game_state->tick_offset)
+          : TextFormat("%s  tick %d", name, game_state->current_tick);
+  int x = (int)camera->screen_area.x + 10;
+  DrawRectangle(x - 4, top - 2, MeasureText(label, 10) + 8, 14,
+                (Color){0, 0, 0, 160});
+  DrawText(label, x, top, 10, RAYWHITE);
+}
+
+void game_window_render_frame(const GameState *views,
+                              const Camera2D_RTS *cameras, int view_count) {
+  TRACE_ZONE_BEGIN(render_zone, "RenderFrame");
+  const GameState *game_state = &views[0];
+  ClearBackground(RAYWHITE);
+  renderer_begin_frame();
+
+  // The world layers follow the quality governor; the UI always renders at
+  // full resolution so text stays sharp. Split views always go through their
+  // own target so each is clipped to its half of the window.
+  const QualitySettings *quality = quality_governor_settings();
+  int units = 0;
+  int objects = 0;
+  for (int i = 0; i < view_count; i++) {
+    if (quality->render_scale < 1.0f || view_count > 1)
+      game_window_render_world_offscreen(&views[i], &cameras[i],
+                                         quality->render_scale,
+                                         quality->draw_objects);
+    else
+      game_window_render_world(&views[i], &cameras[i],
+                               quality->draw_objects);
+    units += views[i].sim->unitCount;
+    objects += views[i].sim->objectCount;
+  }
+
+  // Render UI layers (the minimap is timed as its own stage inside)
+  TRACE_ZONE_BEGIN(ui_zone, "UI");
+  profiler_stage_begin(PROFILER_STAGE_UI);
+  UIConfig config = ui_get_default_config();
+  if (view_count > 1) {
+    DrawRectangle((int)cameras[0].screen_size.x, 0, GAME_WINDOW_DIVIDER_WIDTH,
+                  GetScreenHeight(), BLACK);
+    for (int i = 0; i < view_count; i++)
+      game_window_draw_view_label(&views[i], &cameras[i],
+                                  config.top_bar_height + 8);
+  }
+  for (int i = 0; i < view_count; i++)
+    game_window_draw_index_progress(&views[i], &cameras[i],
+                                    GetScreenHeight() - config.panel_height);
+  ui_draw_main_panel(game_state->sim, game_window_view_map(game_state),
+                     &cameras[0], game_state->timeline,
+                     game_state->unit_events, game_state->current_tick,
                      game_state->max_tick, game_state->paused);
   ui_draw_top_bar(game_state->current_tick, game_state->max_tick,
                   game_state->paused);
+  profiler_stage_end(PROFILER_STAGE_UI);
+  TRACE_ZONE_END(ui_zone);
+
+  RendererFrameStats stats = renderer_get_frame_stats();
+  profiler_set_counter(PROFILER_COUNTER_DRAW_CALLS, stats.draw_calls);
+  profiler_set_counter(PROFILER_COUNTER_UNITS, units);
+  profiler_set_counter(PROFILER_COUNTER_OBJECTS, objects);
+  profiler_set_counter(PROFILER_COUNTER_SPRITES, stats.sprites_drawn);
+  profiler_set_counter(PROFILER_COUNTER_CHUNKS, stats.chunks_drawn);
+
+  if (game_state->show_profiler)
+    profiler_overlay_draw(10, config.top_bar_height + 10);
+  if (game_state->show_quality)
+    quality_overlay_draw(GetScreenWidth() - 310, config.top_bar_height + 10);
+  if (game_state->show_memory)
+    memory_overlay_draw(game_state->show_profiler ? 320 : 10,
+                        config.top_bar_height + 10);
+  TRACE_ZONE_END(render_zone);
 }
@@ -1,7 +1,11 @@
 #ifndef GAME_WINDOW_H
 #define GAME_WINDOW_H
 
+#include "../client/data_thread.h"
+#include "../client/heatmap.h"
 #include "../client/sim_loader.h"
+#include "../client/timeline.h"
+#include "../client/unit_events.h"
 #include "../utils/math_utils.h"
 #include "camera.h"
 #include "renderer.h"
@@ -21,19 +25,74 @@ typedef struct {
   int target_fps;
 } GameWindowConfig;
 
-// Game state management
+// Views shown side by side in comparison mode
+#define GAME_WINDOW_MAX_VIEWS 2
+
+// Second view shown next to the main replay
+typedef struct {
+  const char *filename; // Replay to compare with, or NULL for the main one
+  int tick_offset;      // Ticks the second view runs ahead of the main one
+} GameWindowCompare;
+
+// Game state management; everything below `data` mirrors the latest
+// snapshot published by the data thread
 typedef struct {
-  SimulationState *sim;
+  DataThread *data;
+  const SimReplay *replay; // Read for the tick count while still indexing
+  const SimSnapshot *snapshot;
+  const SimulationState *sim;
   int current_tick;
   int max_tick;
   bool paused;
+  bool show_profiler;
+  bool show_quality; // Quality governor readout
+  bool show_memory;  // Per-subsystem memory readout
+  bool show_trails;  // Fading trails of recent unit movement
+  Heatmap *heatmap;
+  Timeline *timeline; // Main view only: aggregates charted in the tick panel
+  UnitEvents *unit_events; // Main view only: spawn and death markers
+  int heatmap_layer; // HEATMAP_LAYER_ALL, an owner number, or -1 when hidden
+  int fog_owner;     // Perspective shown through fog of war, 0 for none
   char filename[256];
+
+  // Split-screen comparison
+  int view;                  // Slot of this view, 0 for the main one
+  const TileMap *shared_map; // Identical map to draw instead, or NULL
+  int tick_offset;           // Ticks ahead of the main view
+  int requested_tick;        // Last tick requested to follow the main view
+  bool linked_cameras;       // Main view only: cameras pan and zoom together
 } GameState;
 
-int game_window_run(SimulationState *sim);
+int game_window_run(const char *filename);
+
+/**
+ * @brief Draws terrain from a paged map file instead of the replay's map
+ *
+ * Call before game_window_run(). The file must have the size of the
+ * replay's map, which is then never built, so heatmap and fog are sized from
+ * the paged map. If the file cannot be opened the replay's own map is drawn.
+ *
+ * @param path File written by --write-map, or NULL to disable
+ */
+void game_window_use_paged_map(const char *path);
+
+/**
+ * @brief Runs the client with two views side by side
+ *
+ * The second view shows another replay, or the same replay at a tick offset,
+ * and follows the main view's tick. Two ticks of one replay share the parsed
+ * replay, its tick index and the heatmap; two replays of the same map share
+ * the terrain caches. Atlas textures are always shared.
+ *
+ * @param filename Main replay, shown on the left
+ * @param compare Second view, or NULL for a single view
+ */
+int game_window_run_compare(const char *filename,
+                            const GameWindowCompare *compare);
 void game_window_handle_input(GameState *game_state, Camera2D_RTS *camera);
-void game_window_render_frame(const GameState *game_state,
-                              const Camera2D_RTS *camera);
+void game_window_handle_compare_input(GameState *views);
+void game_window_render_frame(const GameState *views,
+                              const Camera2D_RTS *cameras, int view_count);
 void game_window_toggle_fullscreen(void);
 void game_window_load_tick(GameState *game_state, int tick);
 
@@ -0,0 +1,216 @@
+#include "heatmap_overlay.h"
+#include "../utils/job_system.h"
+#include "../utils/mem_track.h"
+#include "../utils/trace.h"
+#include "renderer.h"
+#include <math.h>
+#include <stdlib.h>
+
+// Maps larger than this are reduced, each texel showing the hottest of the
+// cells it covers
+#define HEATMAP_OVERLAY_MAX_SIZE 2048
+// Texel rows coloured by one job
+#define HEATMAP_OVERLAY_GRAIN_ROWS 16
+// Counts below this are coloured from a table built once per bake
+#define HEATMAP_OVERLAY_LUT_SIZE 4096
+
+// Cold-to-hot ramp; counts are log-scaled so sparse traffic stays visible
+// next to hot spots
+static const Color HEATMAP_RAMP[] = {
+    {0, 0, 255, 0}, {0, 255, 255, 0}, {0, 255, 0, 0},
+    {255, 255, 0, 0}, {255, 0, 0, 0}};
+#define HEATMAP_RAMP_STOPS (int)(sizeof(HEATMAP_RAMP) / sizeof(HEATMAP_RAMP[0]))
+
+// Inputs of a bake, read by its jobs
+typedef struct {
+  const unsigned int *counts;
+  int map_width;
+  int map_height;
+  int width; // Texture size
+  int height;
+  float log_max;
+  Color *pixels;
+  Color lut[HEATMAP_OVERLAY_LUT_SIZE];
+} HeatmapOverlayBake;
+
+typedef struct {
+  Texture2D texture;
+  Color *pixels; // Staging for texture updates, texture-sized
+  // What the texture shows
+  const Heatmap *heatmap;
+  unsigned long version;
+  int layer;
+  // What the running bake will show
+  const Heatmap *bake_heatmap;
+  unsigned long bake_version;
+  int bake_layer;
+  bool baking;
+  JobCounter bake_jobs;
+  HeatmapOverlayBake bake;
+} HeatmapOverlayCache;
+
+static HeatmapOverlayCache g_heatmap_overlay = {.layer = -1};
+
+// Colour at t in [0, 1] along the log scale
+static Color heatmap_overlay_ramp(float t) {
+  float position = t * (HEATMAP_RAMP_STOPS - 1);
+  int stop = (int)position;
+  if (stop >= HEATMAP_RAMP_STOPS - 1)
+    stop = HEATMAP_RAMP_STOPS - 2;
+  float blend = position - stop;
+
+  Color a = HEATMAP_RAMP[stop];
+  Color b = HEATMAP_RAMP[stop + 1];
+  return (Color){(unsigned char)(a.r + (b.r - a.r) * blend),
+                 (unsigned char)(a.g + (b.g - a.g) * blend),
+                 (unsigned char)(a.b + (b.b - a.b) * blend),
+                 (unsigned char)(70 + 150 * t)};
+}
+
+static Color heatmap_overlay_color(const HeatmapOverlayBake *bake,
+                                   unsigned int count) {
+  if (count == 0 || bake->log_max <= 0.0f)
+    return BLANK;
+  if (count < HEATMAP_OVERLAY_LUT_SIZE)
+    return bake->lut[count];
+  return heatmap_overlay_ramp(logf(1.0f + count) / bake->log_max);
+}
+
+static void heatmap_overlay_bake_rows(void *arg, int begin, int end) {
+  const HeatmapOverlayBake *bake = (const HeatmapOverlayBake *)arg;
+  int map_width = bake->map_width;
+
+  TRACE_ZONE_BEGIN(zone, "heatmap_overlay_bake");
+  for (int py = begin; py < end; py++) {
+    int first_y = (int)((long)py * bake->map_height / bake->height);
+    int end_y = (int)((long)(py + 1) * bake->map_height / bake->height);
+    for (int px = 0; px < bake->width; px++) {
+      int first_x = (int)((long)px * map_width / bake->width);
+      int end_x = (int)((long)(px + 1) * map_width / bake->width);
+      unsigned int hottest = 0;
+      for (int y = first_y; y < end_y; y++) {
+        const unsigned int *row = &bake->counts[(size_t)y * map_width];
+        for (int x = first_x; x < end_x; x++)
+          hottest = row[x] > hottest ? row[x] : hottest;
+      }
+      bake->pixels[(size_t)py * bake->width + px] =
+          heatmap_overlay_color(bake, hottest);
+    }
+  }
+  TRACE_ZONE_END(zone);
+}
+
+static void heatmap_overlay_release(void) {
+  Texture2D texture = g_heatmap_overlay.texture;
+  if (texture.id > 0) {
+    mem_track_texture_unloaded(texture.width, texture.height,
+                               MEM_TRACK_TEXTURE_BPP);
+    UnloadTexture(texture);
+  }
+  g_heatmap_overlay.texture = (Texture2D){0};
+  mem_track_free(g_heatmap_overlay.pixels);
+  g_heatmap_overlay.pixels = NULL;
+}
+
+// Creates the texture and its staging pixels, or keeps them if the size
+// still matches
+static bool heatmap_overlay_reserve(int width, int height) {
+  Texture2D texture = g_heatmap_overlay.texture;
+  if (texture.id > 0 && texture.width == width && texture.height == height)
+    return true;
+
+  heatmap_overlay_release();
+  g_heatmap_overlay.heatmap = NULL;
+  g_heatmap_overlay.pixels = (Color *)mem_track_malloc(
+      MEM_SUBSYSTEM_CACHES, (size_t)width * height * sizeof(Color));
+  if (!g_heatmap_overlay.pixels)
+    return false;
+  Image image = GenImageColor(width, height, BLANK);
+  g_heatmap_overlay.texture = LoadTextureFromImage(image);
+  UnloadImage(image);
+  if (g_heatmap_overlay.texture.id == 0)
+    return false;
+  mem_track_texture_loaded(width, height, MEM_TRACK_TEXTURE_BPP);
+  SetTextureFilter(g_heatmap_overlay.texture, TEXTURE_FILTER_BILINEAR);
+  return true;
+}
+
+// Colours a layer into the staging pixels in jobs; the counts stay still
+// until they finish, as the heatmap holds its next batch back
+static void heatmap_overlay_start_bake(Heatmap *heatmap, int layer) {
+  int map_width = heatmap_width(heatmap);
+  int map_height = heatmap_height(heatmap);
+  int width = map_width < HEATMAP_OVERLAY_MAX_SIZE ? map_width
+                                                   : HEATMAP_OVERLAY_MAX_SIZE;
+  int height = map_height < HEATMAP_OVERLAY_MAX_SIZE
+                   ? map_height
+                   : HEATMAP_OVERLAY_MAX_SIZE;
+  if (width <= 0 || height <= 0 || !heatmap_overlay_reserve(width, height))
+    return;
+
+  HeatmapOverlayBake *bake = &g_heatmap_overlay.bake;
+  unsigned int max = heatmap_layer_max(heatmap, layer);
+  bake->counts = heatmap_layer(heatmap, layer);
+  bake->map_width = map_width;
+  bake->map_height = map_height;
+  bake->width = width;
+  bake->height = height;
+  bake->log_max = logf(1.0f + max);
+  bake->pixels = g_heatmap_overlay.pixels;
+  int lut_size = max < HEATMAP_OVERLAY_LUT_SIZE ? (int)max + 1
+                                                : HEATMAP_OVERLAY_LUT_SIZE;
+  for (int count = 1; count < lut_size; count++)
+    bake->lut[count] = heatmap_overlay_ramp(logf(1.0f + count) / bake->log_max);
+
+  g_heatmap_overlay.bake_heatmap = heatmap;
+  g_heatmap_overlay.bake_version = heatmap_version(heatmap);
+  g_heatmap_overlay.bake_layer = layer;
+  g_heatmap_overlay.baking = true;
+  job_parallel_for(height, HEATMAP_OVERLAY_GRAIN_ROWS,
+                   heatmap_overlay_bake_rows, bake,
+                   &g_heatmap_overlay.bake_jobs);
+  heatmap_set_reader(heatmap, &g_heatmap_overlay.bake_jobs);
+}
+
+void heatmap_overlay_draw(Heatmap *heatmap, int layer,
+                          const Camera2D_RTS *camera) {
+  if (!heatmap || heatmap_ticks_covered(heatmap) == 0)
+    return;
+
+  // Only the upload of a finished bake runs on this thread
+  HeatmapOverlayCache *cache = &g_heatmap_overlay;
+  if (cache->baking && job_counter_done(&cache->bake_jobs)) {
+    UpdateTexture(cache->texture, cache->pixels);
+    cache->heatmap = cache->bake_heatmap;
+    cache->version = cache->bake_version;
+    cache->layer = cache->bake_layer;
+    cache->baking = false;
+  }
+
+  // Counts can only be read between batches; a new layer is shown once
+  // the running batch is merged and the layer baked
+  if ((cache->heatmap != heatmap ||
+       cache->version != heatmap_version(heatmap) ||
+       cache->layer != layer) &&
+      !cache->baking && !heatmap_is_busy(heatmap))
+    heatmap_overlay_start_bake(heatmap, layer);
+  if (cache->texture.id == 0 || cache->heatmap != heatmap ||
+      cache->layer != layer)
+    return;
+
+  Vector2 top_left = camera_world_to_screen(camera, (Vector2){0, 0});
+  Rectangle source = {0, 0, cache->texture.width, cache->texture.height};
+  Rectangle dest = {top_left.x, top_left.y,
+                    heatmap_width(heatmap) * camera->scale,
+                    heatmap_height(heatmap) * camera->scale};
+
+  renderer_track_texture(cache->texture.id);
+  DrawTexturePro(cache->texture, source, dest, (Vector2){0, 0}, 0.0f,
+                 WHITE);
+}
+
+void heatmap_overlay_cleanup(void) {
+  job_wait(&g_heatmap_overlay.bake_jobs);
+  heatmap_overlay_release();
+  g_heatmap_overlay = (HeatmapOverlayCache){.layer = -1};
+}
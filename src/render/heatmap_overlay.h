@@ -0,0 +1,29 @@
+#ifndef HEATMAP_OVERLAY_H
+#define HEATMAP_OVERLAY_H
+
+#include "../client/heatmap.h"
+#include "camera.h"
+
+/**
+ * @brief Draws a heatmap layer over the world, above the terrain
+ *
+ * The layer is colour-mapped into a texture only when the heatmap or the
+ * selected layer changes, by jobs that the heatmap waits for before its
+ * next batch; this thread only uploads the result. Maps larger than the
+ * texture are reduced by taking the hottest cell under each texel, so
+ * isolated hot spots stay visible. Drawing is a single textured quad.
+ *
+ * @param heatmap Accumulated occupancy
+ * @param layer HEATMAP_LAYER_ALL or an owner number
+ * @param camera Active camera
+ */
+void heatmap_overlay_draw(Heatmap *heatmap, int layer,
+                          const Camera2D_RTS *camera);
+
+/**
+ * @brief Waits for a running bake and releases the overlay texture
+ *        (requires a live GL context)
+ */
+void heatmap_overlay_cleanup(void);
+
+#endif
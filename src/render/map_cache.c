@@ -0,0 +1,288 @@
+#include "map_cache.h"
+#include "../map/paged_map.h"
+#include "../utils/chunk_table.h"
+#include "../utils/math_utils.h"
+#include "../utils/mem_track.h"
+#include "../utils/trace.h"
+#include "renderer.h"
+#include <math.h>
+#include <stdlib.h>
+
+// Bakes allowed per frame before falling back to per-tile drawing, so a fast
+// pan across unbaked terrain spreads its cost over several frames
+#define MAP_CACHE_MAX_BAKES_PER_FRAME 4
+
+typedef struct {
+  RenderTexture2D target;
+  int chunk_x;
+  int chunk_y;
+  unsigned long last_used;
+  bool in_use;
+  bool dirty;
+} MapChunk;
+
+typedef struct {
+  MapChunk *chunks;
+  int budget;
+  ChunkTable lookup; // chunk index -> slot; sized by the budget, not the map
+  bool bound;
+  int chunks_x;
+  int chunks_y;
+  const Tile *tiles; // map the lookup table was built for
+  const PagedMap *paged;
+  int map_width;
+  int map_height;
+  unsigned long frame;
+  const RenderTexture2D *frame_target; // Rebound after baking, NULL = screen
+} MapCache;
+
+static MapCache g_map_cache = {0};
+
+void map_cache_init(int budget_chunks) {
+  map_cache_cleanup();
+  if (budget_chunks <= 0)
+    return;
+
+  g_map_cache.chunks = (MapChunk *)mem_track_calloc(
+      MEM_SUBSYSTEM_CACHES, budget_chunks, sizeof(MapChunk));
+  if (!g_map_cache.chunks)
+    return;
+  if (!chunk_table_init(&g_map_cache.lookup, budget_chunks,
+                        MEM_SUBSYSTEM_CACHES)) {
+    map_cache_cleanup();
+    return;
+  }
+  g_map_cache.budget = budget_chunks;
+}
+
+void map_cache_cleanup(void) {
+  for (int i = 0; i < g_map_cache.budget; i++) {
+    RenderTexture2D target = g_map_cache.chunks[i].target;
+    if (target.id > 0) {
+      mem_track_texture_unloaded(target.texture.width, target.texture.height,
+                                 MEM_TRACK_RENDER_TEXTURE_BPP);
+      UnloadRenderTexture(target);
+    }
+  }
+  mem_track_free(g_map_cache.chunks);
+  chunk_table_free(&g_map_cache.lookup);
+  g_map_cache = (MapCache){0};
+}
+
+// Rebuilds the lookup table when a different map is drawn; slots keep their
+// textures so they can be reused for the new map's chunks
+static void map_cache_bind(const TileMap *map) {
+  if (g_map_cache.bound && g_map_cache.tiles == map->tiles &&
+      g_map_cache.paged == map->paged &&
+      g_map_cache.map_width == map->width &&
+      g_map_cache.map_height == map->height)
+    return;
+
+  g_map_cache.chunks_x =
+      (map->width + MAP_CACHE_CHUNK_TILES - 1) / MAP_CACHE_CHUNK_TILES;
+  g_map_cache.chunks_y =
+      (map->height + MAP_CACHE_CHUNK_TILES - 1) / MAP_CACHE_CHUNK_TILES;
+  chunk_table_clear(&g_map_cache.lookup);
+  for (int i = 0; i < g_map_cache.budget; i++)
+    g_map_cache.chunks[i].in_use = false;
+
+  g_map_cache.bound = true;
+  g_map_cache.tiles = map->tiles;
+  g_map_cache.paged = map->paged;
+  g_map_cache.map_width = map->width;
+  g_map_cache.map_height = map->height;
+}
+
+static int64_t map_cache_chunk_index(int chunk_x, int chunk_y) {
+  return (int64_t)chunk_y * g_map_cache.chunks_x + chunk_x;
+}
+
+// Picks a free slot, or the least recently used one not drawn this frame
+static int map_cache_acquire_slot(void) {
+  int victim = -1;
+  for (int i = 0; i < g_map_cache.budget; i++) {
+    MapChunk *chunk = &g_map_cache.chunks[i];
+    if (!chunk->in_use)
+      return i;
+    if (chunk->last_used == g_map_cache.frame)
+      continue;
+    if (victim < 0 || chunk->last_used < g_map_cache.chunks[victim].last_used)
+      victim = i;
+  }
+
+  if (victim >= 0) {
+    MapChunk *chunk = &g_map_cache.chunks[victim];
+    chunk_table_remove(&g_map_cache.lookup,
+                       map_cache_chunk_index(chunk->chunk_x, chunk->chunk_y));
+    chunk->in_use = false;
+  }
+  return victim;
+}
+
+static bool map_cache_bake(MapChunk *chunk, const TileMap *map) {
+  int tile_w = g_world_atlas.tile_width;
+  int tile_h = g_world_atlas.tile_height;
+
+  if (chunk->target.id == 0) {
+    chunk->target = LoadRenderTexture(MAP_CACHE_CHUNK_TILES * tile_w,
+                                      MAP_CACHE_CHUNK_TILES * tile_h);
+    if (chunk->target.id == 0)
+      return false;
+    mem_track_texture_loaded(chunk->target.texture.width,
+                             chunk->target.texture.height,
+                             MEM_TRACK_RENDER_TEXTURE_BPP);
+  }
+
+  int start_x = chunk->chunk_x * MAP_CACHE_CHUNK_TILES;
+  int start_y = chunk->chunk_y * MAP_CACHE_CHUNK_TILES;
+  int end_x = (int)fmin(map->width, start_x + MAP_CACHE_CHUNK_TILES);
+  int end_y = (int)fmin(map->height, start_y + MAP_CACHE_CHUNK_TILES);
+
+  TRACE_ZONE_BEGIN(zone, "map_cache_bake");
+  // Switching render targets submits whatever is batched so far
+  renderer_track_flush(0);
+  BeginTextureMode(chunk->target);
+  ClearBackground(BLANK);
+  for (int y = start_y; y < end_y; y++) {
+    for (int x = start_x; x < end_x; x++) {
+      Rectangle dest_rect = {(x - start_x) * tile_w, (y - start_y) * tile_h,
+                             tile_w, tile_h};
+      renderer_draw_tile_textured(map_get_tile(map, x, y), dest_rect);
+    }
+  }
+  EndTextureMode();
+  if (g_map_cache.frame_target)
+    BeginTextureMode(*g_map_cache.frame_target);
+  renderer_track_flush(0);
+  TRACE_ZONE_END(zone);
+
+  chunk->dirty = false;
+  return true;
+}
+
+static void map_cache_draw_chunk(const MapChunk *chunk, const TileMap *map,
+                                 const Camera2D_RTS *camera) {
+  int start_x = chunk->chunk_x * MAP_CACHE_CHUNK_TILES;
+  int start_y = chunk->chunk_y * MAP_CACHE_CHUNK_TILES;
+  int tiles_w = (int)fmin(MAP_CACHE_CHUNK_TILES, map->width - start_x);
+  int tiles_h = (int)fmin(MAP_CACHE_CHUNK_TILES, map->height - start_y);
+
+  // Render textures are stored bottom-up: the baked area sits at the top of
+  // the texture and is sampled with a negative height to flip it back
+  float used_w = (float)tiles_w * g_world_atlas.tile_width;
+  float used_h = (float)tiles_h * g_world_atlas.tile_height;
+  Rectangle source_rect = {0, chunk->target.texture.height - used_h, used_w,
+                           -used_h};
+
+  Vector2 top_left =
+      camera_world_to_screen(camera, (Vector2){start_x, start_y});
+  float tile_size = camera->scale;
+  Rectangle dest_rect = {top_left.x, top_left.y, tiles_w * tile_size,
+                         tiles_h * tile_size};
+
+  renderer_track_texture(chunk->target.texture.id);
+  renderer_count_chunk_drawn();
+  DrawTexturePro(chunk->target.texture, source_rect, dest_rect,
+                 (Vector2){0, 0}, 0.0f, WHITE);
+}
+
+void map_cache_draw(const TileMap *map, const Camera2D_RTS *camera) {
+  int start_x, start_y, end_x, end_y;
+  renderer_calculate_visible_tile_range(camera, map, &start_x, &start_y, &end_x,
+                                        &end_y);
+  if (start_x >= end_x || start_y >= end_y)
+    return;
+
+  // Paged tiles are read below, by baking or per-tile drawing
+  if (map->paged)
+    paged_map_prefetch(map->paged, start_x, start_y, end_x, end_y);
+
+  if (g_map_cache.budget == 0) {
+    renderer_draw_map_region(map, camera, start_x, start_y, end_x, end_y);
+    return;
+  }
+  map_cache_bind(map);
+
+  g_map_cache.frame++;
+  int bakes_left = MAP_CACHE_MAX_BAKES_PER_FRAME;
+
+  int first_cx = start_x / MAP_CACHE_CHUNK_TILES;
+  int first_cy = start_y / MAP_CACHE_CHUNK_TILES;
+  int last_cx = (end_x - 1) / MAP_CACHE_CHUNK_TILES;
+  int last_cy = (end_y - 1) / MAP_CACHE_CHUNK_TILES;
+
+  for (int cy = first_cy; cy <= last_cy; cy++) {
+    for (int cx = first_cx; cx <= last_cx; cx++) {
+      int64_t index = map_cache_chunk_index(cx, cy);
+      int slot = chunk_table_find(&g_map_cache.lookup, index);
+
+      if (slot < 0 && bakes_left > 0) {
+        slot = map_cache_acquire_slot();
+        if (slot >= 0) {
+          MapChunk *chunk = &g_map_cache.chunks[slot];
+          chunk->chunk_x = cx;
+          chunk->chunk_y = cy;
+          chunk->in_use = true;
+          chunk->dirty = true;
+          chunk_table_insert(&g_map_cache.lookup, index, slot);
+        }
+      }
+
+      MapChunk *chunk = slot >= 0 ? &g_map_cache.chunks[slot] : NULL;
+      if (chunk && chunk->dirty) {
+        if (bakes_left > 0 && map_cache_bake(chunk, map))
+          bakes_left--;
+        else
+          chunk = NULL;
+      }
+
+      if (chunk) {
+        chunk->last_used = g_map_cache.frame;
+        map_cache_draw_chunk(chunk, map, camera);
+        continue;
+      }
+
+      // Not resident (budget exhausted or bake deferred): draw the visible
+      // part of this chunk the slow way for this frame
+      int chunk_x0 = cx * MAP_CACHE_CHUNK_TILES;
+      int chunk_y0 = cy * MAP_CACHE_CHUNK_TILES;
+      renderer_draw_map_region(
+          map, camera, (int)fmax(start_x, chunk_x0),
+          (int)fmax(start_y, chunk_y0),
+          (int)fmin(end_x, chunk_x0 + MAP_CACHE_CHUNK_TILES),
+          (int)fmin(end_y, chunk_y0 + MAP_CACHE_CHUNK_TILES));
+    }
+  }
+}
+
+void map_cache_set_frame_target(const RenderTexture2D *target) {
+  g_map_cache.frame_target = target;
+}
+
+void map_cache_invalidate_region(int x, int y, int width, int height) {
+  if (!g_map_cache.bound || width <= 0 || height <= 0)
+    return;
+
+  int first_cx = (int)fmax(0, x / MAP_CACHE_CHUNK_TILES);
+  int first_cy = (int)fmax(0, y / MAP_CACHE_CHUNK_TILES);
+  int last_cx = (int)fmin(g_map_cache.chunks_x - 1,
+                          (x + width - 1) / MAP_CACHE_CHUNK_TILES);
+  int last_cy = (int)fmin(g_map_cache.chunks_y - 1,
+                          (y + height - 1) / MAP_CACHE_CHUNK_TILES);
+
+  for (int cy = first_cy; cy <= last_cy; cy++) {
+    for (int cx = first_cx; cx <= last_cx; cx++) {
+      int slot = chunk_table_find(&g_map_cache.lookup,
+                                  map_cache_chunk_index(cx, cy));
+      if (slot >= 0)
+        g_map_cache.chunks[slot].dirty = true;
+    }
+  }
+}
+
+void map_cache_invalidate_all(void) {
+  for (int i = 0; i < g_map_cache.budget; i++) {
+    if (g_map_cache.chunks[i].in_use)
+      g_map_cache.chunks[i].dirty = true;
+  }
+}
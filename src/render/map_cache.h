@@ -0,0 +1,70 @@
+#ifndef MAP_CACHE_H
+#define MAP_CACHE_H
+
+#include "../map/map.h"
+#include "camera.h"
+#include "raylib.h"
+
+/**
+ * @brief Chunked render-texture cache for the static tile map
+ *
+ * The map is pre-rendered into square chunks of MAP_CACHE_CHUNK_TILES tiles,
+ * each baked once into its own render texture at atlas resolution. Visible
+ * chunks are then drawn as single quads, so terrain cost per frame scales
+ * with the number of visible chunks rather than visible tiles. Resident
+ * chunks are bounded by a budget and evicted least-recently-used.
+ */
+
+#define MAP_CACHE_CHUNK_TILES 32
+#define MAP_CACHE_DEFAULT_BUDGET 64
+
+/**
+ * @brief Allocates the chunk slots; textures are created lazily on first bake
+ *
+ * @param budget_chunks Maximum number of chunk textures kept resident
+ */
+void map_cache_init(int budget_chunks);
+
+/**
+ * @brief Releases every chunk texture (requires a live GL context)
+ */
+void map_cache_cleanup(void);
+
+/**
+ * @brief Marks resident chunks overlapping a tile rectangle for re-baking
+ *
+ * @param x First tile column
+ * @param y First tile row
+ * @param width Width of the region in tiles
+ * @param height Height of the region in tiles
+ */
+void map_cache_invalidate_region(int x, int y, int width, int height);
+
+/**
+ * @brief Marks every resident chunk for re-baking
+ */
+void map_cache_invalidate_all(void);
+
+/**
+ * @brief Draws the visible part of the map from cached chunks
+ *
+ * Chunks that are not resident are baked on demand, up to a small per-frame
+ * limit; anything left over is drawn tile by tile for that frame.
+ *
+ * @param map Tile map to draw
+ * @param camera Active camera
+ */
+void map_cache_draw(const TileMap *map, const Camera2D_RTS *camera);
+
+/**
+ * @brief Sets the render target the frame is being drawn into
+ *
+ * Baking a chunk binds the chunk's own render texture. When the map is drawn
+ * into an offscreen target rather than the window, pass it here so drawing
+ * resumes there after a bake.
+ *
+ * @param target Offscreen target, or NULL when drawing to the window
+ */
+void map_cache_set_frame_target(const RenderTexture2D *target);
+
+#endif
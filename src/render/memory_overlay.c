@@ -0,0 +1,71 @@
+#include "memory_overlay.h"
+#include "../utils/mem_track.h"
+#include "../utils/profiler.h"
+#include "raylib.h"
+#include <stdio.h>
+
+#define OVERLAY_WIDTH 330
+#define OVERLAY_LINE_HEIGHT 14
+#define OVERLAY_FONT_SIZE 10
+
+static const Color OVERLAY_BACKGROUND = {0, 0, 0, 200};
+
+static void memory_overlay_format_bytes(char *buffer, size_t size,
+                                        size_t bytes) {
+  if (bytes >= 1024 * 1024)
+    snprintf(buffer, size, "%.1f MB", bytes / (1024.0 * 1024.0));
+  else
+    snprintf(buffer, size, "%.1f KB", bytes / 1024.0);
+}
+
+void memory_overlay_draw(int x, int y) {
+  int lines = 2 + MEM_SUBSYSTEM_COUNT + 2;
+  int height = 6 + lines * OVERLAY_LINE_HEIGHT + 4;
+  DrawRectangle(x, y, OVERLAY_WIDTH, height, OVERLAY_BACKGROUND);
+  DrawRectangleLines(x, y, OVERLAY_WIDTH, height, GRAY);
+
+  int text_x = x + 8;
+  int line_y = y + 6;
+  size_t heap_bytes = 0;
+  for (int s = 0; s < MEM_SUBSYSTEM_COUNT; s++) {
+    MemSubsystemStats stats;
+    mem_track_stats((MemSubsystem)s, &stats);
+    if (s != MEM_SUBSYSTEM_TEXTURES)
+      heap_bytes += stats.bytes;
+  }
+  char total[32];
+  memory_overlay_format_bytes(total, sizeof(total), heap_bytes);
+  DrawText(TextFormat("Memory  heap %s tracked", total), text_x, line_y,
+           OVERLAY_FONT_SIZE, RAYWHITE);
+  line_y += OVERLAY_LINE_HEIGHT;
+  DrawText("subsystem         live        peak    blocks    allocs", text_x,
+           line_y, OVERLAY_FONT_SIZE, GRAY);
+  line_y += OVERLAY_LINE_HEIGHT;
+
+  for (int s = 0; s < MEM_SUBSYSTEM_COUNT; s++) {
+    MemSubsystemStats stats;
+    mem_track_stats((MemSubsystem)s, &stats);
+    char live[32];
+    char peak[32];
+    memory_overlay_format_bytes(live, sizeof(live), stats.bytes);
+    memory_overlay_format_bytes(peak, sizeof(peak), stats.peak_bytes);
+
+    DrawText(mem_track_subsystem_name((MemSubsystem)s), text_x, line_y,
+             OVERLAY_FONT_SIZE, LIGHTGRAY);
+    DrawText(TextFormat("%10s  %10s  %8lu  %8lu", live, peak,
+                        stats.live_allocations, stats.total_allocations),
+             text_x + 70, line_y, OVERLAY_FONT_SIZE, RAYWHITE);
+    line_y += OVERLAY_LINE_HEIGHT;
+  }
+
+  const ProfilerFrame *last = profiler_history_frame(0);
+  int frame_allocations =
+      last ? last->counters[PROFILER_COUNTER_ALLOCATIONS] : 0;
+  DrawText(TextFormat("render thread allocations last frame: %d",
+                      frame_allocations),
+           text_x, line_y + 2, OVERLAY_FONT_SIZE,
+           frame_allocations > 0 ? ORANGE : RAYWHITE);
+  line_y += OVERLAY_LINE_HEIGHT;
+  DrawText("textures are estimated GPU memory; F9: hide", text_x, line_y + 2,
+           OVERLAY_FONT_SIZE, GRAY);
+}
@@ -0,0 +1,16 @@
+#ifndef MEMORY_OVERLAY_H
+#define MEMORY_OVERLAY_H
+
+/**
+ * @brief Draws the per-subsystem memory readout
+ *
+ * Lists live and peak bytes, live blocks and total allocations for every
+ * tracked subsystem, GPU textures included, followed by the heap
+ * allocations the render thread made in the last frame.
+ *
+ * @param x Left edge of the readout
+ * @param y Top edge of the readout
+ */
+void memory_overlay_draw(int x, int y);
+
+#endif
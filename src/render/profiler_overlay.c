@@ -0,0 +1,94 @@
+#include "profiler_overlay.h"
+#include "../utils/profiler.h"
+#include "raylib.h"
+
+#define OVERLAY_WIDTH 300
+#define OVERLAY_LINE_HEIGHT 14
+#define OVERLAY_FONT_SIZE 10
+#define OVERLAY_GRAPH_HEIGHT 60
+// Frame time at the top of the graph
+#define OVERLAY_GRAPH_MAX_MS 50.0
+
+static const Color OVERLAY_BACKGROUND = {0, 0, 0, 200};
+static const Color OVERLAY_BUDGET_COLOR = {0, 228, 48, 160};
+
+void profiler_overlay_draw(int x, int y) {
+  int lines = 2 + PROFILER_STAGE_COUNT + PROFILER_COUNTER_COUNT;
+  int height = 6 + lines * OVERLAY_LINE_HEIGHT + 6 + OVERLAY_GRAPH_HEIGHT + 4 +
+               OVERLAY_LINE_HEIGHT;
+  DrawRectangle(x, y, OVERLAY_WIDTH, height, OVERLAY_BACKGROUND);
+  DrawRectangleLines(x, y, OVERLAY_WIDTH, height, GRAY);
+
+  const ProfilerFrame *last = profiler_history_frame(0);
+  int text_x = x + 8;
+  int line_y = y + 6;
+
+  double p50 = profiler_frame_percentile(50.0);
+  double p99 = profiler_frame_percentile(99.0);
+  DrawText(TextFormat("Frame %.2f ms  p50 %.2f  p99 %.2f",
+                      last ? last->frame_ms : 0.0, p50, p99),
+           text_x, line_y, OVERLAY_FONT_SIZE, RAYWHITE);
+  line_y += OVERLAY_LINE_HEIGHT;
+  DrawText("stage            last ms    avg ms", text_x, line_y,
+           OVERLAY_FONT_SIZE, GRAY);
+  line_y += OVERLAY_LINE_HEIGHT;
+
+  for (int s = 0; s < PROFILER_STAGE_COUNT; s++) {
+    DrawText(profiler_stage_name((ProfilerStage)s), text_x, line_y,
+             OVERLAY_FONT_SIZE, LIGHTGRAY);
+    DrawText(TextFormat("%8.3f", last ? last->stage_ms[s] : 0.0), text_x + 110,
+             line_y, OVERLAY_FONT_SIZE, RAYWHITE);
+    DrawText(TextFormat("%8.3f", profiler_stage_average((ProfilerStage)s)),
+             text_x + 180, line_y, OVERLAY_FONT_SIZE, RAYWHITE);
+    line_y += OVERLAY_LINE_HEIGHT;
+  }
+
+  for (int c = 0; c < PROFILER_COUNTER_COUNT; c++) {
+    DrawText(profiler_counter_name((ProfilerCounter)c), text_x, line_y,
+             OVERLAY_FONT_SIZE, LIGHTGRAY);
+    DrawText(TextFormat("%8d", last ? last->counters[c] : 0), text_x + 110,
+             line_y, OVERLAY_FONT_SIZE, RAYWHITE);
+    line_y += OVERLAY_LINE_HEIGHT;
+  }
+
+  // Rolling frame-time graph, newest frame on the right
+  int graph_x = x + 8;
+  int graph_y = line_y + 6;
+  int graph_w = OVERLAY_WIDTH - 16;
+  DrawRectangleLines(graph_x, graph_y, graph_w, OVERLAY_GRAPH_HEIGHT,
+                     DARKGRAY);
+
+  float bar_w = (float)graph_w / PROFILER_HISTORY_FRAMES;
+  int count = profiler_history_count();
+  for (int age = 0; age < count; age++) {
+    double ms = profiler_history_frame(age)->frame_ms;
+    float h = (float)(ms / OVERLAY_GRAPH_MAX_MS) * OVERLAY_GRAPH_HEIGHT;
+    if (h > OVERLAY_GRAPH_HEIGHT)
+      h = OVERLAY_GRAPH_HEIGHT;
+    Color color = ms > 1000.0 / 30.0   ? RED
+                  : ms > 1000.0 / 60.0 ? ORANGE
+                                       : SKYBLUE;
+    DrawRectangleRec((Rectangle){graph_x + graph_w - (age + 1) * bar_w,
+                                 graph_y + OVERLAY_GRAPH_HEIGHT - h, bar_w, h},
+                     color);
+  }
+
+  // 60 FPS budget line and percentile markers
+  float budget_y = graph_y + OVERLAY_GRAPH_HEIGHT -
+                   (float)(1000.0 / 60.0 / OVERLAY_GRAPH_MAX_MS) *
+                       OVERLAY_GRAPH_HEIGHT;
+  DrawLine(graph_x, (int)budget_y, graph_x + graph_w, (int)budget_y,
+           OVERLAY_BUDGET_COLOR);
+  double markers[2] = {p50, p99};
+  for (int m = 0; m < 2; m++) {
+    double ms = markers[m] < OVERLAY_GRAPH_MAX_MS ? markers[m]
+                                                  : OVERLAY_GRAPH_MAX_MS;
+    int marker_y =
+        graph_y + OVERLAY_GRAPH_HEIGHT -
+        (int)(ms / OVERLAY_GRAPH_MAX_MS * OVERLAY_GRAPH_HEIGHT);
+    DrawLine(graph_x, marker_y, graph_x + 6, marker_y, m == 0 ? WHITE : RED);
+  }
+
+  DrawText("F3: hide  F4: dump CSV", text_x,
+           graph_y + OVERLAY_GRAPH_HEIGHT + 4, OVERLAY_FONT_SIZE, GRAY);
+}
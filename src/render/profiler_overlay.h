@@ -0,0 +1,15 @@
+#ifndef PROFILER_OVERLAY_H
+#define PROFILER_OVERLAY_H
+
+/**
+ * @brief Draws the frame profiler overlay
+ *
+ * Shows per-stage timings (last frame and history average), draw-call and
+ * entity counters, and a rolling frame-time graph with p50/p99 markers.
+ *
+ * @param x Left edge of the overlay
+ * @param y Top edge of the overlay
+ */
+void profiler_overlay_draw(int x, int y);
+
+#endif
@@ -0,0 +1,65 @@
+#include "quality_overlay.h"
+#include "../utils/quality_governor.h"
+#include "raylib.h"
+
+#define OVERLAY_WIDTH 300
+#define OVERLAY_LINE_HEIGHT 14
+#define OVERLAY_FONT_SIZE 10
+
+static const Color OVERLAY_BACKGROUND = {0, 0, 0, 200};
+
+void quality_overlay_draw(int x, int y) {
+  int lines = 5 + QUALITY_LOG_ENTRIES + 1;
+  int height = 6 + lines * OVERLAY_LINE_HEIGHT + 4;
+  DrawRectangle(x, y, OVERLAY_WIDTH, height, OVERLAY_BACKGROUND);
+  DrawRectangleLines(x, y, OVERLAY_WIDTH, height, GRAY);
+
+  int text_x = x + 8;
+  int line_y = y + 6;
+  int level = quality_governor_level();
+  const QualitySettings *settings = quality_governor_settings();
+
+  DrawText(TextFormat("Quality %d/%d  %s%s", level, QUALITY_LEVEL_COUNT - 1,
+                      quality_governor_level_name(level),
+                      quality_governor_is_enabled() ? "" : "  (governor off)"),
+           text_x, line_y, OVERLAY_FONT_SIZE,
+           level == 0 ? RAYWHITE : ORANGE);
+  line_y += OVERLAY_LINE_HEIGHT;
+  DrawText(TextFormat("scale %.0f%%  unit LOD %.0f px  trees %s  minimap 1/%d",
+                      settings->render_scale * 100.0f,
+                      settings->unit_lod_pixels,
+                      settings->draw_objects ? "on" : "off",
+                      settings->minimap_interval),
+           text_x, line_y, OVERLAY_FONT_SIZE, LIGHTGRAY);
+  line_y += OVERLAY_LINE_HEIGHT;
+
+  double target = quality_governor_target_ms();
+  double frame = quality_governor_frame_ms();
+  DrawText(TextFormat("frame %.2f ms  work %.2f ms  budget %.2f ms", frame,
+                      quality_governor_work_ms(), target),
+           text_x, line_y, OVERLAY_FONT_SIZE,
+           frame > target * 1.1 ? RED : RAYWHITE);
+  line_y += OVERLAY_LINE_HEIGHT;
+  DrawText(TextFormat("upgrade after %d / %d calm frames",
+                      quality_governor_upgrade_progress(),
+                      quality_governor_upgrade_hold()),
+           text_x, line_y, OVERLAY_FONT_SIZE, LIGHTGRAY);
+  line_y += OVERLAY_LINE_HEIGHT;
+
+  DrawText("frame    level   reason", text_x, line_y, OVERLAY_FONT_SIZE, GRAY);
+  line_y += OVERLAY_LINE_HEIGHT;
+  for (int age = 0; age < QUALITY_LOG_ENTRIES; age++) {
+    const QualityDecision *decision = quality_governor_decision(age);
+    if (decision) {
+      DrawText(TextFormat("%6ld   %d -> %d   %s", decision->frame,
+                          decision->from_level, decision->to_level,
+                          decision->reason),
+               text_x, line_y, OVERLAY_FONT_SIZE,
+               decision->to_level > decision->from_level ? ORANGE : SKYBLUE);
+    }
+    line_y += OVERLAY_LINE_HEIGHT;
+  }
+
+  DrawText("F7: hide  F8: toggle governor", text_x, line_y + 2,
+           OVERLAY_FONT_SIZE, GRAY);
+}
@@ -0,0 +1,16 @@
+#ifndef QUALITY_OVERLAY_H
+#define QUALITY_OVERLAY_H
+
+/**
+ * @brief Draws the quality governor readout
+ *
+ * Shows the active level and its settings, the smoothed frame and work
+ * times against the budget, progress towards the next upgrade, and the most
+ * recent level changes with the reason for each.
+ *
+ * @param x Left edge of the readout
+ * @param y Top edge of the readout
+ */
+void quality_overlay_draw(int x, int y);
+
+#endif
@@ -1,60 +1,158 @@
 #include "renderer.h"
 #include "../map/map.h"
 #include "../utils/math_utils.h"
+#include "../utils/mem_track.h"
+#include "../utils/trace.h"
+#include "map_cache.h"
 #include "sim_loader.h"
+#include "sprite_batch.h"
+#include "texture_atlas.h"
 #include <math.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 
-TileAtlas g_tile_atlas = {0};
-Texture2D g_unit_texture = {0};
-Texture2D g_tree_texture = {0};
+WorldAtlas g_world_atlas = {0};
 
-void renderer_init_tile_atlas(const char *texture_path, int tile_width,
-                              int tile_height, int gap) {
-  g_tile_atlas.texture = LoadTexture(texture_path);
-  g_tile_atlas.tile_width = tile_width;
-  g_tile_atlas.tile_height = tile_height;
-  g_tile_atlas.gap = gap;
+static RendererFrameStats g_frame_stats = {0};
+static unsigned int g_last_texture_id = 0;
+static SpriteBatch g_world_batch = {0};
 
-  // Calculate columns and rows based on texture dimensions
-  g_tile_atlas.columns = g_tile_atlas.texture.width / (tile_width + gap);
-  g_tile_atlas.rows = (g_tile_atlas.texture.height + gap) / (tile_height + gap);
+// Entities within this many tiles outside the viewport are still tested
+// individually, so sprites overhanging a cell border are not culled early
+#define RENDERER_CULL_MARGIN_TILES 2.0f
+
+static int *g_cull_candidates = NULL;
+static int g_cull_capacity = 0;
+static CameraVisibleEntity *g_visible = NULL;
+static int g_visible_capacity = 0;
+
+// Units smaller than this on screen skip rotation and the sprite tint
+static float g_unit_lod_pixels = 0.0f;
+
+void renderer_begin_frame(void) {
+  g_frame_stats = (RendererFrameStats){0};
+  g_last_texture_id = 0;
 }
 
-void renderer_init_unit_texture(const char *texture_path) {
-  if (g_unit_texture.id > 0) {
-    UnloadTexture(g_unit_texture);
+RendererFrameStats renderer_get_frame_stats(void) { return g_frame_stats; }
+
+void renderer_track_texture(unsigned int texture_id) {
+  // rlgl starts a new draw call whenever the bound texture changes
+  if (texture_id != g_last_texture_id) {
+    g_frame_stats.draw_calls++;
+    g_last_texture_id = texture_id;
   }
-  g_unit_texture = LoadTexture(texture_path);
 }
 
-void renderer_init_tree_texture(const char *texture_path) {
-  if (g_tree_texture.id > 0) {
-    UnloadTexture(g_tree_texture);
-  }
-  g_tree_texture = LoadTexture(texture_path);
+void renderer_track_flush(int draw_calls) {
+  g_frame_stats.draw_calls += draw_calls;
+  g_last_texture_id = 0;
 }
 
-void renderer_cleanup_tile_atlas(void) {
-  if (g_tile_atlas.texture.id > 0) {
-    UnloadTexture(g_tile_atlas.texture);
-    g_tile_atlas.texture.id = 0;
-  }
+void renderer_count_chunk_drawn(void) { g_frame_stats.chunks_drawn++; }
+
+Color renderer_owner_color(int owner) { return (owner == 1) ? RED : YELLOW; }
+
+void renderer_set_unit_lod_pixels(float pixels) { g_unit_lod_pixels = pixels; }
+
+void renderer_init_sprite_batches(void) { sprite_batch_system_init(); }
+
+void renderer_cleanup_sprite_batches(void) {
+  mem_track_free(g_cull_candidates);
+  g_cull_candidates = NULL;
+  g_cull_capacity = 0;
+  mem_track_free(g_visible);
+  g_visible = NULL;
+  g_visible_capacity = 0;
+  sprite_batch_free(&g_world_batch);
+  sprite_batch_system_cleanup();
 }
 
-void renderer_cleanup_unit_texture(void) {
-  if (g_unit_texture.id > 0) {
-    UnloadTexture(g_unit_texture);
-    g_unit_texture.id = 0;
+void renderer_init_world_atlas(const char *tiles_path, int tile_width,
+                               int tile_height, int gap, const char *unit_path,
+                               const char *tree_path) {
+  renderer_cleanup_world_atlas();
+  TRACE_ZONE_BEGIN(zone, "renderer_init_world_atlas");
+
+  Image tiles = LoadImage(tiles_path);
+  Image sprites[WORLD_SPRITE_COUNT] = {LoadImage(unit_path),
+                                       LoadImage(tree_path)};
+  ImageFormat(&tiles, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+  for (int i = 0; i < WORLD_SPRITE_COUNT; i++)
+    ImageFormat(&sprites[i], PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+
+  g_world_atlas.tile_width = tile_width;
+  g_world_atlas.tile_height = tile_height;
+  g_world_atlas.gap = gap;
+
+  // Calculate columns and rows based on the tile sheet dimensions
+  g_world_atlas.columns = (tiles.width + gap) / (tile_width + gap);
+  g_world_atlas.rows = (tiles.height + gap) / (tile_height + gap);
+
+  int tile_count = g_world_atlas.columns * g_world_atlas.rows;
+  int input_count = tile_count + WORLD_SPRITE_COUNT;
+  AtlasPackInput *inputs =
+      (AtlasPackInput *)mem_track_malloc(MEM_SUBSYSTEM_RENDERER,
+                                         input_count * sizeof(AtlasPackInput));
+  Rectangle *rects = (Rectangle *)mem_track_malloc(
+      MEM_SUBSYSTEM_RENDERER, input_count * sizeof(Rectangle));
+  if (!inputs || !rects) {
+    mem_track_free(inputs);
+    mem_track_free(rects);
+    UnloadImage(tiles);
+    for (int i = 0; i < WORLD_SPRITE_COUNT; i++)
+      UnloadImage(sprites[i]);
+    TRACE_ZONE_END(zone);
+    return;
+  }
+
+  // Tile cells first, in sheet order, then the standalone sprites
+  int count = 0;
+  for (int row = 0; row < g_world_atlas.rows; row++) {
+    for (int col = 0; col < g_world_atlas.columns; col++) {
+      inputs[count++] = (AtlasPackInput){
+          tiles, (Rectangle){col * (tile_width + gap),
+                             row * (tile_height + gap), tile_width,
+                             tile_height}};
+    }
   }
+  for (int i = 0; i < WORLD_SPRITE_COUNT; i++) {
+    g_world_atlas.has_sprite[i] = sprites[i].data != NULL;
+    inputs[count++] = (AtlasPackInput){
+        sprites[i], (Rectangle){0, 0, sprites[i].width, sprites[i].height}};
+  }
+
+  Image packed =
+      texture_atlas_pack(inputs, count, WORLD_ATLAS_PADDING, rects);
+  if (packed.data) {
+    g_world_atlas.texture = LoadTextureFromImage(packed);
+    if (g_world_atlas.texture.id > 0)
+      mem_track_texture_loaded(packed.width, packed.height,
+                               MEM_TRACK_TEXTURE_BPP);
+    UnloadImage(packed);
+  }
+
+  g_world_atlas.tile_rects = rects;
+  for (int i = 0; i < WORLD_SPRITE_COUNT; i++)
+    g_world_atlas.sprite_rects[i] = rects[tile_count + i];
+
+  mem_track_free(inputs);
+  UnloadImage(tiles);
+  for (int i = 0; i < WORLD_SPRITE_COUNT; i++)
+    UnloadImage(sprites[i]);
+  TRACE_ZONE_END(zone);
 }
 
-void renderer_cleanup_tree_texture(void) {
-  if (g_tree_texture.id > 0) {
-    UnloadTexture(g_tree_texture);
-    g_tree_texture.id = 0;
+void renderer_cleanup_world_atlas(void) {
+  if (g_world_atlas.texture.id > 0) {
+    mem_track_texture_unloaded(g_world_atlas.texture.width,
+                               g_world_atlas.texture.height,
+                               MEM_TRACK_TEXTURE_BPP);
+    UnloadTexture(g_world_atlas.texture);
   }
+  mem_track_free(g_world_atlas.tile_rects);
+  g_world_atlas = (WorldAtlas){0};
 }
 
 void renderer_draw_tile(Vector2 screen_pos, float size, Color color) {
@@ -83,162 +181,237 @@ void renderer_calculate_visible_tile_range(const Camera2D_RTS *camera,
 }
 
 Rectangle renderer_get_tile_source_rect_from_tile(const Tile *tile) {
-
   int atlas_x = tile->texture_index_x;
   int atlas_y = tile->texture_index_y;
 
-  int source_x = atlas_x * (g_tile_atlas.tile_width + g_tile_atlas.gap);
-  int source_y = atlas_y * (g_tile_atlas.tile_height + g_tile_atlas.gap);
+  if (!g_world_atlas.tile_rects || atlas_x < 0 ||
+      atlas_x >= g_world_atlas.columns || atlas_y < 0 ||
+      atlas_y >= g_world_atlas.rows)
+    return (Rectangle){0, 0, 0, 0};
 
-  return (Rectangle){source_x, source_y, g_tile_atlas.tile_width,
-                     g_tile_atlas.tile_height};
+  return g_world_atlas.tile_rects[atlas_y * g_world_atlas.columns + atlas_x];
+}
+
+void renderer_draw_tile_textured(const Tile *tile, Rectangle dest_rect) {
+  Rectangle source_rect = renderer_get_tile_source_rect_from_tile(tile);
+  renderer_track_texture(g_world_atlas.texture.id);
+  g_frame_stats.tiles_drawn++;
+  DrawTexturePro(g_world_atlas.texture, source_rect, dest_rect, (Vector2){0, 0},
+                 0.0f, WHITE);
+}
+
+void renderer_draw_map_region(const TileMap *map, const Camera2D_RTS *camera,
+                              int start_x, int start_y, int end_x, int end_y) {
+  // The tile range already comes from the viewport, so every tile in it is
+  // on screen; walk the grid in screen space instead of transforming each tile
+  float tile_size = camera->scale;
+  Vector2 origin = camera_world_to_screen(camera, (Vector2){start_x, start_y});
+
+  for (int y = start_y; y < end_y; y++) {
+    float screen_y = origin.y + (y - start_y) * tile_size;
+    for (int x = start_x; x < end_x; x++) {
+      Rectangle dest_rect = {origin.x + (x - start_x) * tile_size, screen_y,
+                             tile_size, tile_size};
+      renderer_draw_tile_textured(map_get_tile(map, x, y), dest_rect);
+    }
+  }
 }
 
 void renderer_draw_map_textured(const TileMap *map,
                                 const Camera2D_RTS *camera) {
-  if (g_tile_atlas.texture.id == 0)
+  if (g_world_atlas.texture.id == 0)
     return;
 
-  int start_x, start_y, end_x, end_y;
-  renderer_calculate_visible_tile_range(camera, map, &start_x, &start_y, &end_x,
-                                        &end_y);
+  TRACE_ZONE_BEGIN(zone, "renderer_draw_map");
+  map_cache_draw(map, camera);
+  TRACE_ZONE_END(zone);
+}
 
-  for (int y = start_y; y < end_y; y++) {
-    for (int x = start_x; x < end_x; x++) {
-      Tile *tile = &map->tiles[y * map->width + x];
-      Rectangle source_rect = renderer_get_tile_source_rect_from_tile(tile);
-
-      Vector2 screen_pos =
-          camera_world_to_screen(camera, (Vector2){x + 0.5f, y + 0.5f});
-      float tile_size = TILE_SIZE_PIXELS * camera->zoom;
-
-      if (renderer_is_position_visible(screen_pos, tile_size / 2)) {
-        // Draw the texture
-        Rectangle dest_rect = {screen_pos.x - tile_size / 2,
-                               screen_pos.y - tile_size / 2, tile_size,
-                               tile_size};
-        DrawTexturePro(g_tile_atlas.texture, source_rect, dest_rect,
-                       (Vector2){0, 0}, 0.0f, WHITE);
-      }
+// Gathers the indices of entities bucketed in grid cells that overlap the
+// viewport. Returns NULL when there is no grid (every entity is a candidate).
+static const int *renderer_collect_candidates(const SpatialGrid *grid,
+                                              const Camera2D_RTS *camera,
+                                              int *count) {
+  if (!grid || grid->count != *count)
+    return NULL;
+
+  *count = 0;
+  int first_cx, first_cy, last_cx, last_cy;
+  Rectangle view = camera->viewport;
+  if (!spatial_grid_cell_range(grid, view.x - RENDERER_CULL_MARGIN_TILES,
+                               view.y - RENDERER_CULL_MARGIN_TILES,
+                               view.width + 2 * RENDERER_CULL_MARGIN_TILES,
+                               view.height + 2 * RENDERER_CULL_MARGIN_TILES,
+                               &first_cx, &first_cy, &last_cx, &last_cy))
+    return g_cull_candidates;
+
+  for (int cy = first_cy; cy <= last_cy; cy++) {
+    // Cells of one row are contiguous in the index array
+    int row = cy * grid->cells_x;
+    int begin = grid->cell_start[row + first_cx];
+    int end = grid->cell_start[row + last_cx + 1];
+    int needed = *count + (end - begin);
+
+    if (needed > g_cull_capacity) {
+      int capacity = g_cull_capacity ? g_cull_capacity : 1024;
+      while (capacity < needed)
+        capacity *= 2;
+      int *grown = (int *)mem_track_realloc(
+          MEM_SUBSYSTEM_RENDERER, g_cull_candidates, capacity * sizeof(int));
+      if (!grown)
+        return g_cull_candidates;
+      g_cull_candidates = grown;
+      g_cull_capacity = capacity;
     }
+
+    for (int k = begin; k < end; k++)
+      g_cull_candidates[(*count)++] = grid->indices[k];
   }
+  return g_cull_candidates;
 }
+
+// Transforms and culls candidate entities, returning the visible ones
+static const CameraVisibleEntity *
+renderer_cull_visible(const void *entities, size_t stride, int count,
+                      const SpatialGrid *grid, const Camera2D_RTS *camera,
+                      int *visible_count) {
+  const int *candidates = renderer_collect_candidates(grid, camera, &count);
+  *visible_count = 0;
+
+  if (count > g_visible_capacity) {
+    int capacity = g_visible_capacity ? g_visible_capacity : 1024;
+    while (capacity < count)
+      capacity *= 2;
+    CameraVisibleEntity *grown = (CameraVisibleEntity *)mem_track_realloc(
+        MEM_SUBSYSTEM_RENDERER, g_visible,
+        capacity * sizeof(CameraVisibleEntity));
+    if (!grown)
+      return g_visible;
+    g_visible = grown;
+    g_visible_capacity = capacity;
+  }
+
+  *visible_count = camera_cull_entities(camera, entities, stride, candidates,
+                                        count, g_visible);
+  return g_visible;
+}
+
 void renderer_draw_objects(const Object *objects, int count,
+                           const SpatialGrid *grid,
                            const Camera2D_RTS *camera) {
-  // Check if tree texture is loaded
-  if (g_tree_texture.id == 0) {
+  TRACE_ZONE_BEGIN(zone, "renderer_draw_objects");
+  int visible_count;
+  const CameraVisibleEntity *visible = renderer_cull_visible(
+      objects, sizeof(Object), count, grid, camera, &visible_count);
+
+  // Check if the tree sprite is packed
+  if (!g_world_atlas.has_sprite[WORLD_SPRITE_TREE]) {
     // Fall back to colored circles
-    for (int i = 0; i < count; i++) {
-      Object obj = objects[i];
-      Vector2 screen_pos =
-          camera_world_to_screen(camera, (Vector2){obj.x, obj.y});
-      float radius = obj.size * TILE_SIZE_PIXELS * camera->zoom / 2.0f;
-
-      if (renderer_is_position_visible(screen_pos, radius)) {
-        DrawCircle(screen_pos.x, screen_pos.y, radius, PURPLE);
-        DrawCircleLines(screen_pos.x, screen_pos.y, radius, DARKPURPLE);
-      }
+    for (int n = 0; n < visible_count; n++) {
+      Vector2 screen_pos = visible[n].screen_pos;
+      float radius = visible[n].screen_size / 2.0f;
+      DrawCircle(screen_pos.x, screen_pos.y, radius, PURPLE);
+      DrawCircleLines(screen_pos.x, screen_pos.y, radius, DARKPURPLE);
     }
+    TRACE_ZONE_END(zone);
     return;
   }
 
-  // Use texture for objects (trees)
-  for (int i = 0; i < count; i++) {
-    Object obj = objects[i];
-    Vector2 screen_pos =
-        camera_world_to_screen(camera, (Vector2){obj.x, obj.y});
-    float obj_size = obj.size * TILE_SIZE_PIXELS * camera->zoom;
+  // Use the tree sprite, queued into the shared world batch
+  // Trees might be taller than wide, so keep the sprite's proportions
+  Rectangle source = g_world_atlas.sprite_rects[WORLD_SPRITE_TREE];
+  float height_ratio = source.height / source.width;
 
-    if (!renderer_is_position_visible(screen_pos, obj_size / 2))
-      continue;
-
-    // Trees might be taller than wide, so we can adjust proportions if needed
-    float width = obj_size;
-    float height =
-        obj_size * ((float)g_tree_texture.height / g_tree_texture.width);
-
-    Rectangle dest_rect = {screen_pos.x - width / 2,
-                           screen_pos.y -
-                               height / 2, // Center vertically on position
-                           width, height};
-
-    // Draw the tree texture
-    DrawTexturePro(
-        g_tree_texture,
-        (Rectangle){0, 0, g_tree_texture.width, g_tree_texture.height},
-        dest_rect, (Vector2){0, 0}, // No rotation needed for trees
-        0.0f,
-        WHITE); // Use original tree colors
-
-    // Optional: Draw a subtle shadow or base circle
-    // DrawCircle(screen_pos.x, screen_pos.y + height * 0.4f, width * 0.3f,
-    // (Color){0, 0, 0, 128});
+  for (int n = 0; n < visible_count; n++) {
+    float obj_size = visible[n].screen_size;
+    sprite_batch_push(&g_world_batch, source, visible[n].screen_pos,
+                      (Vector2){obj_size, obj_size * height_ratio}, 0.0f,
+                      WHITE); // Use original tree colors
   }
+  g_frame_stats.sprites_drawn += visible_count;
+  TRACE_ZONE_END(zone);
 }
 
 void renderer_draw_units(const Unit *units, int count,
-                         const Camera2D_RTS *camera) {
-  // Check if unit texture is loaded
-  if (g_unit_texture.id == 0) {
+                         const SpatialGrid *grid, const Camera2D_RTS *camera) {
+  TRACE_ZONE_BEGIN(zone, "renderer_draw_units");
+  int visible_count;
+  const CameraVisibleEntity *visible = renderer_cull_visible(
+      units, sizeof(Unit), count, grid, camera, &visible_count);
+
+  // Check if the unit sprite is packed
+  if (!g_world_atlas.has_sprite[WORLD_SPRITE_UNIT]) {
     // Fall back to colored circles
-    for (int i = 0; i < count; i++) {
-      Unit unit = units[i];
-      Vector2 screen_pos =
-          camera_world_to_screen(camera, (Vector2){unit.x, unit.y});
-      float radius = unit.size * TILE_SIZE_PIXELS * camera->zoom / 2.0f;
-
-      if (!renderer_is_position_visible(screen_pos, radius))
+    for (int n = 0; n < visible_count; n++) {
+      const Unit *unit = &units[visible[n].index];
+      Vector2 screen_pos = visible[n].screen_pos;
+      float radius = visible[n].screen_size / 2.0f;
+
+      Color unit_color = renderer_owner_color(unit->owner);
+      if (visible[n].screen_size < g_unit_lod_pixels) {
+        renderer_draw_tile(screen_pos, visible[n].screen_size, unit_color);
         continue;
-
-      Color unit_color = (unit.owner == 1) ? RED : YELLOW;
+      }
       DrawCircle(screen_pos.x, screen_pos.y, radius, unit_color);
       DrawCircleLines(screen_pos.x, screen_pos.y, radius, BLACK);
 
       // Draw facing direction indicator
-      float end_x = screen_pos.x + cos(unit.facing * DEG2RAD) * radius * 1.5f;
-      float end_y = screen_pos.y + sin(unit.facing * DEG2RAD) * radius * 1.5f;
+      float end_x = screen_pos.x + cos(unit->facing * DEG2RAD) * radius * 1.5f;
+      float end_y = screen_pos.y + sin(unit->facing * DEG2RAD) * radius * 1.5f;
       DrawLine(screen_pos.x, screen_pos.y, end_x, end_y, BLACK);
     }
+    TRACE_ZONE_END(zone);
     return;
   }
 
-  // Use texture for units - maintain aspect ratio
-  for (int i = 0; i < count; i++) {
-    Unit unit = units[i];
-    Vector2 screen_pos =
-        camera_world_to_screen(camera, (Vector2){unit.x, unit.y});
-    float unit_size = unit.size * TILE_SIZE_PIXELS * camera->zoom;
-
-    if (!renderer_is_position_visible(screen_pos, unit_size / 2))
+  // Use the unit sprite - maintain aspect ratio, computed once per frame
+  Rectangle source = g_world_atlas.sprite_rects[WORLD_SPRITE_UNIT];
+  float aspect_ratio = source.width / source.height;
+  float width_scale = aspect_ratio > 1.0f ? 1.0f : aspect_ratio;
+  float height_scale = aspect_ratio > 1.0f ? 1.0f / aspect_ratio : 1.0f;
+
+  for (int n = 0; n < visible_count; n++) {
+    const Unit *unit = &units[visible[n].index];
+    float unit_size = visible[n].screen_size;
+
+    // Too small to read a facing: an unrotated sprite in the plain owner
+    // colour is enough and skips the rotation when the batch is flushed
+    Color owner = renderer_owner_color(unit->owner);
+    if (unit_size < g_unit_lod_pixels) {
+      sprite_batch_push(&g_world_batch, source, visible[n].screen_pos,
+                        (Vector2){unit_size * width_scale,
+                                  unit_size * height_scale},
+                        0.0f, owner);
       continue;
-
-    // Calculate destination rectangle while maintaining aspect ratio
-    float aspect_ratio =
-        (float)g_unit_texture.width / (float)g_unit_texture.height;
-    float draw_width, draw_height;
-
-    if (aspect_ratio > 1.0f) {
-      // Texture is wider than tall
-      draw_width = unit_size;
-      draw_height = unit_size / aspect_ratio;
-    } else {
-      // Texture is taller than wide or square
-      draw_width = unit_size * aspect_ratio;
-      draw_height = unit_size;
     }
 
-    Rectangle dest_rect = {screen_pos.x - draw_width / 2,
-                           screen_pos.y - draw_height / 2, draw_width,
-                           draw_height};
+    // Tint halfway towards the owner colour so the sprite detail survives
+    Color tint = {(unsigned char)((owner.r + 255) / 2),
+                  (unsigned char)((owner.g + 255) / 2),
+                  (unsigned char)((owner.b + 255) / 2), 255};
 
-    // Rotate based on facing direction
-    float rotation = unit.facing;
-
-    DrawTexturePro(
-        g_unit_texture,
-        (Rectangle){0, 0, g_unit_texture.width, g_unit_texture.height},
-        dest_rect,
-        (Vector2){draw_width / 2, draw_height / 2}, // rotation center
-        rotation, WHITE);
+    // Rotate around the unit position based on facing direction
+    sprite_batch_push(
+        &g_world_batch, source, visible[n].screen_pos,
+        (Vector2){unit_size * width_scale, unit_size * height_scale},
+        unit->facing, tint);
   }
+  g_frame_stats.sprites_drawn += visible_count;
+  TRACE_ZONE_END(zone);
+}
+
+void renderer_begin_world_sprites(void) {
+  sprite_batch_begin(&g_world_batch, g_world_atlas.texture);
+}
+
+void renderer_flush_world_sprites(void) {
+  // Trees and units share the atlas, so depth order costs no extra draw
+  // calls; at equal depth trees stay under the units queued after them
+  TRACE_ZONE_BEGIN(sort_zone, "renderer_sort_world_sprites");
+  sprite_batch_sort_by_depth(&g_world_batch);
+  TRACE_ZONE_END(sort_zone);
+
+  TRACE_ZONE_BEGIN(zone, "renderer_flush_world_sprites");
+  renderer_track_flush(sprite_batch_flush(&g_world_batch));
+  TRACE_ZONE_END(zone);
 }
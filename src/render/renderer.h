@@ -2,28 +2,42 @@
 #define RENDERER_H
 
 #include "../client/sim_loader.h"
+#include "../utils/spatial_grid.h"
 #include "camera.h"
 #include "raylib.h"
 
-// Tile atlas configuration
+// Standalone sprites packed next to the tile cells in the world atlas
+typedef enum { WORLD_SPRITE_UNIT, WORLD_SPRITE_TREE, WORLD_SPRITE_COUNT } WorldSprite;
+
+// Bleed guard around every packed region, in atlas pixels
+#define WORLD_ATLAS_PADDING 2
+
+// Single packed texture holding every world sprite (tiles, units, trees)
 typedef struct {
   Texture2D texture;
   int tile_width;
   int tile_height;
-  int gap;
+  int gap; // Gap between cells in the source tile sheet
   int columns;
   int rows;
-} TileAtlas;
+  Rectangle *tile_rects; // Packed rect per tile sheet cell, row-major
+  Rectangle sprite_rects[WORLD_SPRITE_COUNT];
+  bool has_sprite[WORLD_SPRITE_COUNT];
+} WorldAtlas;
+
+// Per-frame counters for the world layers
+typedef struct {
+  int draw_calls;    // GPU submissions (texture changes and batch flushes)
+  int tiles_drawn;   // Tiles drawn individually (chunk bakes and fallbacks)
+  int chunks_drawn;  // Cached map chunks drawn as single quads
+  int sprites_drawn; // Unit and tree sprites submitted through batches
+} RendererFrameStats;
 
 // Function prototypes
-void renderer_init_tile_atlas(const char *texture_path, int tile_width,
-                              int tile_height, int gap);
-void renderer_init_unit_texture(const char *texture_path);
-void renderer_cleanup_unit_texture(void);
-void renderer_cleanup_tile_atlas(void);
-
-void renderer_init_tree_texture(const char *texture_path);
-void renderer_cleanup_tree_texture(void);
+void renderer_init_world_atlas(const char *tiles_path, int tile_width,
+                               int tile_height, int gap, const char *unit_path,
+                               const char *tree_path);
+void renderer_cleanup_world_atlas(void);
 void renderer_draw_tile(Vector2 screen_pos, float size, Color color);
 bool renderer_is_position_visible(Vector2 screen_pos, float radius);
 void renderer_calculate_visible_tile_range(const Camera2D_RTS *camera,
@@ -32,14 +46,36 @@ void renderer_calculate_visible_tile_range(const Camera2D_RTS *camera,
                                            int *end_y);
 
 void renderer_draw_objects(const Object *objects, int count,
+                           const SpatialGrid *grid,
                            const Camera2D_RTS *camera);
 void renderer_draw_units(const Unit *units, int count,
-                         const Camera2D_RTS *camera);
+                         const SpatialGrid *grid, const Camera2D_RTS *camera);
+void renderer_begin_world_sprites(void);
+// Draws the queued units and trees back to front by screen y
+void renderer_flush_world_sprites(void);
 
 // Texture-based rendering
 void renderer_draw_map_textured(const TileMap *map, const Camera2D_RTS *camera);
+void renderer_draw_map_region(const TileMap *map, const Camera2D_RTS *camera,
+                              int start_x, int start_y, int end_x, int end_y);
+void renderer_draw_tile_textured(const Tile *tile, Rectangle dest_rect);
+Rectangle renderer_get_tile_source_rect_from_tile(const Tile *tile);
+
+// Batching and per-frame statistics
+void renderer_init_sprite_batches(void);
+void renderer_cleanup_sprite_batches(void);
+void renderer_begin_frame(void);
+RendererFrameStats renderer_get_frame_stats(void);
+void renderer_track_texture(unsigned int texture_id);
+void renderer_track_flush(int draw_calls);
+void renderer_count_chunk_drawn(void);
+Color renderer_owner_color(int owner);
+
+// Units drawn smaller than this many screen pixels are drawn unrotated in
+// their plain owner colour; 0 disables the simplification
+void renderer_set_unit_lod_pixels(float pixels);
 
 // External configuration
-extern TileAtlas g_tile_atlas;
+extern WorldAtlas g_world_atlas;
 
 #endif
@@ -0,0 +1,189 @@
+#include "sprite_batch.h"
+#include "../utils/mem_track.h"
+#include "rlgl.h"
+#include <math.h>
+#include <stdlib.h>
+
+static rlRenderBatch g_sprite_render_batch = {0};
+static bool g_sprite_render_batch_loaded = false;
+
+void sprite_batch_system_init(void) {
+  if (g_sprite_render_batch_loaded)
+    return;
+  g_sprite_render_batch = rlLoadRenderBatch(1, SPRITE_BATCH_MAX_QUADS);
+  g_sprite_render_batch_loaded = true;
+}
+
+void sprite_batch_system_cleanup(void) {
+  if (!g_sprite_render_batch_loaded)
+    return;
+  rlUnloadRenderBatch(g_sprite_render_batch);
+  g_sprite_render_batch_loaded = false;
+}
+
+void sprite_batch_begin(SpriteBatch *batch, Texture2D texture) {
+  batch->texture = texture;
+  batch->count = 0;
+}
+
+void sprite_batch_push(SpriteBatch *batch, Rectangle source, Vector2 center,
+                       Vector2 size, float rotation, Color tint) {
+  if (batch->texture.id == 0)
+    return;
+  if (batch->count == batch->capacity) {
+    int capacity = batch->capacity ? batch->capacity * 2 : 1024;
+    SpriteInstance *instances = (SpriteInstance *)mem_track_realloc(
+        MEM_SUBSYSTEM_RENDERER, batch->instances,
+        capacity * sizeof(SpriteInstance));
+    if (!instances)
+      return;
+    batch->instances = instances;
+    batch->capacity = capacity;
+  }
+
+  batch->instances[batch->count++] =
+      (SpriteInstance){.x = center.x,
+                       .y = center.y,
+                       .half_width = size.x / 2.0f,
+                       .half_height = size.y / 2.0f,
+                       .rotation = rotation,
+                       .u0 = source.x / batch->texture.width,
+                       .v0 = source.y / batch->texture.height,
+                       .u1 = (source.x + source.width) / batch->texture.width,
+                       .v1 = (source.y + source.height) / batch->texture.height,
+                       .tint = tint};
+}
+
+static bool sprite_batch_reserve_sort(SpriteBatch *batch) {
+  if (batch->sort_capacity >= batch->capacity)
+    return true;
+  SpriteInstance *sorted = (SpriteInstance *)mem_track_realloc(
+      MEM_SUBSYSTEM_RENDERER, batch->sorted,
+      batch->capacity * sizeof(SpriteInstance));
+  if (!sorted)
+    return false;
+  batch->sorted = sorted;
+  unsigned long long *items = (unsigned long long *)mem_track_realloc(
+      MEM_SUBSYSTEM_RENDERER, batch->sort_items,
+      2 * (size_t)batch->capacity * sizeof(unsigned long long));
+  if (!items)
+    return false;
+  batch->sort_items = items;
+  batch->sort_capacity = batch->capacity;
+  return true;
+}
+
+void sprite_batch_sort_by_depth(SpriteBatch *batch) {
+  int count = batch->count;
+  // Without scratch space the batch is drawn in queue order
+  if (count < 2 || !sprite_batch_reserve_sort(batch))
+    return;
+
+  // Keys and both byte histograms in one pass
+  const SpriteInstance *instances = batch->instances;
+  unsigned long long *items = batch->sort_items;
+  unsigned long long *spare = items + batch->sort_capacity;
+  unsigned int histogram[2][256] = {{0}};
+  unsigned int previous = 0;
+  bool ordered = true;
+  for (int i = 0; i < count; i++) {
+    float bottom = instances[i].y + instances[i].half_height;
+    float depth =
+        (bottom + SPRITE_BATCH_DEPTH_ORIGIN) * SPRITE_BATCH_DEPTH_STEPS;
+    unsigned int key = 0;
+    if (depth >= 65535.0f)
+      key = 65535;
+    else if (depth > 0.0f)
+      key = (unsigned int)depth;
+    items[i] = (unsigned long long)key << 32 | (unsigned int)i;
+    histogram[0][key & 255]++;
+    histogram[1][key >> 8]++;
+    ordered = ordered && key >= previous;
+    previous = key;
+  }
+  if (ordered)
+    return;
+
+  for (int pass = 0; pass < 2; pass++) {
+    int shift = 32 + pass * 8;
+    unsigned int *counts = histogram[pass];
+    // Every key shares this byte: the pass would not move anything
+    if (counts[(items[0] >> shift) & 255] == (unsigned int)count)
+      continue;
+
+    unsigned int offset = 0;
+    for (int b = 0; b < 256; b++) {
+      unsigned int n = counts[b];
+      counts[b] = offset;
+      offset += n;
+    }
+    for (int i = 0; i < count; i++)
+      spare[counts[(items[i] >> shift) & 255]++] = items[i];
+    unsigned long long *swap = items;
+    items = spare;
+    spare = swap;
+  }
+
+  for (int i = 0; i < count; i++)
+    batch->sorted[i] = instances[(unsigned int)items[i]];
+  SpriteInstance *swap = batch->instances;
+  batch->instances = batch->sorted;
+  batch->sorted = swap;
+}
+
+int sprite_batch_flush(SpriteBatch *batch) {
+  if (batch->count == 0 || batch->texture.id == 0) {
+    batch->count = 0;
+    return 0;
+  }
+
+  // Submitting the default batch first keeps anything drawn before this
+  // layer underneath it
+  if (g_sprite_render_batch_loaded)
+    rlSetRenderBatchActive(&g_sprite_render_batch);
+
+  int draw_calls = 1;
+  rlSetTexture(batch->texture.id);
+  rlBegin(RL_QUADS);
+  for (int i = 0; i < batch->count; i++) {
+    const SpriteInstance *s = &batch->instances[i];
+
+    if (rlCheckRenderBatchLimit(4))
+      draw_calls++;
+
+    // Corners relative to the centre, rotated clockwise in screen space
+    float c = 1.0f;
+    float sn = 0.0f;
+    if (s->rotation != 0.0f) {
+      c = cosf(s->rotation * DEG2RAD);
+      sn = sinf(s->rotation * DEG2RAD);
+    }
+    float ax = s->half_width * c, ay = s->half_width * sn;
+    float bx = -s->half_height * sn, by = s->half_height * c;
+
+    rlColor4ub(s->tint.r, s->tint.g, s->tint.b, s->tint.a);
+    rlTexCoord2f(s->u0, s->v0);
+    rlVertex2f(s->x - ax - bx, s->y - ay - by);
+    rlTexCoord2f(s->u0, s->v1);
+    rlVertex2f(s->x - ax + bx, s->y - ay + by);
+    rlTexCoord2f(s->u1, s->v1);
+    rlVertex2f(s->x + ax + bx, s->y + ay + by);
+    rlTexCoord2f(s->u1, s->v0);
+    rlVertex2f(s->x + ax - bx, s->y + ay - by);
+  }
+  rlEnd();
+  rlSetTexture(0);
+
+  if (g_sprite_render_batch_loaded)
+    rlSetRenderBatchActive(NULL);
+
+  batch->count = 0;
+  return draw_calls;
+}
+
+void sprite_batch_free(SpriteBatch *batch) {
+  mem_track_free(batch->instances);
+  mem_track_free(batch->sorted);
+  mem_track_free(batch->sort_items);
+  *batch = (SpriteBatch){0};
+}
@@ -0,0 +1,106 @@
+#ifndef SPRITE_BATCH_H
+#define SPRITE_BATCH_H
+
+#include "raylib.h"
+
+/**
+ * @brief Batched sprite submission through rlgl
+ *
+ * Sprites sharing one texture are collected into an instance list during
+ * the frame and written into a dedicated rlgl vertex buffer on flush, so a
+ * whole layer of units and trees is submitted as one draw call instead of
+ * one DrawTexturePro per sprite. A batch can be sorted by depth before it
+ * is flushed, so sprites of different layers overlap correctly.
+ */
+
+// Quads per submission; larger layers are split into extra draw calls
+#define SPRITE_BATCH_MAX_QUADS 65536
+// Depth keys per screen pixel when sorting: 16-bit keys then tell apart
+// bottom edges from -8192 to 8192 pixels, well past any visible sprite
+#define SPRITE_BATCH_DEPTH_STEPS 4.0f
+#define SPRITE_BATCH_DEPTH_ORIGIN 8192.0f
+
+typedef struct {
+  float x; // Screen-space centre
+  float y;
+  float half_width;
+  float half_height;
+  float rotation; // Degrees, clockwise
+  float u0;       // Normalized texture coordinates of the source region
+  float v0;
+  float u1;
+  float v1;
+  Color tint;
+} SpriteInstance;
+
+typedef struct {
+  Texture2D texture;
+  SpriteInstance *instances;
+  int count;
+  int capacity;
+  // Depth sort scratch, grown to `capacity` on the first sort after growth
+  SpriteInstance *sorted;
+  unsigned long long *sort_items; // Two buffers of key << 32 | index
+  int sort_capacity;
+} SpriteBatch;
+
+/**
+ * @brief Creates the shared GPU vertex buffer (requires a live GL context)
+ */
+void sprite_batch_system_init(void);
+
+/**
+ * @brief Releases the shared GPU vertex buffer
+ */
+void sprite_batch_system_cleanup(void);
+
+/**
+ * @brief Starts collecting sprites for one texture
+ *
+ * Instance storage is kept between frames, so steady-state batching does
+ * not allocate.
+ *
+ * @param batch Batch to reset
+ * @param texture Texture every sprite in the batch samples
+ */
+void sprite_batch_begin(SpriteBatch *batch, Texture2D texture);
+
+/**
+ * @brief Queues one sprite
+ *
+ * @param batch Target batch
+ * @param source Source rectangle within the batch texture
+ * @param center Screen-space centre of the sprite
+ * @param size Screen-space width and height
+ * @param rotation Rotation around the centre in degrees
+ * @param tint Colour multiplied with the texture
+ */
+void sprite_batch_push(SpriteBatch *batch, Rectangle source, Vector2 center,
+                       Vector2 size, float rotation, Color tint);
+
+/**
+ * @brief Reorders queued sprites back to front by their bottom edge
+ *
+ * Sprites lower on screen are drawn later, so they cover the ones behind
+ * them. Bottom edges are quantized to 16-bit keys and ordered with a
+ * two-pass LSD radix sort, which is stable: sprites within one key keep
+ * the order they were queued in. Already ordered batches are left alone.
+ *
+ * @param batch Batch to reorder
+ */
+void sprite_batch_sort_by_depth(SpriteBatch *batch);
+
+/**
+ * @brief Submits every queued sprite and empties the batch
+ *
+ * @param batch Batch to submit
+ * @return int Number of GPU draw calls issued
+ */
+int sprite_batch_flush(SpriteBatch *batch);
+
+/**
+ * @brief Frees instance storage owned by a batch
+ */
+void sprite_batch_free(SpriteBatch *batch);
+
+#endif
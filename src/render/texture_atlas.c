@@ -0,0 +1,123 @@
+#include "texture_atlas.h"
+#include "../utils/mem_track.h"
+#include <stdlib.h>
+
+#define ATLAS_MIN_WIDTH 256
+#define ATLAS_MAX_WIDTH 8192
+
+static const AtlasPackInput *g_sort_inputs = NULL;
+
+// Taller regions first keeps shelves tight
+static int atlas_compare_height(const void *a, const void *b) {
+  float ha = g_sort_inputs[*(const int *)a].source.height;
+  float hb = g_sort_inputs[*(const int *)b].source.height;
+  return (ha < hb) - (ha > hb);
+}
+
+// Lays regions out on shelves of the given width; returns the height used,
+// or -1 if a region does not fit the width at all
+static int atlas_layout(const AtlasPackInput *inputs, const int *order,
+                        int count, int padding, int width,
+                        Rectangle *out_rects) {
+  int cursor_x = 0;
+  int shelf_y = 0;
+  int shelf_height = 0;
+
+  for (int i = 0; i < count; i++) {
+    const AtlasPackInput *input = &inputs[order[i]];
+    int cell_w = (int)input->source.width + padding * 2;
+    int cell_h = (int)input->source.height + padding * 2;
+    if (cell_w > width)
+      return -1;
+
+    if (cursor_x + cell_w > width) {
+      shelf_y += shelf_height;
+      cursor_x = 0;
+      shelf_height = 0;
+    }
+
+    if (out_rects) {
+      out_rects[order[i]] =
+          (Rectangle){cursor_x + padding, shelf_y + padding,
+                      input->source.width, input->source.height};
+    }
+    cursor_x += cell_w;
+    if (cell_h > shelf_height)
+      shelf_height = cell_h;
+  }
+
+  return shelf_y + shelf_height;
+}
+
+// Copies a region and extrudes its edge pixels into the padding band
+static void atlas_blit(Color *atlas, int atlas_width, const Color *src,
+                       int src_width, Rectangle source, Rectangle dest,
+                       int padding) {
+  int w = (int)source.width;
+  int h = (int)source.height;
+
+  for (int dy = -padding; dy < h + padding; dy++) {
+    int sy = (int)source.y + (dy < 0 ? 0 : (dy >= h ? h - 1 : dy));
+    Color *row = &atlas[((int)dest.y + dy) * atlas_width + (int)dest.x];
+    for (int dx = -padding; dx < w + padding; dx++) {
+      int sx = (int)source.x + (dx < 0 ? 0 : (dx >= w ? w - 1 : dx));
+      row[dx] = src[sy * src_width + sx];
+    }
+  }
+}
+
+Image texture_atlas_pack(const AtlasPackInput *inputs, int count, int padding,
+                         Rectangle *out_rects) {
+  Image result = {0};
+  if (count <= 0)
+    return result;
+
+  int *order =
+      (int *)mem_track_malloc(MEM_SUBSYSTEM_RENDERER, count * sizeof(int));
+  if (!order)
+    return result;
+
+  long area = 0;
+  for (int i = 0; i < count; i++) {
+    order[i] = i;
+    area += (long)(inputs[i].source.width + padding * 2) *
+            (long)(inputs[i].source.height + padding * 2);
+  }
+  g_sort_inputs = inputs;
+  qsort(order, count, sizeof(int), atlas_compare_height);
+  g_sort_inputs = NULL;
+
+  // Smallest power-of-two width whose layout is no taller than it is wide
+  int width = ATLAS_MIN_WIDTH;
+  int height = -1;
+  for (; width <= ATLAS_MAX_WIDTH; width *= 2) {
+    if ((long)width * width < area)
+      continue;
+    height = atlas_layout(inputs, order, count, padding, width, NULL);
+    if (height >= 0 && height <= width)
+      break;
+  }
+  if (height < 0 || width > ATLAS_MAX_WIDTH) {
+    TraceLog(LOG_ERROR, "TextureAtlas: Sprites do not fit in %dx%d",
+             ATLAS_MAX_WIDTH, ATLAS_MAX_WIDTH);
+    mem_track_free(order);
+    return result;
+  }
+  atlas_layout(inputs, order, count, padding, width, out_rects);
+
+  result = GenImageColor(width, height, BLANK);
+  Color *pixels = (Color *)result.data;
+
+  for (int i = 0; i < count; i++) {
+    const Image *source = &inputs[i].image;
+    if (source->format != PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 || !source->data)
+      continue;
+    atlas_blit(pixels, width, (const Color *)source->data, source->width,
+               inputs[i].source, out_rects[i], padding);
+  }
+
+  mem_track_free(order);
+  TraceLog(LOG_INFO, "TextureAtlas: Packed %d sprites into %dx%d", count,
+           width, height);
+  return result;
+}
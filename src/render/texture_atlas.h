@@ -0,0 +1,33 @@
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include "raylib.h"
+
+/**
+ * @brief CPU-side atlas packer
+ *
+ * Combines regions from any number of source images into one RGBA image
+ * using shelf packing. Every packed region is surrounded by a padding band
+ * filled by extruding its edge pixels, so filtering or sub-pixel sampling
+ * at the border never bleeds in a neighbouring sprite.
+ */
+
+typedef struct {
+  Image image;      // RGBA8 source image (not owned by the packer)
+  Rectangle source; // Region of the source image to pack
+} AtlasPackInput;
+
+/**
+ * @brief Packs image regions into a single atlas image
+ *
+ * @param inputs Regions to pack
+ * @param count Number of regions
+ * @param padding Bleed guard in pixels on every side of each region
+ * @param out_rects Receives the packed location of each region (same order)
+ * @return Image Packed RGBA8 atlas, or an empty image on failure; the caller
+ * owns it and releases it with UnloadImage
+ */
+Image texture_atlas_pack(const AtlasPackInput *inputs, int count, int padding,
+                         Rectangle *out_rects);
+
+#endif
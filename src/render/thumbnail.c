@@ -0,0 +1,205 @@
+#include "thumbnail.h"
+#include "../utils/mem_track.h"
+#include "../utils/trace.h"
+#include "renderer.h"
+#include <math.h>
+#include <stdlib.h>
+
+// Markers never shrink below this radius, so units stay visible in small
+// thumbnails
+#define THUMBNAIL_MIN_MARKER_RADIUS 1.0f
+
+static const Color THUMBNAIL_OBJECT_COLOR = {0, 117, 44, 255}; // DARKGREEN
+static const Color THUMBNAIL_MISSING_TILE = {255, 0, 255, 255};
+
+bool thumbnail_load_sheet(ThumbnailSheet *sheet, const char *tiles_path,
+                          int tile_width, int tile_height, int gap) {
+  *sheet = (ThumbnailSheet){0};
+  sheet->sheet = LoadImage(tiles_path);
+  if (!sheet->sheet.data) {
+    TraceLog(LOG_ERROR, "Thumbnail: Failed to load tile sheet %s", tiles_path);
+    return false;
+  }
+  ImageFormat(&sheet->sheet, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+
+  sheet->tile_width = tile_width;
+  sheet->tile_height = tile_height;
+  sheet->gap = gap;
+  sheet->columns = (sheet->sheet.width + gap) / (tile_width + gap);
+  sheet->rows = (sheet->sheet.height + gap) / (tile_height + gap);
+  sheet->cells = (Color **)mem_track_calloc(
+      MEM_SUBSYSTEM_RENDERER, sheet->columns * sheet->rows, sizeof(Color *));
+  if (!sheet->cells) {
+    UnloadImage(sheet->sheet);
+    *sheet = (ThumbnailSheet){0};
+    return false;
+  }
+  return true;
+}
+
+static void thumbnail_release_cells(ThumbnailSheet *sheet) {
+  if (!sheet->cells)
+    return;
+  for (int i = 0; i < sheet->columns * sheet->rows; i++) {
+    free(sheet->cells[i]); // Image data from raylib, not tracked
+    sheet->cells[i] = NULL;
+  }
+}
+
+void thumbnail_unload_sheet(ThumbnailSheet *sheet) {
+  thumbnail_release_cells(sheet);
+  mem_track_free(sheet->cells);
+  if (sheet->sheet.data)
+    UnloadImage(sheet->sheet);
+  *sheet = (ThumbnailSheet){0};
+}
+
+float thumbnail_fit_scale(const TileMap *map, int max_size) {
+  int longest = map->width > map->height ? map->width : map->height;
+  if (longest <= 0 || max_size <= 0)
+    return 1.0f;
+  return (float)max_size / longest;
+}
+
+// Returns the cell resampled to cell_size x cell_size, building it on first
+// use. ImageResize box-filters when shrinking, which keeps small thumbnails
+// from shimmering.
+static const Color *thumbnail_cell(ThumbnailSheet *sheet, int atlas_x,
+                                   int atlas_y) {
+  if (atlas_x < 0 || atlas_x >= sheet->columns || atlas_y < 0 ||
+      atlas_y >= sheet->rows)
+    return NULL;
+
+  int index = atlas_y * sheet->columns + atlas_x;
+  if (sheet->cells[index])
+    return sheet->cells[index];
+
+  Rectangle source = {atlas_x * (sheet->tile_width + sheet->gap),
+                      atlas_y * (sheet->tile_height + sheet->gap),
+                      sheet->tile_width, sheet->tile_height};
+  Image cell = ImageFromImage(sheet->sheet, source);
+  if (!cell.data)
+    return NULL;
+  if (cell.width != sheet->cell_size || cell.height != sheet->cell_size)
+    ImageResize(&cell, sheet->cell_size, sheet->cell_size);
+
+  // The image buffer is RGBA8, so it can be kept as the Color array directly
+  sheet->cells[index] = (Color *)cell.data;
+  return sheet->cells[index];
+}
+
+static void thumbnail_fill_circle(Color *pixels, int width, int height,
+                                  float cx, float cy, float radius,
+                                  Color color) {
+  int x0 = (int)fmaxf(0.0f, floorf(cx - radius));
+  int x1 = (int)fminf(width - 1.0f, ceilf(cx + radius));
+  int y0 = (int)fmaxf(0.0f, floorf(cy - radius));
+  int y1 = (int)fminf(height - 1.0f, ceilf(cy + radius));
+  float r2 = radius * radius;
+
+  for (int y = y0; y <= y1; y++) {
+    float dy = y + 0.5f - cy;
+    for (int x = x0; x <= x1; x++) {
+      float dx = x + 0.5f - cx;
+      if (dx * dx + dy * dy <= r2)
+        pixels[y * width + x] = color;
+    }
+  }
+}
+
+Image thumbnail_render(ThumbnailSheet *sheet, const SimulationState *sim,
+                       float pixels_per_tile) {
+  const TileMap *map = &sim->map;
+  int width = (int)ceilf(map->width * pixels_per_tile);
+  int height = (int)ceilf(map->height * pixels_per_tile);
+  if (width <= 0 || height <= 0 || !sheet->cells)
+    return (Image){0};
+
+  TRACE_ZONE_BEGIN(zone, "thumbnail_render");
+
+  // Cells are resampled to the smallest square covering one output tile
+  int cell_size = (int)ceilf(pixels_per_tile);
+  if (cell_size < 1)
+    cell_size = 1;
+  if (cell_size > sheet->tile_width)
+    cell_size = sheet->tile_width;
+  if (cell_size != sheet->cell_size) {
+    thumbnail_release_cells(sheet);
+    sheet->cell_size = cell_size;
+  }
+
+  Image image = GenImageColor(width, height, BLANK);
+  int *column_tile =
+      (int *)mem_track_malloc(MEM_SUBSYSTEM_RENDERER, width * sizeof(int));
+  int *column_texel =
+      (int *)mem_track_malloc(MEM_SUBSYSTEM_RENDERER, width * sizeof(int));
+  if (!image.data || !column_tile || !column_texel) {
+    mem_track_free(column_tile);
+    mem_track_free(column_texel);
+    if (image.data)
+      UnloadImage(image);
+    TRACE_ZONE_END(zone);
+    return (Image){0};
+  }
+  Color *pixels = (Color *)image.data;
+
+  // The mapping is separable: precompute the tile column and texel for
+  // every output column once, then each row only looks up its own
+  for (int x = 0; x < width; x++) {
+    float world_x = (x + 0.5f) / pixels_per_tile;
+    int tile_x = (int)world_x;
+    column_tile[x] = tile_x < map->width ? tile_x : map->width - 1;
+    column_texel[x] = (int)((world_x - tile_x) * cell_size);
+    if (column_texel[x] >= cell_size)
+      column_texel[x] = cell_size - 1;
+  }
+
+  for (int y = 0; y < height; y++) {
+    float world_y = (y + 0.5f) / pixels_per_tile;
+    int tile_y = (int)world_y;
+    if (tile_y >= map->height)
+      tile_y = map->height - 1;
+    int texel_y = (int)((world_y - tile_y) * cell_size);
+    if (texel_y >= cell_size)
+      texel_y = cell_size - 1;
+
+    const Tile *row = &map->tiles[(size_t)tile_y * map->width];
+    Color *out = &pixels[y * width];
+    const Tile *cached_tile = NULL;
+    const Color *cell_row = NULL;
+
+    for (int x = 0; x < width; x++) {
+      const Tile *tile = &row[column_tile[x]];
+      if (tile != cached_tile) {
+        const Color *cell =
+            thumbnail_cell(sheet, tile->texture_index_x, tile->texture_index_y);
+        cell_row = cell ? &cell[texel_y * cell_size] : NULL;
+        cached_tile = tile;
+      }
+      out[x] = cell_row ? cell_row[column_texel[x]] : THUMBNAIL_MISSING_TILE;
+    }
+  }
+  mem_track_free(column_tile);
+  mem_track_free(column_texel);
+
+  // Markers on top: objects first so units stay readable over forests
+  for (int i = 0; i < sim->objectCount; i++) {
+    const Object *obj = &sim->objects[i];
+    float radius = fmaxf(THUMBNAIL_MIN_MARKER_RADIUS,
+                         obj->size * pixels_per_tile / 2.0f);
+    thumbnail_fill_circle(pixels, width, height, obj->x * pixels_per_tile,
+                          obj->y * pixels_per_tile, radius,
+                          THUMBNAIL_OBJECT_COLOR);
+  }
+  for (int i = 0; i < sim->unitCount; i++) {
+    const Unit *unit = &sim->units[i];
+    float radius = fmaxf(THUMBNAIL_MIN_MARKER_RADIUS,
+                         unit->size * pixels_per_tile / 2.0f);
+    thumbnail_fill_circle(pixels, width, height, unit->x * pixels_per_tile,
+                          unit->y * pixels_per_tile, radius,
+                          renderer_owner_color(unit->owner));
+  }
+
+  TRACE_ZONE_END(zone);
+  return image;
+}
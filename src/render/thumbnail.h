@@ -0,0 +1,60 @@
+#ifndef THUMBNAIL_H
+#define THUMBNAIL_H
+
+#include "../client/sim_loader.h"
+#include "raylib.h"
+
+/**
+ * @brief Tile sheet for software rendering, with cells resampled per scale
+ *
+ * Everything here is CPU-side Image work, so thumbnails can be rendered
+ * without a window or GL context.
+ */
+typedef struct {
+  Image sheet; // RGBA8 tile sheet
+  int tile_width;
+  int tile_height;
+  int gap;
+  int columns;
+  int rows;
+  Color **cells;  // Resampled cell pixels, lazily filled, columns * rows
+  int cell_size;  // Edge length of every resampled cell
+} ThumbnailSheet;
+
+/**
+ * @brief Loads a tile sheet for thumbnail rendering
+ * @param sheet Sheet to initialize
+ * @param tiles_path Path to the tile sheet (same layout as the game atlas)
+ * @param tile_width Width of one cell in pixels
+ * @param tile_height Height of one cell in pixels
+ * @param gap Gap between cells in pixels
+ * @return bool False if the image could not be loaded
+ */
+bool thumbnail_load_sheet(ThumbnailSheet *sheet, const char *tiles_path,
+                          int tile_width, int tile_height, int gap);
+
+/**
+ * @brief Frees the sheet image and its resampled cells
+ */
+void thumbnail_unload_sheet(ThumbnailSheet *sheet);
+
+/**
+ * @brief Scale that fits the whole map into max_size pixels on its long side
+ */
+float thumbnail_fit_scale(const TileMap *map, int max_size);
+
+/**
+ * @brief Rasterizes the map, objects and units of a state into an Image
+ *
+ * Tiles are box-filtered down to the target scale once per sheet, so
+ * repeated renders at the same scale only pay for the per-pixel lookup.
+ *
+ * @param sheet Loaded tile sheet; resampled cells are cached on it
+ * @param sim State to draw
+ * @param pixels_per_tile Output pixels per map tile (fractions allowed)
+ * @return Image RGBA8 image, data is NULL on failure
+ */
+Image thumbnail_render(ThumbnailSheet *sheet, const SimulationState *sim,
+                       float pixels_per_tile);
+
+#endif
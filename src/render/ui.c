@@ -1,8 +1,14 @@
 #include "ui.h"
+#include "../map/paged_map.h"
 #include "../utils/math_utils.h"
+#include "../utils/mem_track.h"
+#include "../utils/profiler.h"
 #include "renderer.h"
+#include "rlgl.h"
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 // Internal constants - now relative to screen size
 #define UI_PANEL_HEIGHT_RATIO 0.15f       // 15% of screen height
@@ -16,11 +22,19 @@
 #define UI_MIN_STATUS_WIDTH 180
 #define UI_MIN_TOP_BAR_HEIGHT 25
 
+// Minimap layer resolutions: the terrain is baked at one pixel per tile up
+// to this size, the entity overlay is a fixed square splatted once per tick
+#define UI_MINIMAP_MAX_TERRAIN_SIZE 1024
+#define UI_MINIMAP_OVERLAY_SIZE 256
+
 // Color constants
 static const Color UI_PANEL_COLOR = {0, 0, 0, 230};
 static const Color UI_BORDER_COLOR = {255, 215, 0, 255};
 static const Color UI_STATUS_PANEL_COLOR = {169, 169, 169, 178};
 static const Color UI_COMMAND_PANEL_COLOR = {139, 69, 19, 153};
+static const Color UI_SPAWN_MARKER_COLOR = {0, 228, 48, 255};
+static const Color UI_DEATH_MARKER_COLOR = {230, 41, 55, 255};
+static const Color UI_JUMP_MARKER_COLOR = {200, 122, 255, 255};
 
 // Helper macros for min/max if not available
 #ifndef max
@@ -31,6 +45,118 @@ static const Color UI_COMMAND_PANEL_COLOR = {139, 69, 19, 153};
 #define min(a, b) (((a) < (b)) ? (a) : (b))
 #endif
 
+// Baked minimap layers; both are rebuilt only when their inputs change
+typedef struct {
+  Texture2D terrain;
+  const Tile *terrain_tiles; // Map the terrain layer was baked from
+  int terrain_map_width;
+  int terrain_map_height;
+  bool terrain_dirty;
+
+  Texture2D overlay;
+  Color *overlay_pixels;
+  const SimulationState *overlay_sim;
+  int overlay_tick;
+  int overlay_age;      // Draws since the entity layer was last refreshed
+  int overlay_interval; // Minimum draws between refreshes
+} MinimapCache;
+
+static MinimapCache g_minimap = {.overlay_tick = -1, .overlay_interval = 1};
+
+// Everything a retained panel's pixels depend on; all ints so keys compare
+// with memcmp
+typedef struct {
+  int width;
+  int height;
+  int values[7]; // Panel-specific content inputs
+} UIPanelKey;
+
+// A panel drawn into its own render texture and redrawn only when its key
+// changes
+typedef struct {
+  RenderTexture2D target;
+  UIPanelKey key;
+  bool valid;
+} UIPanelCache;
+
+static UIPanelCache g_main_panel = {0};
+static UIPanelCache g_top_bar = {0};
+
+// Per-column summaries of the timeline chart, kept between redraws
+static TimelineSummary *g_chart_columns = NULL;
+static int g_chart_capacity = 0;
+
+static void ui_panel_release(UIPanelCache *panel) {
+  if (panel->target.id > 0) {
+    mem_track_texture_unloaded(panel->target.texture.width,
+                               panel->target.texture.height,
+                               MEM_TRACK_RENDER_TEXTURE_BPP);
+    UnloadRenderTexture(panel->target);
+  }
+  *panel = (UIPanelCache){0};
+}
+
+static void ui_release_texture(Texture2D *texture) {
+  if (texture->id > 0) {
+    mem_track_texture_unloaded(texture->width, texture->height,
+                               MEM_TRACK_TEXTURE_BPP);
+    UnloadTexture(*texture);
+  }
+  *texture = (Texture2D){0};
+}
+
+// Returns true when the panel must be redrawn, with drawing redirected into
+// its texture until ui_panel_end. Panel content uses local coordinates.
+static bool ui_panel_begin(UIPanelCache *panel, const UIPanelKey *key) {
+  if (panel->valid && memcmp(&panel->key, key, sizeof(*key)) == 0)
+    return false;
+
+  if (panel->target.texture.width != key->width ||
+      panel->target.texture.height != key->height) {
+    ui_panel_release(panel);
+    panel->target = LoadRenderTexture(key->width, key->height);
+    if (panel->target.id > 0)
+      mem_track_texture_loaded(key->width, key->height,
+                               MEM_TRACK_RENDER_TEXTURE_BPP);
+  }
+  panel->key = *key;
+  panel->valid = panel->target.id > 0;
+  if (!panel->valid)
+    return false;
+
+  // Switching render targets submits whatever is batched so far
+  renderer_track_flush(0);
+  BeginTextureMode(panel->target);
+  ClearBackground(BLANK);
+  // Accumulate premultiplied colour with straight coverage in alpha, so the
+  // translucent panel composites the same as when drawn directly
+  rlSetBlendFactorsSeparate(RL_SRC_ALPHA, RL_ONE_MINUS_SRC_ALPHA, RL_ONE,
+                            RL_ONE_MINUS_SRC_ALPHA, RL_FUNC_ADD, RL_FUNC_ADD);
+  BeginBlendMode(BLEND_CUSTOM_SEPARATE);
+  return true;
+}
+
+static void ui_panel_end(void) {
+  EndBlendMode();
+  EndTextureMode();
+  renderer_track_flush(0);
+}
+
+static void ui_panel_draw(const UIPanelCache *panel, int x, int y) {
+  if (!panel->valid)
+    return;
+  // Render textures are stored bottom-up; a negative height flips them back
+  BeginBlendMode(BLEND_ALPHA_PREMULTIPLY);
+  DrawTexturePro(panel->target.texture,
+                 (Rectangle){0, 0, (float)panel->key.width,
+                             (float)-panel->key.height},
+                 (Rectangle){(float)x, (float)y, (float)panel->key.width,
+                             (float)panel->key.height},
+                 (Vector2){0, 0}, 0.0f, WHITE);
+  EndBlendMode();
+}
+
+
 UIConfig ui_get_default_config(void) {
   int screen_width = GetScreenWidth();
   int screen_height = GetScreenHeight();
@@ -47,65 +173,201 @@ UIConfig ui_get_default_config(void) {
                             UI_MIN_TOP_BAR_HEIGHT)};
 }
 
-void ui_draw_minimap(const SimulationState *sim, const Camera2D_RTS *camera,
-                     int x, int y, int size) {
-  // Mini-map background with border
-  DrawRectangle(x, y, size, size, (Color){0, 0, 50, 255});
-  DrawRectangleLines(x, y, size, size, UI_BORDER_COLOR);
-  DrawRectangleLines(x - 1, y - 1, size + 2, size + 2, (Color){0, 0, 0, 255});
+static Color ui_minimap_tile_color(const Tile *tile) {
+  (void)tile;
+  Color color = UI_BORDER_COLOR;
+  color.a = (unsigned char)(255 * 0.7f);
+  return color;
+}
 
-  // Calculate scaling factors
-  float scale_x = (float)size / sim->map.width;
-  float scale_y = (float)size / sim->map.height;
-
-  // Draw map tiles with better scaling for small maps
-  for (int y_pos = 0; y_pos < sim->map.height; y_pos++) {
-    for (int x_pos = 0; x_pos < sim->map.width; x_pos++) {
-      RawTileKey tile = sim->map.tiles[y_pos * sim->map.width + x_pos].raw_key;
-      Color color = UI_BORDER_COLOR;
-      color.a = (unsigned char)(255 * 0.7f);
-
-      int pixel_x = x + (int)(x_pos * scale_x);
-      int pixel_y = y + (int)(y_pos * scale_y);
-      int pixel_width = max(1, (int)ceil(scale_x));
-      int pixel_height = max(1, (int)ceil(scale_y));
-
-      DrawRectangle(pixel_x, pixel_y, pixel_width, pixel_height, color);
+// Paged maps are drawn from their resident overview rather than paging in
+// every chunk
+static const TileMap *ui_minimap_terrain_source(const TileMap *map) {
+  return map->paged ? paged_map_overview(map->paged) : map;
+}
+
+// Rasterizes the terrain on the CPU, one pixel per tile (nearest-sampled
+// down for maps larger than the cap), and uploads it as a single texture
+static void ui_bake_minimap_terrain(const TileMap *map) {
+  ui_release_texture(&g_minimap.terrain);
+
+  int width = min(map->width, UI_MINIMAP_MAX_TERRAIN_SIZE);
+  int height = min(map->height, UI_MINIMAP_MAX_TERRAIN_SIZE);
+  if (width <= 0 || height <= 0)
+    return;
+
+  Image image = GenImageColor(width, height, BLANK);
+  Color *pixels = (Color *)image.data;
+  for (int py = 0; py < height; py++) {
+    int tile_y = (int)((long)py * map->height / height);
+    for (int px = 0; px < width; px++) {
+      int tile_x = (int)((long)px * map->width / width);
+      pixels[py * width + px] =
+          ui_minimap_tile_color(&map->tiles[(size_t)tile_y * map->width +
+                                            tile_x]);
+    }
+  }
+
+  g_minimap.terrain = LoadTextureFromImage(image);
+  if (g_minimap.terrain.id > 0)
+    mem_track_texture_loaded(width, height, MEM_TRACK_TEXTURE_BPP);
+  UnloadImage(image);
+
+  g_minimap.terrain_tiles = map->tiles;
+  g_minimap.terrain_map_width = map->width;
+  g_minimap.terrain_map_height = map->height;
+  g_minimap.terrain_dirty = false;
+}
+
+static void ui_overlay_fill_rect(int x, int y, int width, int height,
+                                 Color color) {
+  int x0 = max(0, x), y0 = max(0, y);
+  int x1 = min(UI_MINIMAP_OVERLAY_SIZE, x + width);
+  int y1 = min(UI_MINIMAP_OVERLAY_SIZE, y + height);
+  for (int py = y0; py < y1; py++) {
+    for (int px = x0; px < x1; px++)
+      g_minimap.overlay_pixels[py * UI_MINIMAP_OVERLAY_SIZE + px] = color;
+  }
+}
+
+static void ui_overlay_fill_circle(int cx, int cy, int radius, Color color) {
+  for (int dy = -radius; dy <= radius; dy++) {
+    int py = cy + dy;
+    if (py < 0 || py >= UI_MINIMAP_OVERLAY_SIZE)
+      continue;
+    for (int dx = -radius; dx <= radius; dx++) {
+      int px = cx + dx;
+      if (px < 0 || px >= UI_MINIMAP_OVERLAY_SIZE ||
+          dx * dx + dy * dy > radius * radius)
+        continue;
+      g_minimap.overlay_pixels[py * UI_MINIMAP_OVERLAY_SIZE + px] = color;
     }
   }
+}
+
+// Splats objects and units into the CPU overlay and uploads it in one go
+static void ui_update_minimap_overlay(const SimulationState *sim) {
+  if (!g_minimap.overlay_pixels) {
+    g_minimap.overlay_pixels = (Color *)mem_track_malloc(
+        MEM_SUBSYSTEM_CACHES,
+        UI_MINIMAP_OVERLAY_SIZE * UI_MINIMAP_OVERLAY_SIZE * sizeof(Color));
+    if (!g_minimap.overlay_pixels)
+      return;
+  }
+  if (g_minimap.overlay.id == 0) {
+    Image image = GenImageColor(UI_MINIMAP_OVERLAY_SIZE,
+                                UI_MINIMAP_OVERLAY_SIZE, BLANK);
+    g_minimap.overlay = LoadTextureFromImage(image);
+    if (g_minimap.overlay.id > 0)
+      mem_track_texture_loaded(UI_MINIMAP_OVERLAY_SIZE,
+                               UI_MINIMAP_OVERLAY_SIZE, MEM_TRACK_TEXTURE_BPP);
+    UnloadImage(image);
+  }
 
-  // Draw objects on mini-map (as small dots)
+  memset(g_minimap.overlay_pixels, 0,
+         UI_MINIMAP_OVERLAY_SIZE * UI_MINIMAP_OVERLAY_SIZE * sizeof(Color));
+
+  float scale_x = (float)UI_MINIMAP_OVERLAY_SIZE / sim->map.width;
+  float scale_y = (float)UI_MINIMAP_OVERLAY_SIZE / sim->map.height;
+
+  // Objects as small dots
   for (int i = 0; i < sim->objectCount; i++) {
     Object obj = sim->objects[i];
-    int pixel_x = x + (int)(obj.x * scale_x);
-    int pixel_y = y + (int)(obj.y * scale_y);
-    DrawCircle(pixel_x, pixel_y, max(1, (int)(2 * scale_x)), PURPLE);
+    ui_overlay_fill_circle((int)(obj.x * scale_x), (int)(obj.y * scale_y),
+                           max(1, (int)(2 * scale_x)), PURPLE);
   }
 
-  // Draw units on mini-map (colored by owner, proportional rectangles)
+  // Units colored by owner, proportional rectangles with a dark border
   for (int i = 0; i < sim->unitCount; i++) {
     Unit unit = sim->units[i];
-
-    // Calculate unit position and size in minimap pixels
-    int unit_x = x + (int)(unit.x * scale_x);
-    int unit_y = y + (int)(unit.y * scale_y);
-
-    // Use unit's actual size scaled down for the minimap
     int unit_width = max(1, (int)(unit.size * scale_x));
     int unit_height = max(1, (int)(unit.size * scale_y));
+    int unit_x = (int)(unit.x * scale_x) - unit_width / 2;
+    int unit_y = (int)(unit.y * scale_y) - unit_height / 2;
+
+    if (unit_width > 2 && unit_height > 2) {
+      ui_overlay_fill_rect(unit_x, unit_y, unit_width, unit_height, BLACK);
+      ui_overlay_fill_rect(unit_x + 1, unit_y + 1, unit_width - 2,
+                           unit_height - 2, renderer_owner_color(unit.owner));
+    } else {
+      ui_overlay_fill_rect(unit_x, unit_y, unit_width, unit_height,
+                           renderer_owner_color(unit.owner));
+    }
+  }
 
-    // Adjust position so unit is centered at its actual position
-    unit_x -= unit_width / 2;
-    unit_y -= unit_height / 2;
+  UpdateTexture(g_minimap.overlay, g_minimap.overlay_pixels);
+}
+
+void ui_invalidate_minimap_terrain(void) { g_minimap.terrain_dirty = true; }
+
+void ui_invalidate_panels(void) {
+  g_main_panel.valid = false;
+  g_top_bar.valid = false;
+}
 
-    Color unit_color = (unit.owner == 1) ? RED : YELLOW;
+void ui_cleanup_panels(void) {
+  ui_panel_release(&g_main_panel);
+  ui_panel_release(&g_top_bar);
+  mem_track_free(g_chart_columns);
+  g_chart_columns = NULL;
+  g_chart_capacity = 0;
+}
 
-    // Draw filled rectangle for the unit
-    DrawRectangle(unit_x, unit_y, unit_width, unit_height, unit_color);
+void ui_set_minimap_update_interval(int frames) {
+  g_minimap.overlay_interval = frames > 1 ? frames : 1;
+}
 
-    // Optional: Add a border to make units more visible
-    DrawRectangleLines(unit_x, unit_y, unit_width, unit_height,
-                       (Color){0, 0, 0, 255});
+void ui_cleanup_minimap(void) {
+  ui_release_texture(&g_minimap.terrain);
+  ui_release_texture(&g_minimap.overlay);
+  mem_track_free(g_minimap.overlay_pixels);
+  g_minimap = (MinimapCache){.overlay_tick = -1,
+                             .overlay_interval = g_minimap.overlay_interval};
+}
+
+void ui_draw_minimap(const SimulationState *sim, const TileMap *map,
+                     const Camera2D_RTS *camera, int x, int y, int size,
+                     int current_tick) {
+  // Mini-map background with border
+  DrawRectangle(x, y, size, size, (Color){0, 0, 50, 255});
+  DrawRectangleLines(x, y, size, size, UI_BORDER_COLOR);
+  DrawRectangleLines(x - 1, y - 1, size + 2, size + 2, (Color){0, 0, 0, 255});
+
+  // Calculate scaling factors
+  float scale_x = (float)size / map->width;
+  float scale_y = (float)size / map->height;
+  Rectangle dest_rect = {x, y, size, size};
+
+  // Terrain layer, re-baked only when the tiles change
+  const TileMap *terrain = ui_minimap_terrain_source(map);
+  if (g_minimap.terrain_dirty || g_minimap.terrain.id == 0 ||
+      g_minimap.terrain_tiles != terrain->tiles ||
+      g_minimap.terrain_map_width != terrain->width ||
+      g_minimap.terrain_map_height != terrain->height)
+    ui_bake_minimap_terrain(terrain);
+  if (g_minimap.terrain.id > 0) {
+    DrawTexturePro(g_minimap.terrain,
+                   (Rectangle){0, 0, g_minimap.terrain.width,
+                               g_minimap.terrain.height},
+                   dest_rect, (Vector2){0, 0}, 0.0f, WHITE);
+  }
+
+  // Entity layer, re-splatted once per tick but no more often than the
+  // refresh interval allows
+  g_minimap.overlay_age++;
+  if ((g_minimap.overlay_tick != current_tick || g_minimap.overlay_sim != sim) &&
+      (g_minimap.overlay.id == 0 ||
+       g_minimap.overlay_age >= g_minimap.overlay_interval)) {
+    ui_update_minimap_overlay(sim);
+    g_minimap.overlay_tick = current_tick;
+    g_minimap.overlay_sim = sim;
+    g_minimap.overlay_age = 0;
+  }
+  if (g_minimap.overlay.id > 0) {
+    DrawTexturePro(g_minimap.overlay,
+                   (Rectangle){0, 0, UI_MINIMAP_OVERLAY_SIZE,
+                               UI_MINIMAP_OVERLAY_SIZE},
+                   dest_rect, (Vector2){0, 0}, 0.0f, WHITE);
   }
 
   // Draw viewport rectangle
@@ -130,8 +392,245 @@ void ui_draw_minimap(const SimulationState *sim, const Camera2D_RTS *camera,
     DrawRectangleLines(x, y, size, size, WHITE);
   }
 }
+// Tick panel within the main panel, in panel coordinates; empty when the
+// screen is too narrow to show it
+static Rectangle ui_tick_panel_rect(const UIConfig *config) {
+  int status_panel_x = 10 + config->minimap_size + 10;
+  int x = status_panel_x + config->status_panel_width + 10;
+  int width = GetScreenWidth() - x - 10;
+  if (width <= 200)
+    return (Rectangle){0};
+  return (Rectangle){(float)x, 10.0f, (float)width,
+                     (float)(config->panel_height - 20)};
+}
+
+static int ui_tick_controls_text_size(int height) {
+  return max(10, height / 8);
+}
+
+// Chart area of the tick controls, below a line of text
+static Rectangle ui_tick_chart_rect(int x, int y, int width, int height) {
+  int top = ui_tick_controls_text_size(height) + 12;
+  return (Rectangle){(float)(x + 8), (float)(y + top), (float)(width - 16),
+                     (float)max(0, height - top - 8)};
+}
+
+// Tick range of one chart column, as the timeline splits it
+static void ui_chart_column_ticks(int column, int columns, int tick_count,
+                                  int *first, int *end) {
+  *first = (int)((long long)tick_count * column / columns);
+  *end = (int)((long long)tick_count * (column + 1) / columns);
+  if (*end <= *first)
+    *end = *first + 1;
+}
+
+static bool ui_chart_reserve(int columns) {
+  if (columns <= g_chart_capacity)
+    return true;
+  TimelineSummary *grown = (TimelineSummary *)mem_track_realloc(
+      MEM_SUBSYSTEM_CACHES, g_chart_columns,
+      (size_t)columns * sizeof(TimelineSummary));
+  if (!grown)
+    return false;
+  g_chart_columns = grown;
+  g_chart_capacity = columns;
+  return true;
+}
+
+static float ui_chart_y(Rectangle chart, float value, float scale) {
+  return chart.y + chart.height - value * scale;
+}
+
+// Range of total units as a band, then each owner's mean as a line
+static void ui_draw_timeline_chart(Rectangle chart, const Timeline *timeline,
+                                   int tick_count) {
+  int columns = (int)chart.width;
+  int covered = timeline_ticks_covered(timeline);
+  if (columns <= 0 || covered == 0 || !ui_chart_reserve(columns))
+    return;
+
+  float highest = timeline_summary(timeline, TIMELINE_UNITS, 0, covered).max;
+  float scale = (chart.height - 1) / (highest > 0.0f ? highest : 1.0f);
+
+  timeline_columns(timeline, TIMELINE_UNITS, 0, tick_count, columns,
+                   g_chart_columns);
+  Color band = {200, 200, 200, 110};
+  for (int c = 0; c < columns; c++) {
+    const TimelineSummary *column = &g_chart_columns[c];
+    if (column->ticks == 0)
+      break;
+    float top = ui_chart_y(chart, column->max, scale);
+    float bottom = ui_chart_y(chart, column->min, scale);
+    DrawRectangleRec((Rectangle){chart.x + c, top, 1.0f,
+                                 fmaxf(1.0f, bottom - top)},
+                     band);
+  }
+
+  for (int owner = 1; owner <= TIMELINE_MAX_OWNERS; owner++) {
+    TimelineSeries series = TIMELINE_OWNER_UNITS + owner - 1;
+    if (timeline_summary(timeline, series, 0, covered).max <= 0.0f)
+      continue;
+    timeline_columns(timeline, series, 0, tick_count, columns,
+                     g_chart_columns);
+    Color color = renderer_owner_color(owner);
+    for (int c = 1; c < columns && g_chart_columns[c].ticks > 0; c++)
+      DrawLineV((Vector2){chart.x + c - 0.5f,
+                          ui_chart_y(chart, g_chart_columns[c - 1].mean,
+                                     scale)},
+                (Vector2){chart.x + c + 0.5f,
+                          ui_chart_y(chart, g_chart_columns[c].mean, scale)},
+                color);
+  }
+}
+
+// Marker length grows with the log of the event count, up to 6 pixels
+static float ui_marker_length(int count) {
+  int length = 0;
+  while (count > 0 && length < 6) {
+    length++;
+    count >>= 1;
+  }
+  return (float)length;
+}
+
+// Spawns rise from the bottom edge, deaths hang from the top and jumps sit
+// just above the spawns; each column counts its ticks in O(1)
+static void ui_draw_event_markers(Rectangle chart, const UnitEvents *events,
+                                  int tick_count) {
+  int columns = (int)chart.width;
+  int covered = unit_events_ticks_covered(events);
+  float bottom = chart.y + chart.height;
+  for (int c = 0; c < columns; c++) {
+    int first, end;
+    ui_chart_column_ticks(c, columns, tick_count, &first, &end);
+    if (first >= covered)
+      break;
+    float spawned = ui_marker_length(
+        unit_events_count(events, UNIT_EVENT_SPAWNED, first, end));
+    float died = ui_marker_length(
+        unit_events_count(events, UNIT_EVENT_DIED, first, end));
+    float jumped = ui_marker_length(
+        unit_events_count(events, UNIT_EVENT_MOVED_FAR, first, end));
+    if (spawned > 0.0f)
+      DrawRectangleRec((Rectangle){chart.x + c, bottom - spawned, 1.0f,
+                                   spawned},
+                       UI_SPAWN_MARKER_COLOR);
+    if (died > 0.0f)
+      DrawRectangleRec((Rectangle){chart.x + c, chart.y, 1.0f, died},
+                       UI_DEATH_MARKER_COLOR);
+    if (jumped > 0.0f)
+      DrawRectangleRec((Rectangle){chart.x + c, bottom - 7.0f, 1.0f, 1.0f},
+                       UI_JUMP_MARKER_COLOR);
+  }
+}
+
 void ui_draw_tick_controls(int x, int y, int width, int height,
-                           int current_tick, int max_tick, bool paused) {}
+                           const Timeline *timeline, const UnitEvents *events,
+                           int current_tick, int max_tick, bool paused) {
+  int text_size = ui_tick_controls_text_size(height);
+  DrawText(TextFormat("Tick %d / %d%s", current_tick, max_tick,
+                      paused ? "  (paused)" : ""),
+           x + 8, y + 6, text_size, RAYWHITE);
+
+  Rectangle chart = ui_tick_chart_rect(x, y, width, height);
+  if (chart.width <= 0 || chart.height <= 0)
+    return;
+  DrawRectangleRec(chart, (Color){0, 0, 0, 120});
+
+  int tick_count = max(max_tick + 1, 1);
+  if (timeline)
+    ui_draw_timeline_chart(chart, timeline, tick_count);
+  if (events)
+    ui_draw_event_markers(chart, events, tick_count);
+
+  float cursor = chart.x + (current_tick + 0.5f) * chart.width / tick_count;
+  DrawLineV((Vector2){cursor, chart.y},
+            (Vector2){cursor, chart.y + chart.height}, RAYWHITE);
+  DrawRectangleLinesEx(chart, 1.0f, UI_BORDER_COLOR);
+}
+
+bool ui_tick_controls_tick_at(Vector2 point, int max_tick, int *tick) {
+  UIConfig config = ui_get_default_config();
+  Rectangle panel = ui_tick_panel_rect(&config);
+  int panel_y = GetScreenHeight() - config.panel_height;
+  Rectangle chart =
+      ui_tick_chart_rect((int)panel.x, (int)panel.y + panel_y,
+                         (int)panel.width, (int)panel.height);
+  if (panel.width <= 0 || chart.width <= 0 ||
+      !CheckCollisionPointRec(point, chart))
+    return false;
+
+  int tick_count = max(max_tick + 1, 1);
+  int first, end;
+  ui_chart_column_ticks((int)(point.x - chart.x), (int)chart.width,
+                        tick_count, &first, &end);
+  *tick = min(first, max_tick);
+  return true;
+}
+
+// Summary of the ticks under the mouse, next to the cursor
+static void ui_draw_timeline_tooltip(const Timeline *timeline,
+                                     const UnitEvents *events, int max_tick,
+                                     int panel_y, Rectangle panel) {
+  Vector2 mouse = GetMousePosition();
+  Rectangle chart =
+      ui_tick_chart_rect((int)panel.x, (int)panel.y + panel_y,
+                         (int)panel.width, (int)panel.height);
+  if (chart.width <= 0 || !CheckCollisionPointRec(mouse, chart))
+    return;
+
+  int first, end;
+  ui_chart_column_ticks((int)(mouse.x - chart.x), (int)chart.width,
+                        max(max_tick + 1, 1), &first, &end);
+  TimelineSummary units =
+      timeline_summary(timeline, TIMELINE_UNITS, first, end);
+  if (units.ticks == 0)
+    return;
+
+  char lines[TIMELINE_MAX_OWNERS + 5][64];
+  int count = 0;
+  if (end - first > 1)
+    snprintf(lines[count++], sizeof(lines[0]), "Ticks %d-%d", first, end - 1);
+  else
+    snprintf(lines[count++], sizeof(lines[0]), "Tick %d", first);
+  snprintf(lines[count++], sizeof(lines[0]), "Units %.0f-%.0f, mean %.1f",
+           units.min, units.max, units.mean);
+  for (int owner = 1; owner <= TIMELINE_MAX_OWNERS; owner++) {
+    TimelineSummary owned = timeline_summary(
+        timeline, TIMELINE_OWNER_UNITS + owner - 1, first, end);
+    if (owned.max > 0.0f)
+      snprintf(lines[count++], sizeof(lines[0]), "Owner %d: mean %.1f", owner,
+               owned.mean);
+  }
+  TimelineSummary objects =
+      timeline_summary(timeline, TIMELINE_OBJECTS, first, end);
+  TimelineSummary speed =
+      timeline_summary(timeline, TIMELINE_MEAN_SPEED, first, end);
+  snprintf(lines[count++], sizeof(lines[0]), "Objects: mean %.1f",
+           objects.mean);
+  snprintf(lines[count++], sizeof(lines[0]), "Speed: mean %.2f", speed.mean);
+  if (events && first < unit_events_ticks_covered(events))
+    snprintf(lines[count++], sizeof(lines[0]),
+             "Spawned %d, died %d, jumped %d",
+             unit_events_count(events, UNIT_EVENT_SPAWNED, first, end),
+             unit_events_count(events, UNIT_EVENT_DIED, first, end),
+             unit_events_count(events, UNIT_EVENT_MOVED_FAR, first, end));
+
+  const int font_size = 10;
+  int width = 0;
+  for (int i = 0; i < count; i++)
+    width = max(width, MeasureText(lines[i], font_size));
+  int box_width = width + 12;
+  int box_height = count * (font_size + 2) + 10;
+  int box_x = min((int)mouse.x + 12, GetScreenWidth() - box_width - 4);
+  int box_y = max(4, (int)chart.y - box_height - 4);
+
+  DrawRectangle(box_x, box_y, box_width, box_height, UI_PANEL_COLOR);
+  DrawRectangleLines(box_x, box_y, box_width, box_height, UI_BORDER_COLOR);
+  for (int i = 0; i < count; i++)
+    DrawText(lines[i], box_x + 6, box_y + 5 + i * (font_size + 2), font_size,
+             RAYWHITE);
+}
 
 void ui_draw_status_panel(int x, int y, int width, int height,
                           const SimulationState *sim,
@@ -148,52 +647,94 @@ void ui_draw_status_panel(int x, int y, int width, int height,
 
 void ui_draw_top_bar(int current_tick, int max_tick, bool paused) {
   UIConfig config = ui_get_default_config();
+  int screen_width = GetScreenWidth();
 
-  Color top_bar_color = {0, 0, 0, 204};
-  DrawRectangle(0, 0, GetScreenWidth(), config.top_bar_height, top_bar_color);
-  DrawRectangle(0, config.top_bar_height, GetScreenWidth(), 1, UI_BORDER_COLOR);
+  // World-layer draw calls for the frame, to verify batching at a glance.
+  // They only change when the view does, so a still frame reuses the bar.
+  RendererFrameStats stats = renderer_get_frame_stats();
+  UIPanelKey key = {.width = screen_width,
+                    .height = config.top_bar_height + 1,
+                    .values = {stats.draw_calls, stats.chunks_drawn,
+                               stats.sprites_drawn}};
+
+  if (ui_panel_begin(&g_top_bar, &key)) {
+    Color top_bar_color = {0, 0, 0, 204};
+    DrawRectangle(0, 0, screen_width, config.top_bar_height, top_bar_color);
+    DrawRectangle(0, config.top_bar_height, screen_width, 1, UI_BORDER_COLOR);
+
+    int font_size = max(10, config.top_bar_height - 10);
+    const char *stats_text =
+        TextFormat("Draw calls: %d  Chunks: %d  Sprites: %d", stats.draw_calls,
+                   stats.chunks_drawn, stats.sprites_drawn);
+    DrawText(stats_text, screen_width - MeasureText(stats_text, font_size) - 10,
+             (config.top_bar_height - font_size) / 2, font_size, RAYWHITE);
+    ui_panel_end();
+  }
+  ui_panel_draw(&g_top_bar, 0, 0);
 }
 
-void ui_draw_main_panel(const SimulationState *sim, const Camera2D_RTS *camera,
-                        int current_tick, int max_tick, bool paused) {
+void ui_draw_main_panel(const SimulationState *sim, const TileMap *map,
+                        const Camera2D_RTS *camera, const Timeline *timeline,
+                        const UnitEvents *events, int current_tick,
+                        int max_tick, bool paused) {
   int screen_width = GetScreenWidth();
   int screen_height = GetScreenHeight();
   UIConfig config = ui_get_default_config();
-
-  // Main panel background
-  DrawRectangle(0, screen_height - config.panel_height, screen_width,
-                config.panel_height, UI_PANEL_COLOR);
-  DrawRectangle(0, screen_height - config.panel_height, screen_width, 2,
-                UI_BORDER_COLOR);
+  int panel_y = screen_height - config.panel_height;
 
   // Calculate layout with proper spacing
   int panel_inner_height = config.panel_height - 20; // 10px top/bottom margin
 
   // Mini-map on left edge
   int minimap_x = 10;
-  int minimap_y = screen_height - config.panel_height + 10;
+  int minimap_y = panel_y + 10;
 
   // Status panel (moved right to make space for minimap)
   int status_panel_x = minimap_x + config.minimap_size + 10;
-  ui_draw_status_panel(status_panel_x, screen_height - config.panel_height + 10,
-                       config.status_panel_width, panel_inner_height, sim,
-                       camera, current_tick, max_tick, paused);
 
   // Tick controls panel
-  int tick_panel_x = status_panel_x + config.status_panel_width + 10;
-  int tick_panel_width = screen_width - tick_panel_x - 10;
-
-  if (tick_panel_width > 200) { // Only draw if there's reasonable space
-    DrawRectangle(tick_panel_x, screen_height - config.panel_height + 10,
-                  tick_panel_width, panel_inner_height, UI_COMMAND_PANEL_COLOR);
-    DrawRectangleLines(tick_panel_x, screen_height - config.panel_height + 10,
-                       tick_panel_width, panel_inner_height, UI_BORDER_COLOR);
-
-    ui_draw_tick_controls(
-        tick_panel_x, screen_height - config.panel_height + 10,
-        tick_panel_width, panel_inner_height, current_tick, max_tick, paused);
+  Rectangle tick_panel = ui_tick_panel_rect(&config);
+
+  // The panel body is retained; add anything new the status or tick panels
+  // display to the key. The minimap and the timeline tooltip follow the
+  // mouse and camera and are drawn live.
+  UIPanelKey key = {
+      .width = screen_width,
+      .height = config.panel_height,
+      .values = {current_tick, max_tick, paused, sim->unitCount,
+                 sim->objectCount,
+                 timeline ? timeline_ticks_covered(timeline) : 0,
+                 events ? unit_events_ticks_covered(events) : 0}};
+
+  if (ui_panel_begin(&g_main_panel, &key)) {
+    // Main panel background
+    DrawRectangle(0, 0, screen_width, config.panel_height, UI_PANEL_COLOR);
+    DrawRectangle(0, 0, screen_width, 2, UI_BORDER_COLOR);
+
+    ui_draw_status_panel(status_panel_x, 10, config.status_panel_width,
+                         panel_inner_height, sim, camera, current_tick,
+                         max_tick, paused);
+
+    if (tick_panel.width > 0) { // Only drawn if there's reasonable space
+      DrawRectangleRec(tick_panel, UI_COMMAND_PANEL_COLOR);
+      DrawRectangleLinesEx(tick_panel, 1.0f, UI_BORDER_COLOR);
+
+      ui_draw_tick_controls((int)tick_panel.x, (int)tick_panel.y,
+                            (int)tick_panel.width, (int)tick_panel.height,
+                            timeline, events, current_tick, max_tick,
+                            paused);
+    }
+    ui_panel_end();
   }
+  ui_panel_draw(&g_main_panel, 0, panel_y);
 
   // Draw minimap (always on left edge)
-  ui_draw_minimap(sim, camera, minimap_x, minimap_y, config.minimap_size);
+  profiler_stage_begin(PROFILER_STAGE_MINIMAP);
+  ui_draw_minimap(sim, map, camera, minimap_x, minimap_y,
+                  config.minimap_size, current_tick);
+  profiler_stage_end(PROFILER_STAGE_MINIMAP);
+
+  if (timeline && tick_panel.width > 0)
+    ui_draw_timeline_tooltip(timeline, events, max_tick, panel_y,
+                             tick_panel);
 }
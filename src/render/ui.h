@@ -2,6 +2,8 @@
 #define UI_H
 
 #include "../client/sim_loader.h"
+#include "../client/timeline.h"
+#include "../client/unit_events.h"
 #include "camera.h"
 #include "raylib.h"
 
@@ -28,36 +30,89 @@ typedef struct {
 /**
  * @brief Draws the mini-map representation of the simulation
  *
+ * The terrain layer is baked into a texture when the map changes and the
+ * entity layer is splatted into a CPU pixel buffer and uploaded once per
+ * tick, so drawing costs the same regardless of map size or unit count.
+ *
  * @param sim Simulation state to visualize
+ * @param map Terrain drawn under it; paged maps use their overview
  * @param camera Current camera view for viewport rectangle
  * @param x X position of mini-map
  * @param y Y position of mini-map
  * @param size Size of the mini-map (width and height)
+ * @param current_tick Tick shown by sim, used to refresh the entity layer
  */
-void ui_draw_minimap(const SimulationState *sim, const Camera2D_RTS *camera,
-                     int x, int y, int size);
+void ui_draw_minimap(const SimulationState *sim, const TileMap *map,
+                     const Camera2D_RTS *camera, int x, int y, int size,
+                     int current_tick);
+
+/**
+ * @brief Forces the minimap terrain layer to be re-baked on its next draw
+ *
+ * Call after tiles of the displayed map were modified in place.
+ */
+void ui_invalidate_minimap_terrain(void);
+
+/**
+ * @brief Limits how often the minimap entity layer is re-splatted
+ *
+ * @param frames Minimum number of minimap draws between refreshes; 1
+ * refreshes on every new tick
+ */
+void ui_set_minimap_update_interval(int frames);
+
+/**
+ * @brief Releases the minimap textures (requires a live GL context)
+ */
+void ui_cleanup_minimap(void);
 
 /**
  * @brief Draws the main control panel at the bottom of the screen
  *
+ * The panel body (background, status and tick panels) is kept in a render
+ * texture and redrawn only when the tick, pause state, entity counts,
+ * summarized or matched ticks or screen size change; the minimap on top of
+ * it and the timeline tooltip are drawn every frame.
+ *
  * @param sim Current simulation state
+ * @param map Terrain shown in the minimap
  * @param camera Active camera
+ * @param timeline Aggregates charted in the tick panel, or NULL
+ * @param events Spawns and deaths marked in the tick panel, or NULL
  * @param current_tick Current simulation tick
  * @param max_tick Maximum available tick
  * @param paused Whether simulation is paused
  */
-void ui_draw_main_panel(const SimulationState *sim, const Camera2D_RTS *camera,
-                        int current_tick, int max_tick, bool paused);
+void ui_draw_main_panel(const SimulationState *sim, const TileMap *map,
+                        const Camera2D_RTS *camera, const Timeline *timeline,
+                        const UnitEvents *events, int current_tick,
+                        int max_tick, bool paused);
 
 /**
  * @brief Draws the top information bar with simulation stats and controls
  *
+ * Retained like the main panel: redrawn only when the displayed stats or
+ * the screen width change.
+ *
  * @param current_tick Current simulation tick
  * @param max_tick Maximum available tick
  * @param paused Whether simulation is paused
  */
 void ui_draw_top_bar(int current_tick, int max_tick, bool paused);
 
+/**
+ * @brief Forces the retained panels to be redrawn on their next draw
+ *
+ * Only needed when something a panel shows changes without changing its
+ * inputs, e.g. after reloading fonts.
+ */
+void ui_invalidate_panels(void);
+
+/**
+ * @brief Releases the retained panel textures (requires a live GL context)
+ */
+void ui_cleanup_panels(void);
+
 /**
  * @brief Draws control buttons for unit commands (legacy - may be deprecated)
  *
@@ -88,19 +143,36 @@ void ui_draw_status_panel(int x, int y, int width, int height,
                           int max_tick, bool paused);
 
 /**
- * @brief Draws tick control buttons and progress bar
+ * @brief Draws the timeline scrub bar with a chart of unit counts
+ *
+ * Each pixel column shows the range of total units over its ticks and the
+ * mean units of each owner, read from the timeline's summary pyramid, so
+ * the cost follows the width rather than the replay length.
  *
  * @param x X position
  * @param y Y position
  * @param width Width of control area
  * @param height Height of control area
+ * @param timeline Aggregates to chart, or NULL for the bare bar
+ * @param events Unit events to mark along the bar, or NULL
  * @param current_tick Current simulation tick
  * @param max_tick Maximum available tick
  * @param paused Whether simulation is paused
  */
 void ui_draw_tick_controls(int x, int y, int width, int height,
+                           const Timeline *timeline, const UnitEvents *events,
                            int current_tick, int max_tick, bool paused);
 
+/**
+ * @brief Maps a screen point over the main panel's scrub bar to a tick
+ *
+ * @param point Screen position, e.g. the mouse
+ * @param max_tick Maximum available tick, the right end of the bar
+ * @param tick Receives the tick under the point
+ * @return bool False when the point is not over the bar
+ */
+bool ui_tick_controls_tick_at(Vector2 point, int max_tick, int *tick);
+
 /**
  * @brief Gets the default UI configuration based on current screen size
  *
@@ -0,0 +1,284 @@
+#include "unit_trails.h"
+#include "../utils/mem_track.h"
+#include "../utils/trace.h"
+#include "renderer.h"
+#include "rlgl.h"
+#include <string.h>
+
+// Trails of units this far outside the view may still cross into it
+#define UNIT_TRAILS_CULL_MARGIN_TILES 8.0f
+// Opacity of the newest segment; older ones fade out to nothing
+#define UNIT_TRAILS_ALPHA 200
+
+static rlRenderBatch g_trail_render_batch = {0};
+static bool g_trail_render_batch_loaded = false;
+
+void unit_trails_system_init(void) {
+  if (g_trail_render_batch_loaded)
+    return;
+  // Batches are sized in quads of four vertices; a segment takes two
+  g_trail_render_batch = rlLoadRenderBatch(1, UNIT_TRAILS_BATCH_SEGMENTS / 2);
+  g_trail_render_batch_loaded = true;
+}
+
+void unit_trails_system_cleanup(void) {
+  if (!g_trail_render_batch_loaded)
+    return;
+  rlUnloadRenderBatch(g_trail_render_batch);
+  g_trail_render_batch_loaded = false;
+}
+
+void unit_trails_reset(UnitTrails *trails) {
+  trails->unit_count = 0;
+  trails->sampled = false;
+}
+
+static bool unit_trails_grow(void **array, int capacity, size_t item_size) {
+  void *resized = mem_track_realloc(MEM_SUBSYSTEM_RENDERER, *array,
+                                    (size_t)capacity * item_size);
+  if (!resized)
+    return false;
+  *array = resized;
+  return true;
+}
+
+// Rings in use never outnumber the units of one sample, so every array is
+// sized by the largest unit count seen
+static bool unit_trails_reserve(UnitTrails *trails, int count) {
+  if (count <= trails->unit_capacity)
+    return true;
+
+  int capacity = trails->unit_capacity ? trails->unit_capacity : 1024;
+  while (capacity < count)
+    capacity *= 2;
+  if (!unit_trails_grow((void **)&trails->points, capacity,
+                        UNIT_TRAILS_LENGTH * sizeof(Vector2)) ||
+      !unit_trails_grow((void **)&trails->lengths, capacity, 1) ||
+      !unit_trails_grow((void **)&trails->rings, capacity, sizeof(int)) ||
+      !unit_trails_grow((void **)&trails->next_rings, capacity,
+                        sizeof(int)) ||
+      !unit_trails_grow((void **)&trails->units, capacity, sizeof(Unit)) ||
+      !unit_trails_grow((void **)&trails->free_rings, capacity, sizeof(int)))
+    return false;
+  trails->unit_capacity = capacity;
+  return true;
+}
+
+// Hands out the ring of a unit with no match in the previous sample
+static int unit_trails_take_ring(UnitTrails *trails) {
+  int ring = trails->free_count > 0 ? trails->free_rings[--trails->free_count]
+                                    : trails->ring_count++;
+  trails->lengths[ring] = 0;
+  return ring;
+}
+
+void unit_trails_update(UnitTrails *trails, const SimSnapshot *snapshot) {
+  int tick = snapshot->tick;
+  if (snapshot->fog.owner != 0) {
+    unit_trails_reset(trails);
+    return;
+  }
+  if (trails->sampled && tick == trails->last_tick)
+    return;
+
+  TRACE_ZONE_BEGIN(zone, "unit_trails_update");
+  const Unit *units = snapshot->sim.units;
+  int count = snapshot->sim.unitCount;
+  int elapsed = tick - trails->last_tick;
+  if (!trails->sampled || elapsed < 0 ||
+      elapsed > UNIT_TRAILS_MAX_GAP_TICKS) {
+    trails->unit_count = 0;
+    elapsed = 0;
+  }
+
+  const TileMap *map = &snapshot->sim.map;
+  const UnitMatcher *matcher = &trails->matcher;
+  if (!unit_trails_reserve(trails, count) ||
+      (trails->unit_count > 0 &&
+       !unit_matcher_match(&trails->matcher, trails->units,
+                           trails->unit_count, units, count, map->width,
+                           map->height))) {
+    unit_trails_reset(trails);
+    TRACE_ZONE_END(zone);
+    return;
+  }
+  if (trails->unit_count == 0) {
+    trails->ring_count = 0;
+    trails->free_count = 0;
+  }
+
+  // Rings of units that disappeared are reused before new ones
+  for (int i = 0; i < trails->unit_count; i++) {
+    if (matcher->matches[i] < 0)
+      trails->free_rings[trails->free_count++] = trails->rings[i];
+  }
+
+  int previous = trails->head;
+  trails->head = (trails->head + 1) % UNIT_TRAILS_LENGTH;
+  trails->sample_ticks[trails->head] = tick;
+  float max_step = UNIT_TRAILS_MAX_STEP_TILES * elapsed;
+  float max_step_sq = max_step * max_step;
+
+  for (int j = 0; j < count; j++) {
+    int source = trails->unit_count > 0 ? matcher->sources[j] : -1;
+    int ring_index =
+        source >= 0 ? trails->rings[source] : unit_trails_take_ring(trails);
+    Vector2 *ring = trails->points + (size_t)ring_index * UNIT_TRAILS_LENGTH;
+    Vector2 p = {units[j].x, units[j].y};
+    unsigned char length = trails->lengths[ring_index];
+
+    // Moved further than possible: the match was wrong
+    if (length > 0) {
+      float dx = p.x - ring[previous].x;
+      float dy = p.y - ring[previous].y;
+      if (dx * dx + dy * dy > max_step_sq)
+        length = 0;
+    }
+    ring[trails->head] = p;
+    trails->lengths[ring_index] =
+        length < UNIT_TRAILS_LENGTH ? length + 1 : length;
+    trails->next_rings[j] = ring_index;
+  }
+
+  int *rings = trails->rings;
+  trails->rings = trails->next_rings;
+  trails->next_rings = rings;
+  if (count > 0)
+    memcpy(trails->units, units, (size_t)count * sizeof(Unit));
+  trails->unit_count = count;
+  trails->last_tick = tick;
+  trails->sampled = true;
+  TRACE_ZONE_END(zone);
+}
+
+// Points of a trail to step over so `units` trails fit in one batch
+static int unit_trails_stride(int units) {
+  if (units <= 0)
+    return 1;
+  int per_unit = UNIT_TRAILS_BATCH_SEGMENTS / units;
+  if (per_unit >= UNIT_TRAILS_LENGTH - 1)
+    return 1;
+  // Every stride-th point plus the oldest one
+  if (per_unit < 2)
+    return UNIT_TRAILS_LENGTH - 1;
+  return (UNIT_TRAILS_LENGTH - 1 + per_unit - 2) / (per_unit - 1);
+}
+
+// Queues the segments of one unit's trail, newest first, counting the
+// draw calls issued when the batch fills up
+static void unit_trails_push(const UnitTrails *trails, int index, Color color,
+                             const Camera2D_RTS *camera, float min_step_sq,
+                             int stride, int *segments, int *draw_calls) {
+  int ring_index = trails->rings[index];
+  const Vector2 *ring =
+      trails->points + (size_t)ring_index * UNIT_TRAILS_LENGTH;
+  int length = trails->lengths[ring_index];
+
+  Vector2 from = ring[trails->head];
+  unsigned char from_alpha = UNIT_TRAILS_ALPHA;
+  for (int k = stride; k - stride < length - 1; k += stride) {
+    // Step by the stride, ending on the oldest point so the trail keeps its
+    // full extent
+    if (k > length - 1)
+      k = length - 1;
+    int slot = trails->head - k;
+    if (slot < 0)
+      slot += UNIT_TRAILS_LENGTH;
+    int age = trails->last_tick - trails->sample_ticks[slot];
+    if (age >= UNIT_TRAILS_LENGTH)
+      break;
+
+    // Skip points too close to the last one drawn, except the oldest
+    Vector2 to = ring[slot];
+    float dx = to.x - from.x;
+    float dy = to.y - from.y;
+    if (dx * dx + dy * dy < min_step_sq && k < length - 1)
+      continue;
+
+    unsigned char to_alpha = (unsigned char)(
+        UNIT_TRAILS_ALPHA * (UNIT_TRAILS_LENGTH - age) / UNIT_TRAILS_LENGTH);
+    if (rlCheckRenderBatchLimit(2))
+      (*draw_calls)++;
+    (*segments)++;
+    rlColor4ub(color.r, color.g, color.b, from_alpha);
+    rlVertex2f(from.x * camera->scale + camera->offset.x,
+               from.y * camera->scale + camera->offset.y);
+    rlColor4ub(color.r, color.g, color.b, to_alpha);
+    rlVertex2f(to.x * camera->scale + camera->offset.x,
+               to.y * camera->scale + camera->offset.y);
+    from = to;
+    from_alpha = to_alpha;
+  }
+}
+
+void unit_trails_draw(const UnitTrails *trails, const SimSnapshot *snapshot,
+                      const Camera2D_RTS *camera) {
+  if (!trails->sampled || trails->last_tick != snapshot->tick ||
+      trails->unit_count == 0 ||
+      trails->unit_count != snapshot->sim.unitCount || camera->scale <= 0.0f)
+    return;
+
+  TRACE_ZONE_BEGIN(zone, "unit_trails_draw");
+  const Unit *units = snapshot->sim.units;
+  const SpatialGrid *grid = &snapshot->unit_grid;
+  float min_step = UNIT_TRAILS_MIN_SEGMENT_PIXELS / camera->scale;
+  float min_step_sq = min_step * min_step;
+
+  // Submitting the default batch first keeps the terrain underneath
+  if (g_trail_render_batch_loaded)
+    rlSetRenderBatchActive(&g_trail_render_batch);
+
+  int segments = 0;
+  int draw_calls = 0;
+  rlBegin(RL_LINES);
+  int first_cx, first_cy, last_cx, last_cy;
+  Rectangle view = camera->viewport;
+  if (grid->count != trails->unit_count) {
+    int stride = unit_trails_stride(trails->unit_count);
+    for (int i = 0; i < trails->unit_count; i++)
+      unit_trails_push(trails, i, renderer_owner_color(units[i].owner),
+                       camera, min_step_sq, stride, &segments, &draw_calls);
+  } else if (spatial_grid_cell_range(
+                 grid, view.x - UNIT_TRAILS_CULL_MARGIN_TILES,
+                 view.y - UNIT_TRAILS_CULL_MARGIN_TILES,
+                 view.width + 2 * UNIT_TRAILS_CULL_MARGIN_TILES,
+                 view.height + 2 * UNIT_TRAILS_CULL_MARGIN_TILES, &first_cx,
+                 &first_cy, &last_cx, &last_cy)) {
+    // Cells of one row are contiguous in the index array
+    int candidates = 0;
+    for (int cy = first_cy; cy <= last_cy; cy++) {
+      int row = cy * grid->cells_x;
+      candidates += grid->cell_start[row + last_cx + 1] -
+                    grid->cell_start[row + first_cx];
+    }
+    int stride = unit_trails_stride(candidates);
+
+    for (int cy = first_cy; cy <= last_cy; cy++) {
+      int row = cy * grid->cells_x;
+      int begin = grid->cell_start[row + first_cx];
+      int end = grid->cell_start[row + last_cx + 1];
+      for (int k = begin; k < end; k++) {
+        int i = grid->indices[k];
+        unit_trails_push(trails, i, renderer_owner_color(units[i].owner),
+                         camera, min_step_sq, stride, &segments, &draw_calls);
+      }
+    }
+  }
+  rlEnd();
+
+  if (g_trail_render_batch_loaded)
+    rlSetRenderBatchActive(NULL);
+  renderer_track_flush(segments > 0 ? draw_calls + 1 : 0);
+  TRACE_ZONE_END(zone);
+}
+
+void unit_trails_free(UnitTrails *trails) {
+  mem_track_free(trails->points);
+  mem_track_free(trails->lengths);
+  mem_track_free(trails->rings);
+  mem_track_free(trails->next_rings);
+  mem_track_free(trails->units);
+  mem_track_free(trails->free_rings);
+  unit_matcher_free(&trails->matcher);
+  *trails = (UnitTrails){0};
+}
@@ -0,0 +1,102 @@
+#ifndef UNIT_TRAILS_H
+#define UNIT_TRAILS_H
+
+#include "../client/data_thread.h"
+#include "../client/unit_events.h"
+#include "camera.h"
+#include "raylib.h"
+#include <stdbool.h>
+
+/**
+ * @brief Fading trails of where units were over the last ticks
+ *
+ * Every unit owns a ring of its last UNIT_TRAILS_LENGTH positions. All
+ * units are sampled at the same ticks, so the ring head and the tick of
+ * each slot are shared and a ring only stores its points and how many are
+ * valid. Rings are appended to as snapshots advance, never rebuilt from
+ * older ticks.
+ *
+ * Indices within a tick are not stable, so each sample is matched against
+ * the previous one with a UnitMatcher: units with an id keep the ring of
+ * the unit with that id, the rest keep the ring of the nearest unit of the
+ * same owner. Unmatched units start a new ring, and the rings of units
+ * that disappeared are reused. A matched unit that moves further than it
+ * could in the elapsed ticks still restarts its trail; a seek backwards or
+ * a jump of more than UNIT_TRAILS_MAX_GAP_TICKS restarts every trail.
+ * Under a fog of war perspective units drop in and out of view, so no
+ * trails are kept.
+ *
+ * Trails are drawn as line segments into a dedicated rlgl vertex buffer
+ * that holds UNIT_TRAILS_BATCH_SEGMENTS, submitted as one draw call. Points
+ * closer than UNIT_TRAILS_MIN_SEGMENT_PIXELS on screen are merged, and when
+ * too many units are in view to fit their full trails in the buffer, trails
+ * are drawn through every n-th point so they still span every tick.
+ */
+
+#define UNIT_TRAILS_LENGTH 32          // Ticks of history per unit
+#define UNIT_TRAILS_MAX_GAP_TICKS 8    // Larger tick jumps restart trails
+#define UNIT_TRAILS_MAX_STEP_TILES 4.0f // Farthest a unit moves per tick
+#define UNIT_TRAILS_MIN_SEGMENT_PIXELS 2.0f
+#define UNIT_TRAILS_BATCH_SEGMENTS 131072 // Segments per draw call
+
+typedef struct {
+  Vector2 *points;        // unit_capacity rings of UNIT_TRAILS_LENGTH
+  unsigned char *lengths; // Valid points per ring, newest at `head`
+  int *rings;             // Ring of each unit sampled at last_tick
+  int *next_rings;        // Scratch for the rings of the next sample
+  Unit *units;            // Units sampled at last_tick
+  int *free_rings;        // Rings no unit owns
+  int free_count;
+  int ring_count; // Rings handed out since the last restart
+  int sample_ticks[UNIT_TRAILS_LENGTH]; // Tick sampled into each slot
+  int head;
+  int unit_count; // Units sampled at last_tick
+  int unit_capacity;
+  int last_tick;
+  bool sampled; // False until the first update after a reset
+  UnitMatcher matcher;
+} UnitTrails;
+
+/**
+ * @brief Creates the shared GPU vertex buffer (requires a live GL context)
+ */
+void unit_trails_system_init(void);
+
+/**
+ * @brief Releases the shared GPU vertex buffer
+ */
+void unit_trails_system_cleanup(void);
+
+/**
+ * @brief Appends the positions of a snapshot's units
+ *
+ * Does nothing while the snapshot shows the tick sampled last. Storage
+ * grows with the unit count and is kept, so playback does not allocate
+ * once the largest tick has been seen.
+ *
+ * @param trails Trails of one view
+ * @param snapshot Latest snapshot of that view
+ */
+void unit_trails_update(UnitTrails *trails, const SimSnapshot *snapshot);
+
+/**
+ * @brief Drops every trail; the next update starts new ones
+ */
+void unit_trails_reset(UnitTrails *trails);
+
+/**
+ * @brief Draws the trails of units around the view
+ *
+ * @param trails Trails updated from `snapshot`
+ * @param snapshot Snapshot whose units and culling grid are drawn
+ * @param camera View camera
+ */
+void unit_trails_draw(const UnitTrails *trails, const SimSnapshot *snapshot,
+                      const Camera2D_RTS *camera);
+
+/**
+ * @brief Frees the rings and matching scratch owned by a set of trails
+ */
+void unit_trails_free(UnitTrails *trails);
+
+#endif
@@ -0,0 +1,212 @@
+#include "client/replay_diff.h"
+#include "client/sim_loader.h"
+#include "raylib.h"
+#include "utils/job_system.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Reports where two replays diverge without opening a window:
+//   axiorem-diff [options] <a.sim.json> <b.sim.json>
+// Exit status is 0 when the replays match, 1 when they differ, 2 on errors.
+
+#define DIFF_DEFAULT_TOLERANCE 1e-4f
+// Pause between checks while waiting for the indexers
+#define DIFF_POLL_NS 1000000L
+
+static void print_usage(const char *program) {
+  printf("Usage: %s [options] <a.sim.json> <b.sim.json>\n", program);
+  printf("  -e <tolerance>  Largest per-field difference still equal "
+         "(default %g)\n",
+         DIFF_DEFAULT_TOLERANCE);
+  printf("  --first         Stop at the first divergent tick\n");
+  printf("  -v              Print every tick, not only divergent ones\n");
+  printf("  -q              Print the summary only\n");
+}
+
+typedef struct {
+  const char *path;
+  SimReplay *replay;
+} OpenJob;
+
+static void open_replay_job(void *arg) {
+  OpenJob *job = (OpenJob *)arg;
+  job->replay = OpenReplayProgressive(job->path);
+}
+
+static void diff_pause(void) {
+  struct timespec pause = {0, DIFF_POLL_NS};
+  nanosleep(&pause, NULL);
+}
+
+// Waits until the replay has indexed the tick; false if it ends before it
+static bool wait_for_tick(const SimReplay *replay, int tick) {
+  while (GetReplayTickCount(replay) <= tick) {
+    // The count is final once indexing has finished
+    if (IsReplayIndexed(replay))
+      return GetReplayTickCount(replay) > tick;
+    diff_pause();
+  }
+  return true;
+}
+
+static void print_tick(int tick, const ReplayTickDiff *diff) {
+  printf("%6d  %7d/%-7d %7d %7d %7d %10.4f  %7d/%-7d %7d %7d %7d %10.4f\n",
+         tick, diff->units_a, diff->units_b, diff->units_added,
+         diff->units_removed, diff->units_changed, diff->max_unit_error,
+         diff->objects_a, diff->objects_b, diff->objects_added,
+         diff->objects_removed, diff->objects_changed,
+         diff->max_object_error);
+}
+
+typedef struct {
+  float tolerance;
+  bool stop_at_first;
+  bool verbose;
+  bool quiet;
+} DiffOptions;
+
+// Streams both replays tick by tick while they are still being indexed,
+// comparing each tick as soon as both hold it; returns the exit status
+static int diff_replays(const SimReplay *replay_a, const SimReplay *replay_b,
+                        const DiffOptions *options) {
+  bool maps_equal =
+      replay_diff_maps_equal(GetReplayMap(replay_a), GetReplayMap(replay_b));
+
+  // Both states are refilled in place, so memory stays at one tick each
+  SimulationState state_a = {0};
+  SimulationState state_b = {0};
+  ReplayDiffScratch scratch = {0};
+  int first_divergent = -1;
+  int divergent_ticks = 0;
+  int compared = 0;
+  float max_unit_error = 0.0f;
+  float max_object_error = 0.0f;
+  bool failed = false;
+  bool stopped = false;
+
+  if (!options->quiet)
+    printf("  tick     units a/b      added removed changed    max err"
+           "    objects a/b     added removed changed    max err\n");
+
+  for (int tick = 0;
+       wait_for_tick(replay_a, tick) && wait_for_tick(replay_b, tick);
+       tick++) {
+    if (!LoadReplayTick(replay_a, tick, &state_a) ||
+        !LoadReplayTick(replay_b, tick, &state_b)) {
+      fprintf(stderr, "Error: Could not decode tick %d\n", tick);
+      failed = true;
+      break;
+    }
+
+    ReplayTickDiff diff;
+    if (!replay_diff_tick(&state_a, &state_b, options->tolerance, &scratch,
+                          &diff)) {
+      fprintf(stderr, "Error: Out of memory comparing tick %d\n", tick);
+      failed = true;
+      break;
+    }
+    compared++;
+    if (diff.max_unit_error > max_unit_error)
+      max_unit_error = diff.max_unit_error;
+    if (diff.max_object_error > max_object_error)
+      max_object_error = diff.max_object_error;
+
+    bool differs = replay_diff_differs(&diff);
+    if (differs) {
+      divergent_ticks++;
+      if (first_divergent < 0)
+        first_divergent = tick;
+    }
+    if (!options->quiet && (differs || options->verbose))
+      print_tick(tick, &diff);
+    if (differs && options->stop_at_first) {
+      stopped = true;
+      break;
+    }
+  }
+  FreeStateEntities(&state_a);
+  FreeStateEntities(&state_b);
+  replay_diff_scratch_free(&scratch);
+  if (failed)
+    return 2;
+
+  // Unless stopped early, the longer replay may still be indexing its tail
+  while (!stopped &&
+         (!IsReplayIndexed(replay_a) || !IsReplayIndexed(replay_b)))
+    diff_pause();
+  int ticks_a = GetReplayTickCount(replay_a);
+  int ticks_b = GetReplayTickCount(replay_b);
+  bool counts_known = IsReplayIndexed(replay_a) && IsReplayIndexed(replay_b);
+  bool counts_differ = counts_known && ticks_a != ticks_b;
+
+  printf("Compared %d of %d/%d ticks%s (tolerance %g)\n", compared, ticks_a,
+         ticks_b, counts_known ? "" : " indexed so far", options->tolerance);
+  if (!maps_equal)
+    printf("Maps differ\n");
+  if (counts_differ)
+    printf("Tick counts differ: %d vs %d\n", ticks_a, ticks_b);
+  if (first_divergent >= 0)
+    printf("First divergent tick: %d (%d divergent tick%s%s)\n",
+           first_divergent, divergent_ticks, divergent_ticks == 1 ? "" : "s",
+           options->stop_at_first ? ", stopped early" : "");
+  else
+    printf("No divergent ticks\n");
+  printf("Max position error: units %.4f, objects %.4f tiles\n",
+         max_unit_error, max_object_error);
+
+  return first_divergent >= 0 || !maps_equal || counts_differ ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+  DiffOptions options = {.tolerance = DIFF_DEFAULT_TOLERANCE};
+  const char *inputs[2] = {NULL, NULL};
+  int input_count = 0;
+
+  for (int i = 1; i < argc; i++) {
+    bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "-e") == 0 && has_value) {
+      options.tolerance = (float)atof(argv[++i]);
+    } else if (strcmp(argv[i], "--first") == 0) {
+      options.stop_at_first = true;
+    } else if (strcmp(argv[i], "-v") == 0) {
+      options.verbose = true;
+    } else if (strcmp(argv[i], "-q") == 0) {
+      options.quiet = true;
+    } else if (argv[i][0] == '-' || input_count == 2) {
+      print_usage(argv[0]);
+      return 2;
+    } else {
+      inputs[input_count++] = argv[i];
+    }
+  }
+  if (input_count != 2) {
+    print_usage(argv[0]);
+    return 2;
+  }
+
+  SetTraceLogLevel(LOG_WARNING);
+
+  // Each replay is indexed on its own thread once open; building the maps
+  // is what the open waits for, so open both at once
+  job_system_init_headless();
+  OpenJob jobs[2] = {{inputs[0], NULL}, {inputs[1], NULL}};
+  JobCounter opened = {0};
+  job_run(open_replay_job, &jobs[1], &opened);
+  open_replay_job(&jobs[0]);
+  job_wait(&opened);
+
+  int status = 2;
+  for (int i = 0; i < 2; i++) {
+    if (!jobs[i].replay)
+      fprintf(stderr, "Error: Could not open replay %s\n", inputs[i]);
+  }
+  if (jobs[0].replay && jobs[1].replay)
+    status = diff_replays(jobs[0].replay, jobs[1].replay, &options);
+
+  CloseReplay(jobs[0].replay);
+  CloseReplay(jobs[1].replay);
+  job_system_shutdown();
+  return status;
+}
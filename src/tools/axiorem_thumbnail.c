@@ -0,0 +1,127 @@
+#include "client/sim_loader.h"
+#include "raylib.h"
+#include "render/thumbnail.h"
+#include "utils/job_system.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Renders replay thumbnails without opening a window:
+//   axiorem-thumbnail [options] <replay.sim.json>...
+
+#define THUMBNAIL_DEFAULT_SIZE 512
+
+static void print_usage(const char *program) {
+  printf("Usage: %s [options] <replay.sim.json>...\n", program);
+  printf("  -o <file>       Output PNG (one replay only; default: replay name "
+         "with .png)\n");
+  printf("  -s <pixels>     Pixels per tile (default: fit to -m)\n");
+  printf("  -m <pixels>     Longest image side when fitting (default %d)\n",
+         THUMBNAIL_DEFAULT_SIZE);
+  printf("  -t <tick>       Tick to draw (default: last)\n");
+  printf("  --tiles <file>  Tile sheet (default ../assets/tiles.png)\n");
+}
+
+// Replaces a trailing .sim.json / .json with .png
+static void default_output_path(const char *input, char *out, size_t size) {
+  size_t length = strlen(input);
+  const char *suffixes[] = {".sim.json", ".json"};
+  for (int i = 0; i < 2; i++) {
+    size_t suffix = strlen(suffixes[i]);
+    if (length > suffix && strcmp(input + length - suffix, suffixes[i]) == 0) {
+      length -= suffix;
+      break;
+    }
+  }
+  snprintf(out, size, "%.*s.png", (int)length, input);
+}
+
+static bool render_replay(ThumbnailSheet *sheet, const char *input,
+                          const char *output, float scale, int max_size,
+                          int tick) {
+  SimReplay *replay = OpenReplay(input);
+  if (!replay) {
+    fprintf(stderr, "Error: Could not open replay %s\n", input);
+    return false;
+  }
+
+  SimulationState state = {0};
+  int last_tick = GetReplayTickCount(replay) - 1;
+  bool ok = LoadReplayTick(replay, tick < 0 ? last_tick : tick, &state);
+  if (ok) {
+    float pixels_per_tile =
+        scale > 0.0f ? scale : thumbnail_fit_scale(&state.map, max_size);
+    Image image = thumbnail_render(sheet, &state, pixels_per_tile);
+    ok = image.data && ExportImage(image, output);
+    if (image.data)
+      UnloadImage(image);
+  }
+  if (!ok)
+    fprintf(stderr, "Error: Could not render %s\n", input);
+
+  FreeStateEntities(&state);
+  CloseReplay(replay);
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  const char *output = NULL;
+  const char *tiles_path = "../assets/tiles.png";
+  float scale = 0.0f;
+  int max_size = THUMBNAIL_DEFAULT_SIZE;
+  int tick = -1;
+  int first_input = argc;
+
+  for (int i = 1; i < argc; i++) {
+    bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "-o") == 0 && has_value) {
+      output = argv[++i];
+    } else if (strcmp(argv[i], "-s") == 0 && has_value) {
+      scale = (float)atof(argv[++i]);
+    } else if (strcmp(argv[i], "-m") == 0 && has_value) {
+      max_size = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-t") == 0 && has_value) {
+      tick = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--tiles") == 0 && has_value) {
+      tiles_path = argv[++i];
+    } else if (argv[i][0] == '-') {
+      print_usage(argv[0]);
+      return 1;
+    } else {
+      first_input = i;
+      break;
+    }
+  }
+
+  int input_count = argc - first_input;
+  if (input_count == 0 || (output && input_count > 1)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  SetTraceLogLevel(LOG_WARNING);
+  ThumbnailSheet sheet;
+  if (!thumbnail_load_sheet(&sheet, tiles_path, 16, 16, 1))
+    return 1;
+  job_system_init_headless();
+
+  // The sheet keeps its resampled cells, so batches at one scale only
+  // resample the tiles once
+  int failures = 0;
+  for (int i = first_input; i < argc; i++) {
+    char path[1024];
+    if (output)
+      snprintf(path, sizeof(path), "%s", output);
+    else
+      default_output_path(argv[i], path, sizeof(path));
+
+    if (render_replay(&sheet, argv[i], path, scale, max_size, tick))
+      printf("%s -> %s\n", argv[i], path);
+    else
+      failures++;
+  }
+
+  thumbnail_unload_sheet(&sheet);
+  job_system_shutdown();
+  return failures ? 1 : 0;
+}
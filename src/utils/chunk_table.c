@@ -0,0 +1,88 @@
+#include "chunk_table.h"
+
+// Fibonacci hashing spreads neighbouring chunk indices across the table
+static inline int chunk_table_bucket(const ChunkTable *table, int64_t key) {
+  return (int)(((uint64_t)key * 0x9E3779B97F4A7C15ull) >> (64 - table->bits));
+}
+
+bool chunk_table_init(ChunkTable *table, int max_entries,
+                      MemSubsystem subsystem) {
+  *table = (ChunkTable){0};
+
+  // At most half full keeps probe sequences short
+  int bits = 4;
+  while ((1 << bits) < max_entries * 2 && bits < 30)
+    bits++;
+  int buckets = 1 << bits;
+
+  table->keys =
+      (int64_t *)mem_track_malloc(subsystem, buckets * sizeof(int64_t));
+  table->values = (int *)mem_track_malloc(subsystem, buckets * sizeof(int));
+  if (!table->keys || !table->values) {
+    chunk_table_free(table);
+    return false;
+  }
+  table->bits = bits;
+  chunk_table_clear(table);
+  return true;
+}
+
+int chunk_table_find(const ChunkTable *table, int64_t key) {
+  if (!table->keys)
+    return -1;
+
+  int mask = (1 << table->bits) - 1;
+  for (int i = chunk_table_bucket(table, key);; i = (i + 1) & mask) {
+    if (table->keys[i] == key)
+      return table->values[i];
+    if (table->keys[i] == CHUNK_TABLE_EMPTY)
+      return -1;
+  }
+}
+
+void chunk_table_insert(ChunkTable *table, int64_t key, int value) {
+  int mask = (1 << table->bits) - 1;
+  int i = chunk_table_bucket(table, key);
+  while (table->keys[i] != CHUNK_TABLE_EMPTY)
+    i = (i + 1) & mask;
+  table->keys[i] = key;
+  table->values[i] = value;
+}
+
+void chunk_table_remove(ChunkTable *table, int64_t key) {
+  if (!table->keys)
+    return;
+
+  int mask = (1 << table->bits) - 1;
+  int hole = chunk_table_bucket(table, key);
+  while (table->keys[hole] != key) {
+    if (table->keys[hole] == CHUNK_TABLE_EMPTY)
+      return;
+    hole = (hole + 1) & mask;
+  }
+
+  // Pull later entries of the probe run back into the hole unless that
+  // would move them in front of their own home bucket
+  for (int i = (hole + 1) & mask; table->keys[i] != CHUNK_TABLE_EMPTY;
+       i = (i + 1) & mask) {
+    int home = chunk_table_bucket(table, table->keys[i]);
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      table->keys[hole] = table->keys[i];
+      table->values[hole] = table->values[i];
+      hole = i;
+    }
+  }
+  table->keys[hole] = CHUNK_TABLE_EMPTY;
+}
+
+void chunk_table_clear(ChunkTable *table) {
+  int buckets = table->keys ? 1 << table->bits : 0;
+  for (int i = 0; i < buckets; i++)
+    table->keys[i] = CHUNK_TABLE_EMPTY;
+}
+
+void chunk_table_free(ChunkTable *table) {
+  mem_track_free(table->keys);
+  mem_track_free(table->values);
+  *table = (ChunkTable){0};
+}
@@ -0,0 +1,55 @@
+#ifndef CHUNK_TABLE_H
+#define CHUNK_TABLE_H
+
+#include "mem_track.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Fixed-size hash table from a chunk index to a resident slot
+ *
+ * Chunk caches keep a bounded number of slots, so the table is sized once
+ * for that bound and never grows; its memory depends on the budget rather
+ * than on how many chunks the map has. Open addressing with linear probing
+ * and backward-shift deletion, so removals leave no tombstones behind.
+ */
+
+typedef struct {
+  int64_t *keys; // Chunk indices; CHUNK_TABLE_EMPTY marks a free bucket
+  int *values;
+  int bits; // Bucket count is 1 << bits
+} ChunkTable;
+
+#define CHUNK_TABLE_EMPTY INT64_MIN
+
+/**
+ * @brief Allocates buckets for up to max_entries chunks at once
+ *
+ * @param table Table to initialise
+ * @param max_entries Most chunks ever resident together
+ * @param subsystem Subsystem charged for the buckets
+ * @return bool False if the buckets could not be allocated
+ */
+bool chunk_table_init(ChunkTable *table, int max_entries,
+                      MemSubsystem subsystem);
+
+/**
+ * @brief Returns the slot stored for a chunk, or -1 when it is not resident
+ */
+int chunk_table_find(const ChunkTable *table, int64_t key);
+
+/**
+ * @brief Stores a chunk's slot; the chunk must not be in the table yet and
+ * the table must hold fewer than max_entries chunks
+ */
+void chunk_table_insert(ChunkTable *table, int64_t key, int value);
+
+/**
+ * @brief Removes a chunk; absent chunks are ignored
+ */
+void chunk_table_remove(ChunkTable *table, int64_t key);
+
+void chunk_table_clear(ChunkTable *table);
+void chunk_table_free(ChunkTable *table);
+
+#endif
@@ -0,0 +1,480 @@
+#include "job_system.h"
+#include "mem_track.h"
+#include "trace.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+// Failed searches before an idle worker goes to sleep
+#define JOB_IDLE_SPINS 64
+
+struct Job {
+  JobFunction function;
+  JobRangeFunction range_function; // Set for parallel-for pieces
+  void *arg;
+  int begin;
+  int end;
+  int grain;
+  JobCounter *counter;
+  Job *next;          // In a continuation list or the shared queue
+  atomic_bool in_use; // Pool record taken until the job has run
+};
+
+// Chase-Lev deque: the owner pushes and pops at the bottom, thieves take
+// from the top
+typedef struct {
+  atomic_long top;
+  atomic_long bottom;
+  _Atomic(Job *) jobs[JOB_DEQUE_SIZE];
+} JobDeque;
+
+typedef struct {
+  JobDeque deque;
+  Job pool[JOB_POOL_SIZE];
+  unsigned int pool_next;
+  unsigned int rng; // Victim selection
+  pthread_t thread;
+} JobThread;
+
+typedef struct {
+  bool running;
+  int worker_count;
+  int thread_count;   // Deques allocated, fixed before any worker starts
+  JobThread *threads; // Slot 0 is the thread that started the system
+
+  // Jobs from threads without a deque, and their records
+  pthread_mutex_t shared_lock;
+  Job *shared_head;
+  Job *shared_tail;
+  Job shared_pool[JOB_POOL_SIZE];
+  unsigned int shared_pool_next;
+
+  pthread_mutex_t continuation_lock; // Guards every continuation list
+
+  pthread_mutex_t sleep_lock;
+  pthread_cond_t wake;
+  atomic_int sleeping;
+  atomic_uint work_epoch; // Bumped by every push, checked before sleeping
+  atomic_bool stopping;
+} JobSystem;
+
+static JobSystem g_jobs = {0};
+
+// Deque slot of the calling thread, -1 for threads without one
+static _Thread_local int t_job_thread = -1;
+
+static bool job_deque_push(JobDeque *deque, Job *job) {
+  long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+  long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+  if (bottom - top >= JOB_DEQUE_SIZE)
+    return false;
+  atomic_store_explicit(&deque->jobs[bottom & (JOB_DEQUE_SIZE - 1)], job,
+                        memory_order_relaxed);
+  atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_release);
+  return true;
+}
+
+static Job *job_deque_pop(JobDeque *deque) {
+  long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+  atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+  if (top > bottom) {
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    return NULL;
+  }
+  Job *job = atomic_load_explicit(&deque->jobs[bottom & (JOB_DEQUE_SIZE - 1)],
+                                  memory_order_relaxed);
+  if (top == bottom) {
+    // Last job: race thieves for it
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                 memory_order_seq_cst,
+                                                 memory_order_relaxed))
+      job = NULL;
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+  }
+  return job;
+}
+
+static Job *job_deque_steal(JobDeque *deque) {
+  long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+  atomic_thread_fence(memory_order_seq_cst);
+  long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+  if (top >= bottom)
+    return NULL;
+
+  Job *job = atomic_load_explicit(&deque->jobs[top & (JOB_DEQUE_SIZE - 1)],
+                                  memory_order_relaxed);
+  if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                               memory_order_seq_cst,
+                                               memory_order_relaxed))
+    return NULL;
+  return job;
+}
+
+// Takes a free record from the calling thread's pool; NULL when the next
+// one is still in use, and the caller then runs the job inline
+static Job *job_alloc(void) {
+  Job *job;
+  if (t_job_thread >= 0) {
+    JobThread *thread = &g_jobs.threads[t_job_thread];
+    job = &thread->pool[thread->pool_next++ & (JOB_POOL_SIZE - 1)];
+  } else {
+    pthread_mutex_lock(&g_jobs.shared_lock);
+    job = &g_jobs.shared_pool[g_jobs.shared_pool_next++ & (JOB_POOL_SIZE - 1)];
+    pthread_mutex_unlock(&g_jobs.shared_lock);
+  }
+
+  bool expected = false;
+  if (!atomic_compare_exchange_strong(&job->in_use, &expected, true))
+    return NULL;
+  job->function = NULL;
+  job->range_function = NULL;
+  job->next = NULL;
+  return job;
+}
+
+static void job_wake_workers(void) {
+  atomic_fetch_add(&g_jobs.work_epoch, 1);
+  if (atomic_load(&g_jobs.sleeping) > 0) {
+    pthread_mutex_lock(&g_jobs.sleep_lock);
+    pthread_cond_signal(&g_jobs.wake);
+    pthread_mutex_unlock(&g_jobs.sleep_lock);
+  }
+}
+
+// Queues a job on the caller's deque, or the shared queue for threads
+// without one
+static bool job_push(Job *job) {
+  if (t_job_thread >= 0) {
+    if (!job_deque_push(&g_jobs.threads[t_job_thread].deque, job))
+      return false;
+  } else {
+    pthread_mutex_lock(&g_jobs.shared_lock);
+    job->next = NULL;
+    if (g_jobs.shared_tail)
+      g_jobs.shared_tail->next = job;
+    else
+      g_jobs.shared_head = job;
+    g_jobs.shared_tail = job;
+    pthread_mutex_unlock(&g_jobs.shared_lock);
+  }
+  job_wake_workers();
+  return true;
+}
+
+static Job *job_take_shared(void) {
+  pthread_mutex_lock(&g_jobs.shared_lock);
+  Job *job = g_jobs.shared_head;
+  if (job) {
+    g_jobs.shared_head = job->next;
+    if (!g_jobs.shared_head)
+      g_jobs.shared_tail = NULL;
+  }
+  pthread_mutex_unlock(&g_jobs.shared_lock);
+  return job;
+}
+
+// Own deque first, then the shared queue, then other threads' deques
+static Job *job_find(void) {
+  Job *job = NULL;
+  unsigned int rng = 0x9e3779b9u;
+  if (t_job_thread >= 0) {
+    JobThread *thread = &g_jobs.threads[t_job_thread];
+    job = job_deque_pop(&thread->deque);
+    if (job)
+      return job;
+    rng = thread->rng = thread->rng * 1664525u + 1013904223u;
+  }
+  job = job_take_shared();
+  if (job)
+    return job;
+
+  int count = g_jobs.thread_count;
+  int first = (int)((rng >> 16) % (unsigned int)count);
+  for (int i = 0; i < count; i++) {
+    int victim = (first + i) % count;
+    if (victim == t_job_thread)
+      continue;
+    job = job_deque_steal(&g_jobs.threads[victim].deque);
+    if (job)
+      return job;
+  }
+  return NULL;
+}
+
+static void job_execute(Job *job);
+
+// Releases a counter held by a finished job. The last release takes the
+// continuation list under the lock before the count reaches zero, so a
+// waiter that sees zero may free the counter right away.
+static void job_counter_release(JobCounter *counter) {
+  if (!counter)
+    return;
+  for (;;) {
+    int pending = atomic_load(&counter->pending);
+    if (pending > 1) {
+      if (atomic_compare_exchange_weak(&counter->pending, &pending,
+                                       pending - 1))
+        return;
+      continue;
+    }
+
+    pthread_mutex_lock(&g_jobs.continuation_lock);
+    Job *ready = counter->continuations;
+    counter->continuations = NULL;
+    atomic_fetch_sub(&counter->pending, 1);
+    pthread_mutex_unlock(&g_jobs.continuation_lock);
+
+    while (ready) {
+      Job *next = ready->next;
+      if (!job_push(ready))
+        job_execute(ready);
+      ready = next;
+    }
+    return;
+  }
+}
+
+// Splits a parallel-for piece down to its grain, queueing the upper halves
+static void job_execute_range(Job *job) {
+  int begin = job->begin;
+  int end = job->end;
+  while (end - begin > job->grain) {
+    int middle = begin + (end - begin) / 2;
+    Job *half = job_alloc();
+    if (!half)
+      break;
+    half->range_function = job->range_function;
+    half->arg = job->arg;
+    half->begin = middle;
+    half->end = end;
+    half->grain = job->grain;
+    half->counter = job->counter;
+    if (job->counter)
+      atomic_fetch_add(&job->counter->pending, 1);
+    if (!job_push(half))
+      job_execute(half);
+    end = middle;
+  }
+  job->range_function(job->arg, begin, end);
+}
+
+static void job_execute(Job *job) {
+  JobCounter *counter = job->counter;
+  if (job->range_function)
+    job_execute_range(job);
+  else
+    job->function(job->arg);
+  atomic_store_explicit(&job->in_use, false, memory_order_release);
+  job_counter_release(counter);
+}
+
+static void *job_worker_main(void *arg) {
+  t_job_thread = (int)(intptr_t)arg;
+  char name[16];
+  snprintf(name, sizeof(name), "job %d", t_job_thread);
+  trace_set_thread_name(name);
+
+  int idle = 0;
+  while (!atomic_load(&g_jobs.stopping)) {
+    unsigned int epoch = atomic_load(&g_jobs.work_epoch);
+    Job *job = job_find();
+    if (job) {
+      job_execute(job);
+      idle = 0;
+      continue;
+    }
+    if (++idle < JOB_IDLE_SPINS) {
+      sched_yield();
+      continue;
+    }
+
+    // Sleep unless something was pushed since the search started
+    pthread_mutex_lock(&g_jobs.sleep_lock);
+    atomic_fetch_add(&g_jobs.sleeping, 1);
+    if (atomic_load(&g_jobs.work_epoch) == epoch &&
+        !atomic_load(&g_jobs.stopping))
+      pthread_cond_wait(&g_jobs.wake, &g_jobs.sleep_lock);
+    atomic_fetch_sub(&g_jobs.sleeping, 1);
+    pthread_mutex_unlock(&g_jobs.sleep_lock);
+    idle = 0;
+  }
+  return NULL;
+}
+
+static int job_system_cores(void) {
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  return cores < 1 ? 1 : (int)cores;
+}
+
+bool job_system_init(int worker_count) {
+  if (g_jobs.running)
+    return true;
+  // Leave the render and data threads a core each
+  if (worker_count < 0) {
+    worker_count = job_system_cores() - 2;
+    if (worker_count < 1)
+      worker_count = 1;
+  }
+  if (worker_count > JOB_SYSTEM_MAX_WORKERS)
+    worker_count = JOB_SYSTEM_MAX_WORKERS;
+  if (worker_count == 0)
+    return false;
+
+  JobThread *threads = (JobThread *)mem_track_calloc(
+      MEM_SUBSYSTEM_JOBS, (size_t)worker_count + 1, sizeof(JobThread));
+  if (!threads)
+    return false;
+
+  g_jobs.threads = threads;
+  g_jobs.thread_count = worker_count + 1;
+  g_jobs.worker_count = 0;
+  g_jobs.shared_head = g_jobs.shared_tail = NULL;
+  pthread_mutex_init(&g_jobs.shared_lock, NULL);
+  pthread_mutex_init(&g_jobs.continuation_lock, NULL);
+  pthread_mutex_init(&g_jobs.sleep_lock, NULL);
+  pthread_cond_init(&g_jobs.wake, NULL);
+  atomic_store(&g_jobs.sleeping, 0);
+  atomic_store(&g_jobs.stopping, false);
+  for (int i = 0; i <= worker_count; i++)
+    threads[i].rng = 2463534242u + (unsigned int)i * 7919u;
+
+  // The starting thread owns deque 0; workers take the rest
+  t_job_thread = 0;
+  for (int i = 1; i <= worker_count; i++) {
+    if (pthread_create(&threads[i].thread, NULL, job_worker_main,
+                       (void *)(intptr_t)i) != 0)
+      break;
+    g_jobs.worker_count++;
+  }
+  g_jobs.running = true;
+  if (g_jobs.worker_count == 0) {
+    job_system_shutdown();
+    return false;
+  }
+  return true;
+}
+
+bool job_system_init_headless(void) {
+  int cores = job_system_cores();
+  return job_system_init(cores > 1 ? cores - 1 : 1);
+}
+
+void job_system_shutdown(void) {
+  if (!g_jobs.running)
+    return;
+
+  pthread_mutex_lock(&g_jobs.sleep_lock);
+  atomic_store(&g_jobs.stopping, true);
+  pthread_cond_broadcast(&g_jobs.wake);
+  pthread_mutex_unlock(&g_jobs.sleep_lock);
+  for (int i = 1; i <= g_jobs.worker_count; i++)
+    pthread_join(g_jobs.threads[i].thread, NULL);
+
+  // Whatever is left runs here, before jobs start running inline
+  Job *job;
+  while ((job = job_find()) != NULL)
+    job_execute(job);
+
+  g_jobs.running = false;
+  pthread_mutex_destroy(&g_jobs.shared_lock);
+  pthread_mutex_destroy(&g_jobs.continuation_lock);
+  pthread_mutex_destroy(&g_jobs.sleep_lock);
+  pthread_cond_destroy(&g_jobs.wake);
+  mem_track_free(g_jobs.threads);
+  g_jobs.threads = NULL;
+  g_jobs.thread_count = 0;
+  g_jobs.worker_count = 0;
+  t_job_thread = -1;
+}
+
+bool job_system_running(void) { return g_jobs.running; }
+
+int job_system_worker_count(void) {
+  return g_jobs.running ? g_jobs.worker_count : 0;
+}
+
+void job_run(JobFunction function, void *arg, JobCounter *counter) {
+  Job *job = g_jobs.running ? job_alloc() : NULL;
+  if (!job) {
+    function(arg);
+    return;
+  }
+  job->function = function;
+  job->arg = arg;
+  job->counter = counter;
+  if (counter)
+    atomic_fetch_add(&counter->pending, 1);
+  if (!job_push(job))
+    job_execute(job);
+}
+
+void job_run_after(JobCounter *dependency, JobFunction function, void *arg,
+                   JobCounter *counter) {
+  Job *job = g_jobs.running ? job_alloc() : NULL;
+  if (!job) {
+    job_wait(dependency);
+    function(arg);
+    return;
+  }
+  job->function = function;
+  job->arg = arg;
+  job->counter = counter;
+  if (counter)
+    atomic_fetch_add(&counter->pending, 1);
+
+  pthread_mutex_lock(&g_jobs.continuation_lock);
+  bool ready = atomic_load(&dependency->pending) == 0;
+  if (!ready) {
+    job->next = dependency->continuations;
+    dependency->continuations = job;
+  }
+  pthread_mutex_unlock(&g_jobs.continuation_lock);
+
+  if (ready && !job_push(job))
+    job_execute(job);
+}
+
+void job_parallel_for(int count, int grain, JobRangeFunction function,
+                      void *arg, JobCounter *counter) {
+  if (count <= 0)
+    return;
+  if (grain < 1)
+    grain = 1;
+  Job *job = g_jobs.running && count > grain ? job_alloc() : NULL;
+  if (!job) {
+    function(arg, 0, count);
+    return;
+  }
+  job->range_function = function;
+  job->arg = arg;
+  job->begin = 0;
+  job->end = count;
+  job->grain = grain;
+  job->counter = counter;
+  if (counter)
+    atomic_fetch_add(&counter->pending, 1);
+  if (!job_push(job))
+    job_execute(job);
+}
+
+bool job_counter_done(JobCounter *counter) {
+  return atomic_load(&counter->pending) == 0;
+}
+
+void job_wait(JobCounter *counter) {
+  TRACE_ZONE_BEGIN(zone, "job_wait");
+  while (!job_counter_done(counter)) {
+    Job *job = g_jobs.running ? job_find() : NULL;
+    if (job)
+      job_execute(job);
+    else
+      sched_yield();
+  }
+  TRACE_ZONE_END(zone);
+}
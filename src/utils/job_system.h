@@ -0,0 +1,129 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+/**
+ * @brief Shared worker threads for short, parallel pieces of work
+ *
+ * One pool of workers runs every job in the process, so parallel passes
+ * (tick summaries, the heatmap, map preprocessing) share the cores instead
+ * of each starting threads of their own. Every worker and the thread that
+ * started the system own a work-stealing deque: jobs a thread spawns go to
+ * the bottom of its own deque and are popped from there, idle workers
+ * steal from the top of others. Jobs from any other thread go through a
+ * shared queue. Job records come from fixed per-thread pools, so spawning
+ * does not allocate.
+ *
+ * Completion is tracked with JobCounters: each job spawned against a
+ * counter holds it until it finishes. Waiting on a counter runs queued
+ * jobs meanwhile, and a job can be made to start only once a counter is
+ * done (a continuation).
+ *
+ * Long-running loops that block on I/O, such as the data thread, the
+ * replay indexer and the map pager, keep their own threads.
+ *
+ * Before job_system_init() or after job_system_shutdown() every job runs
+ * inline on the calling thread, so callers need no fallback path.
+ */
+
+// Jobs a thread can have queued in its deque at once
+#define JOB_DEQUE_SIZE 4096
+// Job records per thread; a thread that runs out runs its new jobs inline
+#define JOB_POOL_SIZE 4096
+#define JOB_SYSTEM_MAX_WORKERS 64
+
+typedef void (*JobFunction)(void *arg);
+// Processes items [begin, end) of a parallel for
+typedef void (*JobRangeFunction)(void *arg, int begin, int end);
+
+typedef struct Job Job;
+
+/**
+ * @brief Completion counter shared by a group of jobs
+ *
+ * Zero-initialize before first use. A counter may be reused once done.
+ */
+typedef struct {
+  atomic_int pending;    // Jobs spawned against the counter and not finished
+  Job *continuations;    // Jobs started when pending drops to zero
+} JobCounter;
+
+/**
+ * @brief Starts the workers for the interactive client
+ *
+ * Leaves a core each to the render thread and the data thread.
+ *
+ * @param worker_count Workers to start, or -1 to size by the core count;
+ *                     0 runs every job inline
+ * @return bool False if no worker could be started (jobs then run inline)
+ */
+bool job_system_init(int worker_count);
+
+/**
+ * @brief Starts the workers for a command-line tool
+ *
+ * Sized to use every core: the calling thread is expected to wait on its
+ * jobs with job_wait(), which runs jobs itself.
+ */
+bool job_system_init_headless(void);
+
+/**
+ * @brief Runs every job still queued and stops the workers
+ */
+void job_system_shutdown(void);
+
+bool job_system_running(void);
+int job_system_worker_count(void);
+
+/**
+ * @brief Queues a job
+ *
+ * @param function Job body
+ * @param arg Passed to the function
+ * @param counter Counter to hold until the job finishes, or NULL
+ */
+void job_run(JobFunction function, void *arg, JobCounter *counter);
+
+/**
+ * @brief Queues a job to start once another counter is done
+ *
+ * @param dependency Counter to wait for
+ * @param function Job body
+ * @param arg Passed to the function
+ * @param counter Counter to hold until the job finishes, or NULL; it is
+ *                held from this call on, not from when the job starts
+ */
+void job_run_after(JobCounter *dependency, JobFunction function, void *arg,
+                   JobCounter *counter);
+
+/**
+ * @brief Runs a function over [0, count) in parallel
+ *
+ * The range is halved recursively, one half queued for stealing, until
+ * pieces are at most `grain` items; each piece is one call. Choose the
+ * grain so a piece takes at least a few microseconds.
+ *
+ * @param count Number of items
+ * @param grain Largest number of items per call, at least 1
+ * @param function Called with disjoint sub-ranges
+ * @param arg Passed to the function
+ * @param counter Counter to hold until every piece finishes, or NULL
+ */
+void job_parallel_for(int count, int grain, JobRangeFunction function,
+                      void *arg, JobCounter *counter);
+
+/**
+ * @brief True once every job spawned against the counter has finished
+ */
+bool job_counter_done(JobCounter *counter);
+
+/**
+ * @brief Runs queued jobs until the counter is done
+ *
+ * Never call from inside a job that the counter waits on.
+ */
+void job_wait(JobCounter *counter);
+
+#endif
@@ -0,0 +1,134 @@
+#include "mem_track.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *SUBSYSTEM_NAMES[MEM_SUBSYSTEM_COUNT] = {
+    "loader", "map", "renderer", "caches", "analysis", "jobs", "textures",
+};
+
+// Prepended to every block; the union keeps the payload aligned like
+// malloc's own blocks
+typedef union {
+  struct {
+    size_t size;
+    int subsystem;
+  } info;
+  max_align_t align;
+} MemHeader;
+
+typedef struct {
+  atomic_size_t bytes;
+  atomic_size_t peak_bytes;
+  atomic_ulong live_allocations;
+  atomic_ulong total_allocations;
+} MemCounters;
+
+static MemCounters g_counters[MEM_SUBSYSTEM_COUNT];
+static _Thread_local unsigned long t_allocations[MEM_SUBSYSTEM_COUNT];
+
+static void mem_track_charge(int subsystem, size_t size) {
+  MemCounters *counters = &g_counters[subsystem];
+  size_t bytes = atomic_fetch_add(&counters->bytes, size) + size;
+  size_t peak = atomic_load(&counters->peak_bytes);
+  while (bytes > peak &&
+         !atomic_compare_exchange_weak(&counters->peak_bytes, &peak, bytes))
+    ;
+  atomic_fetch_add(&counters->live_allocations, 1);
+  atomic_fetch_add(&counters->total_allocations, 1);
+}
+
+static void mem_track_release(int subsystem, size_t size) {
+  atomic_fetch_sub(&g_counters[subsystem].bytes, size);
+  atomic_fetch_sub(&g_counters[subsystem].live_allocations, 1);
+}
+
+static MemHeader *mem_track_header(void *ptr) {
+  return (MemHeader *)ptr - 1;
+}
+
+void *mem_track_malloc(MemSubsystem subsystem, size_t size) {
+  if (size > SIZE_MAX - sizeof(MemHeader))
+    return NULL;
+  MemHeader *header = (MemHeader *)malloc(sizeof(MemHeader) + size);
+  if (!header)
+    return NULL;
+  header->info.size = size;
+  header->info.subsystem = subsystem;
+  mem_track_charge(subsystem, size);
+  t_allocations[subsystem]++;
+  return header + 1;
+}
+
+void *mem_track_calloc(MemSubsystem subsystem, size_t count, size_t size) {
+  if (size != 0 && count > SIZE_MAX / size)
+    return NULL;
+  void *ptr = mem_track_malloc(subsystem, count * size);
+  if (ptr)
+    memset(ptr, 0, count * size);
+  return ptr;
+}
+
+void *mem_track_realloc(MemSubsystem subsystem, void *ptr, size_t size) {
+  if (!ptr)
+    return mem_track_malloc(subsystem, size);
+  if (size > SIZE_MAX - sizeof(MemHeader))
+    return NULL;
+
+  MemHeader *old = mem_track_header(ptr);
+  int old_subsystem = old->info.subsystem;
+  size_t old_size = old->info.size;
+  MemHeader *header = (MemHeader *)realloc(old, sizeof(MemHeader) + size);
+  if (!header)
+    return NULL;
+
+  // Re-charged as a new block so the counts show every reallocation
+  mem_track_release(old_subsystem, old_size);
+  header->info.size = size;
+  header->info.subsystem = subsystem;
+  mem_track_charge(subsystem, size);
+  t_allocations[subsystem]++;
+  return header + 1;
+}
+
+void mem_track_free(void *ptr) {
+  if (!ptr)
+    return;
+  MemHeader *header = mem_track_header(ptr);
+  mem_track_release(header->info.subsystem, header->info.size);
+  free(header);
+}
+
+void mem_track_texture_loaded(int width, int height, int bytes_per_texel) {
+  mem_track_charge(MEM_SUBSYSTEM_TEXTURES,
+                   (size_t)width * height * bytes_per_texel);
+}
+
+void mem_track_texture_unloaded(int width, int height, int bytes_per_texel) {
+  mem_track_release(MEM_SUBSYSTEM_TEXTURES,
+                    (size_t)width * height * bytes_per_texel);
+}
+
+void mem_track_stats(MemSubsystem subsystem, MemSubsystemStats *stats) {
+  MemCounters *counters = &g_counters[subsystem];
+  stats->bytes = atomic_load(&counters->bytes);
+  stats->peak_bytes = atomic_load(&counters->peak_bytes);
+  stats->live_allocations = atomic_load(&counters->live_allocations);
+  stats->total_allocations = atomic_load(&counters->total_allocations);
+}
+
+const char *mem_track_subsystem_name(MemSubsystem subsystem) {
+  return SUBSYSTEM_NAMES[subsystem];
+}
+
+unsigned long mem_track_thread_allocations(void) {
+  unsigned long total = 0;
+  for (int i = 0; i < MEM_SUBSYSTEM_COUNT; i++)
+    total += t_allocations[i];
+  return total;
+}
+
+unsigned long mem_track_thread_subsystem_allocations(MemSubsystem subsystem) {
+  return t_allocations[subsystem];
+}
@@ -0,0 +1,80 @@
+#ifndef MEM_TRACK_H
+#define MEM_TRACK_H
+
+#include <stddef.h>
+
+/**
+ * @brief Tracked heap allocations with per-subsystem accounting
+ *
+ * Drop-in replacements for malloc, calloc, realloc and free that charge
+ * every block to a subsystem. Each block carries a small header with its
+ * size and subsystem, so mem_track_free() needs neither. Live bytes, peak
+ * bytes and allocation counts are kept per subsystem with atomics, so any
+ * thread may allocate; allocation counts are also kept per thread, which
+ * lets the frame loop measure exactly what it allocated itself.
+ *
+ * Blocks from these functions must be released with mem_track_free() and
+ * never with free(), and the other way around.
+ */
+
+typedef enum {
+  MEM_SUBSYSTEM_LOADER,   // Replay index, JSON parsing, decoded entities
+  MEM_SUBSYSTEM_MAP,      // Tile maps
+  MEM_SUBSYSTEM_RENDERER, // Sprite batches, culling buffers, atlas data
+  MEM_SUBSYSTEM_CACHES,   // Map chunk table, minimap and overlay pixels
+  MEM_SUBSYSTEM_ANALYSIS, // Heatmap, fog of war, culling grids
+  MEM_SUBSYSTEM_JOBS,     // Job system deques and job records
+  MEM_SUBSYSTEM_TEXTURES, // GPU memory, reported by texture owners
+  MEM_SUBSYSTEM_COUNT
+} MemSubsystem;
+
+// Bytes per texel for mem_track_texture_*: render textures also carry a
+// depth buffer
+#define MEM_TRACK_TEXTURE_BPP 4
+#define MEM_TRACK_RENDER_TEXTURE_BPP 8
+
+typedef struct {
+  size_t bytes;      // Currently allocated
+  size_t peak_bytes; // Highest `bytes` seen
+  unsigned long live_allocations;
+  unsigned long total_allocations; // Every malloc, calloc and realloc
+} MemSubsystemStats;
+
+void *mem_track_malloc(MemSubsystem subsystem, size_t size);
+void *mem_track_calloc(MemSubsystem subsystem, size_t count, size_t size);
+
+/**
+ * @brief Resizes a tracked block, or allocates one when ptr is NULL
+ *
+ * On failure the original block is left untouched, as with realloc().
+ */
+void *mem_track_realloc(MemSubsystem subsystem, void *ptr, size_t size);
+
+/**
+ * @brief Releases a tracked block; NULL is ignored
+ */
+void mem_track_free(void *ptr);
+
+/**
+ * @brief Charges or releases GPU memory for a texture
+ *
+ * GPU allocations do not go through the heap, so owners report them when a
+ * texture is loaded or unloaded. They do not count as heap allocations of
+ * the calling thread.
+ */
+void mem_track_texture_loaded(int width, int height, int bytes_per_texel);
+void mem_track_texture_unloaded(int width, int height, int bytes_per_texel);
+
+void mem_track_stats(MemSubsystem subsystem, MemSubsystemStats *stats);
+const char *mem_track_subsystem_name(MemSubsystem subsystem);
+
+/**
+ * @brief Heap allocations made so far by the calling thread
+ *
+ * Take the difference between two calls to count the allocations of a
+ * stretch of code, such as one frame.
+ */
+unsigned long mem_track_thread_allocations(void);
+unsigned long mem_track_thread_subsystem_allocations(MemSubsystem subsystem);
+
+#endif
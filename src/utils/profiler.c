@@ -0,0 +1,167 @@
+#include "profiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PROFILER_MAX_DEPTH 8
+
+static const char *STAGE_NAMES[PROFILER_STAGE_COUNT] = {
+    "tick_load", "camera", "map", "objects", "units", "minimap", "ui",
+};
+
+static const char *COUNTER_NAMES[PROFILER_COUNTER_COUNT] = {
+    "draw_calls", "units", "objects", "sprites", "chunks", "allocations",
+};
+
+typedef struct {
+  ProfilerFrame history[PROFILER_HISTORY_FRAMES];
+  int head; // Next history slot to write
+  int count;
+
+  ProfilerFrame current;
+  double frame_start_ms;
+  bool in_frame;
+
+  // Open stages; only the innermost one accumulates time
+  ProfilerStage stack[PROFILER_MAX_DEPTH];
+  int depth;
+  double resumed_ms;
+} Profiler;
+
+static Profiler g_profiler = {0};
+
+double profiler_now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+void profiler_frame_begin(void) {
+  double now = profiler_now_ms();
+
+  // The previous frame ends where this one starts, so frame time includes
+  // presentation and the frame limiter
+  if (g_profiler.in_frame) {
+    g_profiler.current.frame_ms = now - g_profiler.frame_start_ms;
+    g_profiler.history[g_profiler.head] = g_profiler.current;
+    g_profiler.head = (g_profiler.head + 1) % PROFILER_HISTORY_FRAMES;
+    if (g_profiler.count < PROFILER_HISTORY_FRAMES)
+      g_profiler.count++;
+  }
+
+  memset(&g_profiler.current, 0, sizeof(g_profiler.current));
+  g_profiler.frame_start_ms = now;
+  g_profiler.in_frame = true;
+  g_profiler.depth = 0;
+}
+
+void profiler_frame_end(void) {
+  while (g_profiler.depth > 0)
+    profiler_stage_end(g_profiler.stack[g_profiler.depth - 1]);
+}
+
+void profiler_stage_begin(ProfilerStage stage) {
+  double now = profiler_now_ms();
+  if (g_profiler.depth > 0) {
+    ProfilerStage outer = g_profiler.stack[g_profiler.depth - 1];
+    g_profiler.current.stage_ms[outer] += now - g_profiler.resumed_ms;
+  }
+  if (g_profiler.depth < PROFILER_MAX_DEPTH)
+    g_profiler.stack[g_profiler.depth++] = stage;
+  g_profiler.resumed_ms = now;
+}
+
+void profiler_stage_end(ProfilerStage stage) {
+  if (g_profiler.depth == 0 || g_profiler.stack[g_profiler.depth - 1] != stage)
+    return;
+
+  double now = profiler_now_ms();
+  g_profiler.current.stage_ms[stage] += now - g_profiler.resumed_ms;
+  g_profiler.depth--;
+  g_profiler.resumed_ms = now;
+}
+
+void profiler_add_stage_ms(ProfilerStage stage, double ms) {
+  g_profiler.current.stage_ms[stage] += ms;
+}
+
+void profiler_set_counter(ProfilerCounter counter, int value) {
+  g_profiler.current.counters[counter] = value;
+}
+
+const ProfilerFrame *profiler_history_frame(int age) {
+  if (age < 0 || age >= g_profiler.count)
+    return NULL;
+  int index = (g_profiler.head - 1 - age + PROFILER_HISTORY_FRAMES) %
+              PROFILER_HISTORY_FRAMES;
+  return &g_profiler.history[index];
+}
+
+int profiler_history_count(void) { return g_profiler.count; }
+
+static int profiler_compare_double(const void *a, const void *b) {
+  double da = *(const double *)a, db = *(const double *)b;
+  return (da > db) - (da < db);
+}
+
+double profiler_frame_percentile(double percentile) {
+  if (g_profiler.count == 0)
+    return 0.0;
+
+  double sorted[PROFILER_HISTORY_FRAMES];
+  for (int i = 0; i < g_profiler.count; i++)
+    sorted[i] = g_profiler.history[i].frame_ms;
+  qsort(sorted, g_profiler.count, sizeof(double), profiler_compare_double);
+
+  int rank = (int)(percentile / 100.0 * (g_profiler.count - 1) + 0.5);
+  if (rank < 0)
+    rank = 0;
+  if (rank >= g_profiler.count)
+    rank = g_profiler.count - 1;
+  return sorted[rank];
+}
+
+double profiler_stage_average(ProfilerStage stage) {
+  if (g_profiler.count == 0)
+    return 0.0;
+  double total = 0.0;
+  for (int i = 0; i < g_profiler.count; i++)
+    total += g_profiler.history[i].stage_ms[stage];
+  return total / g_profiler.count;
+}
+
+const char *profiler_stage_name(ProfilerStage stage) {
+  return STAGE_NAMES[stage];
+}
+
+const char *profiler_counter_name(ProfilerCounter counter) {
+  return COUNTER_NAMES[counter];
+}
+
+bool profiler_dump_csv(const char *path) {
+  FILE *file = fopen(path, "w");
+  if (!file)
+    return false;
+
+  fprintf(file, "frame,frame_ms");
+  for (int s = 0; s < PROFILER_STAGE_COUNT; s++)
+    fprintf(file, ",%s_ms", STAGE_NAMES[s]);
+  for (int c = 0; c < PROFILER_COUNTER_COUNT; c++)
+    fprintf(file, ",%s", COUNTER_NAMES[c]);
+  fprintf(file, "\n");
+
+  for (int age = g_profiler.count - 1; age >= 0; age--) {
+    const ProfilerFrame *frame = profiler_history_frame(age);
+    fprintf(file, "%d,%.4f", g_profiler.count - 1 - age, frame->frame_ms);
+    for (int s = 0; s < PROFILER_STAGE_COUNT; s++)
+      fprintf(file, ",%.4f", frame->stage_ms[s]);
+    for (int c = 0; c < PROFILER_COUNTER_COUNT; c++)
+      fprintf(file, ",%d", frame->counters[c]);
+    fprintf(file, "\n");
+  }
+
+  bool ok = !ferror(file);
+  fclose(file);
+  return ok;
+}
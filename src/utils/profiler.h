@@ -0,0 +1,85 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdbool.h>
+
+/**
+ * @brief Per-frame stage timings for the render thread
+ *
+ * Stages are timed with a monotonic high-resolution clock. Nested stages
+ * are exclusive: while a stage is open inside another, only the inner one
+ * accumulates time. The last PROFILER_HISTORY_FRAMES frames are kept for
+ * the overlay graph, percentiles and CSV export.
+ */
+
+#define PROFILER_HISTORY_FRAMES 240
+
+typedef enum {
+  PROFILER_STAGE_TICK_LOAD, // Decode time of ticks picked up this frame
+  PROFILER_STAGE_CAMERA,
+  PROFILER_STAGE_MAP,
+  PROFILER_STAGE_OBJECTS,
+  PROFILER_STAGE_UNITS,
+  PROFILER_STAGE_MINIMAP,
+  PROFILER_STAGE_UI,
+  PROFILER_STAGE_COUNT
+} ProfilerStage;
+
+typedef enum {
+  PROFILER_COUNTER_DRAW_CALLS,
+  PROFILER_COUNTER_UNITS,
+  PROFILER_COUNTER_OBJECTS,
+  PROFILER_COUNTER_SPRITES,
+  PROFILER_COUNTER_CHUNKS,
+  PROFILER_COUNTER_ALLOCATIONS, // Tracked heap allocations on this thread
+  PROFILER_COUNTER_COUNT
+} ProfilerCounter;
+
+typedef struct {
+  double frame_ms; // Time from this frame's start to the next one's
+  double stage_ms[PROFILER_STAGE_COUNT];
+  int counters[PROFILER_COUNTER_COUNT];
+} ProfilerFrame;
+
+// High-resolution monotonic clock in milliseconds
+double profiler_now_ms(void);
+
+void profiler_frame_begin(void);
+void profiler_frame_end(void);
+void profiler_stage_begin(ProfilerStage stage);
+void profiler_stage_end(ProfilerStage stage);
+void profiler_add_stage_ms(ProfilerStage stage, double ms);
+void profiler_set_counter(ProfilerCounter counter, int value);
+
+/**
+ * @brief Returns a completed frame from the history
+ *
+ * @param age 0 for the most recent completed frame, up to
+ * profiler_history_count() - 1
+ */
+const ProfilerFrame *profiler_history_frame(int age);
+int profiler_history_count(void);
+
+/**
+ * @brief Frame-time percentile over the history
+ *
+ * @param percentile Between 0 and 100
+ */
+double profiler_frame_percentile(double percentile);
+
+/**
+ * @brief Average of one stage over the history
+ */
+double profiler_stage_average(ProfilerStage stage);
+
+const char *profiler_stage_name(ProfilerStage stage);
+const char *profiler_counter_name(ProfilerCounter counter);
+
+/**
+ * @brief Writes the history as CSV, oldest frame first
+ *
+ * @return bool False if the file could not be written
+ */
+bool profiler_dump_csv(const char *path);
+
+#endif
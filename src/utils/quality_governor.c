@@ -0,0 +1,200 @@
+#include "quality_governor.h"
+#include <stdio.h>
+
+// Smoothing factor of the frame-time averages
+#define GOVERNOR_EMA_ALPHA 0.1
+// Samples are clamped to this multiple of the target before smoothing, so a
+// one-off hitch (a stall loading a file, a window drag) decays quickly
+#define GOVERNOR_SAMPLE_CLAMP 2.0
+
+// Drop a level once the smoothed frame time stays this far over budget
+#define GOVERNOR_DEGRADE_RATIO 1.10
+#define GOVERNOR_DEGRADE_FRAMES 30
+
+// Climb a level once frames are on budget and the work leaves this much room
+#define GOVERNOR_UPGRADE_FRAME_RATIO 1.05
+#define GOVERNOR_UPGRADE_WORK_RATIO 0.55
+#define GOVERNOR_UPGRADE_HOLD_MIN 120
+#define GOVERNOR_UPGRADE_HOLD_MAX 1920
+
+// Frames after any change before the averages are trusted again
+#define GOVERNOR_COOLDOWN_FRAMES 45
+// A degrade this soon after an upgrade counts as a bounce
+#define GOVERNOR_BOUNCE_FRAMES 600
+// Stable frames after which the upgrade hold is halved again
+#define GOVERNOR_RELAX_FRAMES 1800
+
+static const QualitySettings LEVELS[QUALITY_LEVEL_COUNT] = {
+    {1.0f, 0.0f, true, 1},     {1.0f, 0.0f, true, 4},
+    {1.0f, 6.0f, true, 4},     {0.85f, 6.0f, true, 8},
+    {0.7f, 10.0f, true, 8},    {0.7f, 10.0f, false, 15},
+    {0.5f, 14.0f, false, 30},
+};
+
+static const char *LEVEL_NAMES[QUALITY_LEVEL_COUNT] = {
+    "full",      "minimap 15 Hz", "unit LOD",  "scale 85%",
+    "scale 70%", "no trees",      "scale 50%",
+};
+
+typedef struct {
+  bool enabled;
+  int level;
+  double target_ms;
+
+  double frame_ema;
+  double work_ema;
+  bool has_samples;
+
+  long frame;
+  int over_frames;
+  int under_frames;
+  int cooldown;
+  int upgrade_hold;
+  long last_upgrade_frame;
+  long last_degrade_frame;
+  long hold_changed_frame;
+
+  QualityDecision log[QUALITY_LOG_ENTRIES];
+  int log_head; // Next log slot to write
+  int log_count;
+} QualityGovernor;
+
+static QualityGovernor g_governor = {.level = 0, .target_ms = 1000.0 / 60.0};
+
+static void quality_governor_set_level(int level, const char *reason) {
+  QualityDecision *decision = &g_governor.log[g_governor.log_head];
+  decision->frame = g_governor.frame;
+  decision->from_level = g_governor.level;
+  decision->to_level = level;
+  snprintf(decision->reason, sizeof(decision->reason), "%s", reason);
+  g_governor.log_head = (g_governor.log_head + 1) % QUALITY_LOG_ENTRIES;
+  if (g_governor.log_count < QUALITY_LOG_ENTRIES)
+    g_governor.log_count++;
+
+  g_governor.level = level;
+  g_governor.over_frames = 0;
+  g_governor.under_frames = 0;
+  g_governor.cooldown = GOVERNOR_COOLDOWN_FRAMES;
+}
+
+void quality_governor_init(double target_frame_ms) {
+  g_governor = (QualityGovernor){
+      .enabled = true,
+      .target_ms = target_frame_ms,
+      .upgrade_hold = GOVERNOR_UPGRADE_HOLD_MIN,
+      .last_upgrade_frame = -GOVERNOR_BOUNCE_FRAMES,
+  };
+}
+
+void quality_governor_update(double frame_ms, double work_ms) {
+  if (!g_governor.enabled)
+    return;
+
+  double clamp = g_governor.target_ms * GOVERNOR_SAMPLE_CLAMP;
+  if (frame_ms > clamp)
+    frame_ms = clamp;
+  if (work_ms > clamp)
+    work_ms = clamp;
+  if (!g_governor.has_samples) {
+    g_governor.frame_ema = frame_ms;
+    g_governor.work_ema = work_ms;
+    g_governor.has_samples = true;
+  } else {
+    g_governor.frame_ema += (frame_ms - g_governor.frame_ema) * GOVERNOR_EMA_ALPHA;
+    g_governor.work_ema += (work_ms - g_governor.work_ema) * GOVERNOR_EMA_ALPHA;
+  }
+  g_governor.frame++;
+
+  if (g_governor.cooldown > 0) {
+    g_governor.cooldown--;
+    return;
+  }
+
+  // Long stretches without a degrade earn back a shorter upgrade wait
+  if (g_governor.upgrade_hold > GOVERNOR_UPGRADE_HOLD_MIN &&
+      g_governor.frame - g_governor.last_degrade_frame > GOVERNOR_RELAX_FRAMES &&
+      g_governor.frame - g_governor.hold_changed_frame > GOVERNOR_RELAX_FRAMES) {
+    g_governor.upgrade_hold /= 2;
+    g_governor.hold_changed_frame = g_governor.frame;
+  }
+
+  char reason[64];
+  double degrade_ms = g_governor.target_ms * GOVERNOR_DEGRADE_RATIO;
+  if (g_governor.frame_ema > degrade_ms) {
+    g_governor.under_frames = 0;
+    if (++g_governor.over_frames < GOVERNOR_DEGRADE_FRAMES ||
+        g_governor.level == QUALITY_LEVEL_COUNT - 1)
+      return;
+
+    // Undoing a recent upgrade means the headroom estimate was wrong; wait
+    // longer before trying that level again
+    bool bounce =
+        g_governor.frame - g_governor.last_upgrade_frame < GOVERNOR_BOUNCE_FRAMES;
+    if (bounce && g_governor.upgrade_hold < GOVERNOR_UPGRADE_HOLD_MAX) {
+      g_governor.upgrade_hold *= 2;
+      g_governor.hold_changed_frame = g_governor.frame;
+    }
+    snprintf(reason, sizeof(reason), "frame %.1f > %.1f ms%s",
+             g_governor.frame_ema, degrade_ms, bounce ? ", bounce" : "");
+    g_governor.last_degrade_frame = g_governor.frame;
+    quality_governor_set_level(g_governor.level + 1, reason);
+    return;
+  }
+  g_governor.over_frames = 0;
+
+  double work_limit_ms = g_governor.target_ms * GOVERNOR_UPGRADE_WORK_RATIO;
+  if (g_governor.level == 0 ||
+      g_governor.frame_ema > g_governor.target_ms * GOVERNOR_UPGRADE_FRAME_RATIO ||
+      g_governor.work_ema > work_limit_ms) {
+    g_governor.under_frames = 0;
+    return;
+  }
+  if (++g_governor.under_frames < g_governor.upgrade_hold)
+    return;
+
+  snprintf(reason, sizeof(reason), "work %.1f < %.1f ms for %d frames",
+           g_governor.work_ema, work_limit_ms, g_governor.upgrade_hold);
+  g_governor.last_upgrade_frame = g_governor.frame;
+  quality_governor_set_level(g_governor.level - 1, reason);
+}
+
+void quality_governor_set_enabled(bool enabled) {
+  if (enabled == g_governor.enabled)
+    return;
+  if (!enabled && g_governor.level != 0)
+    quality_governor_set_level(0, "governor disabled");
+  g_governor.enabled = enabled;
+  g_governor.over_frames = 0;
+  g_governor.under_frames = 0;
+  g_governor.has_samples = false;
+}
+
+bool quality_governor_is_enabled(void) { return g_governor.enabled; }
+
+const QualitySettings *quality_governor_settings(void) {
+  return &LEVELS[g_governor.level];
+}
+
+int quality_governor_level(void) { return g_governor.level; }
+
+const char *quality_governor_level_name(int level) {
+  if (level < 0 || level >= QUALITY_LEVEL_COUNT)
+    return "?";
+  return LEVEL_NAMES[level];
+}
+
+double quality_governor_target_ms(void) { return g_governor.target_ms; }
+double quality_governor_frame_ms(void) { return g_governor.frame_ema; }
+double quality_governor_work_ms(void) { return g_governor.work_ema; }
+int quality_governor_upgrade_hold(void) { return g_governor.upgrade_hold; }
+int quality_governor_upgrade_progress(void) { return g_governor.under_frames; }
+
+const QualityDecision *quality_governor_decision(int age) {
+  if (age < 0 || age >= g_governor.log_count)
+    return NULL;
+  int index =
+      (g_governor.log_head - 1 - age + QUALITY_LOG_ENTRIES) % QUALITY_LOG_ENTRIES;
+  return &g_governor.log[index];
+}
+
+int quality_governor_decision_count(void) { return g_governor.log_count; }
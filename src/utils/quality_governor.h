@@ -0,0 +1,79 @@
+#ifndef QUALITY_GOVERNOR_H
+#define QUALITY_GOVERNOR_H
+
+#include <stdbool.h>
+
+/**
+ * @brief Adaptive quality governor holding a target frame time
+ *
+ * Walks a fixed ladder of quality levels, each cheaper than the one before:
+ * less frequent minimap refreshes, flat unit sprites below a size threshold,
+ * a lower world render resolution and finally no trees. Frame times are
+ * smoothed so a single hitch never changes the level. Dropping a level
+ * takes a short sustained overrun; climbing back takes a much longer run
+ * with clear headroom, and every upgrade that has to be undone shortly after
+ * doubles that wait so the governor does not oscillate between two levels.
+ * Every level change is logged with its reason for the debug readout.
+ */
+
+#define QUALITY_LEVEL_COUNT 7
+#define QUALITY_LOG_ENTRIES 8
+
+// Knobs the renderer reads each frame
+typedef struct {
+  float render_scale;      // World pass resolution relative to the window
+  float unit_lod_pixels;   // Units smaller than this draw as flat quads
+  bool draw_objects;       // Trees and other map objects
+  int minimap_interval;    // Frames between minimap entity refreshes
+} QualitySettings;
+
+typedef struct {
+  long frame;       // Governor frame the decision was taken on
+  int from_level;
+  int to_level;
+  char reason[64];
+} QualityDecision;
+
+/**
+ * @brief Resets the governor to full quality
+ *
+ * @param target_frame_ms Frame time to hold, e.g. 1000 / target FPS
+ */
+void quality_governor_init(double target_frame_ms);
+
+/**
+ * @brief Feeds one completed frame and possibly changes level
+ *
+ * @param frame_ms Full frame time, including presentation and the limiter
+ * @param work_ms Time the frame spent on CPU work before presenting; with a
+ * frame limiter this is the only signal of how much headroom is left
+ */
+void quality_governor_update(double frame_ms, double work_ms);
+
+/**
+ * @brief Enables or disables the governor; disabling restores full quality
+ */
+void quality_governor_set_enabled(bool enabled);
+bool quality_governor_is_enabled(void);
+
+const QualitySettings *quality_governor_settings(void);
+int quality_governor_level(void);
+const char *quality_governor_level_name(int level);
+
+// Smoothed timings and the current wait before an upgrade, for the readout
+double quality_governor_target_ms(void);
+double quality_governor_frame_ms(void);
+double quality_governor_work_ms(void);
+int quality_governor_upgrade_hold(void);
+int quality_governor_upgrade_progress(void);
+
+/**
+ * @brief Returns a logged level change
+ *
+ * @param age 0 for the most recent decision, up to
+ * quality_governor_decision_count() - 1
+ */
+const QualityDecision *quality_governor_decision(int age);
+int quality_governor_decision_count(void);
+
+#endif
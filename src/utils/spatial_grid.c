@@ -0,0 +1,94 @@
+#include "spatial_grid.h"
+#include "mem_track.h"
+#include <stdlib.h>
+#include <string.h>
+
+static int spatial_grid_cell_of(const SpatialGrid *grid, float x, float y) {
+  int cx = (int)(x / grid->cell_size);
+  int cy = (int)(y / grid->cell_size);
+  if (x < 0 || cx < 0)
+    cx = 0;
+  if (y < 0 || cy < 0)
+    cy = 0;
+  if (cx >= grid->cells_x)
+    cx = grid->cells_x - 1;
+  if (cy >= grid->cells_y)
+    cy = grid->cells_y - 1;
+  return cy * grid->cells_x + cx;
+}
+
+bool spatial_grid_build(SpatialGrid *grid, const void *entities, int count,
+                        size_t stride, int map_width, int map_height,
+                        int cell_size) {
+  if (cell_size <= 0)
+    cell_size = 1;
+  grid->cell_size = cell_size;
+  grid->cells_x = map_width > 0 ? (map_width + cell_size - 1) / cell_size : 1;
+  grid->cells_y = map_height > 0 ? (map_height + cell_size - 1) / cell_size : 1;
+  grid->count = 0;
+
+  int cells = grid->cells_x * grid->cells_y;
+  if (cells + 1 > grid->cell_capacity) {
+    int *cell_start = (int *)mem_track_realloc(
+        MEM_SUBSYSTEM_ANALYSIS, grid->cell_start, (cells + 1) * sizeof(int));
+    if (!cell_start)
+      return false;
+    grid->cell_start = cell_start;
+    grid->cell_capacity = cells + 1;
+  }
+  if (count > grid->index_capacity) {
+    int *indices = (int *)mem_track_realloc(MEM_SUBSYSTEM_ANALYSIS,
+                                            grid->indices, count * sizeof(int));
+    if (!indices)
+      return false;
+    grid->indices = indices;
+    grid->index_capacity = count;
+  }
+
+  // Counting sort: histogram, exclusive prefix sum, scatter
+  memset(grid->cell_start, 0, (cells + 1) * sizeof(int));
+  const char *base = (const char *)entities;
+  for (int i = 0; i < count; i++) {
+    const float *pos = (const float *)(base + i * stride);
+    grid->cell_start[spatial_grid_cell_of(grid, pos[0], pos[1]) + 1]++;
+  }
+  for (int c = 0; c < cells; c++)
+    grid->cell_start[c + 1] += grid->cell_start[c];
+
+  // cell_start[c] doubles as the write cursor and is restored afterwards
+  for (int i = 0; i < count; i++) {
+    const float *pos = (const float *)(base + i * stride);
+    int cell = spatial_grid_cell_of(grid, pos[0], pos[1]);
+    grid->indices[grid->cell_start[cell]++] = i;
+  }
+  for (int c = cells; c > 0; c--)
+    grid->cell_start[c] = grid->cell_start[c - 1];
+  grid->cell_start[0] = 0;
+
+  grid->count = count;
+  return true;
+}
+
+bool spatial_grid_cell_range(const SpatialGrid *grid, float x, float y,
+                             float width, float height, int *first_cx,
+                             int *first_cy, int *last_cx, int *last_cy) {
+  if (!grid->cell_start || x + width < 0 || y + height < 0)
+    return false;
+
+  *first_cx = x < 0 ? 0 : (int)(x / grid->cell_size);
+  *first_cy = y < 0 ? 0 : (int)(y / grid->cell_size);
+  *last_cx = (int)((x + width) / grid->cell_size);
+  *last_cy = (int)((y + height) / grid->cell_size);
+  if (*last_cx >= grid->cells_x)
+    *last_cx = grid->cells_x - 1;
+  if (*last_cy >= grid->cells_y)
+    *last_cy = grid->cells_y - 1;
+
+  return *first_cx <= *last_cx && *first_cy <= *last_cy;
+}
+
+void spatial_grid_free(SpatialGrid *grid) {
+  mem_track_free(grid->cell_start);
+  mem_track_free(grid->indices);
+  *grid = (SpatialGrid){0};
+}
@@ -0,0 +1,58 @@
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Uniform bucket grid over map space for culling and neighbour queries
+ *
+ * Entities are counting-sorted by cell: indices of the entities in cell c
+ * are indices[cell_start[c]] .. indices[cell_start[c + 1] - 1]. Storage is
+ * kept between rebuilds so a grid refreshed every tick does not allocate
+ * once it has grown to the working set.
+ */
+
+typedef struct {
+  int cell_size; // Cell edge in tiles
+  int cells_x;
+  int cells_y;
+  int *cell_start; // cells_x * cells_y + 1 offsets into indices
+  int *indices;    // Entity indices ordered by cell
+  int count;       // Number of bucketed entities
+  int cell_capacity;
+  int index_capacity;
+} SpatialGrid;
+
+/**
+ * @brief Buckets entities by position
+ *
+ * Positions are read as two consecutive floats (x, y) at the start of every
+ * entity, so Unit and Object arrays can be passed directly. Entities outside
+ * the map are clamped into the border cells.
+ *
+ * @param grid Grid to rebuild
+ * @param entities First entity
+ * @param count Number of entities
+ * @param stride Size of one entity in bytes
+ * @param map_width Map width in tiles
+ * @param map_height Map height in tiles
+ * @param cell_size Cell edge in tiles
+ * @return bool False if storage could not be grown
+ */
+bool spatial_grid_build(SpatialGrid *grid, const void *entities, int count,
+                        size_t stride, int map_width, int map_height,
+                        int cell_size);
+
+/**
+ * @brief Converts a tile-space rectangle to an inclusive cell range
+ *
+ * @return bool False if the rectangle does not overlap the grid
+ */
+bool spatial_grid_cell_range(const SpatialGrid *grid, float x, float y,
+                             float width, float height, int *first_cx,
+                             int *first_cy, int *last_cx, int *last_cy);
+
+void spatial_grid_free(SpatialGrid *grid);
+
+#endif
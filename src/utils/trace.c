@@ -0,0 +1,189 @@
+#include "trace.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+  const char *name;
+  uint64_t start_ns;
+  uint64_t end_ns;
+} TraceEvent;
+
+typedef struct TraceThreadBuffer {
+  struct TraceThreadBuffer *next;
+  int thread_id;
+  char thread_name[32];
+  atomic_ullong head; // Total events written; slot is head % capacity
+  TraceEvent events[TRACE_EVENTS_PER_THREAD];
+} TraceThreadBuffer;
+
+atomic_bool g_trace_enabled = false;
+
+static pthread_mutex_t g_trace_registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static TraceThreadBuffer *g_trace_buffers = NULL;
+static int g_trace_next_thread_id = 1;
+static _Thread_local TraceThreadBuffer *t_trace_buffer = NULL;
+static _Thread_local char t_trace_thread_name[32];
+
+uint64_t trace_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static TraceThreadBuffer *trace_thread_buffer(void) {
+  if (t_trace_buffer)
+    return t_trace_buffer;
+
+  TraceThreadBuffer *buffer =
+      (TraceThreadBuffer *)calloc(1, sizeof(TraceThreadBuffer));
+  if (!buffer)
+    return NULL;
+  atomic_init(&buffer->head, 0);
+
+  pthread_mutex_lock(&g_trace_registry_mutex);
+  buffer->thread_id = g_trace_next_thread_id++;
+  if (t_trace_thread_name[0])
+    snprintf(buffer->thread_name, sizeof(buffer->thread_name), "%s",
+             t_trace_thread_name);
+  else
+    snprintf(buffer->thread_name, sizeof(buffer->thread_name), "thread %d",
+             buffer->thread_id);
+  buffer->next = g_trace_buffers;
+  g_trace_buffers = buffer;
+  pthread_mutex_unlock(&g_trace_registry_mutex);
+
+  t_trace_buffer = buffer;
+  return buffer;
+}
+
+void trace_record(const char *name, uint64_t start_ns, uint64_t end_ns) {
+  TraceThreadBuffer *buffer = trace_thread_buffer();
+  if (!buffer)
+    return;
+
+  // Only this thread writes its buffer; publishing head with release lets
+  // an exporter see the event once it sees the new head
+  unsigned long long head =
+      atomic_load_explicit(&buffer->head, memory_order_relaxed);
+  buffer->events[head % TRACE_EVENTS_PER_THREAD] =
+      (TraceEvent){name, start_ns, end_ns};
+  atomic_store_explicit(&buffer->head, head + 1, memory_order_release);
+}
+
+void trace_set_enabled(bool enabled) { atomic_store(&g_trace_enabled, enabled); }
+
+bool trace_is_enabled(void) { return atomic_load(&g_trace_enabled); }
+
+// Threads that never record never get a buffer, so the name is kept
+// thread-locally until the first zone
+void trace_set_thread_name(const char *name) {
+  snprintf(t_trace_thread_name, sizeof(t_trace_thread_name), "%s", name);
+  if (!t_trace_buffer)
+    return;
+  pthread_mutex_lock(&g_trace_registry_mutex);
+  snprintf(t_trace_buffer->thread_name, sizeof(t_trace_buffer->thread_name),
+           "%s", name);
+  pthread_mutex_unlock(&g_trace_registry_mutex);
+}
+
+// Writes a JSON string literal, escaping the few characters that need it
+static void trace_write_string(FILE *file, const char *text) {
+  fputc('"', file);
+  for (const char *c = text; *c; c++) {
+    if (*c == '"' || *c == '\\')
+      fputc('\\', file);
+    if ((unsigned char)*c >= 0x20)
+      fputc(*c, file);
+  }
+  fputc('"', file);
+}
+
+bool trace_write_json(const char *path) {
+  FILE *file = fopen(path, "w");
+  if (!file)
+    return false;
+
+  TraceEvent *scratch =
+      (TraceEvent *)malloc(TRACE_EVENTS_PER_THREAD * sizeof(TraceEvent));
+  if (!scratch) {
+    fclose(file);
+    return false;
+  }
+
+  // Timestamps are written relative to the oldest recorded zone
+  pthread_mutex_lock(&g_trace_registry_mutex);
+  uint64_t epoch = UINT64_MAX;
+  for (TraceThreadBuffer *b = g_trace_buffers; b; b = b->next) {
+    unsigned long long head = atomic_load_explicit(&b->head, memory_order_acquire);
+    unsigned long long first =
+        head > TRACE_EVENTS_PER_THREAD ? head - TRACE_EVENTS_PER_THREAD : 0;
+    for (unsigned long long i = first; i < head; i++) {
+      uint64_t start = b->events[i % TRACE_EVENTS_PER_THREAD].start_ns;
+      if (start < epoch)
+        epoch = start;
+    }
+  }
+  if (epoch == UINT64_MAX)
+    epoch = 0;
+
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  bool first_event = true;
+
+  for (TraceThreadBuffer *b = g_trace_buffers; b; b = b->next) {
+    fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                  "\"tid\":%d,\"args\":{\"name\":",
+            first_event ? "" : ",\n", b->thread_id);
+    trace_write_string(file, b->thread_name);
+    fprintf(file, "}}");
+    first_event = false;
+
+    // Copy the live window, then drop whatever the owner overwrote meanwhile
+    unsigned long long head = atomic_load_explicit(&b->head, memory_order_acquire);
+    unsigned long long first =
+        head > TRACE_EVENTS_PER_THREAD ? head - TRACE_EVENTS_PER_THREAD : 0;
+    for (unsigned long long i = first; i < head; i++)
+      scratch[i - first] = b->events[i % TRACE_EVENTS_PER_THREAD];
+    unsigned long long head_after =
+        atomic_load_explicit(&b->head, memory_order_acquire);
+    unsigned long long valid_from = head_after > TRACE_EVENTS_PER_THREAD
+                                        ? head_after - TRACE_EVENTS_PER_THREAD
+                                        : 0;
+    if (valid_from < first)
+      valid_from = first;
+
+    for (unsigned long long i = valid_from; i < head; i++) {
+      const TraceEvent *e = &scratch[i - first];
+      if (e->start_ns < epoch)
+        continue;
+      fprintf(file, ",\n{\"name\":");
+      trace_write_string(file, e->name);
+      fprintf(file,
+              ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+              b->thread_id, (e->start_ns - epoch) / 1000.0,
+              (e->end_ns - e->start_ns) / 1000.0);
+    }
+  }
+  pthread_mutex_unlock(&g_trace_registry_mutex);
+
+  fprintf(file, "\n]}\n");
+  free(scratch);
+
+  bool ok = !ferror(file);
+  fclose(file);
+  return ok;
+}
+
+void trace_shutdown(void) {
+  trace_set_enabled(false);
+  pthread_mutex_lock(&g_trace_registry_mutex);
+  while (g_trace_buffers) {
+    TraceThreadBuffer *next = g_trace_buffers->next;
+    free(g_trace_buffers);
+    g_trace_buffers = next;
+  }
+  pthread_mutex_unlock(&g_trace_registry_mutex);
+  t_trace_buffer = NULL;
+}
@@ -0,0 +1,84 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Scoped-zone instrumentation exported as Chrome trace-event JSON
+ *
+ * Zones are recorded as complete events into a per-thread ring buffer, so
+ * recording never takes a lock and long sessions keep the most recent
+ * TRACE_EVENTS_PER_THREAD zones of every thread. The resulting file opens in
+ * chrome://tracing and ui.perfetto.dev.
+ *
+ * Usage:
+ *   TRACE_ZONE_BEGIN(zone, "LoadReplayTick");
+ *   ...
+ *   TRACE_ZONE_END(zone);
+ *
+ * Zone names must be string literals (or otherwise outlive the trace). When
+ * recording is off a zone costs one relaxed atomic load; building without
+ * AXIOM_TRACE compiles zones out entirely.
+ */
+
+#define TRACE_EVENTS_PER_THREAD (1 << 16)
+
+typedef struct {
+  const char *name;
+  uint64_t start_ns; // 0 when the zone was opened while recording was off
+} TraceZone;
+
+extern atomic_bool g_trace_enabled;
+
+uint64_t trace_now_ns(void);
+void trace_record(const char *name, uint64_t start_ns, uint64_t end_ns);
+
+static inline TraceZone trace_zone_begin(const char *name) {
+  TraceZone zone = {name, 0};
+  if (atomic_load_explicit(&g_trace_enabled, memory_order_relaxed))
+    zone.start_ns = trace_now_ns();
+  return zone;
+}
+
+static inline void trace_zone_end(const TraceZone *zone) {
+  if (zone->start_ns)
+    trace_record(zone->name, zone->start_ns, trace_now_ns());
+}
+
+#ifdef AXIOM_TRACE
+#define TRACE_ZONE_BEGIN(var, name) TraceZone var = trace_zone_begin(name)
+#define TRACE_ZONE_END(var) trace_zone_end(&(var))
+#else
+#define TRACE_ZONE_BEGIN(var, name) ((void)0)
+#define TRACE_ZONE_END(var) ((void)0)
+#endif
+
+/**
+ * @brief Starts or stops recording for all threads
+ */
+void trace_set_enabled(bool enabled);
+bool trace_is_enabled(void);
+
+/**
+ * @brief Names the calling thread in exported traces
+ */
+void trace_set_thread_name(const char *name);
+
+/**
+ * @brief Writes every thread's recorded zones as Chrome trace-event JSON
+ *
+ * Safe to call while other threads keep recording; zones overwritten during
+ * the export are dropped rather than written torn.
+ *
+ * @return bool False if the file could not be written
+ */
+bool trace_write_json(const char *path);
+
+/**
+ * @brief Frees all per-thread buffers; no thread may record afterwards
+ */
+void trace_shutdown(void);
+
+#endif